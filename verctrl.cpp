@@ -18,6 +18,9 @@
 #include <memory>
 #include <stdio.h>
 #include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
 #define snprintf _snprintf
 
 #include "mex.h"
@@ -25,6 +28,20 @@
 
 #include "verctrl.h"
 #include "verctrlUtil.h"
+#include "verctrlRecord.h"
+#include "verctrlPath.h"
+#include "verctrlProvider.h"
+#include "verctrlCache.h"
+#include "verctrlJournal.h"
+#include "verctrlPristine.h"
+#include "verctrlWatch.h"
+#include "verctrlMerkle.h"
+#include "verctrlSubscribe.h"
+#include "verctrlGit.h"
+#include "verctrlCvs.h"
+#include "verctrlRcs.h"
+#include "verctrlProject.h"
+#include "verctrlPrefetch.h"
 #include "resources/verctrl/verctrl.hpp"
 
 #include "package.h"
@@ -40,13 +57,10 @@
 
 #define strcmpi _strcmpi
 
-static char userName[SCC_USER_LEN + 1];
-static void* context        = NULL;
-static LONG capability      = 0x00000000L;
-static LONG chkCommentLength;
-static LONG cmtLen;
-static HMODULE serverLib    = NULL;
-static char currentWorkingFolder[_MAX_PATH];
+// Provider selected with cmopts. Files in folders mapped to another
+// provider with MAP_PROVIDER are not sent to it.
+static SCCPROVIDER* gDefaultProvider = NULL;
+static bool gExitRegistered = false;
 // DLL to use instead of the Source Control Provider specified in the registry.
 // For debugging purposes.
 static char* gDebugDLL = NULL;
@@ -225,174 +239,301 @@ static char* identifySCCSystem(SCCARGS *sccArgs) {
 }
 
 
-void startSCCSystem(SCCARGS* sccArgs, char* libPath) {
+static SCCPROVIDER* startSCCSystem(SCCARGS* sccArgs, const char* libPath) {
+
+    SCCPROVIDER* provider = findProvider(libPath);
+    if (provider != NULL) {
+        return provider;
+    }
 
     if (gVerboseMode) mexPrintf("Attempting to load library \"%s\"\n", libPath);
 
-    // Step 3: Load the DLL
-    serverLib       = LoadLibrary(libPath);
-    if (serverLib == NULL)
+    // Step 3 and 4: Load the DLL and initialize the SCC provider.
+    bool loaded;
+    SCCRTN rtn;
+    provider = startProvider(sccArgs->WindowHandle, libPath, &loaded, &rtn);
+    if (!loaded)
     {
         if (gVerboseMode) mexPrintf("Failed to load library \"%s\"\n", libPath);
-        mxFree(libPath);
 		throwMatlabError(sccArgs,verctrl::verctrl::ProviderFailedToLoad());
     }
-    if (gVerboseMode) mexPrintf("Finished loading library \"%s\"\n", libPath);
-
-    mxFree(libPath);
-
-    // Step 4: Initialize the SCC provider.
-    char axPath[SCC_PRJPATH_LEN + 1];
-    char sccName[SCC_NAME_LEN + 1];
-    char projName[SCC_PRJPATH_LEN + 1];
-
-    userName[0]     = '\0';
-    axPath[0]       = '\0';
-    projName[0]     = '\0';
-    sccName[0]      = '\0';
-    currentWorkingFolder[0] = '\0';
-
-    // get the user name from the environment, it's used when opening projects
-    if (strlen(userName) == 0) {
-        const char *usrNm = getenv("USER");
-        if (usrNm != NULL) {
-            if (strlen(usrNm) <= SCC_USER_LEN) {
-                strcpy(userName, usrNm);
-            }
-        }
-    }
-    if (gVerboseMode) mexPrintf("Attempting to SccInitialize\n");
-
-    SCCRTN rtn      = (*(SccInitialize_PROC) GetProcAddress(serverLib, "SccInitialize"))
-        (&context, sccArgs->WindowHandle, "MATLAB", sccName, &capability, axPath,
-        &chkCommentLength, &cmtLen);
-    if (IS_SCC_ERROR(rtn)) {
+    if (provider == NULL) {
 		if (gVerboseMode) mexPrintf("verctrl: SCC provider failed to initialize: %s\n",
 			errorCodeToString(rtn));
-        FreeLibrary(serverLib);
-        serverLib   = NULL;
 		throwMatlabError(sccArgs,verctrl::verctrl::FailedToInitialize());
     }
 
     // clean up - do not free sccArgs in this case, it is not an error condition path
-    if (gVerboseMode) mexPrintf("verctrl: SCC provider initialized successfully\n");
+    if (gVerboseMode) mexPrintf("verctrl: SCC provider \"%s\" initialized successfully\n", provider->SccName);
+    return provider;
 }
 
 
-void loadSCCSystem(SCCARGS* sccArgs) {
+static SCCPROVIDER* loadSCCSystem(SCCARGS* sccArgs) {
 
-    if (serverLib != NULL) {
-        return;
+    SCCPROVIDER* provider = gDefaultProvider;
+    if (provider != NULL) {
+        return provider;
     }
 
     if (gDebugDLL != NULL) {
-        // There's no mxStrdup
-        mxArray* temp = mxCreateString(gDebugDLL);
-        char* copy = mxArrayToString(temp);
-        startSCCSystem(sccArgs, copy);
+        provider = startSCCSystem(sccArgs, gDebugDLL);
     } else {
-       char* libPath = identifySCCSystem(sccArgs);
-       startSCCSystem(sccArgs,libPath); 
+       char libPath[_MAX_PATH];
+       char* sccLib = identifySCCSystem(sccArgs);
+       strncpy(libPath, sccLib, _MAX_PATH - 1);
+       libPath[_MAX_PATH - 1] = '\0';
+       mxFree(sccLib);
+       provider = startSCCSystem(sccArgs, libPath);
     }
+    InterlockedCompareExchangePointer((PVOID volatile *)&gDefaultProvider, provider, NULL);
+    return gDefaultProvider;
 }
 
 /*
-* Close the currently opened project if any.
+* The provider for a file: the one mapped to the file's folder with
+* MAP_PROVIDER, or the default provider.
 */
-static void closeProject() {
-    FARPROC proc    = GetProcAddress(serverLib, "SccCloseProject");
-    if (gVerboseMode) mexPrintf("verctrl: closing current project\n");
-    (*(SccCloseProject_PROC) proc) (context);
+static SCCPROVIDER* providerForFile(SCCARGS* sccArgs, PATHID file) {
+    char libPath[_MAX_PATH];
+    if (!providerLibForPath(file, libPath)) {
+        return loadSCCSystem(sccArgs);
+    }
+    return startSCCSystem(sccArgs, libPath);
+}
+
+/*
+* Sessions borrowed by the command running on this thread. An error
+* leaves mexFunction without returning, so the sessions are released
+* before a command raises one while it holds them. The next command
+* releases anything still held, in case an error came from elsewhere.
+*/
+#define MAX_HELD_SESSIONS 64
+static __declspec(thread) SCCSESSION* tHeldSessions[MAX_HELD_SESSIONS];
+static __declspec(thread) int tNumberOfHeldSessions = 0;
+
+static void releaseHeldSession(SCCSESSION* session) {
+    for (int i = 0; i < tNumberOfHeldSessions; i++) {
+        if (tHeldSessions[i] == session) {
+            tHeldSessions[i] = tHeldSessions[--tNumberOfHeldSessions];
+            break;
+        }
+    }
+    releaseSession(session);
+}
+
+static void releaseHeldSessions() {
+    while (tNumberOfHeldSessions > 0) {
+        releaseSession(tHeldSessions[--tNumberOfHeldSessions]);
+    }
+}
+
+static void releaseAndThrowSccError(SCCARGS* sccArgs, SCCRTN rtn) {
+    releaseHeldSessions();
+    throwSccError(sccArgs, rtn);
 }
 
 /*
-* Unload the source control system library.
+* Borrow a session of the provider, preferably one with the project of
+* folder open, waiting for one if they are all in use. folder may be
+* NO_PATH.
+*/
+static SCCSESSION* holdSession(SCCARGS* sccArgs, SCCPROVIDER* provider, PATHID folder) {
+    SCCSESSION* session = acquireSession(provider, sccArgs->WindowHandle, folder);
+    if (session == NULL) {
+        releaseHeldSessions();
+		throwMatlabError(sccArgs,verctrl::verctrl::FailedToInitialize());
+    }
+    if (tNumberOfHeldSessions < MAX_HELD_SESSIONS) {
+        tHeldSessions[tNumberOfHeldSessions++] = session;
+    }
+    return session;
+}
+
+/*
+* Unload all the source control system libraries.
 */
 static void unloadSCCSystem() {
-    if (serverLib == NULL) {
+    if (!hasProviders()) {
         return;
     }
     else {
         if (gVerboseMode) mexPrintf("verctrl: Unloading SCC DLL\n");
-        closeProject();
-        FARPROC proc    = GetProcAddress(serverLib, "SccUninitialize");
-        (*(SccUninitialize_PROC) proc) (context);
-        FreeLibrary(serverLib);
-        serverLib = NULL;
+        gDefaultProvider = NULL;
+        unloadAllProviders();
+        invalidateAllStatus();
+    }
+}
+
+/*
+* Unload the default provider, unless folders are still mapped to it.
+*/
+static void unloadDefaultProvider() {
+    SCCPROVIDER* provider = (SCCPROVIDER*)InterlockedExchangePointer((PVOID volatile *)&gDefaultProvider, NULL);
+    if (provider == NULL) {
+        return;
+    }
+    for (int i = 0; i < getNumberOfMappings(); i++) {
+        char folder[_MAX_PATH], libPath[_MAX_PATH];
+        if (getMapping(i, folder, libPath) && _stricmp(libPath, provider->LibPath) == 0) {
+            return;
+        }
+    }
+    if (gVerboseMode) mexPrintf("verctrl: Unloading SCC DLL \"%s\"\n", provider->LibPath);
+    unloadProvider(provider);
+    invalidateAllStatus();
+}
+
+// Results of savedProjectInfo.
+#define PROJECT_NOT_SAVED   0
+#define PROJECT_SAVED       1
+#define PROJECT_ERROR       -1
+
+/*
+* Call getsccprj for dir. Returns PROJECT_ERROR if it cannot be called,
+* otherwise whether a project is saved for dir; its name and aux path
+* are left in plhs for the caller to destroy.
+*/
+static int callGetSccPrj(const char *dir, mxArray *plhs[2]) {
+    mxArray *prhs[1] = {NULL};
+    prhs[0]          = mxCreateString(dir);
+    if (prhs[0] == NULL) {
+        return PROJECT_ERROR;
+    }
+    plhs[0] = NULL;
+    plhs[1] = NULL;
+    mexSetTrapFlag(1);
+    int status       = mexCallMATLAB(2, plhs, 1, prhs, "getsccprj");
+    mxDestroyArray(prhs[0]);
+    if (status != 0 || plhs[0] == NULL || plhs[1] == NULL) {
+        if (gVerboseMode) mexPrintf("verctrl: error calling getsccprj\n");
+        return PROJECT_ERROR;
     }
+    return mxIsEmpty(plhs[0]) ? PROJECT_NOT_SAVED : PROJECT_SAVED;
+}
+
+/*
+* Look up the project saved for folder with savesccprj, in the project
+* cache first. Returns PROJECT_ERROR if getsccprj cannot be called.
+* fileName is a file in folder as the caller spelled it, or NULL:
+* projects saved before folders were looked up by their canonical name
+* are under the folder's spelling, and are saved again under the
+* canonical name once found there.
+*/
+static int savedProjectInfo(PATHID folder, const char *fileName, char *projName, char *axPath) {
+    if (lookupProjectInfo(folder, projName, axPath)) {
+        return PROJECT_SAVED;
+    }
+    const char *localDir = pathName(folder);
+
+    // Query matlab to get the projectName, lpAuxProjPath.
+    mxArray    *plhs[2] = {NULL, NULL};
+    int saved        = callGetSccPrj(localDir, plhs);
+    if (saved == PROJECT_ERROR) {
+        return PROJECT_ERROR;
+    }
+    const char *separator = fileName != NULL ? strrchr(fileName, '\\') : NULL;
+    const char *slash     = fileName != NULL ? strrchr(fileName, '/') : NULL;
+    if (slash > separator)
+        separator = slash;
+    if (saved == PROJECT_NOT_SAVED && separator != NULL) {
+        std::string spelling(fileName, separator - fileName);
+        mxArray *old[2] = {NULL, NULL};
+        if (!spelling.empty() && spelling != localDir &&
+            callGetSccPrj(spelling.c_str(), old) == PROJECT_SAVED) {
+            if (gVerboseMode) mexPrintf("verctrl: moving the project saved for \"%s\" to \"%s\"\n",
+                spelling.c_str(), localDir);
+            mxArray *rhs[3] = {mxCreateString(localDir), old[0], old[1]};
+            mexSetTrapFlag(1);
+            mexCallMATLAB(0, NULL, 3, rhs, "savesccprj");
+            mxDestroyArray(rhs[0]);
+            mxDestroyArray(plhs[0]);
+            mxDestroyArray(plhs[1]);
+            plhs[0] = old[0];
+            plhs[1] = old[1];
+            saved   = PROJECT_SAVED;
+        } else {
+            if (old[0] != NULL)
+                mxDestroyArray(old[0]);
+            if (old[1] != NULL)
+                mxDestroyArray(old[1]);
+        }
+    }
+    if (saved == PROJECT_SAVED) { //Previously saved.
+        axPath[0]        = '\0';
+        projName[0]      = '\0';
+
+        // update for 64 bit mxarrays, cast to int.  Never will have 64 bit project name
+        int prjNmLth     = static_cast<int>(mxGetNumberOfElements(plhs[0])) + 1;
+        mxGetString(plhs[0], projName, prjNmLth);
+        if (strlen(projName) == 0) {
+            strcpy(projName, localDir);
+        }
+        // update for 64 bit mxarrays, cast to int.  Never will have 64 bit aux path name 
+        int axPthLth =  static_cast<int>(mxGetNumberOfElements(plhs[1])) + 1;
+		mxGetString(plhs[1], axPath, axPthLth);
+
+        if (!utStrcmp(projName,empty_proj_placeholder)) {
+            /* The string matches our placeholder for an empty
+               project name.  Replace with an empty string. */
+            projName[0] = '\0';
+        }
+
+        if (!utStrcmp(axPath,empty_path_placeholder)) {
+            /* The string matches our placeholder for an empty
+               path.  Replace with an empty string. */
+            axPath[0] = '\0';
+        }
+        storeProjectInfo(folder, projName, axPath);
+    }
+
+    // Clean up
+    mxDestroyArray(plhs[0]);
+    mxDestroyArray(plhs[1]);
+    return saved;
+}
+
+/*
+* As savedProjectInfo, throwing an error if getsccprj cannot be called.
+* Returns false if no project was saved for the folder. The first file
+* of sccArgs gives the folder's old spelling if it is in folder.
+*/
+static bool getSavedProjectInfo(SCCARGS *sccArgs, PATHID folder, char *projName, char *axPath) {
+    const char *fileName = NULL;
+    if (sccArgs->FileNames != NULL && sccArgs->NumberOfFiles > 0 &&
+        internParentPath(sccArgs->FileNames[0]) == folder)
+        fileName = sccArgs->FileNames[0];
+    int saved = savedProjectInfo(folder, fileName, projName, axPath);
+    if (saved == PROJECT_ERROR) {
+        releaseHeldSessions();
+		throwMatlabError(sccArgs,verctrl::verctrl::NoProvider());
+    }
+    return saved == PROJECT_SAVED;
 }
 
 /*
 * Open the given project. This will close any existing open projects.
 */
-static SCCRTN openProjFromSavedInfo(SCCARGS *sccArgs, HWND hWnd) {
+static SCCRTN openProjFromSavedInfo(SCCSESSION *session, SCCARGS *sccArgs, PATHID folder, HWND hWnd) {
     SCCRTN rtn       = SCC_E_INITIALIZEFAILED;
 
-    char localDir[_MAX_PATH];
-    getParentPath(sccArgs->FileNames[0], localDir);
-    if (strcmp(localDir, currentWorkingFolder) == 0) {
+    const char *localDir = pathName(folder);
+    if (folder == session->CurrentFolder) {
         if (gVerboseMode) mexPrintf("verctrl: (openProjFromSavedInfo) already in this folder\n");
         rtn = SCC_OK;
     }
     else {
-        // Query matlab to get the projectName, lpAuxProjPath.
-        mxArray *prhs[1] = {NULL};
-        prhs[0]          = mxCreateString(localDir);
-        if (prhs[0] == NULL) {
-			throwMatlabError(sccArgs,verctrl::verctrl::MemoryError());
-        }
-        mxArray    *plhs[2] = {NULL, NULL};
-        mexSetTrapFlag(1);
-        int status       = mexCallMATLAB(2, plhs, 1, prhs, "getsccprj");
-        if (status != 0 || plhs[0] == NULL || plhs[1] == NULL) {
-            if (gVerboseMode) mexPrintf("verctrl: error calling getsccprj\n");
-			throwMatlabError(sccArgs,verctrl::verctrl::NoProvider());
-        }
-        if (!mxIsEmpty(plhs[0])) { //Previously saved.
-            char axPath[SCC_PRJPATH_LEN + 1];
-            char projName[SCC_PRJPATH_LEN + 1];
-            axPath[0]        = '\0';
-            projName[0]      = '\0';
-
-            closeProject();
-            // update for 64 bit mxarrays, cast to int.  Never will have 64 bit project name
-            int prjNmLth     = static_cast<int>(mxGetNumberOfElements(plhs[0])) + 1;
-            mxGetString(plhs[0], projName, prjNmLth);
-            if (strlen(projName) == 0) {
-                strcpy(projName, const_cast<const char *>(localDir));
-            }
-            // update for 64 bit mxarrays, cast to int.  Never will have 64 bit aux path name 
-            int axPthLth =  static_cast<int>(mxGetNumberOfElements(plhs[1])) + 1;
-			mxGetString(plhs[1], axPath, axPthLth);
-
-            if (!utStrcmp(projName,empty_proj_placeholder)) {
-                /* The string matches our placeholder for an empty
-                   project name.  Replace with an empty string. */
-                projName[0] = '\0';
-            }
-
-            if (!utStrcmp(axPath,empty_path_placeholder)) {
-                /* The string matches our placeholder for an empty
-                   path.  Replace with an empty string. */
-                axPath[0] = '\0';
-            }
-
-            rtn =  (*(SccOpenProject_PROC) GetProcAddress(serverLib, "SccOpenProject"))
-                (context, hWnd, userName, projName, localDir,
-                axPath, "", NULL, SCC_OP_SILENTOPEN & ~SCC_OP_CREATEIFNEW);
+        char axPath[SCC_PRJPATH_LEN + 1];
+        char projName[SCC_PRJPATH_LEN + 1];
+        if (getSavedProjectInfo(sccArgs, folder, projName, axPath)) {
+            if (gVerboseMode) mexPrintf("verctrl: closing current project\n");
+            rtn = openSessionProject(session, hWnd, folder, projName, axPath);
             if (IS_SCC_SUCCESS(rtn)) {
                 if (gVerboseMode) mexPrintf("verctrl: (openProjFromSavedInfo) current working folder is now \"%s\"\n", localDir);
-                strcpy(currentWorkingFolder, localDir);
             }
             else if (IS_SCC_ERROR(rtn)) {
                 if (gVerboseMode) mexPrintf("verctrl: (openProjFromSavedInfo) error calling SccOpenProject\n", localDir);
-                currentWorkingFolder[0] = '\0';
             }
-
-            // Clean up
-            mxDestroyArray(prhs[0]);
-            mxDestroyArray(plhs[0]);
-            mxDestroyArray(plhs[1]);
         } else if (gVerboseMode) {
             mexPrintf("verctrl: (openProjFromSavedInfo) No project name stored\n");
         }
@@ -404,7 +545,7 @@ static SCCRTN openProjFromSavedInfo(SCCARGS *sccArgs, HWND hWnd) {
 /*
 * Open project for the given folder based on the saved info or prompt to select a SCC project.
 */
-static SCCRTN promptAndOpenProject(const char *localFile, HWND hWnd) {
+static SCCRTN promptAndOpenProject(SCCSESSION *session, PATHID folder, HWND hWnd) {
     char axPath[SCC_PRJPATH_LEN + 1];
     char projName[SCC_PRJPATH_LEN + 1];
     char localDir[_MAX_PATH];
@@ -414,11 +555,20 @@ static SCCRTN promptAndOpenProject(const char *localFile, HWND hWnd) {
 
     if (gVerboseMode) mexPrintf("verctrl: promptAndOpenProject\n");
 
-    getParentPath(localFile, localDir);
-    SCCRTN rtn      = (*(SccGetProjPath_PROC) GetProcAddress(serverLib, "SccGetProjPath"))
-        (context, hWnd, userName, projName, localDir,
+    strncpy(localDir, pathName(folder), _MAX_PATH - 1);
+    localDir[_MAX_PATH - 1] = '\0';
+    LPCSTR projDir[1] = {localDir};
+    SCCRECORD rec;
+    recordBegin(&rec, session->Provider->LibPath, session->Context, SCCPROC_GETPROJPATH, 1, projDir, NULL, 0);
+    SCCRTN rtn      = (*(SccGetProjPath_PROC) session->Provider->Procs[SCCPROC_GETPROJPATH])
+        (session->Context, hWnd, session->UserName, projName, localDir,
         axPath, false, &pbNew);
+    LONG projResults[1]         = {pbNew};
+    const char *projStrings[4]  = {session->UserName, projName, localDir, axPath};
+    recordEnd(&rec, rtn, 1, projResults, 4, projStrings);
     if (IS_SCC_SUCCESS(rtn)) {
+        // The provider may have picked another folder.
+        folder = internPath(localDir);
         if (strlen(projName)==0) {
             /* Since we can't handle empty project names, use the
                placeholder. */
@@ -431,10 +581,8 @@ static SCCRTN promptAndOpenProject(const char *localFile, HWND hWnd) {
         }
         if (gVerboseMode) mexPrintf("verctrl:  SccGetProjPath succeeded.\n"
 	 			"Project name \"%s\", AuxPath \"%s\"\n", projName, axPath);
-        closeProject();
-        rtn         = (*(SccOpenProject_PROC) GetProcAddress(serverLib, "SccOpenProject"))
-            (context, hWnd, userName, projName, localDir,
-            axPath, "", NULL, SCC_OP_SILENTOPEN & ~SCC_OP_CREATEIFNEW);
+        if (gVerboseMode) mexPrintf("verctrl: closing current project\n");
+        rtn         = openSessionProject(session, hWnd, folder, projName, axPath);
         if (IS_SCC_SUCCESS(rtn)) {// Save results back in matlab.
 	        if (gVerboseMode) mexPrintf("verctrl:  SccOpenProject succeeded.\n"
 				"Saving project info for dicrectory \"%s\"\n", localDir);
@@ -444,6 +592,9 @@ static SCCRTN promptAndOpenProject(const char *localFile, HWND hWnd) {
             rhs[2]          = mxCreateString(axPath);
             mexSetTrapFlag(1);
             mexCallMATLAB(0, NULL, 3, rhs, "savesccprj");
+            storeProjectInfo(folder,
+                utStrcmp(projName, empty_proj_placeholder) ? projName : "",
+                utStrcmp(axPath, empty_path_placeholder) ? axPath : "");
 
             // Clean up.
             mxDestroyArray(rhs[0]);
@@ -454,7 +605,6 @@ static SCCRTN promptAndOpenProject(const char *localFile, HWND hWnd) {
 
     if (IS_SCC_SUCCESS(rtn)) {
         if (gVerboseMode) mexPrintf("verctrl: (promptAndOpenProject) current working folder is now \"%s\"\n", localDir);
-        strcpy(currentWorkingFolder, localDir);
     }
     return rtn;
 }
@@ -462,23 +612,28 @@ static SCCRTN promptAndOpenProject(const char *localFile, HWND hWnd) {
 /*
 * Add a new file into the source code control system.
 */
-static bool add(SCCARGS *sccArgs) {
+static bool add(SCCSESSION *session, SCCARGS *sccArgs) {
     bool reload     = true;
     if (!sccArgs->Quiet) {
-        reload      = showSCCUI(sccArgs, capability, cmtLen);
+        reload      = showSCCUI(sccArgs, session->Provider->Capability, session->Provider->CommentLen);
     }
     if (reload) {
         LONG *fOptions  = (LONG*)mxCalloc(sccArgs->NumberOfFiles, sizeof(LONG));
         for (int i = 0; i < sccArgs->NumberOfFiles; i++)
             fOptions[i] = sccArgs->KeepCheckout ? SCC_KEEP_CHECKEDOUT : 0;
-        int rtn         = (*(SccAdd_PROC) GetProcAddress(serverLib, "SccAdd"))
-            (context, sccArgs->WindowHandle, sccArgs->NumberOfFiles,
+        SCCRECORD rec;
+        recordBegin(&rec, session->Provider->LibPath, session->Context, SCCPROC_ADD, sccArgs->NumberOfFiles,
+            const_cast<const char **>(sccArgs->FileNames), sccArgs->Comment,
+            sccArgs->KeepCheckout ? SCC_KEEP_CHECKEDOUT : 0);
+        int rtn         = (*(SccAdd_PROC) session->Provider->Procs[SCCPROC_ADD])
+            (session->Context, sccArgs->WindowHandle, sccArgs->NumberOfFiles,
             const_cast<const char **>(sccArgs->FileNames),
             sccArgs->Comment, fOptions, NULL);
+        recordEnd(&rec, rtn, sccArgs->NumberOfFiles, fOptions, 0, NULL);
 
          // Throw error if necessary
         if (IS_SCC_ERROR(rtn))
-           throwSccError(sccArgs,rtn);
+           releaseAndThrowSccError(sccArgs,rtn);
     }
     return reload;
 }
@@ -486,21 +641,25 @@ static bool add(SCCARGS *sccArgs) {
 /*
 * Retrive a copy of a file for viewing and compling, but not editing.
 */
-static bool get(SCCARGS *sccArgs) {
+static bool get(SCCSESSION *session, SCCARGS *sccArgs) {
     bool reload     = true;
     if (!sccArgs->Quiet) {
-        reload      = showSCCUI(sccArgs, capability, cmtLen);
+        reload      = showSCCUI(sccArgs, session->Provider->Capability, session->Provider->CommentLen);
     }
     if (reload) {
         LONG fOptions = 0;
-        int rtn         = (*(SccGet_PROC) GetProcAddress(serverLib, "SccGet"))
-            (context, sccArgs->WindowHandle, sccArgs->NumberOfFiles,
+        SCCRECORD rec;
+        recordBegin(&rec, session->Provider->LibPath, session->Context, SCCPROC_GET, sccArgs->NumberOfFiles,
+            const_cast<const char **>(sccArgs->FileNames), NULL, fOptions);
+        int rtn         = (*(SccGet_PROC) session->Provider->Procs[SCCPROC_GET])
+            (session->Context, sccArgs->WindowHandle, sccArgs->NumberOfFiles,
             const_cast<const char **>(sccArgs->FileNames),
             fOptions, NULL);
+        recordEnd(&rec, rtn, 0, NULL, 0, NULL);
 
         // Throw error if necessary
         if (IS_SCC_ERROR(rtn))
-            throwSccError(sccArgs, rtn);
+            releaseAndThrowSccError(sccArgs, rtn);
      }
     return reload;
 }
@@ -508,21 +667,25 @@ static bool get(SCCARGS *sccArgs) {
 /*
 * Retrive a copy of the file for editing.
 */
-static bool checkout(SCCARGS *sccArgs) {
+static bool checkout(SCCSESSION *session, SCCARGS *sccArgs) {
     bool reload     = true;
     if (!sccArgs->Quiet) {
-        reload = showSCCUI(sccArgs, capability, chkCommentLength);
+        reload = showSCCUI(sccArgs, session->Provider->Capability, session->Provider->CheckoutCommentLen);
     }
     if (reload) {
         LONG fOptions = 0;
-        int rtn         = (*(SccCheckout_PROC) GetProcAddress(serverLib, "SccCheckout"))
-            (context, sccArgs->WindowHandle, sccArgs->NumberOfFiles,
+        SCCRECORD rec;
+        recordBegin(&rec, session->Provider->LibPath, session->Context, SCCPROC_CHECKOUT, sccArgs->NumberOfFiles,
+            const_cast<const char **>(sccArgs->FileNames), sccArgs->Comment, fOptions);
+        int rtn         = (*(SccCheckout_PROC) session->Provider->Procs[SCCPROC_CHECKOUT])
+            (session->Context, sccArgs->WindowHandle, sccArgs->NumberOfFiles,
             const_cast<const char **>(sccArgs->FileNames),
             sccArgs->Comment, fOptions, NULL);
+        recordEnd(&rec, rtn, 0, NULL, 0, NULL);
 
         // Throw error if necessary
         if (IS_SCC_ERROR(rtn))
-            throwSccError(sccArgs, rtn);
+            releaseAndThrowSccError(sccArgs, rtn);
     }
     return reload;
 }
@@ -531,20 +694,24 @@ static bool checkout(SCCARGS *sccArgs) {
 * This operation checks checked-out files back into SCC system, storing the changes
 * and creating a new version.
 */
-static bool checkin(SCCARGS *sccArgs) {
+static bool checkin(SCCSESSION *session, SCCARGS *sccArgs) {
     bool reload = true;
     if (!sccArgs->Quiet) {
-        reload = showSCCUI(sccArgs, capability, cmtLen);
+        reload = showSCCUI(sccArgs, session->Provider->Capability, session->Provider->CommentLen);
     }
     if (reload) {
         LONG fOptions = sccArgs->KeepCheckout ?  SCC_KEEP_CHECKEDOUT : 0;
-        int rtn       = (*(SccCheckin_PROC) GetProcAddress(serverLib, "SccCheckin"))
-            (context, sccArgs->WindowHandle, sccArgs->NumberOfFiles,
+        SCCRECORD rec;
+        recordBegin(&rec, session->Provider->LibPath, session->Context, SCCPROC_CHECKIN, sccArgs->NumberOfFiles,
+            const_cast<const char **>(sccArgs->FileNames), sccArgs->Comment, fOptions);
+        int rtn       = (*(SccCheckin_PROC) session->Provider->Procs[SCCPROC_CHECKIN])
+            (session->Context, sccArgs->WindowHandle, sccArgs->NumberOfFiles,
             const_cast<const char **>(sccArgs->FileNames),
             sccArgs->Comment, fOptions, NULL);
+        recordEnd(&rec, rtn, 0, NULL, 0, NULL);
 
         if (IS_SCC_ERROR(rtn))
-            throwSccError(sccArgs, rtn);
+            releaseAndThrowSccError(sccArgs, rtn);
     }
     return reload;
 }
@@ -554,21 +721,25 @@ static bool checkin(SCCARGS *sccArgs) {
 * or files to the way they ere before the checkout. All changes made to the file
 * since the checkout were lost.
 */
-static bool uncheckout(SCCARGS *sccArgs) {
+static bool uncheckout(SCCSESSION *session, SCCARGS *sccArgs) {
     bool reload     = true;
     if (!sccArgs->Quiet) {
-        reload      = showSCCUI(sccArgs, capability, cmtLen);
+        reload      = showSCCUI(sccArgs, session->Provider->Capability, session->Provider->CommentLen);
     }
     if (reload) {
         LONG fOptions = 0;
-        int rtn         = (*(SccUncheckout_PROC) GetProcAddress(serverLib, "SccUncheckout"))
-            (context, sccArgs->WindowHandle, sccArgs->NumberOfFiles,
+        SCCRECORD rec;
+        recordBegin(&rec, session->Provider->LibPath, session->Context, SCCPROC_UNCHECKOUT, sccArgs->NumberOfFiles,
+            const_cast<const char **>(sccArgs->FileNames), NULL, fOptions);
+        int rtn         = (*(SccUncheckout_PROC) session->Provider->Procs[SCCPROC_UNCHECKOUT])
+            (session->Context, sccArgs->WindowHandle, sccArgs->NumberOfFiles,
             const_cast<const char **>(sccArgs->FileNames),
             fOptions, NULL);
+        recordEnd(&rec, rtn, 0, NULL, 0, NULL);
 
         // Throw error if necessary
         if (IS_SCC_ERROR(rtn))
-            throwSccError(sccArgs, rtn);
+            releaseAndThrowSccError(sccArgs, rtn);
     }
     return reload;
 }
@@ -576,50 +747,64 @@ static bool uncheckout(SCCARGS *sccArgs) {
 /*
 * Remove files from source control system.
 */
-static void remove(SCCARGS *sccArgs) {
+static void remove(SCCSESSION *session, SCCARGS *sccArgs) {
     if (!sccArgs->Quiet) {
-        bool approved = showSCCUI(sccArgs, capability, cmtLen);
+        bool approved = showSCCUI(sccArgs, session->Provider->Capability, session->Provider->CommentLen);
         if (!approved)
             return;
     }
 
     LONG fOptions = 0;
-    int rtn         = (*(SccRemove_PROC) GetProcAddress(serverLib, "SccRemove"))
-        (context, sccArgs->WindowHandle, sccArgs->NumberOfFiles,
+    SCCRECORD rec;
+    recordBegin(&rec, session->Provider->LibPath, session->Context, SCCPROC_REMOVE, sccArgs->NumberOfFiles,
+        const_cast<const char **>(sccArgs->FileNames), sccArgs->Comment, fOptions);
+    int rtn         = (*(SccRemove_PROC) session->Provider->Procs[SCCPROC_REMOVE])
+        (session->Context, sccArgs->WindowHandle, sccArgs->NumberOfFiles,
         const_cast<const char **>(sccArgs->FileNames),
         sccArgs->Comment, fOptions, NULL);
+    recordEnd(&rec, rtn, 0, NULL, 0, NULL);
 
     // Throw error if necessary
     if (IS_SCC_ERROR(rtn))
-       throwSccError(sccArgs, rtn);
+       releaseAndThrowSccError(sccArgs, rtn);
+}
+
+/*
+* Call SccDiff on a single file with the given diff options.
+*/
+static int sccDiff(SCCSESSION *session, char *fileName, HWND windowHandle, LONG fOptions) {
+    LPCSTR diffFile[1] = {fileName};
+    SCCRECORD rec;
+    recordBegin(&rec, session->Provider->LibPath, session->Context, SCCPROC_DIFF, 1, diffFile, NULL, fOptions);
+    int rtn         = (*(SccDiff_PROC) session->Provider->Procs[SCCPROC_DIFF])
+        (session->Context, windowHandle, fileName, fOptions, NULL);
+    recordEnd(&rec, rtn, 0, NULL, 0, NULL);
+    return rtn;
 }
 
 /*
 * Is there any differences between working copy and latest version of a file.
 */
-static bool isDiff(char *fileName, HWND windowHandle) {
-    int rtn         = (*(SccDiff_PROC) GetProcAddress(serverLib, "SccDiff"))
-        (context, windowHandle, fileName, SCC_DIFF_QD_CHECKSUM, NULL);
+static bool isDiff(SCCSESSION *session, char *fileName, HWND windowHandle) {
+    int rtn         = sccDiff(session, fileName, windowHandle, SCC_DIFF_QD_CHECKSUM);
     return (rtn == SCC_I_FILEDIFFERS);
 }
 
-static int isFileDiff(char *fileName, HWND windowHandle) {
-    int rtn         = (*(SccDiff_PROC) GetProcAddress(serverLib, "SccDiff"))
-        (context, windowHandle, fileName, SCC_DIFF_QD_CHECKSUM, NULL);
+static int isFileDiff(SCCSESSION *session, char *fileName, HWND windowHandle) {
+    int rtn         = sccDiff(session, fileName, windowHandle, SCC_DIFF_QD_CHECKSUM);
     return (rtn);
 }
 /*
 * Display differences between the working copy and latest version of a file.
 */
-static void showDiff(SCCARGS *sccArgs) {
+static void showDiff(SCCSESSION *session, SCCARGS *sccArgs) {
     int rtn;
-    rtn = isFileDiff(sccArgs->FileNames[0], sccArgs->WindowHandle);
+    rtn = isFileDiff(session, sccArgs->FileNames[0], sccArgs->WindowHandle);
     if (rtn == SCC_I_FILEDIFFERS) 
     {
-         rtn = (*(SccDiff_PROC) GetProcAddress(serverLib, "SccDiff"))
-            (context, sccArgs->WindowHandle, sccArgs->FileNames[0], SCC_DIFF_IGNORESPACE, NULL);
+         rtn = sccDiff(session, sccArgs->FileNames[0], sccArgs->WindowHandle, SCC_DIFF_IGNORESPACE);
         if (IS_SCC_ERROR(rtn))
-            throwSccError(sccArgs, rtn);
+            releaseAndThrowSccError(sccArgs, rtn);
     }
     else {
         // note: we are not doing anything special with error returns SCC_E_FILENOTCONTROLLED, SCC_E_NOTAUTHORIZED, 
@@ -631,8 +816,10 @@ static void showDiff(SCCARGS *sccArgs) {
         // the file are equal SCCI Telelogic ScciDiff function return the value:
         // SCC_E_NONSPECIFICERROR
         // They do not want to see the following message when a graphical merge took place.
-        if (rtn == SCC_OK)
-			throwMatlabError(sccArgs, verctrl::verctrl::DiffError());
+        if (rtn == SCC_OK) {
+            releaseHeldSessions();
+            throwMatlabError(sccArgs, verctrl::verctrl::DiffError());
+        }
     }
 }
 
@@ -640,14 +827,18 @@ static void showDiff(SCCARGS *sccArgs) {
 * Displays the histroy of the passed file or files.
 * Return true if the file has changed and needs to be reloaded.
 */
-static bool history(SCCARGS *sccArgs){
-    int rtn            = (*(SccHistory_PROC) GetProcAddress(serverLib, "SccHistory"))
-        (context, sccArgs->WindowHandle, sccArgs->NumberOfFiles, 
+static bool history(SCCSESSION *session, SCCARGS *sccArgs){
+    SCCRECORD rec;
+    recordBegin(&rec, session->Provider->LibPath, session->Context, SCCPROC_HISTORY, sccArgs->NumberOfFiles,
+        const_cast<LPCSTR*>(sccArgs->FileNames), NULL, 0x0);
+    int rtn            = (*(SccHistory_PROC) session->Provider->Procs[SCCPROC_HISTORY])
+        (session->Context, sccArgs->WindowHandle, sccArgs->NumberOfFiles, 
          const_cast<LPCSTR*>(sccArgs->FileNames), 0x0, NULL);
+    recordEnd(&rec, rtn, 0, NULL, 0, NULL);
     if (rtn == SCC_I_RELOADFILE)
         return true;
     else if (IS_SCC_ERROR(rtn))
-        throwSccError(sccArgs, rtn);
+        releaseAndThrowSccError(sccArgs, rtn);
     return false;
 }
 
@@ -655,22 +846,38 @@ static bool history(SCCARGS *sccArgs){
 * Display version specific properties of the passed file.
 * Return true if the file has changed and needs to be reloaded.
 */
-static bool properties(SCCARGS *sccArgs) {
-    int rtn         = (*(SccProperties_PROC) GetProcAddress(serverLib, "SccProperties"))
-        (context, sccArgs->WindowHandle, sccArgs->FileNames[0]);
+static bool properties(SCCSESSION *session, SCCARGS *sccArgs) {
+    SCCRECORD rec;
+    recordBegin(&rec, session->Provider->LibPath, session->Context, SCCPROC_PROPERTIES, 1,
+        const_cast<LPCSTR*>(sccArgs->FileNames), NULL, 0);
+    int rtn         = (*(SccProperties_PROC) session->Provider->Procs[SCCPROC_PROPERTIES])
+        (session->Context, sccArgs->WindowHandle, sccArgs->FileNames[0]);
+    recordEnd(&rec, rtn, 0, NULL, 0, NULL);
     if (rtn == SCC_I_RELOADFILE)
         return true;
     else if (IS_SCC_ERROR(rtn))
-        throwSccError(sccArgs, rtn);
+        releaseAndThrowSccError(sccArgs, rtn);
     return false;
 }
 
 /*
 * Get the status of a file.
+* May be called on a worker thread; does not use the MEX API.
 */
-static int fileStatus(char **fileNames, const int numberOfFiles, LPLONG fileStatus) {
-    int ret = (*(SccQueryInfo_PROC) GetProcAddress(serverLib, "SccQueryInfo"))(context, numberOfFiles,
+static int fileStatus(SCCSESSION *session, char **fileNames, const int numberOfFiles, LPLONG fileStatus) {
+    SCCRECORD rec;
+    recordBegin(&rec, session->Provider->LibPath, session->Context, SCCPROC_QUERYINFO, numberOfFiles,
+        const_cast<const char **>(fileNames), NULL, 0);
+    int ret = (*(SccQueryInfo_PROC) session->Provider->Procs[SCCPROC_QUERYINFO])(session->Context, numberOfFiles,
         const_cast<const char **>(fileNames), fileStatus);
+    recordEnd(&rec, ret, numberOfFiles, fileStatus, 0, NULL);
+	return ret;
+}
+
+/*
+* Print the status of files when in verbose mode.
+*/
+static void printFileStatus(char **fileNames, const int numberOfFiles, LPLONG fileStatus) {
 	if (gVerboseMode) {
 		mexPrintf("verctrl: fileStatus\n");
 		for (int i=0; i<numberOfFiles; i++) {
@@ -679,26 +886,626 @@ static int fileStatus(char **fileNames, const int numberOfFiles, LPLONG fileStat
 			mexPrintf("  %s  :  %s\n", fileNames[i], x.c_str());
 		}
 	}
-	return ret;
+}
+
+/*
+* Files of one command that are routed to the same provider.
+*/
+typedef struct PROVIDERGROUP {
+    SCCPROVIDER    *Provider;
+    SCCARGS         Args;       // the command's arguments, with only this group's files
+    int            *Index;      // position of each file in the command's file list
+    LPLONG          Status;
+    SCCRTN          Rtn;
+    PATHID         *Ids;        // interned name of each file
+    // STATUS only: the folder of the group's files and its saved project
+    PATHID          Folder;
+    char            ProjName[SCC_PRJPATH_LEN + 1];
+    char            AxPath[SCC_PRJPATH_LEN + 1];
+} PROVIDERGROUP;
+
+/*
+* Intern the file names of a command.
+*/
+static PATHID* internFileNames(SCCARGS *sccArgs) {
+    PATHID *ids = (PATHID *) mxCalloc(sccArgs->NumberOfFiles, sizeof(PATHID));
+    if (ids == NULL)
+		throwMatlabError(sccArgs, verctrl::verctrl::MemoryError());
+    for (int i = 0; i < sccArgs->NumberOfFiles; i++)
+        ids[i] = internPath(sccArgs->FileNames[i]);
+    return ids;
+}
+
+/*
+* Split the files of a command by the provider they are routed to, and
+* by folder too if byFolder is set. Returns the number of groups.
+*/
+static int groupFilesByProvider(SCCARGS *sccArgs, const PATHID *ids, PROVIDERGROUP **groups, bool byFolder) {
+    PROVIDERGROUP *group = (PROVIDERGROUP *) mxCalloc(sccArgs->NumberOfFiles, sizeof(PROVIDERGROUP));
+    int *groupOf = (int *) mxCalloc(sccArgs->NumberOfFiles, sizeof(int));
+    if (group == NULL || groupOf == NULL)
+		throwMatlabError(sccArgs, verctrl::verctrl::MemoryError());
+    std::map<std::pair<SCCPROVIDER *, PATHID>, int> groupIndex;
+    int numberOfGroups = 0;
+    for (int i = 0; i < sccArgs->NumberOfFiles; i++) {
+        SCCPROVIDER *provider = providerForFile(sccArgs, ids[i]);
+        PATHID folder = byFolder ? parentPathId(ids[i]) : NO_PATH;
+        std::map<std::pair<SCCPROVIDER *, PATHID>, int>::iterator it =
+            groupIndex.insert(std::make_pair(std::make_pair(provider, folder), numberOfGroups)).first;
+        int g = it->second;
+        if (g == numberOfGroups) {
+            group[g].Provider           = provider;
+            group[g].Args               = *sccArgs;
+            group[g].Folder             = folder;
+            numberOfGroups++;
+        }
+        groupOf[i] = g;
+        // Counted here, and set back to 0 to fill the group once its
+        // arrays are allocated.
+        group[g].Args.NumberOfFiles++;
+    }
+    for (int g = 0; g < numberOfGroups; g++) {
+        int numberOfFiles               = group[g].Args.NumberOfFiles;
+        group[g].Args.NumberOfFiles     = 0;
+        group[g].Args.FileNames         = (char **) mxCalloc(numberOfFiles, sizeof(char *));
+        group[g].Index                  = (int *) mxCalloc(numberOfFiles, sizeof(int));
+        group[g].Ids                    = (PATHID *) mxCalloc(numberOfFiles, sizeof(PATHID));
+        if (group[g].Args.FileNames == NULL || group[g].Index == NULL || group[g].Ids == NULL)
+			throwMatlabError(sccArgs, verctrl::verctrl::MemoryError());
+    }
+    for (int i = 0; i < sccArgs->NumberOfFiles; i++) {
+        PROVIDERGROUP *target = &group[groupOf[i]];
+        target->Index[target->Args.NumberOfFiles] = i;
+        target->Ids[target->Args.NumberOfFiles]   = ids[i];
+        target->Args.FileNames[target->Args.NumberOfFiles++] = sccArgs->FileNames[i];
+    }
+    mxFree(groupOf);
+    *groups = group;
+    return numberOfGroups;
+}
+
+/*
+* Status of one group of files, in a session borrowed for the group.
+* May be called on a worker thread; does not use the MEX API.
+*/
+static void groupStatus(PROVIDERGROUP *group) {
+    SCCSESSION *session = acquireSession(group->Provider, group->Args.WindowHandle, group->Folder);
+    if (session == NULL) {
+        group->Rtn = SCC_E_INITIALIZEFAILED;
+        return;
+    }
+    group->Rtn = SCC_OK;
+    if (session->CurrentFolder != group->Folder) {
+        group->Rtn = openSessionProject(session, group->Args.WindowHandle,
+            group->Folder, group->ProjName, group->AxPath);
+    }
+    if (!IS_SCC_ERROR(group->Rtn)) {
+        group->Rtn = fileStatus(session, group->Args.FileNames,
+            group->Args.NumberOfFiles, group->Status);
+    }
+    releaseSession(session);
+}
+
+typedef struct STATUSWORK {
+    PROVIDERGROUP **Groups;
+    int             NumberOfGroups;
+    volatile LONG   Next;
+} STATUSWORK;
+
+static DWORD WINAPI statusThread(LPVOID arg) {
+    STATUSWORK *work = (STATUSWORK *) arg;
+    for (;;) {
+        LONG g = InterlockedIncrement(&work->Next) - 1;
+        if (g >= work->NumberOfGroups)
+            break;
+        groupStatus(work->Groups[g]);
+    }
+    return 0;
 }
 
 /*
 * Invoke the source code control system.
 */
-static int runScc(HWND windowHandle) {
-    return (*(SccRunScc_PROC) GetProcAddress(serverLib, "SccRunScc"))
-        (context, windowHandle, 0, NULL);
+static int runScc(SCCSESSION *session, HWND windowHandle) {
+    SCCRECORD rec;
+    recordBegin(&rec, session->Provider->LibPath, session->Context, SCCPROC_RUNSCC, 0, NULL, NULL, 0);
+    int rtn = (*(SccRunScc_PROC) session->Provider->Procs[SCCPROC_RUNSCC])
+        (session->Context, windowHandle, 0, NULL);
+    recordEnd(&rec, rtn, 0, NULL, 0, NULL);
+    return rtn;
+}
+
+// Tag of the timer that calls SUBSCRIBE callbacks.
+#define EVENT_TIMER_TAG "verctrl-events"
+
+// Every subscription made with SUBSCRIBE, and its callback or NULL.
+static std::map<int, mxArray*> gSubscriptions;
+static mxArray* gEventTimer = NULL;
+
+/*
+* Start the timer that drains events for SUBSCRIBE callbacks. MATLAB
+* functions may only be called on the MATLAB thread, so the subscription
+* thread cannot call them itself.
+*/
+static void startEventTimer(SCCARGS *sccArgs) {
+    if (gEventTimer != NULL)
+        return;
+    mxArray *fcnText = mxCreateString("@(~,~)verctrl('DISPATCH_EVENTS')");
+    mxArray *fcn = NULL;
+    mexSetTrapFlag(1);
+    if (fcnText == NULL || mexCallMATLAB(1, &fcn, 1, &fcnText, "str2func") != 0)
+		throwMatlabError(sccArgs, verctrl::verctrl::MemoryError());
+    mxArray *rhs[10] = {
+        mxCreateString("TimerFcn"), fcn,
+        mxCreateString("Period"), mxCreateDoubleScalar(0.25),
+        mxCreateString("ExecutionMode"), mxCreateString("fixedSpacing"),
+        mxCreateString("BusyMode"), mxCreateString("drop"),
+        mxCreateString("Tag"), mxCreateString(EVENT_TIMER_TAG)};
+    mexSetTrapFlag(1);
+    if (mexCallMATLAB(1, &gEventTimer, 10, rhs, "timer") != 0) {
+        if (gVerboseMode) mexPrintf("verctrl: error calling timer\n");
+        gEventTimer = NULL;
+    } else {
+        mexMakeArrayPersistent(gEventTimer);
+        mexSetTrapFlag(1);
+        mexCallMATLAB(0, NULL, 1, &gEventTimer, "start");
+    }
+    mxDestroyArray(fcnText);
+    for (int i = 0; i < 10; i++)
+        mxDestroyArray(rhs[i]);
+}
+
+/*
+* Stop and delete the event timer, and any left by an earlier load of
+* this MEX file.
+*/
+static void stopEventTimers() {
+    mxArray *rhs[2] = {mxCreateString("Tag"), mxCreateString(EVENT_TIMER_TAG)};
+    mxArray *timers = NULL;
+    mexSetTrapFlag(1);
+    if (mexCallMATLAB(1, &timers, 2, rhs, "timerfind") == 0 && timers != NULL) {
+        if (!mxIsEmpty(timers)) {
+            mexSetTrapFlag(1);
+            mexCallMATLAB(0, NULL, 1, &timers, "stop");
+            mexSetTrapFlag(1);
+            mexCallMATLAB(0, NULL, 1, &timers, "delete");
+        }
+        mxDestroyArray(timers);
+    }
+    mxDestroyArray(rhs[0]);
+    mxDestroyArray(rhs[1]);
+    if (gEventTimer != NULL) {
+        mxDestroyArray(gEventTimer);
+        gEventTimer = NULL;
+    }
+}
+
+static bool hasEventCallbacks() {
+    for (std::map<int, mxArray*>::const_iterator it = gSubscriptions.begin(); it != gSubscriptions.end(); ++it) {
+        if (it->second != NULL)
+            return true;
+    }
+    return false;
+}
+
+/*
+* Forget subscriptions without calling MATLAB, as when the MEX file is
+* cleared. A timer left running deletes itself on its next call.
+*/
+static void forgetEventCallbacks() {
+    for (std::map<int, mxArray*>::iterator it = gSubscriptions.begin(); it != gSubscriptions.end(); ++it) {
+        if (it->second != NULL)
+            mxDestroyArray(it->second);
+    }
+    gSubscriptions.clear();
+    if (gEventTimer != NULL) {
+        mxDestroyArray(gEventTimer);
+        gEventTimer = NULL;
+    }
+}
+
+/*
+* Status events as a struct array for EVENTS and SUBSCRIBE callbacks.
+*/
+static mxArray* statusEventArray(SCCARGS *sccArgs, const std::vector<STATUSEVENT> &events) {
+    static const char *fields[] = {"subscription", "file", "status", "text"};
+    mxArray *result = mxCreateStructMatrix((mwSize)events.size(), 1, 4, fields);
+    if (result == NULL)
+		throwMatlabError(sccArgs, verctrl::verctrl::MemoryError());
+    for (size_t i = 0; i < events.size(); i++) {
+        std::string text;
+        if (events[i].File != NO_PATH)
+            statusToString(events[i].Status, text);
+        mxSetField(result, (mwIndex)i, "subscription", mxCreateDoubleScalar(events[i].Subscription));
+        mxSetField(result, (mwIndex)i, "file", mxCreateString(pathName(events[i].File)));
+        mxSetField(result, (mwIndex)i, "status", mxCreateDoubleScalar(events[i].Status));
+        mxSetField(result, (mwIndex)i, "text", mxCreateString(text.c_str()));
+    }
+    return result;
+}
+
+/*
+* Called when the MEX file is cleared or MATLAB exits.
+*/
+static void exitVerctrl() {
+    releaseHeldSessions();
+    stopSubscriptions();
+    stopPrefetch();
+    forgetEventCallbacks();
+    stopJournal();
+    stopPristine();
+    stopMerkle();
+    closeProjects();
+    removeAllWatches();
+    forgetGitIndexes();
+    closeCvsSessions();
+    unloadSCCSystem();
+    stopRecording();
+}
+
+// Upper bound on the threads querying status at once.
+#define MAX_STATUS_THREADS 16
+
+// Sibling folders whose saved project is looked up for the prefetch
+// thread after each STATUS.
+#define PREFETCH_RESOLVE_PER_STATUS 4
+
+// How long a command waits for journaled operations on its files.
+#define JOURNAL_WAIT_MS 30000
+
+/*
+* The journal operation for a command, or -1 if it is not journaled.
+*/
+static int journalOpFor(const char *command) {
+    if (strcmpi(command, "ADD") == 0)
+        return JOURNAL_ADD;
+    if (strcmpi(command, "CHECKIN") == 0)
+        return JOURNAL_CHECKIN;
+    if (strcmpi(command, "REMOVE") == 0)
+        return JOURNAL_REMOVE;
+    return -1;
+}
+
+/*
+* Put the group's files in the journal instead of calling the provider.
+* Returns false if the operation has to be done now, because no project
+* is saved for the folder or the journal could not be written.
+*/
+static bool journalGroup(PROVIDERGROUP *group, int op, PATHID folder, bool *reload) {
+    SCCARGS *groupArgs      = &group->Args;
+    SCCPROVIDER *provider   = group->Provider;
+    // The journal is sent on another thread, which may not call a
+    // provider that is not reentrant.
+    if ((provider->Capability & SCC_CAP_REENTRANT) == 0)
+        return false;
+    char axPath[SCC_PRJPATH_LEN + 1];
+    char projName[SCC_PRJPATH_LEN + 1];
+    if (!getSavedProjectInfo(groupArgs, folder, projName, axPath)) {
+        return false;
+    }
+
+    *reload = true;
+    if (!groupArgs->Quiet) {
+        *reload = showSCCUI(groupArgs, provider->Capability, provider->CommentLen);
+        if (!*reload) {
+            return true;
+        }
+        // Do not ask again if it has to be done now after all.
+        groupArgs->Quiet = true;
+    }
+    LONG options = (op != JOURNAL_REMOVE && groupArgs->KeepCheckout) ? SCC_KEEP_CHECKEDOUT : 0;
+    if (!journalOperation(op, provider->LibPath, folder, projName, axPath,
+            groupArgs->Comment, options, groupArgs->NumberOfFiles, group->Ids)) {
+        if (gVerboseMode) mexPrintf("verctrl: Unable to write to the journal\n");
+        return false;
+    }
+    if (gVerboseMode) mexPrintf("verctrl: Journaled %s of %d files\n", groupArgs->Command, groupArgs->NumberOfFiles);
+    // The journal keeps the new base once the provider has taken the
+    // files; until then the old one stays.
+    if (op == JOURNAL_REMOVE) {
+        forgetPristine(groupArgs->NumberOfFiles, group->Ids);
+        *reload = false;
+    }
+    return true;
+}
+
+/*
+* Put back the group's files from the pristine store and journal the
+* UNCHECKOUT for the provider. Returns false if it has to be done by the
+* provider now, because a file has no base kept or could not be replaced.
+*/
+static bool uncheckoutFromPristine(PROVIDERGROUP *group, PATHID folder, bool *reload) {
+    SCCARGS *groupArgs      = &group->Args;
+    SCCPROVIDER *provider   = group->Provider;
+    // The journal is sent on another thread, which may not call a
+    // provider that is not reentrant.
+    if ((provider->Capability & SCC_CAP_REENTRANT) == 0)
+        return false;
+    char axPath[SCC_PRJPATH_LEN + 1];
+    char projName[SCC_PRJPATH_LEN + 1];
+    for (int i = 0; i < groupArgs->NumberOfFiles; i++) {
+        if (!hasPristineBase(group->Ids[i]))
+            return false;
+    }
+    if (!getSavedProjectInfo(groupArgs, folder, projName, axPath)) {
+        return false;
+    }
+
+    *reload = true;
+    if (!groupArgs->Quiet) {
+        *reload = showSCCUI(groupArgs, provider->Capability, provider->CommentLen);
+        if (!*reload) {
+            return true;
+        }
+        groupArgs->Quiet = true;
+    }
+    bool *restored      = (bool*)mxCalloc(groupArgs->NumberOfFiles, sizeof(bool));
+    int numberRestored  = restorePristine(groupArgs->NumberOfFiles, group->Ids, restored);
+    mxFree(restored);
+    if (gVerboseMode) mexPrintf("verctrl: Restored %d of %d files from the pristine store\n",
+        numberRestored, groupArgs->NumberOfFiles);
+    if (numberRestored < groupArgs->NumberOfFiles)
+        return false;
+    for (int i = 0; i < groupArgs->NumberOfFiles; i++)
+        invalidateStatus(group->Ids[i]);
+    if (!journalOperation(JOURNAL_UNCHECKOUT, provider->LibPath, folder, projName, axPath,
+            "", 0, groupArgs->NumberOfFiles, group->Ids)) {
+        if (gVerboseMode) mexPrintf("verctrl: Unable to write to the journal\n");
+        return false;
+    }
+    return true;
+}
+
+/*
+* Show the differences between a file and its base in the pristine store
+* without the provider. Returns false if the provider has to show them.
+*/
+static bool showDiffFromPristine(SCCARGS *sccArgs, PATHID file) {
+    int compare = comparePristine(file);
+    if (compare == PRISTINE_UNKNOWN)
+        return false;
+    if (compare == PRISTINE_SAME)
+        throwMatlabError(sccArgs, verctrl::verctrl::DiffError());
+
+    std::string baseName;
+    if (!pristineCopy(file, baseName))
+        return false;
+    mxArray *prhs[2] = {mxCreateString(baseName.c_str()), mxCreateString(sccArgs->FileNames[0])};
+    if (prhs[0] == NULL || prhs[1] == NULL)
+		throwMatlabError(sccArgs, verctrl::verctrl::MemoryError());
+    mexSetTrapFlag(1);
+    int status = mexCallMATLAB(0, NULL, 2, prhs, "visdiff");
+    mxDestroyArray(prhs[0]);
+    mxDestroyArray(prhs[1]);
+    if (status != 0) {
+        if (gVerboseMode) mexPrintf("verctrl: error calling visdiff\n");
+        return false;
+    }
+    return true;
+}
+
+/*
+* Entries of the journal as a struct array for JOURNAL_STATUS.
+*/
+static mxArray* journalStatusArray(SCCARGS *sccArgs) {
+    static const char *fields[] = {"id", "command", "state", "attempts", "error", "comment", "files"};
+    static const char *opNames[] = {"ADD", "CHECKIN", "REMOVE", "UNCHECKOUT"};
+    static const char *stateNames[] = {"pending", "done", "failed"};
+    std::vector<JOURNALINFO> entries;
+    getJournalInfo(entries);
+
+    mxArray *result = mxCreateStructMatrix((mwSize)entries.size(), 1, 7, fields);
+    if (result == NULL)
+		throwMatlabError(sccArgs, verctrl::verctrl::MemoryError());
+    for (size_t i = 0; i < entries.size(); i++) {
+        const JOURNALINFO &info = entries[i];
+        mxArray *files = mxCreateCellMatrix((mwSize)info.Files.size(), 1);
+        for (size_t f = 0; f < info.Files.size(); f++)
+            mxSetCell(files, (mwIndex)f, mxCreateString(info.Files[f].c_str()));
+        mxSetField(result, (mwIndex)i, "id", mxCreateDoubleScalar((double)info.Id));
+        mxSetField(result, (mwIndex)i, "command", mxCreateString(opNames[info.Op]));
+        mxSetField(result, (mwIndex)i, "state", mxCreateString(stateNames[info.State]));
+        mxSetField(result, (mwIndex)i, "attempts", mxCreateDoubleScalar(info.Attempts));
+        mxSetField(result, (mwIndex)i, "error", mxCreateString(
+            info.Attempts > 0 && IS_SCC_ERROR(info.Rtn) ? errorCodeToString(info.Rtn) : ""));
+        mxSetField(result, (mwIndex)i, "comment", mxCreateString(info.Comment.c_str()));
+        mxSetField(result, (mwIndex)i, "files", files);
+    }
+    return result;
+}
+
+/*
+* Queue the neighbours of the folders of files for prefetching, and look
+* up the saved projects of the folders the prefetch thread could not.
+*/
+static void queuePrefetch(int numberOfFiles, const PATHID *files) {
+    std::vector<PATHID> folders;
+    for (int i = 0; i < numberOfFiles; i++) {
+        PATHID folder = parentPathId(files[i]);
+        if (std::find(folders.begin(), folders.end(), folder) == folders.end())
+            folders.push_back(folder);
+    }
+    for (size_t f = 0; f < folders.size(); f++) {
+        char axPath[SCC_PRJPATH_LEN + 1];
+        char projName[SCC_PRJPATH_LEN + 1];
+        char libPath[_MAX_PATH];
+        // Folders without a saved project were not queried.
+        if (!lookupProjectInfo(folders[f], projName, axPath))
+            continue;
+        bool mapped = providerLibForPath(folders[f], libPath);
+        if (!mapped) {
+            SCCPROVIDER *provider = gDefaultProvider;
+            if (provider == NULL)
+                continue;
+            strcpy(libPath, provider->LibPath);
+        }
+        prefetchNeighbours(folders[f], libPath, mapped, projName, axPath);
+    }
+
+    std::vector<PATHID> unresolved;
+    takeUnresolvedFolders(PREFETCH_RESOLVE_PER_STATUS, unresolved);
+    for (size_t f = 0; f < unresolved.size(); f++) {
+        char axPath[SCC_PRJPATH_LEN + 1];
+        char projName[SCC_PRJPATH_LEN + 1];
+        prefetchResolved(unresolved[f], savedProjectInfo(unresolved[f], NULL, projName, axPath) == PROJECT_SAVED);
+    }
+}
+
+/*
+* Status of the files in sccArgs, from the status cache or their providers,
+* as a 1xN uint32 array.
+*/
+static mxArray *queryStatus(SCCARGS *sccArgs) {
+    // Error checking
+    if (sccArgs->FileNames == NULL) {
+ 			throwMatlabError(sccArgs, verctrl::verctrl::NoFiles(sccArgs->Command));
+    }
+    if (sccArgs->WindowHandle == NULL)
+			throwMatlabError(sccArgs, verctrl::verctrl::InvalidHandle());
+    beginForeground();
+
+    LPLONG status   = (LPLONG)mxCalloc(sccArgs->NumberOfFiles, sizeof(LONG));
+    int *missing    = (int *)mxCalloc(sccArgs->NumberOfFiles, sizeof(int));
+    PATHID *ids     = internFileNames(sccArgs);
+    PATHID *missIds = (PATHID *)mxCalloc(sccArgs->NumberOfFiles, sizeof(PATHID));
+    if (status == NULL || missing == NULL || missIds == NULL)
+			throwMatlabError(sccArgs, verctrl::verctrl::MemoryError());
+
+    // Only ask the providers about files not in the status cache.
+    SCCARGS missArgs        = *sccArgs;
+    missArgs.NumberOfFiles  = 0;
+    missArgs.FileNames      = (char **)mxCalloc(sccArgs->NumberOfFiles, sizeof(char *));
+    if (missArgs.FileNames == NULL)
+			throwMatlabError(sccArgs, verctrl::verctrl::MemoryError());
+    for (int i = 0; i < sccArgs->NumberOfFiles; i++) {
+        bool cached = lookupStatus(ids[i], &status[i]);
+        notePrefetchLookup(ids[i], cached);
+        if (!cached) {
+            missing[missArgs.NumberOfFiles]             = i;
+            missIds[missArgs.NumberOfFiles]             = ids[i];
+            missArgs.FileNames[missArgs.NumberOfFiles++] = sccArgs->FileNames[i];
+        }
+    }
+    if (gVerboseMode && missArgs.NumberOfFiles < sccArgs->NumberOfFiles)
+        mexPrintf("verctrl: %d of %d files found in the status cache\n",
+            sccArgs->NumberOfFiles - missArgs.NumberOfFiles, sccArgs->NumberOfFiles);
+
+    PROVIDERGROUP *groups = NULL;
+    int numberOfGroups = 0;
+    if (missArgs.NumberOfFiles > 0)
+        numberOfGroups = groupFilesByProvider(&missArgs, missIds, &groups, true);
+    PROVIDERGROUP **pending = (PROVIDERGROUP **)mxCalloc(numberOfGroups + 1, sizeof(PROVIDERGROUP *));
+    PROVIDERGROUP **here    = (PROVIDERGROUP **)mxCalloc(numberOfGroups + 1, sizeof(PROVIDERGROUP *));
+    int numberHere          = 0;
+    if (pending == NULL || here == NULL)
+			throwMatlabError(sccArgs, verctrl::verctrl::MemoryError());
+    STATUSWORK work;
+    work.Groups         = pending;
+    work.NumberOfGroups = 0;
+    work.Next           = 0;
+
+    // Statuses invalidated after this point, e.g. by the journal
+    // flushing, are not put back in the cache.
+    ULONGLONG epoch = getStatusEpoch();
+
+    // Look up the saved projects here, getsccprj can only be called
+    // on this thread.
+    for (int g = 0; g < numberOfGroups; g++) {
+        PROVIDERGROUP *group = &groups[g];
+        group->Status = (LPLONG)mxCalloc(group->Args.NumberOfFiles, sizeof(LONG));
+        if (group->Status == NULL)
+				throwMatlabError(sccArgs, verctrl::verctrl::MemoryError());
+
+        if (getSavedProjectInfo(&group->Args, group->Folder, group->ProjName, group->AxPath)) {
+            // Providers that are not reentrant are only called on this
+            // thread, which loaded them.
+            if (group->Provider->Capability & SCC_CAP_REENTRANT)
+                pending[work.NumberOfGroups++] = group;
+            else
+                here[numberHere++] = group;
+        }
+        else {
+            if (gVerboseMode) mexPrintf("verctrl: (openProjFromSavedInfo) No project name stored\n");
+            group->Rtn = SCC_E_INITIALIZEFAILED;
+        }
+    }
+
+    // Each group borrows its own session, so groups can be queried
+    // concurrently up to the size of each provider's pool.
+    int numberOfThreads = numberHere > 0 ? work.NumberOfGroups : work.NumberOfGroups - 1;
+    if (numberOfThreads > MAX_STATUS_THREADS)
+        numberOfThreads = MAX_STATUS_THREADS;
+    HANDLE threads[MAX_STATUS_THREADS];
+    int started = 0;
+    for (int t = 0; t < numberOfThreads; t++) {
+        threads[started] = CreateThread(NULL, 0, statusThread, &work, 0, NULL);
+        if (threads[started] != NULL)
+            started++;
+    }
+    for (int g = 0; g < numberHere; g++)
+        groupStatus(here[g]);
+    statusThread(&work);
+    if (started > 0) {
+        WaitForMultipleObjects(started, threads, TRUE, INFINITE);
+        for (int t = 0; t < started; t++)
+            CloseHandle(threads[t]);
+    }
+
+    for (int g = 0; g < numberOfGroups; g++) {
+        PROVIDERGROUP *group = &groups[g];
+        if (IS_SCC_ERROR(group->Rtn)) {
+            for (int i = 0; i < group->Args.NumberOfFiles; i++) {
+                // SCC_STATUS_NO_MATLAB_PROJECT is TMW defined in scc.h.  Is an enum that extends microsoft supplied 
+                // include file.  If we use a newer version of scc.h, then the build will break here and we'll need to add
+                // it to the SccStatus enum.
+                group->Status[i] = SCC_STATUS_NO_MATLAB_PROJECT;
+                if (gVerboseMode) mexPrintf("verctrl:  openProjFromSavedInfo failed (%s, %s)\n",
+						group->Args.FileNames[i], errorCodeToString(group->Rtn));
+            }
+        }
+        else {
+            printFileStatus(group->Args.FileNames, group->Args.NumberOfFiles, group->Status);
+            std::vector<bool> journaled;
+            hasPendingJournalOps(group->Args.NumberOfFiles, group->Ids, journaled);
+            for (int i = 0; i < group->Args.NumberOfFiles; i++) {
+                if (!journaled[i])
+                    storeStatus(group->Ids[i], group->Status[i], epoch);
+            }
+        }
+        for (int i = 0; i < group->Args.NumberOfFiles; i++) {
+            status[missing[group->Index[i]]] = group->Status[i];
+        }
+    }
+    mxArray *statusArray = mxCreateNumericMatrix(1, sccArgs->NumberOfFiles, mxUINT32_CLASS,  mxREAL);
+    if (statusArray == NULL) {
+			throwMatlabError(sccArgs,verctrl::verctrl::MemoryError());
+    }
+    // Report journaled operations as if they had been done.
+    applyPendingJournalOps(sccArgs->NumberOfFiles, ids, status);
+    unsigned int *arrayData = (unsigned int *)mxGetData(statusArray);
+    for (int i = 0; i < sccArgs->NumberOfFiles; i++) {
+        arrayData[i] = status[i];
+    }
+    endForeground();
+    if (isPrefetchOn())
+        queuePrefetch(sccArgs->NumberOfFiles, ids);
+    return statusArray;
 }
 
 void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
     if (!(jmiUseJVM() && jmiUseSwing() && jmiUseMWT())) { // Java not available fully
 		throwMatlabError(NULL,verctrl::verctrl::NoJava());
     }
+    // Sessions still held by a previous command that ended in an error.
+    releaseHeldSessions();
+    endForeground();
+
     SCCARGS * sccArgs = (SCCARGS *) mxCalloc(1, sizeof(SCCARGS));
     constructInputArgs(nrhs, prhs, sccArgs);
 
-    if (serverLib == NULL) {
-        mexAtExit(unloadSCCSystem);
+    if (!gExitRegistered) {
+        mexAtExit(exitVerctrl);
+        gExitRegistered = true;
     }
 
     if (gVerboseMode) mexPrintf("verctrl: %s\n", sccArgs->Command);
@@ -726,8 +1533,8 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
         }
     }
     else if (strcmpi("CAPABILITY", sccArgs->Command) == 0) { // For developing the UI menus.
-        loadSCCSystem(sccArgs);
-        mxArray *result = mxCreateDoubleScalar (capability);
+        SCCPROVIDER *provider = loadSCCSystem(sccArgs);
+        mxArray *result = mxCreateDoubleScalar (provider->Capability);
         if (result == NULL) {
 			throwMatlabError(sccArgs, verctrl::verctrl::MemoryError());
         }
@@ -738,8 +1545,9 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
 		if (sccArgs->WindowHandle == NULL) {
             throwMatlabError(sccArgs, verctrl::verctrl::BadWindowHandle());
 		}
-        loadSCCSystem(sccArgs);
-        runScc(sccArgs->WindowHandle);
+        SCCSESSION *session = holdSession(sccArgs, loadSCCSystem(sccArgs), NO_PATH);
+        runScc(session, sccArgs->WindowHandle);
+        releaseHeldSession(session);
     }
     else if (strcmpi("REGISTER", sccArgs->Command) == 0) 
     {
@@ -749,8 +1557,10 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
 		} else if (sccArgs->FileNames == NULL) {
 			throwMatlabError(sccArgs,verctrl::verctrl::NoDirectory());
 		}
-        loadSCCSystem(sccArgs);
-        SCCRTN rtn = promptAndOpenProject(sccArgs->FileNames[0], sccArgs->WindowHandle);
+        PATHID file = internPath(sccArgs->FileNames[0]);
+        SCCSESSION *session = holdSession(sccArgs, providerForFile(sccArgs, file), parentPathId(file));
+        SCCRTN rtn = promptAndOpenProject(session, parentPathId(file), sccArgs->WindowHandle);
+        releaseHeldSession(session);
         if (rtn == SCC_I_OPERATIONCANCELED) 
         {
 			// No need to report an error to the user here
@@ -776,43 +1586,151 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
         unloadSCCSystem();
     }
     else if (strcmpi("STATUS", sccArgs->Command) == 0) {
-        // Error checking
+        plhs[0]     = queryStatus(sccArgs);
+    } else if (strcmpi("PROJECT_STATUS", sccArgs->Command) == 0) {
+        // Status of every file in a Simulink project, given its .prj file.
+        // Returns the file names and, as a second output, their status
+        // like STATUS.
         if (sccArgs->FileNames == NULL) {
  			throwMatlabError(sccArgs, verctrl::verctrl::NoFiles(sccArgs->Command));
         }
-        if (sccArgs->WindowHandle == NULL)
-			throwMatlabError(sccArgs, verctrl::verctrl::InvalidHandle());
+        std::vector<PATHID> files;
+        if (!projectFiles(internPath(sccArgs->FileNames[0]), files)) {
+            throwMatlabError(sccArgs, verctrl::verctrl::ProjectNotRead(sccArgs->FileNames[0]));
+        }
+        if (gVerboseMode) mexPrintf("verctrl: %d files in project %s\n", (int)files.size(), sccArgs->FileNames[0]);
 
-        LPLONG status   = (LPLONG)mxCalloc(sccArgs->NumberOfFiles, sizeof(LONG));
-        if (status == NULL)
+        mxArray *names = mxCreateCellMatrix(1, files.size());
+        if (names == NULL)
 			throwMatlabError(sccArgs, verctrl::verctrl::MemoryError());
-
-        loadSCCSystem(sccArgs);
-
-        // see if we've opened this project before
-        SCCRTN  rtn    = openProjFromSavedInfo(sccArgs, sccArgs->WindowHandle);
-        if (IS_SCC_ERROR(rtn)) {
-            for (int i = 0; i < sccArgs->NumberOfFiles; i++) {
-                // SCC_STATUS_NO_MATLAB_PROJECT is TMW defined in scc.h.  Is an enum that extends microsoft supplied 
-                // include file.  If we use a newer version of scc.h, then the build will break here and we'll need to add
-                // it to the SccStatus enum.
-                status[i] = SCC_STATUS_NO_MATLAB_PROJECT;
-                if (gVerboseMode) mexPrintf("verctrl:  openProjFromSavedInfo failed (%s, %s)\n",
-					sccArgs->FileNames[i], errorCodeToString(rtn));
+        for (size_t i = 0; i < files.size(); i++)
+            mxSetCell(names, i, mxCreateString(pathName(files[i])));
+        plhs[0] = names;
+        if (nlhs > 1) {
+            if (files.empty()) {
+                plhs[1] = mxCreateNumericMatrix(1, 0, mxUINT32_CLASS, mxREAL);
+            } else {
+                SCCARGS projectArgs         = *sccArgs;
+                projectArgs.NumberOfFiles   = (int)files.size();
+                projectArgs.FileNames       = (char **)mxCalloc(files.size(), sizeof(char *));
+                if (projectArgs.FileNames == NULL)
+					throwMatlabError(sccArgs, verctrl::verctrl::MemoryError());
+                for (size_t i = 0; i < files.size(); i++)
+                    projectArgs.FileNames[i] = (char *)pathName(files[i]);
+                plhs[1] = queryStatus(&projectArgs);
             }
         }
-        else {
-            fileStatus(sccArgs->FileNames, sccArgs->NumberOfFiles, status);
+    } else if (strcmpi("GIT_STATUS", sccArgs->Command) == 0) {
+        // Status of files in git working trees, from the repository's
+        // index without loading a provider. Returned like STATUS.
+        if (sccArgs->FileNames == NULL) {
+ 			throwMatlabError(sccArgs, verctrl::verctrl::NoFiles(sccArgs->Command));
         }
+        LPLONG status   = (LPLONG)mxCalloc(sccArgs->NumberOfFiles, sizeof(LONG));
+        PATHID *ids     = internFileNames(sccArgs);
+        if (status == NULL)
+			throwMatlabError(sccArgs, verctrl::verctrl::MemoryError());
+        gitStatus(sccArgs->NumberOfFiles, ids, status);
+        printFileStatus(sccArgs->FileNames, sccArgs->NumberOfFiles, status);
         mxArray *statusArray = mxCreateNumericMatrix(1, sccArgs->NumberOfFiles, mxUINT32_CLASS,  mxREAL);
         if (statusArray == NULL) {
 			throwMatlabError(sccArgs,verctrl::verctrl::MemoryError());
         }
         unsigned int *arrayData = (unsigned int *)mxGetData(statusArray);
-        for (int i = 0; i < sccArgs->NumberOfFiles; i++) {
+        for (int i = 0; i < sccArgs->NumberOfFiles; i++)
             arrayData[i] = status[i];
-        }
         plhs[0]     = statusArray;
+    } else if (strcmpi("RCS_CHECKIN", sccArgs->Command) == 0) {
+        // revisions = verctrl('RCS_CHECKIN', files, 0, comment, lock) checks
+        // files in to their ,v archives as rcs.m does with ci, without
+        // running it. lock is 'on' to keep the files locked (ci -l); the
+        // default is 'off' (ci -u).
+        if (sccArgs->FileNames == NULL) {
+ 			throwMatlabError(sccArgs, verctrl::verctrl::NoFiles(sccArgs->Command));
+        }
+        char *comment = (nrhs > 3 && mxIsChar(prhs[3])) ? mxArrayToString(prhs[3]) : NULL;
+        if (comment == NULL || comment[0] == '\0') {
+            throwMatlabError(sccArgs, verctrl::verctrl::NoComment(sccArgs->Command));
+        }
+        bool lock = false;
+        if (nrhs > 4) {
+            char *lockText = mxIsChar(prhs[4]) ? mxArrayToString(prhs[4]) : NULL;
+            lock = lockText != NULL ? strcmpi(lockText, "on") == 0 : mxIsLogicalScalarTrue(prhs[4]);
+            if (lockText != NULL)
+                mxFree(lockText);
+        }
+        PATHID *ids = internFileNames(sccArgs);
+        std::vector<std::string> revisions(sccArgs->NumberOfFiles);
+        std::vector<std::string> errors(sccArgs->NumberOfFiles);
+        bool ok = rcsCheckin(sccArgs->NumberOfFiles, ids, comment, lock, &revisions[0], &errors[0]);
+        mxFree(comment);
+        mxArray *result = mxCreateCellMatrix(1, sccArgs->NumberOfFiles);
+        if (result == NULL)
+			throwMatlabError(sccArgs, verctrl::verctrl::MemoryError());
+        std::string failures;
+        for (int i = 0; i < sccArgs->NumberOfFiles; i++) {
+            invalidateStatus(ids[i]);
+            mxSetCell(result, (mwIndex)i, mxCreateString(revisions[i].c_str()));
+            if (!errors[i].empty())
+                failures += errors[i] + "\n";
+            else if (gVerboseMode)
+                mexPrintf("verctrl: %s checked in as %s\n", sccArgs->FileNames[i], revisions[i].c_str());
+        }
+        if (!ok) {
+            mxDestroyArray(result);
+            throwMatlabError(sccArgs, verctrl::verctrl::RcsCheckinFailed(failures.c_str()));
+        }
+        plhs[0] = result;
+    } else if (_strnicmp("CVS_", sccArgs->Command, 4) == 0) {
+        // verctrl('CVS_STATUS', files) and verctrl('CVS_LOG', files) return
+        // statuses like STATUS and the log as text. CVS_CHECKIN takes a
+        // comment and CVS_CHECKOUT a revision as the fourth argument;
+        // CVS_EDIT and CVS_UNEDIT take none. All talk to the repository
+        // through a cvs server kept running between commands.
+        if (sccArgs->FileNames == NULL) {
+ 			throwMatlabError(sccArgs, verctrl::verctrl::NoFiles(sccArgs->Command));
+        }
+        PATHID *ids = internFileNames(sccArgs);
+        char *text  = (nrhs > 3 && mxIsChar(prhs[3])) ? mxArrayToString(prhs[3]) : NULL;
+        std::string error;
+        bool ok;
+        if (strcmpi("CVS_STATUS", sccArgs->Command) == 0) {
+            LPLONG status = (LPLONG)mxCalloc(sccArgs->NumberOfFiles, sizeof(LONG));
+            if (status == NULL)
+				throwMatlabError(sccArgs, verctrl::verctrl::MemoryError());
+            ok = cvsStatus(sccArgs->NumberOfFiles, ids, status, error);
+            printFileStatus(sccArgs->FileNames, sccArgs->NumberOfFiles, status);
+            mxArray *statusArray = mxCreateNumericMatrix(1, sccArgs->NumberOfFiles, mxUINT32_CLASS,  mxREAL);
+            if (statusArray == NULL) {
+				throwMatlabError(sccArgs,verctrl::verctrl::MemoryError());
+            }
+            unsigned int *arrayData = (unsigned int *)mxGetData(statusArray);
+            for (int i = 0; i < sccArgs->NumberOfFiles; i++)
+                arrayData[i] = status[i];
+            plhs[0] = statusArray;
+        } else if (strcmpi("CVS_LOG", sccArgs->Command) == 0) {
+            std::string log;
+            ok = cvsLog(sccArgs->NumberOfFiles, ids, log, error);
+            plhs[0] = mxCreateString(log.c_str());
+        } else if (strcmpi("CVS_CHECKIN", sccArgs->Command) == 0) {
+            ok = cvsCheckin(sccArgs->NumberOfFiles, ids, text != NULL ? text : "", error);
+        } else if (strcmpi("CVS_CHECKOUT", sccArgs->Command) == 0) {
+            ok = cvsUpdate(sccArgs->NumberOfFiles, ids, text, error);
+        } else if (strcmpi("CVS_EDIT", sccArgs->Command) == 0 || strcmpi("CVS_UNEDIT", sccArgs->Command) == 0) {
+            ok = cvsEdit(sccArgs->NumberOfFiles, ids, strcmpi("CVS_EDIT", sccArgs->Command) == 0, error);
+        } else {
+            throwMatlabError(sccArgs, verctrl::verctrl::UnknownCommand(sccArgs->Command));
+        }
+        if (text != NULL)
+            mxFree(text);
+        // Files changed on disk have a stale cached status.
+        for (int i = 0; i < sccArgs->NumberOfFiles; i++)
+            invalidateStatus(ids[i]);
+        if (!error.empty() && gVerboseMode)
+            mexPrintf("verctrl: %s", error.c_str());
+        if (!ok) {
+            throwMatlabError(sccArgs, verctrl::verctrl::CvsFailed(error.c_str()));
+        }
     } else if (strcmpi("VERBOSE_ON", sccArgs->Command) == 0) {
         gVerboseMode = true;
         mexPrintf("verctrl: Verbose mode on\n");
@@ -821,7 +1739,7 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
         gVerboseMode = false;
     } else if (strcmpi("SET_DLL", sccArgs->Command) == 0) {
 		/* undocumented command used for interal troubleshooting, errors do not need translation*/
-        unloadSCCSystem();
+        unloadDefaultProvider();
         char* dll = mxArrayToString(prhs[1]);
         if (gDebugDLL!=NULL) {
             mxFree(gDebugDLL);
@@ -833,6 +1751,318 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
             mexPrintf("verctrl: Using DLL \"%s\"\n", dll);
             gDebugDLL = dll;
         }
+    } else if (strcmpi("RECORD_START", sccArgs->Command) == 0) {
+        /* undocumented command used for internal troubleshooting */
+        char* logFile = (nrhs > 1) ? mxArrayToString(prhs[1]) : NULL;
+        if (logFile == NULL || logFile[0] == '\0') {
+            throwMatlabError(sccArgs, verctrl::verctrl::NoFileName(sccArgs->Command));
+        }
+        if (!startRecording(logFile)) {
+            mexPrintf("verctrl: Unable to open \"%s\" for recording\n", logFile);
+        } else {
+            mexPrintf("verctrl: Recording SCC calls to \"%s\"\n", logFile);
+        }
+        mxFree(logFile);
+    } else if (strcmpi("RECORD_STOP", sccArgs->Command) == 0) {
+        if (isRecording()) {
+            mexPrintf("verctrl: Recording stopped\n");
+        }
+        stopRecording();
+    } else if (strcmpi("MAP_PROVIDER", sccArgs->Command) == 0) {
+        // verctrl('MAP_PROVIDER', folder, dll) sends files under folder to the
+        // SCC provider in dll instead of the one selected with cmopts.
+        // An empty dll removes the mapping.
+        char* folder = (nrhs > 1) ? mxArrayToString(prhs[1]) : NULL;
+        char* dll    = (nrhs > 2) ? mxArrayToString(prhs[2]) : NULL;
+        if (folder == NULL || folder[0] == '\0') {
+            throwMatlabError(sccArgs, verctrl::verctrl::NoFolder(sccArgs->Command));
+        }
+        if (gVerboseMode) mexPrintf("verctrl: Mapping \"%s\" to \"%s\"\n", folder, dll != NULL ? dll : "");
+        mapProviderFolder(folder, dll);
+        // Cached status may have come from the previous provider.
+        invalidateAllStatus();
+        mxFree(folder);
+        if (dll != NULL)
+            mxFree(dll);
+    } else if (strcmpi("PROVIDERS", sccArgs->Command) == 0) {
+        // Returns an N-by-2 cell array of mapped folders and provider libraries.
+        int numberOfMappings = getNumberOfMappings();
+        mxArray *mappings = mxCreateCellMatrix(numberOfMappings, 2);
+        if (mappings == NULL)
+			throwMatlabError(sccArgs, verctrl::verctrl::MemoryError());
+        for (int i = 0; i < numberOfMappings; i++) {
+            char folder[_MAX_PATH], libPath[_MAX_PATH];
+            if (!getMapping(i, folder, libPath))
+                folder[0] = libPath[0] = '\0';
+            mxSetCell(mappings, i, mxCreateString(folder));
+            mxSetCell(mappings, i + numberOfMappings, mxCreateString(libPath));
+        }
+        plhs[0] = mappings;
+    } else if (strcmpi("STATUS_CACHE", sccArgs->Command) == 0) {
+        // verctrl('STATUS_CACHE', ms) keeps STATUS results for ms milliseconds;
+        // 0 turns the cache off. Returns the previous setting.
+        DWORD previous = getStatusCacheTimeout();
+        if (nrhs > 1) {
+            double timeout = mxGetScalar(prhs[1]);
+            setStatusCacheTimeout(timeout > 0 ? (DWORD)timeout : 0);
+        }
+        if (gVerboseMode) mexPrintf("verctrl: Status cache timeout %lu ms\n", getStatusCacheTimeout());
+        if (nlhs >= 1)
+            plhs[0] = mxCreateDoubleScalar(previous);
+    } else if (strcmpi("NEGATIVE_CACHE", sccArgs->Command) == 0) {
+        // verctrl('NEGATIVE_CACHE', ms) answers STATUS for files the provider
+        // reported as not controlled without asking it again, for up to ms
+        // milliseconds or until a file is created, deleted or renamed in
+        // their folder. 0 turns it off. Returns the previous setting.
+        DWORD previous = getNegativeCacheTimeout();
+        if (nrhs > 1) {
+            double timeout = mxGetScalar(prhs[1]);
+            setNegativeCacheTimeout(timeout > 0 ? (DWORD)timeout : 0);
+        }
+        if (gVerboseMode) {
+            int folders, files;
+            ULONGLONG hits;
+            getNegativeCacheInfo(&folders, &files, &hits);
+            mexPrintf("verctrl: Negative cache timeout %lu ms, %d files in %d folders, %I64u hits\n",
+                getNegativeCacheTimeout(), files, folders, hits);
+        }
+        if (nlhs >= 1)
+            plhs[0] = mxCreateDoubleScalar(previous);
+    } else if (strcmpi("JOURNAL_ON", sccArgs->Command) == 0) {
+        // verctrl('JOURNAL_ON', file) queues CHECKIN, ADD and REMOVE in the
+        // journal file and sends them to the provider in the background.
+        // Operations left in the file from an earlier session are sent too.
+        char* journalFile = (nrhs > 1) ? mxArrayToString(prhs[1]) : NULL;
+        if (journalFile == NULL || journalFile[0] == '\0') {
+            throwMatlabError(sccArgs, verctrl::verctrl::NoFileName(sccArgs->Command));
+        }
+        if (!startJournal(journalFile)) {
+            mexPrintf("verctrl: Unable to open \"%s\" as a journal\n", journalFile);
+        } else if (gVerboseMode) {
+            mexPrintf("verctrl: Journaling to \"%s\"\n", journalFile);
+        }
+        mxFree(journalFile);
+    } else if (strcmpi("JOURNAL_OFF", sccArgs->Command) == 0) {
+        // Operations not yet sent stay in the journal file.
+        stopJournal();
+        if (gVerboseMode) mexPrintf("verctrl: Journal off\n");
+    } else if (strcmpi("JOURNAL_STATUS", sccArgs->Command) == 0) {
+        plhs[0] = journalStatusArray(sccArgs);
+    } else if (strcmpi("PRISTINE_ON", sccArgs->Command) == 0) {
+        // verctrl('PRISTINE_ON', folder, maxMB) keeps the base revision of
+        // files in folder, using at most maxMB megabytes (default 1024).
+        // UNCHECKOUT then restores files locally while journaling, and
+        // ISDIFF and SHOWDIFF need not ask the provider.
+        char* pristineFolder = (nrhs > 1) ? mxArrayToString(prhs[1]) : NULL;
+        if (pristineFolder == NULL || pristineFolder[0] == '\0') {
+            throwMatlabError(sccArgs, verctrl::verctrl::NoFolder(sccArgs->Command));
+        }
+        double maxMB = (nrhs > 2) ? mxGetScalar(prhs[2]) : 1024;
+        if (!(maxMB > 0))
+            maxMB = 1024;
+        if (!startPristine(pristineFolder, (ULONGLONG)(maxMB * 1024 * 1024))) {
+            mexPrintf("verctrl: Unable to use \"%s\" as a pristine store\n", pristineFolder);
+        } else if (gVerboseMode) {
+            mexPrintf("verctrl: Pristine store in \"%s\"\n", pristineFolder);
+        }
+        mxFree(pristineFolder);
+    } else if (strcmpi("PRISTINE_OFF", sccArgs->Command) == 0) {
+        // The folder is kept and used again by the next PRISTINE_ON.
+        stopPristine();
+        if (gVerboseMode) mexPrintf("verctrl: Pristine store off\n");
+    } else if (strcmpi("PRISTINE_STATUS", sccArgs->Command) == 0) {
+        static const char *fields[] = {"on", "folder", "maxBytes", "bytes", "objects", "files",
+                                       "cloned", "copied", "collected"};
+        PRISTINEINFO info;
+        getPristineInfo(&info);
+        bool on = isPristineOn();
+        mxArray *result = mxCreateStructMatrix(1, 1, 9, fields);
+        if (result == NULL)
+			throwMatlabError(sccArgs, verctrl::verctrl::MemoryError());
+        mxSetField(result, 0, "on", mxCreateLogicalScalar(on));
+        mxSetField(result, 0, "folder", mxCreateString(on ? info.Folder.c_str() : ""));
+        mxSetField(result, 0, "maxBytes", mxCreateDoubleScalar(on ? (double)info.MaxBytes : 0));
+        mxSetField(result, 0, "bytes", mxCreateDoubleScalar(on ? (double)info.Bytes : 0));
+        mxSetField(result, 0, "objects", mxCreateDoubleScalar(on ? (double)info.Objects : 0));
+        mxSetField(result, 0, "files", mxCreateDoubleScalar(on ? (double)info.Files : 0));
+        mxSetField(result, 0, "cloned", mxCreateDoubleScalar(on ? (double)info.Cloned : 0));
+        mxSetField(result, 0, "copied", mxCreateDoubleScalar(on ? (double)info.Copied : 0));
+        mxSetField(result, 0, "collected", mxCreateDoubleScalar(on ? (double)info.Collected : 0));
+        plhs[0] = result;
+    } else if (strcmpi("PREFETCH_ON", sccArgs->Command) == 0) {
+        // After each STATUS, query the files of the subfolders and sibling
+        // folders of the folders asked about on a background thread, so
+        // the next STATUS finds them in the status cache.
+        if (getStatusCacheTimeout() == 0) {
+            mexPrintf("verctrl: The status cache is off, prefetched statuses will not be kept\n");
+        }
+        if (!startPrefetch()) {
+            mexPrintf("verctrl: Unable to start prefetching\n");
+        } else if (gVerboseMode) {
+            mexPrintf("verctrl: Prefetch on\n");
+        }
+    } else if (strcmpi("PREFETCH_OFF", sccArgs->Command) == 0) {
+        // Folders still queued are dropped.
+        stopPrefetch();
+        if (gVerboseMode) mexPrintf("verctrl: Prefetch off\n");
+    } else if (strcmpi("PREFETCH_STATUS", sccArgs->Command) == 0) {
+        // hitRate is the share of the lookups STATUS could not answer
+        // without prefetching that a prefetched status answered. wasted
+        // counts prefetched statuses that STATUS has not asked for.
+        static const char *fields[] = {"on", "queued", "folders", "queries", "files",
+                                       "hits", "misses", "wasted", "dropped", "hitRate"};
+        PREFETCHINFO info;
+        getPrefetchInfo(&info);
+        mxArray *result = mxCreateStructMatrix(1, 1, 10, fields);
+        if (result == NULL)
+			throwMatlabError(sccArgs, verctrl::verctrl::MemoryError());
+        mxSetField(result, 0, "on", mxCreateLogicalScalar(isPrefetchOn()));
+        mxSetField(result, 0, "queued", mxCreateDoubleScalar(info.Queued));
+        mxSetField(result, 0, "folders", mxCreateDoubleScalar((double)info.Folders));
+        mxSetField(result, 0, "queries", mxCreateDoubleScalar((double)info.Queries));
+        mxSetField(result, 0, "files", mxCreateDoubleScalar((double)info.Files));
+        mxSetField(result, 0, "hits", mxCreateDoubleScalar((double)info.Hits));
+        mxSetField(result, 0, "misses", mxCreateDoubleScalar((double)info.Misses));
+        mxSetField(result, 0, "wasted", mxCreateDoubleScalar((double)(info.Files - info.Hits)));
+        mxSetField(result, 0, "dropped", mxCreateDoubleScalar((double)info.Dropped));
+        mxSetField(result, 0, "hitRate", mxCreateDoubleScalar(info.Hits + info.Misses > 0 ?
+            (double)info.Hits / (double)(info.Hits + info.Misses) : 0));
+        plhs[0] = result;
+    } else if (strcmpi("SNAPSHOT", sccArgs->Command) == 0) {
+        // id = verctrl('SNAPSHOT', folder) records the state of every file
+        // below folder, for CHANGED_SINCE.
+        char* root = (nrhs > 1) ? mxArrayToString(prhs[1]) : NULL;
+        if (root == NULL || root[0] == '\0') {
+            throwMatlabError(sccArgs, verctrl::verctrl::NoFolder(sccArgs->Command));
+        }
+        ULONGLONG id = merkleSnapshot(internPath(root));
+        if (id == 0) {
+            mexPrintf("verctrl: Unable to read \"%s\"\n", root);
+        } else if (gVerboseMode) {
+            mexPrintf("verctrl: Snapshot %I64u of \"%s\"\n", id, root);
+        }
+        mxFree(root);
+        plhs[0] = mxCreateDoubleScalar((double)id);
+    } else if (strcmpi("CHANGED_SINCE", sccArgs->Command) == 0) {
+        // folders = verctrl('CHANGED_SINCE', folder, id) lists the folders
+        // below folder with files added, changed or deleted since the
+        // snapshot, and the folders added or deleted.
+        char* root = (nrhs > 2) ? mxArrayToString(prhs[1]) : NULL;
+        if (root == NULL || root[0] == '\0') {
+            throwMatlabError(sccArgs, verctrl::verctrl::NoSnapshot(sccArgs->Command));
+        }
+        ULONGLONG id = (ULONGLONG)mxGetScalar(prhs[2]);
+        std::vector<PATHID> changed;
+        bool known = merkleChangedSince(internPath(root), id, changed);
+        mxFree(root);
+        if (!known) {
+            throwMatlabError(sccArgs, verctrl::verctrl::UnknownSnapshot());
+        }
+        mxArray *folders = mxCreateCellMatrix((mwSize)changed.size(), 1);
+        if (folders == NULL)
+			throwMatlabError(sccArgs, verctrl::verctrl::MemoryError());
+        for (size_t i = 0; i < changed.size(); i++)
+            mxSetCell(folders, (mwIndex)i, mxCreateString(pathName(changed[i])));
+        if (gVerboseMode) mexPrintf("verctrl: %d folders changed since snapshot %I64u\n", (int)changed.size(), id);
+        plhs[0] = folders;
+    } else if (strcmpi("SUBSCRIBE", sccArgs->Command) == 0) {
+        // id = verctrl('SUBSCRIBE', folder, callback) watches the files
+        // below folder and queues an event when the status of one changes.
+        // Events are taken with EVENTS, or passed to callback(events) if
+        // one is given. A file of '' means changes were lost and any file
+        // may have changed.
+        char* folderName = (nrhs > 1) ? mxArrayToString(prhs[1]) : NULL;
+        if (folderName == NULL || folderName[0] == '\0') {
+            throwMatlabError(sccArgs, verctrl::verctrl::NoFolder(sccArgs->Command));
+        }
+        PATHID folder = internPath(folderName);
+        mxFree(folderName);
+        SCCPROVIDER *provider = providerForFile(sccArgs, folder);
+        char axPath[SCC_PRJPATH_LEN + 1];
+        char projName[SCC_PRJPATH_LEN + 1];
+        if (!getSavedProjectInfo(sccArgs, folder, projName, axPath)) {
+            throwMatlabError(sccArgs, verctrl::verctrl::NoSavedProject(sccArgs->Command));
+        }
+        int id = subscribeFolder(folder, provider->LibPath, projName, axPath);
+        if (id < 0) {
+            throwMatlabError(sccArgs, verctrl::verctrl::CannotWatchFolder());
+        }
+        mxArray *callback = NULL;
+        if (nrhs > 2 && !mxIsEmpty(prhs[2])) {
+            callback = mxDuplicateArray(prhs[2]);
+            mexMakeArrayPersistent(callback);
+        }
+        gSubscriptions[id] = callback;
+        if (callback != NULL)
+            startEventTimer(sccArgs);
+        if (gVerboseMode) mexPrintf("verctrl: Subscription %d to \"%s\"\n", id, pathName(folder));
+        plhs[0] = mxCreateDoubleScalar(id);
+    } else if (strcmpi("UNSUBSCRIBE", sccArgs->Command) == 0) {
+        // verctrl('UNSUBSCRIBE', id) ends a subscription; without an id,
+        // every subscription. Events not yet taken are dropped.
+        if (nrhs > 1) {
+            int id = (int)mxGetScalar(prhs[1]);
+            unsubscribeFolder(id);
+            std::map<int, mxArray*>::iterator it = gSubscriptions.find(id);
+            if (it != gSubscriptions.end()) {
+                if (it->second != NULL)
+                    mxDestroyArray(it->second);
+                gSubscriptions.erase(it);
+            }
+        } else {
+            stopSubscriptions();
+            forgetEventCallbacks();
+        }
+        if (!hasEventCallbacks())
+            stopEventTimers();
+    } else if (strcmpi("EVENTS", sccArgs->Command) == 0) {
+        // Events of subscriptions made without a callback.
+        querySubscriptionsHere();
+        std::vector<STATUSEVENT> events;
+        for (std::map<int, mxArray*>::const_iterator it = gSubscriptions.begin(); it != gSubscriptions.end(); ++it) {
+            if (it->second == NULL)
+                drainStatusEvents(it->first, events);
+        }
+        plhs[0] = statusEventArray(sccArgs, events);
+    } else if (strcmpi("DISPATCH_EVENTS", sccArgs->Command) == 0) {
+        // Called by the event timer.
+        if (!hasEventCallbacks()) {
+            stopEventTimers();
+        }
+        querySubscriptionsHere();
+        // A callback may call verctrl to subscribe or unsubscribe.
+        std::vector<int> ids;
+        for (std::map<int, mxArray*>::const_iterator it = gSubscriptions.begin(); it != gSubscriptions.end(); ++it) {
+            if (it->second != NULL)
+                ids.push_back(it->first);
+        }
+        for (size_t i = 0; i < ids.size(); i++) {
+            std::map<int, mxArray*>::const_iterator it = gSubscriptions.find(ids[i]);
+            if (it == gSubscriptions.end())
+                continue;
+            std::vector<STATUSEVENT> events;
+            drainStatusEvents(ids[i], events);
+            if (events.empty())
+                continue;
+            mxArray *rhs[2] = {mxDuplicateArray(it->second), statusEventArray(sccArgs, events)};
+            mexSetTrapFlag(1);
+            if (mexCallMATLAB(0, NULL, 2, rhs, "feval") != 0 && gVerboseMode)
+                mexPrintf("verctrl: error in the callback of subscription %d\n", ids[i]);
+            mxDestroyArray(rhs[0]);
+            mxDestroyArray(rhs[1]);
+        }
+    } else if (strcmpi("POOL_SIZE", sccArgs->Command) == 0) {
+        // verctrl('POOL_SIZE', n) opens up to n contexts on providers that
+        // support it; 0 uses one per processor. Providers already loaded
+        // keep their pool. Returns the previous setting.
+        int previous = getSessionPoolSize();
+        if (nrhs > 1) {
+            double size = mxGetScalar(prhs[1]);
+            setSessionPoolSize(size > 0 ? (int)size : 0);
+        }
+        if (gVerboseMode) mexPrintf("verctrl: Session pool size %d\n", getSessionPoolSize());
+        if (nlhs >= 1)
+            plhs[0] = mxCreateDoubleScalar(previous);
     } else {
         // Error checking
         if (sccArgs->FileNames == NULL) {
@@ -841,70 +2071,133 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
         if (sccArgs->WindowHandle == NULL)
 			throwMatlabError(sccArgs,  verctrl::verctrl::BadWindowHandle());
 
-        loadSCCSystem(sccArgs);
+        PROVIDERGROUP *groups;
+        int numberOfGroups = groupFilesByProvider(sccArgs, internFileNames(sccArgs), &groups, false);
+        bool reload = false;
 
-        SCCRTN rtn = openProjFromSavedInfo(sccArgs, sccArgs->WindowHandle);
-        if (!IS_SCC_SUCCESS(rtn)) 
-        {
-            if (gVerboseMode) mexPrintf("verctrl:  openProjFromSavedInfo failed (%s)\n",
-				sccArgs->FileNames[0], errorCodeToString(rtn));
-            rtn = promptAndOpenProject(sccArgs->FileNames[0], sccArgs->WindowHandle);
-            if (rtn == SCC_I_OPERATIONCANCELED) 
-            {
-                if (nlhs >= 1) 
-                {
-                    mxArray *result = mxCreateLogicalScalar(false);
-                    if (result == NULL)
-						throwMatlabError(sccArgs,verctrl::verctrl::MemoryError());
-                    plhs[0]     = result;
+        int journalOp = isJournaling() ? journalOpFor(sccArgs->Command) : -1;
+        bool pristineUncheckout = isJournaling() && isPristineOn() && strcmpi(sccArgs->Command, "UNCHECKOUT") == 0;
+
+        for (int g = 0; g < numberOfGroups; g++) {
+            SCCARGS *groupArgs    = &groups[g].Args;
+            PATHID folder         = parentPathId(groups[g].Ids[0]);
+
+            if (journalOp >= 0) {
+                bool groupReload = false;
+                if (journalGroup(&groups[g], journalOp, folder, &groupReload)) {
+                    reload |= groupReload;
+                    continue;
                 }
-                cleanupInputArgs(sccArgs);
-                return;
             }
-            else if (!IS_SCC_SUCCESS(rtn)) 
-            {
-				if (gVerboseMode) mexPrintf("verctrl:  promptAndOpenProject failed (%s)\n",
-					sccArgs->FileNames[0], errorCodeToString(rtn));
-                throwSccError(sccArgs,rtn);
+            if (pristineUncheckout) {
+                bool groupReload = false;
+                if (uncheckoutFromPristine(&groups[g], folder, &groupReload)) {
+                    reload |= groupReload;
+                    continue;
+                }
+            }
+            // Compare with the base revision kept locally, if there is one,
+            // without waiting for the journal or the provider.
+            if (isPristineOn() && strcmpi(sccArgs->Command, "ISDIFF") == 0) {
+                int compare = comparePristine(groups[g].Ids[0]);
+                if (compare != PRISTINE_UNKNOWN) {
+                    reload |= compare == PRISTINE_DIFFERENT;
+                    continue;
+                }
+            }
+            if (isPristineOn() && strcmpi(sccArgs->Command, "SHOWDIFF") == 0 &&
+                showDiffFromPristine(groupArgs, groups[g].Ids[0])) {
+                continue;
+            }
+            // Let journaled operations on the files reach the provider
+            // first. This must not hold a session the journal may need.
+            // The ones left for this thread are sent from here.
+            sendJournalOpsHere();
+            SCCRTN journalRtn;
+            if (!waitForJournal(groupArgs->NumberOfFiles, groups[g].Ids, JOURNAL_WAIT_MS, &journalRtn)) {
+                if (gVerboseMode) mexPrintf("verctrl: journaled operations on %s not sent yet\n", groupArgs->FileNames[0]);
+                throwSccError(groupArgs, journalRtn);
             }
-        }
 
-        bool reload = false;
+            SCCSESSION *session   = holdSession(sccArgs, groups[g].Provider, folder);
 
-        if (strcmpi(sccArgs->Command, "ADD") == 0) {
-            reload = add(sccArgs);
-        }
-        else if (strcmpi(sccArgs->Command, "CHECKOUT") == 0) {
-            reload = checkout(sccArgs);
-        }
-        else if (strcmpi(sccArgs->Command, "CHECKIN") == 0) {
-            reload = checkin(sccArgs);
-        }
-        else if (strcmpi(sccArgs->Command, "GET") == 0) {
-            reload = get(sccArgs);
-        }
-        else if (strcmpi(sccArgs->Command, "UNCHECKOUT") == 0) {
-            reload = uncheckout(sccArgs);
-        }
-        else if (strcmpi(sccArgs->Command, "REMOVE") == 0) {
-            remove(sccArgs);
-        }
-        else if (strcmpi(sccArgs->Command, "SHOWDIFF") == 0) {
-            showDiff(sccArgs);
-        }
-        else if (strcmpi(sccArgs->Command, "ISDIFF") == 0) {
-            reload       = isDiff(sccArgs->FileNames[0], sccArgs->WindowHandle);
-        }
-        else if (strcmpi(sccArgs->Command, "HISTORY") == 0) {
-            reload     = history(sccArgs);
-        }
-        else if (strcmpi(sccArgs->Command, "PROPERTIES") == 0) {
-            reload     = properties(sccArgs);
-        }
-        else {
-            char warnTxt[128];
-            sprintf(warnTxt, "Not a valid command: %s", sccArgs->Command);
-            mexWarnMsgTxt(warnTxt);
+            SCCRTN rtn = openProjFromSavedInfo(session, groupArgs, folder, groupArgs->WindowHandle);
+            if (!IS_SCC_SUCCESS(rtn)) 
+            {
+                if (gVerboseMode) mexPrintf("verctrl:  openProjFromSavedInfo failed (%s)\n",
+					groupArgs->FileNames[0], errorCodeToString(rtn));
+                rtn = promptAndOpenProject(session, folder, groupArgs->WindowHandle);
+                if (rtn == SCC_I_OPERATIONCANCELED) 
+                {
+                    releaseHeldSession(session);
+                    continue;
+                }
+                else if (!IS_SCC_SUCCESS(rtn)) 
+                {
+					if (gVerboseMode) mexPrintf("verctrl:  promptAndOpenProject failed (%s)\n",
+						groupArgs->FileNames[0], errorCodeToString(rtn));
+                    releaseAndThrowSccError(groupArgs, rtn);
+                }
+            }
+
+            // The provider may change the status of the files, whether or
+            // not the command goes on to fail.
+            for (int i = 0; i < groupArgs->NumberOfFiles; i++)
+                invalidateStatus(groups[g].Ids[i]);
+
+            // Files the command leaves at their base revision are kept in
+            // the pristine store.
+            bool atBase = false;
+            if (strcmpi(sccArgs->Command, "ADD") == 0) {
+                atBase      = add(session, groupArgs);
+                reload     |= atBase;
+                // Again, in case another thread found the files not
+                // controlled while they were being added.
+                for (int i = 0; i < groupArgs->NumberOfFiles; i++)
+                    invalidateStatus(groups[g].Ids[i]);
+            }
+            else if (strcmpi(sccArgs->Command, "CHECKOUT") == 0) {
+                atBase      = checkout(session, groupArgs);
+                reload     |= atBase;
+            }
+            else if (strcmpi(sccArgs->Command, "CHECKIN") == 0) {
+                atBase      = checkin(session, groupArgs);
+                reload     |= atBase;
+            }
+            else if (strcmpi(sccArgs->Command, "GET") == 0) {
+                atBase      = get(session, groupArgs);
+                reload     |= atBase;
+            }
+            else if (strcmpi(sccArgs->Command, "UNCHECKOUT") == 0) {
+                atBase      = uncheckout(session, groupArgs);
+                reload     |= atBase;
+            }
+            else if (strcmpi(sccArgs->Command, "REMOVE") == 0) {
+                remove(session, groupArgs);
+                forgetPristine(groupArgs->NumberOfFiles, groups[g].Ids);
+            }
+            else if (strcmpi(sccArgs->Command, "SHOWDIFF") == 0) {
+                showDiff(session, groupArgs);
+            }
+            else if (strcmpi(sccArgs->Command, "ISDIFF") == 0) {
+                reload     |= isDiff(session, groupArgs->FileNames[0], groupArgs->WindowHandle);
+            }
+            else if (strcmpi(sccArgs->Command, "HISTORY") == 0) {
+                reload     |= history(session, groupArgs);
+            }
+            else if (strcmpi(sccArgs->Command, "PROPERTIES") == 0) {
+                reload     |= properties(session, groupArgs);
+            }
+            else {
+                releaseHeldSession(session);
+                char warnTxt[128];
+                sprintf(warnTxt, "Not a valid command: %s", sccArgs->Command);
+                mexWarnMsgTxt(warnTxt);
+                break;
+            }
+            releaseHeldSession(session);
+            if (atBase)
+                capturePristine(groupArgs->NumberOfFiles, groups[g].Ids);
         }
         if (nlhs >= 1) {
             mxArray *result = mxCreateLogicalScalar(reload);
@@ -0,0 +1,424 @@
+/*
+*
+*
+* The source code contained in this listing contains proprietary and
+* confidential trade secrets of The MathWorks, Inc.  The use, modification,
+* or development of derivative work based on the code or ideas obtained
+* from the code is prohibited without the express written permission of The
+* MathWorks, Inc. The disclosure of this code to any party not authorized
+* by The MathWorks, Inc. is strictly forbidden.
+* CONFIDENTIAL AND CONTAINING PROPRIETARY TRADE SECRETS
+*/
+
+/*
+* The status cache is split into shards by path id, each with its own
+* reader/writer lock, so that STATUS calls for different files running
+* on different threads rarely touch the same lock. Lookups only take the
+* lock shared.
+*
+* Files the provider reported as not controlled are also kept per folder,
+* as a sorted array of path ids, with the last write time of the folder
+* when the first of them was stored. Creating, deleting or renaming a file
+* in the folder changes that time and drops the folder's files. Path ids
+* are small integers, so the array is as compact as a filter of 32 bit
+* fingerprints and, unlike one, never reports a controlled file as not
+* controlled.
+*
+* Invalidated entries are kept as tombstones so that a status queried
+* before the invalidation is not stored. A shard that grows past a
+* bound is swept of tombstones and expired entries; the sweep advances
+* the shard's cleared epoch, which rejects those late statuses in their
+* place.
+*/
+
+#include <windows.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+
+#include "verctrlPath.h"
+#include "verctrlCache.h"
+
+#define STATUS_CACHE_SHARDS 64
+#define STATUS_SHARD_SWEEP  4096            // entries in a shard before it is first swept
+
+#define NEGATIVE_CACHE_MAX_FILES    (1024 * 1024)   // all are dropped past this
+#define NEGATIVE_UNSORTED_MAX       64              // files appended before they are merged in
+#define NEGATIVE_CHECK_MS           1000            // how often a folder's write time is read
+
+typedef struct STATUSENTRY {
+    LONG        Status;
+    bool        Valid;
+    ULONGLONG   Stamp;          // GetTickCount64 when stored
+    ULONGLONG   Invalidated;    // epoch of the last invalidateStatus, or 0
+} STATUSENTRY;
+
+typedef struct STATUSSHARD {
+    SRWLOCK                             Lock;
+    ULONGLONG                           Cleared;    // epoch of the last invalidateAllStatus or sweep
+    size_t                              SweepAt;    // size of Entries that triggers a sweep, 0 for the default
+    std::map<PATHID, STATUSENTRY>  Entries;
+} STATUSSHARD;
+
+typedef struct NEGATIVEFOLDER {
+    ULONGLONG               WriteTime;  // of the folder, when its first file was stored
+    ULONGLONG               Created;    // GetTickCount64
+    ULONGLONG               Checked;    // GetTickCount64 when WriteTime was last compared
+    std::vector<PATHID>     Files;      // sorted up to Sorted, then in the order stored
+    size_t                  Sorted;
+} NEGATIVEFOLDER;
+
+typedef struct PROJECTINFO {
+    std::string ProjName;
+    std::string AxPath;
+} PROJECTINFO;
+
+static STATUSSHARD                          gStatusShards[STATUS_CACHE_SHARDS];
+static volatile LONG                        gStatusTimeout  = 0;
+static SRWLOCK                              gNegativeLock   = SRWLOCK_INIT;
+static std::map<PATHID, NEGATIVEFOLDER>     gNegative;      // by folder
+static size_t                               gNegativeFiles  = 0;
+static volatile LONG                        gNegativeTimeout = 0;
+static volatile LONG                        gNegativeHits   = 0;
+static SRWLOCK                              gProjectLock    = SRWLOCK_INIT;
+static std::map<PATHID, PROJECTINFO>   gProjects;
+
+static bool folderWriteTime(PATHID folder, ULONGLONG *writeTime) {
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    std::string name;
+    longPathName(folder, name);
+    if (!GetFileAttributesEx(name.c_str(), GetFileExInfoStandard, &data))
+        return false;
+    *writeTime = ((ULONGLONG)data.ftLastWriteTime.dwHighDateTime << 32) | data.ftLastWriteTime.dwLowDateTime;
+    return true;
+}
+
+static bool hasNegativeFile(const NEGATIVEFOLDER &folder, PATHID file) {
+    return std::binary_search(folder.Files.begin(), folder.Files.begin() + folder.Sorted, file) ||
+        std::find(folder.Files.begin() + folder.Sorted, folder.Files.end(), file) != folder.Files.end();
+}
+
+/*
+* Whether file is known not to be controlled. The write time of its folder
+* is read again at most every NEGATIVE_CHECK_MS.
+*/
+static bool lookupNotControlled(PATHID file) {
+    DWORD timeout = getNegativeCacheTimeout();
+    if (timeout == 0)
+        return false;
+    PATHID folder   = parentPathId(file);
+    ULONGLONG now   = GetTickCount64();
+    bool found      = false;
+    bool check      = false;
+
+    AcquireSRWLockShared(&gNegativeLock);
+    std::map<PATHID, NEGATIVEFOLDER>::const_iterator it = gNegative.find(folder);
+    if (it != gNegative.end() && now - it->second.Created < timeout) {
+        found   = hasNegativeFile(it->second, file);
+        check   = found && now - it->second.Checked >= NEGATIVE_CHECK_MS;
+    }
+    ReleaseSRWLockShared(&gNegativeLock);
+    if (!check) {
+        if (found)
+            InterlockedIncrement(&gNegativeHits);
+        return found;
+    }
+
+    ULONGLONG writeTime;
+    bool same = folderWriteTime(folder, &writeTime);
+    AcquireSRWLockExclusive(&gNegativeLock);
+    std::map<PATHID, NEGATIVEFOLDER>::iterator entry = gNegative.find(folder);
+    if (entry == gNegative.end()) {
+        same = false;
+    } else if (same && entry->second.WriteTime == writeTime) {
+        entry->second.Checked = now;
+    } else {
+        same = false;
+        gNegativeFiles -= entry->second.Files.size();
+        gNegative.erase(entry);
+    }
+    ReleaseSRWLockExclusive(&gNegativeLock);
+    if (same)
+        InterlockedIncrement(&gNegativeHits);
+    return same;
+}
+
+/*
+* The write time to store with a file of folder: the one last read for the
+* folder if it is recent enough, rather than reading it for every file of
+* a batch. Returns false if the folder cannot be read.
+*/
+static bool negativeWriteTime(PATHID folder, ULONGLONG now, ULONGLONG *writeTime) {
+    DWORD timeout   = getNegativeCacheTimeout();
+    bool known      = false;
+    AcquireSRWLockShared(&gNegativeLock);
+    std::map<PATHID, NEGATIVEFOLDER>::const_iterator it = gNegative.find(folder);
+    if (it != gNegative.end() && now - it->second.Created < timeout && now - it->second.Checked < NEGATIVE_CHECK_MS) {
+        *writeTime  = it->second.WriteTime;
+        known       = true;
+    }
+    ReleaseSRWLockShared(&gNegativeLock);
+    return known || folderWriteTime(folder, writeTime);
+}
+
+/*
+* Called with the lock of the file's shard held, so that it cannot be
+* invalidated in between.
+*/
+static void storeNotControlled(PATHID file, ULONGLONG writeTime, ULONGLONG now) {
+    DWORD timeout = getNegativeCacheTimeout();
+    PATHID folder = parentPathId(file);
+
+    AcquireSRWLockExclusive(&gNegativeLock);
+    std::map<PATHID, NEGATIVEFOLDER>::iterator entry = gNegative.find(folder);
+    if (entry == gNegative.end() || now - entry->second.Created >= timeout ||
+        entry->second.WriteTime != writeTime) {
+        if (entry != gNegative.end())
+            gNegativeFiles -= entry->second.Files.size();
+        NEGATIVEFOLDER &created = gNegative[folder];
+        created.WriteTime   = writeTime;
+        created.Created     = now;
+        created.Checked     = now;
+        created.Files.clear();
+        created.Sorted      = 0;
+        entry = gNegative.find(folder);
+    }
+    NEGATIVEFOLDER &negative = entry->second;
+    if (!hasNegativeFile(negative, file)) {
+        negative.Files.push_back(file);
+        gNegativeFiles++;
+        if (negative.Files.size() - negative.Sorted > NEGATIVE_UNSORTED_MAX) {
+            std::sort(negative.Files.begin() + negative.Sorted, negative.Files.end());
+            std::inplace_merge(negative.Files.begin(), negative.Files.begin() + negative.Sorted,
+                negative.Files.end());
+            negative.Sorted = negative.Files.size();
+        }
+    }
+    if (gNegativeFiles > NEGATIVE_CACHE_MAX_FILES) {
+        gNegative.clear();
+        gNegativeFiles = 0;
+    }
+    ReleaseSRWLockExclusive(&gNegativeLock);
+}
+
+static void forgetNotControlled(PATHID file) {
+    AcquireSRWLockExclusive(&gNegativeLock);
+    std::map<PATHID, NEGATIVEFOLDER>::iterator entry = gNegative.find(parentPathId(file));
+    if (entry != gNegative.end()) {
+        NEGATIVEFOLDER &negative = entry->second;
+        std::vector<PATHID>::iterator sortedEnd = negative.Files.begin() + negative.Sorted;
+        std::vector<PATHID>::iterator at = std::lower_bound(negative.Files.begin(), sortedEnd, file);
+        if (at != sortedEnd && *at == file) {
+            negative.Files.erase(at);
+            negative.Sorted--;
+            gNegativeFiles--;
+        } else if ((at = std::find(sortedEnd, negative.Files.end(), file)) != negative.Files.end()) {
+            negative.Files.erase(at);
+            gNegativeFiles--;
+        }
+    }
+    ReleaseSRWLockExclusive(&gNegativeLock);
+}
+
+static void forgetAllNotControlled() {
+    AcquireSRWLockExclusive(&gNegativeLock);
+    gNegative.clear();
+    gNegativeFiles = 0;
+    ReleaseSRWLockExclusive(&gNegativeLock);
+}
+
+/*
+* Reject statuses queried before now, as when the caches are turned on:
+* nothing was invalidated while they were off.
+*/
+static void advanceClearedEpochs() {
+    for (int i = 0; i < STATUS_CACHE_SHARDS; i++) {
+        AcquireSRWLockExclusive(&gStatusShards[i].Lock);
+        gStatusShards[i].Cleared = getStatusEpoch();
+        ReleaseSRWLockExclusive(&gStatusShards[i].Lock);
+    }
+}
+
+void setStatusCacheTimeout(DWORD milliseconds) {
+    DWORD previous = (DWORD)InterlockedExchange(&gStatusTimeout, (LONG)milliseconds);
+    if (milliseconds == 0)
+        invalidateAllStatus();
+    else if (previous == 0 && getNegativeCacheTimeout() == 0)
+        advanceClearedEpochs();
+}
+
+DWORD getStatusCacheTimeout() {
+    return (DWORD)gStatusTimeout;
+}
+
+/*
+* Epochs are read from the performance counter rather than a shared
+* counter, so invalidating a file only writes to its own shard.
+*/
+ULONGLONG getStatusEpoch() {
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    return (ULONGLONG)now.QuadPart;
+}
+
+bool lookupStatus(PATHID file, LONG *status) {
+    if (file == NO_PATH)
+        return false;
+    DWORD timeout       = getStatusCacheTimeout();
+    STATUSSHARD *shard  = &gStatusShards[file % STATUS_CACHE_SHARDS];
+    bool found          = false;
+
+    if (timeout != 0) {
+        AcquireSRWLockShared(&shard->Lock);
+        std::map<PATHID, STATUSENTRY>::const_iterator it = shard->Entries.find(file);
+        if (it != shard->Entries.end() && it->second.Valid && GetTickCount64() - it->second.Stamp < timeout) {
+            *status = it->second.Status;
+            found   = true;
+        }
+        ReleaseSRWLockShared(&shard->Lock);
+    }
+    if (!found && lookupNotControlled(file)) {
+        *status = SCC_STATUS_NOTCONTROLLED;
+        found   = true;
+    }
+    return found;
+}
+
+/*
+* Drop the shard's tombstones and expired entries. Called with the
+* shard's lock held exclusively.
+*/
+static void sweepShard(STATUSSHARD *shard, ULONGLONG now, DWORD timeout) {
+    std::map<PATHID, STATUSENTRY>::iterator it = shard->Entries.begin();
+    while (it != shard->Entries.end()) {
+        if (!it->second.Valid || now - it->second.Stamp >= timeout)
+            shard->Entries.erase(it++);
+        else
+            ++it;
+    }
+    shard->Cleared = getStatusEpoch();
+    shard->SweepAt = shard->Entries.size() * 2;
+    if (shard->SweepAt < STATUS_SHARD_SWEEP)
+        shard->SweepAt = STATUS_SHARD_SWEEP;
+}
+
+bool storeStatus(PATHID file, LONG status, ULONGLONG epoch) {
+    if (file == NO_PATH)
+        return false;
+    ULONGLONG now   = GetTickCount64();
+    DWORD timeout   = getStatusCacheTimeout();
+    bool positive   = timeout != 0;
+    ULONGLONG writeTime;
+    bool negative   = status == SCC_STATUS_NOTCONTROLLED && getNegativeCacheTimeout() != 0 &&
+        negativeWriteTime(parentPathId(file), now, &writeTime);
+    if (!positive && !negative)
+        return false;
+    STATUSSHARD *shard  = &gStatusShards[file % STATUS_CACHE_SHARDS];
+
+    AcquireSRWLockExclusive(&shard->Lock);
+    std::map<PATHID, STATUSENTRY>::iterator it = shard->Entries.find(file);
+    bool current = shard->Cleared < epoch && (it == shard->Entries.end() || it->second.Invalidated < epoch);
+    if (current && positive) {
+        if (it == shard->Entries.end() &&
+            shard->Entries.size() >= (shard->SweepAt != 0 ? shard->SweepAt : STATUS_SHARD_SWEEP))
+            sweepShard(shard, now, timeout);
+        STATUSENTRY &entry  = it != shard->Entries.end() ? it->second : shard->Entries[file];
+        if (it == shard->Entries.end())
+            entry.Invalidated = 0;
+        entry.Status        = status;
+        entry.Valid         = true;
+        entry.Stamp         = now;
+    }
+    if (current && negative)
+        storeNotControlled(file, writeTime, now);
+    ReleaseSRWLockExclusive(&shard->Lock);
+    return current;
+}
+
+/*
+* The entry is kept, marked invalid, so that statuses queried before this
+* are not stored by storeStatus. Nothing is kept while both caches are
+* off; turning one on rejects statuses queried before.
+*/
+void invalidateStatus(PATHID file) {
+    if (file == NO_PATH || (getStatusCacheTimeout() == 0 && getNegativeCacheTimeout() == 0))
+        return;
+    STATUSSHARD *shard  = &gStatusShards[file % STATUS_CACHE_SHARDS];
+
+    AcquireSRWLockExclusive(&shard->Lock);
+    STATUSENTRY &entry  = shard->Entries[file];
+    entry.Valid         = false;
+    entry.Invalidated   = getStatusEpoch();
+    ReleaseSRWLockExclusive(&shard->Lock);
+    forgetNotControlled(file);
+}
+
+void invalidateAllStatus() {
+    for (int i = 0; i < STATUS_CACHE_SHARDS; i++) {
+        AcquireSRWLockExclusive(&gStatusShards[i].Lock);
+        gStatusShards[i].Entries.clear();
+        gStatusShards[i].Cleared = getStatusEpoch();
+        gStatusShards[i].SweepAt = 0;
+        ReleaseSRWLockExclusive(&gStatusShards[i].Lock);
+    }
+    forgetAllNotControlled();
+}
+
+void setNegativeCacheTimeout(DWORD milliseconds) {
+    DWORD previous = (DWORD)InterlockedExchange(&gNegativeTimeout, (LONG)milliseconds);
+    if (milliseconds == 0)
+        forgetAllNotControlled();
+    else if (previous == 0 && getStatusCacheTimeout() == 0)
+        advanceClearedEpochs();
+}
+
+DWORD getNegativeCacheTimeout() {
+    return (DWORD)gNegativeTimeout;
+}
+
+void getNegativeCacheInfo(int *folders, int *files, ULONGLONG *hits) {
+    AcquireSRWLockShared(&gNegativeLock);
+    *folders    = (int)gNegative.size();
+    *files      = (int)gNegativeFiles;
+    ReleaseSRWLockShared(&gNegativeLock);
+    *hits       = (ULONGLONG)gNegativeHits;
+}
+
+/*
+* projName and axPath must hold SCC_PRJPATH_LEN + 1 characters.
+*/
+bool lookupProjectInfo(PATHID folder, char *projName, char *axPath) {
+    bool found      = false;
+
+    AcquireSRWLockShared(&gProjectLock);
+    std::map<PATHID, PROJECTINFO>::const_iterator it = gProjects.find(folder);
+    if (it != gProjects.end()) {
+        strncpy(projName, it->second.ProjName.c_str(), SCC_PRJPATH_LEN);
+        projName[SCC_PRJPATH_LEN] = '\0';
+        strncpy(axPath, it->second.AxPath.c_str(), SCC_PRJPATH_LEN);
+        axPath[SCC_PRJPATH_LEN] = '\0';
+        found = true;
+    }
+    ReleaseSRWLockShared(&gProjectLock);
+    return found;
+}
+
+void storeProjectInfo(PATHID folder, const char *projName, const char *axPath) {
+    if (folder == NO_PATH)
+        return;
+    PROJECTINFO info;
+    info.ProjName   = projName;
+    info.AxPath     = axPath;
+
+    AcquireSRWLockExclusive(&gProjectLock);
+    gProjects[folder] = info;
+    ReleaseSRWLockExclusive(&gProjectLock);
+}
+
+void invalidateAllProjectInfo() {
+    AcquireSRWLockExclusive(&gProjectLock);
+    gProjects.clear();
+    ReleaseSRWLockExclusive(&gProjectLock);
+}
@@ -0,0 +1,51 @@
+/*
+*
+*
+* The source code contained in this listing contains proprietary and
+* confidential trade secrets of The MathWorks, Inc.  The use, modification,
+* or development of derivative work based on the code or ideas obtained
+* from the code is prohibited without the express written permission of The
+* MathWorks, Inc. The disclosure of this code to any party not authorized
+* by The MathWorks, Inc. is strictly forbidden.
+* CONFIDENTIAL AND CONTAINING PROPRIETARY TRADE SECRETS
+*/
+
+#ifndef VERCTRLCACHE_H
+#define VERCTRLCACHE_H
+
+#include <windows.h>
+#include "scc.h"
+#include "verctrlPath.h"
+
+/*
+* Caches shared by every thread calling into verctrl. All functions
+* are thread-safe and none of them use the MEX API.
+*/
+
+// File status returned by the provider. Disabled while the timeout is 0.
+// A status is only stored if the file was not invalidated since the
+// epoch taken before the provider was asked for it; storeStatus returns
+// whether it was.
+void setStatusCacheTimeout(DWORD milliseconds);
+DWORD getStatusCacheTimeout();
+ULONGLONG getStatusEpoch();
+bool lookupStatus(PATHID file, LONG *status);
+bool storeStatus(PATHID file, LONG status, ULONGLONG epoch);
+void invalidateStatus(PATHID file);
+void invalidateAllStatus();
+
+// Files the provider reported as not controlled, kept per folder until
+// the folder is written to, so that lookupStatus answers for them while
+// the status cache is off or has timed out. Filled by storeStatus and
+// emptied with the status cache. Disabled while the timeout is 0.
+void setNegativeCacheTimeout(DWORD milliseconds);
+DWORD getNegativeCacheTimeout();
+void getNegativeCacheInfo(int *folders, int *files, ULONGLONG *hits);
+
+// Project name and aux path saved for a folder with savesccprj, so that
+// sessions can open projects without calling back into MATLAB.
+bool lookupProjectInfo(PATHID folder, char *projName, char *axPath);
+void storeProjectInfo(PATHID folder, const char *projName, const char *axPath);
+void invalidateAllProjectInfo();
+
+#endif
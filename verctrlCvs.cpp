@@ -0,0 +1,1047 @@
+/*
+*
+*
+* The source code contained in this listing contains proprietary and
+* confidential trade secrets of The MathWorks, Inc.  The use, modification,
+* or development of derivative work based on the code or ideas obtained
+* from the code is prohibited without the express written permission of The
+* MathWorks, Inc. The disclosure of this code to any party not authorized
+* by The MathWorks, Inc. is strictly forbidden.
+* CONFIDENTIAL AND CONTAINING PROPRIETARY TRADE SECRETS
+*/
+
+/*
+* A command on one folder is sent as
+*
+*   Argument <option>                   for each option
+*   Directory .                         the folder
+*   <repository folder>
+*   Entry /name/rev//options/tag        for each file in CVS\Entries
+*   Unchanged name, or Is-modified name, or
+*   Modified name, mode, size and contents
+*   Argument --
+*   Argument name                       for each file
+*   <command>
+*
+* and answered by responses ending in "ok" or "error". Every folder of a
+* command is sent at once by a writer thread while the responses are
+* read, so neither side waits for the other between folders. A server
+* that sends nothing for CVS_READ_TIMEOUT_MS while a response is awaited
+* is stopped, and its session dropped.
+*/
+
+#include <windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <string>
+#include <vector>
+#include <map>
+
+#include "scc.h"
+#include "verctrlPath.h"
+#include "verctrlCvs.h"
+
+#define CVS_BUFFER_SIZE     (64 * 1024)
+
+// How long a server is given to exit once its input is closed.
+#define CVS_EXIT_WAIT_MS    5000
+
+// How long a server may send nothing while a response is awaited, and
+// the longest wait between checks for its output.
+#define CVS_READ_TIMEOUT_MS 60000
+#define CVS_POLL_MAX_MS     10
+
+static const char *gValidResponses =
+    "Valid-responses ok error Valid-requests Checked-in New-entry Checksum Copy-file Updated Created "
+    "Update-existing Merged Mode Mod-time Removed Remove-entry Set-static-directory Clear-static-directory "
+    "Set-sticky Clear-sticky Template Notified Module-expansion M Mbinary E F MT\n";
+
+static const char *gDays[]   = {"Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"};
+static const char *gMonths[] = {"Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+
+typedef struct CVSSESSION {
+    std::string     Root;           // as in CVS\Root
+    HANDLE          Process;
+    HANDLE          ToServer;
+    HANDLE          FromServer;
+    HANDLE          Writer;         // thread writing Out, or NULL
+    std::string     Out;            // requests being written
+    std::string     ValidRequests;  // separated and surrounded by spaces
+    char            Buffer[CVS_BUFFER_SIZE];
+    DWORD           Start;
+    DWORD           End;
+    bool            TimedOut;       // stopped for not answering
+} CVSSESSION;
+
+typedef struct CVSFOLDER {
+    PATHID                      Folder;
+    std::string                 Root;
+    std::string                 Repository;     // full path in the repository
+    std::vector<std::string>    Entries;        // lines of CVS\Entries
+    bool                        Changed;
+} CVSFOLDER;
+
+enum { SEND_NOTHING, SEND_ENTRIES, SEND_CONTENTS };
+
+typedef struct CVSBLOCK {
+    CVSFOLDER                  *Folder;
+    const char                 *Command;
+    std::vector<std::string>    Arguments;
+    std::vector<std::string>    Names;
+    int                         Send;
+    char                        Notify;         // 'E' or 'U' to send notifications, or 0
+    bool                        Ok;
+    std::string                 Output;         // M, MT and Mbinary
+    std::string                 Errors;         // E and error
+} CVSBLOCK;
+
+static std::map<std::string, CVSSESSION *> gSessions;  // by root
+
+static bool readWholeFile(const char *fileName, std::string &data) {
+    data.clear();
+    HANDLE file = CreateFile(fileName, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+        OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+    char buffer[CVS_BUFFER_SIZE];
+    DWORD got;
+    while (ReadFile(file, buffer, sizeof(buffer), &got, NULL) && got > 0)
+        data.append(buffer, got);
+    CloseHandle(file);
+    return true;
+}
+
+static bool writeWholeFile(const char *fileName, const std::string &data, const FILETIME *modTime) {
+    DWORD attr = GetFileAttributes(fileName);
+    if (attr != INVALID_FILE_ATTRIBUTES && (attr & FILE_ATTRIBUTE_READONLY) != 0)
+        SetFileAttributes(fileName, attr & ~FILE_ATTRIBUTE_READONLY);
+    HANDLE file = CreateFile(fileName, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+    DWORD written = 0;
+    BOOL ok = data.empty() || WriteFile(file, data.data(), (DWORD)data.size(), &written, NULL);
+    if (ok && modTime != NULL)
+        SetFileTime(file, NULL, NULL, modTime);
+    CloseHandle(file);
+    return ok && written == data.size();
+}
+
+static void firstLine(const std::string &text, std::string &line) {
+    size_t end = text.find_first_of("\r\n");
+    line = text.substr(0, end);
+}
+
+static const char *baseName(const char *path) {
+    const char *slash = strrchr(path, '/');
+    const char *backslash = strrchr(path, '\\');
+    if (backslash > slash)
+        slash = backslash;
+    return slash != NULL ? slash + 1 : path;
+}
+
+static void joinPath(PATHID folder, const char *name, std::string &path) {
+    path = pathName(folder);
+    if (path.empty() || path[path.size() - 1] != '\\')
+        path += '\\';
+    path += name;
+}
+
+/*
+* Split a root into the path of the repository and the command line that
+* starts its server. Returns false for methods other than local and ext,
+* and for ext hosts that are not a plain [user@]host.
+*/
+static bool parseRoot(const std::string &root, std::string &path, std::string &command) {
+    std::string rest = root;
+    if (rest.compare(0, 7, ":local:") == 0) {
+        rest = rest.substr(7);
+    } else if (rest.compare(0, 5, ":ext:") == 0) {
+        rest = rest.substr(5);
+        size_t colon = rest.find(':');
+        if (colon == std::string::npos)
+            return false;
+        // The host comes from the working copy, so it must not be able to
+        // pass options to ssh, e.g. -oProxyCommand, or split into more
+        // arguments.
+        std::string host = rest.substr(0, colon);
+        if (host.empty() || host[0] == '-' || host.find_first_of(" \t\r\n\"") != std::string::npos)
+            return false;
+        const char *rsh = getenv("CVS_RSH");
+        command = std::string(rsh != NULL && rsh[0] != '\0' ? rsh : "ssh") + " -- " + host + " cvs server";
+        path = rest.substr(colon + 1);
+        return !path.empty();
+    } else if (!rest.empty() && rest[0] == ':') {
+        return false;
+    }
+    command = "cvs server";
+    path    = rest;
+    return !path.empty();
+}
+
+/*
+* CVS keeps times in Entries as asctime() in UTC.
+*/
+static void formatTime(const SYSTEMTIME &st, std::string &text) {
+    char buffer[32];
+    _snprintf(buffer, sizeof(buffer), "%s %s %2d %02d:%02d:%02d %d", gDays[st.wDayOfWeek % 7],
+        gMonths[(st.wMonth + 11) % 12], st.wDay, st.wHour, st.wMinute, st.wSecond, st.wYear);
+    buffer[sizeof(buffer) - 1] = '\0';
+    text = buffer;
+}
+
+static bool fileTimestamp(const char *fileName, std::string &text) {
+    WIN32_FILE_ATTRIBUTE_DATA info;
+    SYSTEMTIME st;
+    if (!GetFileAttributesEx(fileName, GetFileExInfoStandard, &info) ||
+        !FileTimeToSystemTime(&info.ftLastWriteTime, &st))
+        return false;
+    formatTime(st, text);
+    return true;
+}
+
+// Mod-time responses are RFC 822 dates, such as "7 Apr 1996 01:29:26 -0000".
+static bool parseModTime(const char *text, FILETIME *ft) {
+    int day, year, hour, minute, second;
+    char month[4];
+    if (sscanf(text, "%d %3s %d %d:%d:%d", &day, month, &year, &hour, &minute, &second) != 6)
+        return false;
+    SYSTEMTIME st;
+    memset(&st, 0, sizeof(st));
+    for (int m = 0; m < 12; m++) {
+        if (_stricmp(month, gMonths[m]) == 0)
+            st.wMonth = (WORD)(m + 1);
+    }
+    st.wYear    = (WORD)year;
+    st.wDay     = (WORD)day;
+    st.wHour    = (WORD)hour;
+    st.wMinute  = (WORD)minute;
+    st.wSecond  = (WORD)second;
+    return st.wMonth != 0 && SystemTimeToFileTime(&st, ft) != 0;
+}
+
+/*
+* Field n of an Entries line /name/rev/timestamp/options/tag, counting
+* name as 1.
+*/
+static std::string entryField(const std::string &line, int n) {
+    size_t start = 0;
+    for (int i = 0; i < n; i++) {
+        start = line.find('/', start);
+        if (start == std::string::npos)
+            return "";
+        start++;
+    }
+    size_t end = line.find('/', start);
+    return line.substr(start, end == std::string::npos ? std::string::npos : end - start);
+}
+
+static std::string withField(const std::string &line, int n, const std::string &value) {
+    size_t start = 0;
+    for (int i = 0; i < n; i++) {
+        start = line.find('/', start);
+        if (start == std::string::npos)
+            return line;
+        start++;
+    }
+    size_t end = line.find('/', start);
+    return line.substr(0, start) + value + (end == std::string::npos ? "" : line.substr(end));
+}
+
+static int findEntry(const CVSFOLDER *folder, const char *name) {
+    for (size_t i = 0; i < folder->Entries.size(); i++) {
+        const std::string &line = folder->Entries[i];
+        if (!line.empty() && line[0] == '/' && _stricmp(entryField(line, 1).c_str(), name) == 0)
+            return (int)i;
+    }
+    return -1;
+}
+
+static void setEntry(CVSFOLDER *folder, const std::string &line) {
+    int i = findEntry(folder, entryField(line, 1).c_str());
+    if (i >= 0)
+        folder->Entries[i] = line;
+    else
+        folder->Entries.push_back(line);
+    folder->Changed = true;
+}
+
+static void removeEntry(CVSFOLDER *folder, const char *name) {
+    int i = findEntry(folder, name);
+    if (i >= 0) {
+        folder->Entries.erase(folder->Entries.begin() + i);
+        folder->Changed = true;
+    }
+}
+
+static bool isBinary(const std::string &entry) {
+    return entryField(entry, 4).find("-kb") != std::string::npos;
+}
+
+static bool isLocallyModified(const CVSFOLDER *folder, const std::string &entry) {
+    std::string rev = entryField(entry, 2);
+    if (rev == "0" || (!rev.empty() && rev[0] == '-'))
+        return true;        // added or removed
+    std::string fileName, timestamp;
+    joinPath(folder->Folder, entryField(entry, 1).c_str(), fileName);
+    return !fileTimestamp(fileName.c_str(), timestamp) || timestamp != entryField(entry, 3);
+}
+
+/*
+* Read the CVS folder of folder. Returns false if it has none.
+*/
+static bool loadFolder(PATHID id, CVSFOLDER &folder) {
+    std::string base, text, repository, path, command;
+    joinPath(id, "CVS\\", base);
+    folder.Folder  = id;
+    folder.Changed = false;
+    if (!readWholeFile((base + "Root").c_str(), text))
+        return false;
+    firstLine(text, folder.Root);
+    if (!readWholeFile((base + "Repository").c_str(), text))
+        return false;
+    firstLine(text, repository);
+    if (repository.empty() || repository[0] == '/' || (repository.size() > 1 && repository[1] == ':')) {
+        folder.Repository = repository;
+    } else {
+        if (!parseRoot(folder.Root, path, command))
+            path = folder.Root;
+        folder.Repository = path + "/" + repository;
+    }
+
+    readWholeFile((base + "Entries").c_str(), text);
+    size_t start = 0;
+    while (start < text.size()) {
+        size_t end = text.find('\n', start);
+        if (end == std::string::npos)
+            end = text.size();
+        std::string line = text.substr(start, end - start);
+        if (!line.empty() && line[line.size() - 1] == '\r')
+            line.erase(line.size() - 1);
+        if (!line.empty())
+            folder.Entries.push_back(line);
+        start = end + 1;
+    }
+
+    // Entries.Log holds "A line" and "R line" changes not yet merged.
+    if (readWholeFile((base + "Entries.Log").c_str(), text)) {
+        start = 0;
+        while (start < text.size()) {
+            size_t end = text.find('\n', start);
+            if (end == std::string::npos)
+                end = text.size();
+            std::string line = text.substr(start, end - start);
+            if (!line.empty() && line[line.size() - 1] == '\r')
+                line.erase(line.size() - 1);
+            if (line.size() > 2 && line[0] == 'A' && line[1] == ' ' && line[2] == '/')
+                setEntry(&folder, line.substr(2));
+            else if (line.size() > 2 && line[0] == 'R' && line[1] == ' ' && line[2] == '/')
+                removeEntry(&folder, entryField(line.substr(2), 1).c_str());
+            start = end + 1;
+        }
+        folder.Changed = true;
+    }
+    return true;
+}
+
+/*
+* Write CVS\Entries as cvs does, to Entries.Backup and then over Entries.
+*/
+static void saveFolder(const CVSFOLDER &folder) {
+    std::string base, text;
+    joinPath(folder.Folder, "CVS\\", base);
+    for (size_t i = 0; i < folder.Entries.size(); i++)
+        text += folder.Entries[i] + "\n";
+    if (writeWholeFile((base + "Entries.Backup").c_str(), text, NULL) &&
+        MoveFileEx((base + "Entries.Backup").c_str(), (base + "Entries").c_str(), MOVEFILE_REPLACE_EXISTING))
+        DeleteFile((base + "Entries.Log").c_str());
+}
+
+static void closeSession(CVSSESSION *session) {
+    if (session->ToServer != NULL)
+        CloseHandle(session->ToServer);
+    if (session->Writer != NULL) {
+        WaitForSingleObject(session->Writer, INFINITE);
+        CloseHandle(session->Writer);
+    }
+    if (WaitForSingleObject(session->Process, CVS_EXIT_WAIT_MS) != WAIT_OBJECT_0)
+        TerminateProcess(session->Process, 1);
+    CloseHandle(session->FromServer);
+    CloseHandle(session->Process);
+    delete session;
+}
+
+static void dropSession(CVSSESSION *session) {
+    gSessions.erase(session->Root);
+    closeSession(session);
+}
+
+static DWORD WINAPI writerThread(LPVOID arg) {
+    CVSSESSION *session = (CVSSESSION *) arg;
+    const char *data = session->Out.data();
+    size_t left = session->Out.size();
+    while (left > 0) {
+        DWORD written = 0;
+        if (!WriteFile(session->ToServer, data, (DWORD)(left < CVS_BUFFER_SIZE ? left : CVS_BUFFER_SIZE), &written, NULL))
+            break;
+        data += written;
+        left -= written;
+    }
+    return 0;
+}
+
+// Start writing the queued requests while responses are read.
+static bool startWriting(CVSSESSION *session) {
+    session->Writer = CreateThread(NULL, 0, writerThread, session, 0, NULL);
+    if (session->Writer == NULL)
+        writerThread(session);
+    return true;
+}
+
+static void finishWriting(CVSSESSION *session) {
+    if (session->Writer != NULL) {
+        WaitForSingleObject(session->Writer, INFINITE);
+        CloseHandle(session->Writer);
+        session->Writer = NULL;
+    }
+    session->Out.clear();
+}
+
+/*
+* Read what the server has sent into the empty buffer. ReadFile cannot
+* time out on an anonymous pipe, so the pipe is polled until there is
+* something to read. A server that does not answer in time is stopped,
+* which also ends the writer thread's wait on it.
+*/
+static bool fillBuffer(CVSSESSION *session) {
+    ULONGLONG deadline = GetTickCount64() + CVS_READ_TIMEOUT_MS;
+    DWORD wait = 0;
+    for (;;) {
+        DWORD available = 0;
+        if (!PeekNamedPipe(session->FromServer, NULL, 0, NULL, &available, NULL))
+            return false;
+        if (available > 0)
+            break;
+        if (GetTickCount64() >= deadline) {
+            session->TimedOut = true;
+            TerminateProcess(session->Process, 1);
+            return false;
+        }
+        Sleep(wait);
+        if (wait < CVS_POLL_MAX_MS)
+            wait++;
+    }
+    DWORD got = 0;
+    if (!ReadFile(session->FromServer, session->Buffer, CVS_BUFFER_SIZE, &got, NULL) || got == 0)
+        return false;
+    session->Start  = 0;
+    session->End    = got;
+    return true;
+}
+
+static bool readLine(CVSSESSION *session, std::string &line) {
+    line.clear();
+    for (;;) {
+        char *start = session->Buffer + session->Start;
+        char *newline = (char *)memchr(start, '\n', session->End - session->Start);
+        if (newline != NULL) {
+            line.append(start, newline - start);
+            session->Start = (DWORD)(newline + 1 - session->Buffer);
+            return true;
+        }
+        line.append(start, session->End - session->Start);
+        session->Start = session->End = 0;
+        if (!fillBuffer(session))
+            return false;
+    }
+}
+
+static bool readBytes(CVSSESSION *session, size_t size, std::string &data) {
+    data.clear();
+    while (data.size() < size) {
+        if (session->Start == session->End) {
+            session->Start = session->End = 0;
+            if (!fillBuffer(session))
+                return false;
+        }
+        size_t take = session->End - session->Start;
+        if (take > size - data.size())
+            take = size - data.size();
+        data.append(session->Buffer + session->Start, take);
+        session->Start += (DWORD)take;
+    }
+    return true;
+}
+
+static bool hasRequest(const CVSSESSION *session, const char *request) {
+    return session->ValidRequests.find(std::string(" ") + request + " ") != std::string::npos;
+}
+
+/*
+* Start a server for root and agree on the requests and responses used.
+*/
+static CVSSESSION *startSession(const std::string &root, std::string &error) {
+    std::string path, command;
+    if (!parseRoot(root, path, command)) {
+        error += "cvs: " + root + " is not a local or :ext: repository\n";
+        return NULL;
+    }
+
+    SECURITY_ATTRIBUTES sa;
+    sa.nLength              = sizeof(sa);
+    sa.lpSecurityDescriptor = NULL;
+    sa.bInheritHandle       = TRUE;
+    HANDLE childIn, toServer, fromServer, childOut;
+    if (!CreatePipe(&childIn, &toServer, &sa, 0)) {
+        error += "cvs: unable to create a pipe\n";
+        return NULL;
+    }
+    if (!CreatePipe(&fromServer, &childOut, &sa, 0)) {
+        CloseHandle(childIn);
+        CloseHandle(toServer);
+        error += "cvs: unable to create a pipe\n";
+        return NULL;
+    }
+    SetHandleInformation(toServer, HANDLE_FLAG_INHERIT, 0);
+    SetHandleInformation(fromServer, HANDLE_FLAG_INHERIT, 0);
+
+    STARTUPINFO si;
+    PROCESS_INFORMATION pi;
+    memset(&si, 0, sizeof(si));
+    si.cb           = sizeof(si);
+    si.dwFlags      = STARTF_USESTDHANDLES;
+    si.hStdInput    = childIn;
+    si.hStdOutput   = childOut;
+    si.hStdError    = GetStdHandle(STD_ERROR_HANDLE);
+    std::vector<char> commandLine(command.begin(), command.end());
+    commandLine.push_back('\0');
+    BOOL started = CreateProcess(NULL, &commandLine[0], NULL, NULL, TRUE, CREATE_NO_WINDOW, NULL, NULL, &si, &pi);
+    CloseHandle(childIn);
+    CloseHandle(childOut);
+    if (!started) {
+        CloseHandle(toServer);
+        CloseHandle(fromServer);
+        error += "cvs: unable to run \"" + command + "\"\n";
+        return NULL;
+    }
+    CloseHandle(pi.hThread);
+
+    CVSSESSION *session = new CVSSESSION;
+    session->Root       = root;
+    session->Process    = pi.hProcess;
+    session->ToServer   = toServer;
+    session->FromServer = fromServer;
+    session->Writer     = NULL;
+    session->Start      = 0;
+    session->End        = 0;
+    session->TimedOut   = false;
+    session->Out        = "Root " + path + "\n" + gValidResponses + "valid-requests\n";
+    startWriting(session);
+    std::string line;
+    bool ok = false;
+    while (readLine(session, line)) {
+        if (line.compare(0, 15, "Valid-requests ") == 0) {
+            session->ValidRequests = " " + line.substr(15) + " ";
+        } else if (line.compare(0, 2, "E ") == 0 || line.compare(0, 5, "error") == 0) {
+            error += "cvs: " + line.substr(line[0] == 'E' ? 2 : 5) + "\n";
+        }
+        if (line == "ok" || line.compare(0, 5, "error") == 0) {
+            ok = line == "ok";
+            break;
+        }
+    }
+    finishWriting(session);
+    if (!ok) {
+        if (error.empty() || session->TimedOut)
+            error += "cvs: no response from \"" + command + "\"\n";
+        closeSession(session);
+        return NULL;
+    }
+    if (hasRequest(session, "UseUnchanged"))
+        session->Out = "UseUnchanged\n";
+    return session;
+}
+
+static CVSSESSION *sessionFor(const std::string &root, std::string &error) {
+    std::map<std::string, CVSSESSION *>::iterator it = gSessions.find(root);
+    if (it != gSessions.end()) {
+        DWORD exitCode;
+        if (GetExitCodeProcess(it->second->Process, &exitCode) && exitCode == STILL_ACTIVE)
+            return it->second;
+        dropSession(it->second);
+    }
+    CVSSESSION *session = startSession(root, error);
+    if (session != NULL)
+        gSessions[root] = session;
+    return session;
+}
+
+static void queueArgument(CVSSESSION *session, const std::string &argument) {
+    size_t start = 0;
+    const char *request = "Argument ";
+    do {
+        size_t end = argument.find('\n', start);
+        if (end == std::string::npos)
+            end = argument.size();
+        session->Out += request + argument.substr(start, end - start) + "\n";
+        request = "Argumentx ";
+        start = end + 1;
+    } while (start <= argument.size());
+}
+
+static void queueBlock(CVSSESSION *session, const CVSBLOCK *block) {
+    CVSFOLDER *folder = block->Folder;
+    for (size_t i = 0; i < block->Arguments.size(); i++)
+        queueArgument(session, block->Arguments[i]);
+    session->Out += "Directory .\n" + folder->Repository + "\n";
+
+    std::string fileName, data, host, timestamp;
+    for (size_t i = 0; block->Send != SEND_NOTHING && i < block->Names.size(); i++) {
+        const char *name = block->Names[i].c_str();
+        int e = findEntry(folder, name);
+        std::string entry = e >= 0 ? folder->Entries[e] : "";
+        if (e >= 0) {
+            std::string conflict = entryField(entry, 3).compare(0, 1, "+") == 0 ? "+=" : "";
+            session->Out += "Entry " + withField(entry, 3, conflict) + "\n";
+        }
+        joinPath(folder->Folder, name, fileName);
+        DWORD attr = GetFileAttributes(fileName.c_str());
+        if (attr == INVALID_FILE_ATTRIBUTES)
+            continue;       // lost, or never there
+        if (e >= 0 && !isLocallyModified(folder, entry)) {
+            session->Out += std::string("Unchanged ") + name + "\n";
+        } else if (block->Send == SEND_ENTRIES && hasRequest(session, "Is-modified")) {
+            session->Out += std::string("Is-modified ") + name + "\n";
+        } else {
+            readWholeFile(fileName.c_str(), data);
+            if (!isBinary(entry)) {
+                std::string lf;
+                lf.reserve(data.size());
+                for (size_t j = 0; j < data.size(); j++) {
+                    if (data[j] != '\r' || j + 1 >= data.size() || data[j + 1] != '\n')
+                        lf += data[j];
+                }
+                data.swap(lf);
+            }
+            char size[32];
+            _snprintf(size, sizeof(size), "%lu", (unsigned long)data.size());
+            size[sizeof(size) - 1] = '\0';
+            session->Out += std::string("Modified ") + name + "\n" +
+                ((attr & FILE_ATTRIBUTE_READONLY) != 0 ? "u=r,g=r,o=r\n" : "u=rw,g=r,o=r\n") + size + "\n" + data;
+        }
+    }
+
+    if (block->Notify != 0) {
+        char computer[MAX_COMPUTERNAME_LENGTH + 1];
+        DWORD length = sizeof(computer);
+        if (!GetComputerName(computer, &length))
+            strcpy(computer, "localhost");
+        SYSTEMTIME now;
+        GetSystemTime(&now);
+        formatTime(now, timestamp);
+        for (size_t i = 0; i < block->Names.size(); i++) {
+            session->Out += "Notify " + block->Names[i] + "\n" + block->Notify + "\t" + timestamp + " GMT\t" +
+                computer + "\t" + pathName(folder->Folder) + "\t" + (block->Notify == 'E' ? "EUC" : "") + "\n";
+        }
+    } else if (!block->Names.empty()) {
+        session->Out += "Argument --\n";
+        for (size_t i = 0; i < block->Names.size(); i++)
+            session->Out += "Argument " + block->Names[i] + "\n";
+    }
+    session->Out += std::string(block->Command) + "\n";
+}
+
+/*
+* Apply the responses to a block. Returns false if the connection was lost
+* or the server sent something this does not understand.
+*/
+static bool readBlock(CVSSESSION *session, CVSBLOCK *block) {
+    CVSFOLDER *folder = block->Folder;
+    std::string line, pathLine, repository, entry, mode, size, data, fileName;
+    FILETIME modTime;
+    bool hasModTime = false;
+    for (;;) {
+        if (!readLine(session, line))
+            return false;
+        size_t space = line.find(' ');
+        std::string response = line.substr(0, space);
+        std::string rest = space == std::string::npos ? "" : line.substr(space + 1);
+
+        if (response == "ok") {
+            block->Ok = true;
+            return true;
+        } else if (response == "error") {
+            // "error <errno> <text>", either of which may be empty.
+            size_t text = rest.find(' ');
+            if (text != std::string::npos && text + 1 < rest.size())
+                block->Errors += rest.substr(text + 1) + "\n";
+            block->Ok = false;
+            return true;
+        } else if (response == "M") {
+            block->Output += rest + "\n";
+        } else if (response == "MT") {
+            if (rest == "newline")
+                block->Output += "\n";
+            else if (!rest.empty() && rest[0] != '+' && rest[0] != '-' && rest.find(' ') != std::string::npos)
+                block->Output += rest.substr(rest.find(' ') + 1);
+        } else if (response == "Mbinary") {
+            if (!readLine(session, size) || !readBytes(session, strtoul(size.c_str(), NULL, 10), data))
+                return false;
+            block->Output += data;
+        } else if (response == "E") {
+            block->Errors += rest + "\n";
+        } else if (response == "F" || response == "Checksum" || response == "Mode" ||
+                   response == "Module-expansion") {
+            // Nothing to do.
+        } else if (response == "Valid-requests") {
+            session->ValidRequests = " " + rest + " ";
+        } else if (response == "Mod-time") {
+            hasModTime = parseModTime(rest.c_str(), &modTime);
+        } else {
+            // The rest name a file: the local folder, then its path in
+            // the repository, whose last part is the file's name.
+            if (!readLine(session, repository))
+                return false;
+            const char *name = baseName(repository.c_str());
+            joinPath(folder->Folder, name, fileName);
+            if (response == "Checked-in" || response == "New-entry") {
+                if (!readLine(session, entry))
+                    return false;
+                std::string timestamp = "dummy timestamp";
+                if (response == "Checked-in")
+                    fileTimestamp(fileName.c_str(), timestamp);
+                setEntry(folder, withField(entry, 3, timestamp));
+            } else if (response == "Updated" || response == "Created" || response == "Update-existing" ||
+                       response == "Merged") {
+                if (!readLine(session, entry) || !readLine(session, mode) || !readLine(session, size) ||
+                    !readBytes(session, strtoul(size.c_str(), NULL, 10), data))
+                    return false;
+                if (!isBinary(entry)) {
+                    std::string crlf;
+                    crlf.reserve(data.size() + data.size() / 32);
+                    for (size_t i = 0; i < data.size(); i++) {
+                        if (data[i] == '\n')
+                            crlf += '\r';
+                        crlf += data[i];
+                    }
+                    data.swap(crlf);
+                }
+                if (!writeWholeFile(fileName.c_str(), data, hasModTime ? &modTime : NULL)) {
+                    block->Errors += "cvs: unable to write " + fileName + "\n";
+                } else {
+                    std::string user = mode.substr(0, mode.find(','));
+                    if (user.find('w') == std::string::npos)
+                        SetFileAttributes(fileName.c_str(), GetFileAttributes(fileName.c_str()) | FILE_ATTRIBUTE_READONLY);
+                    std::string timestamp = "Result of merge";
+                    if (response != "Merged")
+                        fileTimestamp(fileName.c_str(), timestamp);
+                    setEntry(folder, withField(entry, 3, timestamp));
+                }
+                hasModTime = false;
+            } else if (response == "Removed" || response == "Remove-entry") {
+                if (response == "Removed") {
+                    SetFileAttributes(fileName.c_str(), FILE_ATTRIBUTE_NORMAL);
+                    DeleteFile(fileName.c_str());
+                }
+                removeEntry(folder, name);
+            } else if (response == "Copy-file") {
+                std::string newName, copyName;
+                if (!readLine(session, newName))
+                    return false;
+                joinPath(folder->Folder, baseName(newName.c_str()), copyName);
+                CopyFile(fileName.c_str(), copyName.c_str(), FALSE);
+            } else if (response == "Set-sticky" || response == "Template") {
+                if (!readLine(session, data))
+                    return false;
+                if (response == "Template" && !readBytes(session, strtoul(data.c_str(), NULL, 10), data))
+                    return false;
+            } else if (response != "Clear-sticky" && response != "Set-static-directory" &&
+                       response != "Clear-static-directory" && response != "Notified") {
+                return false;
+            }
+        }
+    }
+}
+
+/*
+* Send every block, grouped by repository, and read the responses. The
+* folders' Entries are saved afterwards.
+*/
+static bool runBlocks(std::vector<CVSBLOCK> &blocks, std::string &error) {
+    bool ok = true;
+    std::vector<bool> done(blocks.size(), false);
+    for (size_t first = 0; first < blocks.size(); first++) {
+        if (done[first])
+            continue;
+        const std::string &root = blocks[first].Folder->Root;
+        std::vector<size_t> group;
+        for (size_t b = first; b < blocks.size(); b++) {
+            if (!done[b] && blocks[b].Folder->Root == root) {
+                group.push_back(b);
+                done[b] = true;
+            }
+        }
+        CVSSESSION *session = sessionFor(root, error);
+        if (session == NULL) {
+            ok = false;
+            continue;
+        }
+        for (size_t i = 0; i < group.size(); i++)
+            queueBlock(session, &blocks[group[i]]);
+        startWriting(session);
+        bool connected = true;
+        for (size_t i = 0; i < group.size() && connected; i++) {
+            CVSBLOCK *block = &blocks[group[i]];
+            connected = readBlock(session, block);
+            if (!block->Ok || !connected) {
+                ok = false;
+                error += block->Errors;
+            }
+        }
+        // A server that sent something we could not read may still be
+        // waiting on its input, and with it the writer thread.
+        if (!connected)
+            TerminateProcess(session->Process, 1);
+        finishWriting(session);
+        if (!connected) {
+            error += session->TimedOut ? "cvs: no response from " + root + "\n" :
+                "cvs: lost the connection to " + root + "\n";
+            dropSession(session);
+        }
+    }
+    for (size_t b = 0; b < blocks.size(); b++) {
+        if (blocks[b].Folder->Changed) {
+            saveFolder(*blocks[b].Folder);
+            blocks[b].Folder->Changed = false;
+        }
+    }
+    return ok;
+}
+
+/*
+* Load the CVS folders of files. folderOf[i] is the index in folders of
+* file i's folder, or -1 if it has no CVS folder.
+*/
+static void loadFolders(int numberOfFiles, const PATHID *files, std::vector<CVSFOLDER> &folders,
+                        std::vector<int> &folderOf) {
+    std::map<PATHID, int> known;
+    folderOf.assign(numberOfFiles, -1);
+    for (int i = 0; i < numberOfFiles; i++) {
+        PATHID parent = parentPathId(files[i]);
+        std::map<PATHID, int>::const_iterator it = known.find(parent);
+        if (it == known.end()) {
+            CVSFOLDER folder;
+            int index = -1;
+            if (loadFolder(parent, folder)) {
+                index = (int)folders.size();
+                folders.push_back(folder);
+            }
+            it = known.insert(std::make_pair(parent, index)).first;
+        }
+        folderOf[i] = it->second;
+    }
+}
+
+/*
+* One block per folder for the files of a command. Files not in
+* CVS\Entries are left out unless all is set.
+*/
+static void makeBlocks(int numberOfFiles, const PATHID *files, std::vector<CVSFOLDER> &folders,
+                       const std::vector<int> &folderOf, bool all, const char *command, int send,
+                       std::vector<CVSBLOCK> &blocks) {
+    std::vector<int> blockOf(folders.size(), -1);
+    for (int i = 0; i < numberOfFiles; i++) {
+        int f = folderOf[i];
+        const char *name = baseName(pathName(files[i]));
+        if (f < 0 || (!all && findEntry(&folders[f], name) < 0))
+            continue;
+        if (blockOf[f] < 0) {
+            blockOf[f] = (int)blocks.size();
+            blocks.push_back(CVSBLOCK());
+            CVSBLOCK &block = blocks.back();
+            block.Folder    = &folders[f];
+            block.Command   = command;
+            block.Send      = send;
+            block.Notify    = 0;
+            block.Ok        = false;
+        }
+        blocks[blockOf[f]].Names.push_back(name);
+    }
+}
+
+static LONG statusFromText(const std::string &text) {
+    if (text == "Up-to-date")
+        return SCC_STATUS_CONTROLLED;
+    if (text == "Locally Modified")
+        return SCC_STATUS_CONTROLLED | SCC_STATUS_MODIFIED;
+    if (text == "Locally Added")
+        return SCC_STATUS_CONTROLLED | SCC_STATUS_CHECKEDOUT | SCC_STATUS_OUTBYUSER;
+    if (text == "Locally Removed")
+        return SCC_STATUS_CONTROLLED | SCC_STATUS_DELETED;
+    if (text == "Needs Checkout" || text == "Needs Patch")
+        return SCC_STATUS_CONTROLLED | SCC_STATUS_OUTOFDATE;
+    if (text == "Needs Merge")
+        return SCC_STATUS_CONTROLLED | SCC_STATUS_MODIFIED | SCC_STATUS_OUTOFDATE;
+    if (text == "Unresolved Conflict" || text == "File had conflicts on merge")
+        return SCC_STATUS_CONTROLLED | SCC_STATUS_MODIFIED | SCC_STATUS_MERGED;
+    if (text == "Unknown")
+        return SCC_STATUS_NOTCONTROLLED;
+    return SCC_STATUS_INVALID;
+}
+
+bool cvsStatus(int numberOfFiles, const PATHID *files, LONG *status, std::string &error) {
+    std::vector<CVSFOLDER> folders;
+    std::vector<int> folderOf;
+    std::vector<CVSBLOCK> blocks;
+    loadFolders(numberOfFiles, files, folders, folderOf);
+    makeBlocks(numberOfFiles, files, folders, folderOf, false, "status", SEND_ENTRIES, blocks);
+    bool ok = runBlocks(blocks, error);
+
+    // Lines such as "File: foo.m  <tab>Status: Up-to-date", or
+    // "File: no file foo.m  <tab>Status: Needs Checkout" if it was deleted.
+    std::map<std::pair<CVSFOLDER *, std::string>, LONG> reported;
+    for (size_t b = 0; b < blocks.size(); b++) {
+        const std::string &output = blocks[b].Output;
+        size_t start = 0;
+        while ((start = output.find("File: ", start)) != std::string::npos) {
+            size_t end = output.find('\n', start);
+            std::string line = output.substr(start + 6, end == std::string::npos ? std::string::npos : end - start - 6);
+            start = end == std::string::npos ? output.size() : end;
+            size_t label = line.find("Status: ");
+            if (label == std::string::npos)
+                continue;
+            std::string name = line.substr(0, label);
+            while (!name.empty() && (name[name.size() - 1] == ' ' || name[name.size() - 1] == '\t'))
+                name.erase(name.size() - 1);
+            LONG fileStatus = statusFromText(line.substr(label + 8));
+            if (name.compare(0, 8, "no file ") == 0) {
+                name = name.substr(8);
+                if (fileStatus != SCC_STATUS_INVALID && fileStatus != SCC_STATUS_NOTCONTROLLED)
+                    fileStatus |= SCC_STATUS_DELETED;
+            }
+            for (size_t i = 0; i < name.size(); i++)
+                name[i] = (char)tolower((unsigned char)name[i]);
+            reported[std::make_pair(blocks[b].Folder, name)] = fileStatus;
+        }
+    }
+    for (int i = 0; i < numberOfFiles; i++) {
+        int f = folderOf[i];
+        std::string name = baseName(pathName(files[i]));
+        if (f < 0 || findEntry(&folders[f], name.c_str()) < 0) {
+            status[i] = SCC_STATUS_NOTCONTROLLED;
+            continue;
+        }
+        for (size_t j = 0; j < name.size(); j++)
+            name[j] = (char)tolower((unsigned char)name[j]);
+        std::map<std::pair<CVSFOLDER *, std::string>, LONG>::const_iterator it =
+            reported.find(std::make_pair(&folders[f], name));
+        status[i] = it != reported.end() ? it->second : SCC_STATUS_INVALID;
+    }
+    return ok;
+}
+
+bool cvsLog(int numberOfFiles, const PATHID *files, std::string &log, std::string &error) {
+    std::vector<CVSFOLDER> folders;
+    std::vector<int> folderOf;
+    std::vector<CVSBLOCK> blocks;
+    loadFolders(numberOfFiles, files, folders, folderOf);
+    makeBlocks(numberOfFiles, files, folders, folderOf, false, "log", SEND_ENTRIES, blocks);
+    bool ok = runBlocks(blocks, error);
+    log.clear();
+    for (size_t b = 0; b < blocks.size(); b++)
+        log += blocks[b].Output;
+    return ok;
+}
+
+bool cvsCheckin(int numberOfFiles, const PATHID *files, const char *comment, std::string &error) {
+    std::vector<CVSFOLDER> folders;
+    std::vector<int> folderOf;
+    std::vector<CVSBLOCK> blocks;
+    loadFolders(numberOfFiles, files, folders, folderOf);
+    for (int i = 0; i < numberOfFiles; i++) {
+        if (folderOf[i] < 0) {
+            error += std::string("cvs: ") + pathName(parentPathId(files[i])) + " is not a CVS working folder\n";
+            return false;
+        }
+    }
+
+    // Files new to CVS are added first, in one round for every folder.
+    makeBlocks(numberOfFiles, files, folders, folderOf, true, "add", SEND_ENTRIES, blocks);
+    for (size_t b = 0; b < blocks.size(); b++) {
+        std::vector<std::string> &names = blocks[b].Names;
+        for (size_t i = names.size(); i-- > 0;) {
+            if (findEntry(blocks[b].Folder, names[i].c_str()) >= 0)
+                names.erase(names.begin() + i);
+        }
+        if (names.empty())
+            blocks.erase(blocks.begin() + b--);
+    }
+    if (!blocks.empty() && !runBlocks(blocks, error))
+        return false;
+
+    blocks.clear();
+    makeBlocks(numberOfFiles, files, folders, folderOf, false, "ci", SEND_CONTENTS, blocks);
+    for (size_t b = 0; b < blocks.size(); b++) {
+        blocks[b].Arguments.push_back("-m");
+        blocks[b].Arguments.push_back(comment != NULL ? comment : "");
+    }
+    return runBlocks(blocks, error);
+}
+
+bool cvsUpdate(int numberOfFiles, const PATHID *files, const char *revision, std::string &error) {
+    std::vector<CVSFOLDER> folders;
+    std::vector<int> folderOf;
+    std::vector<CVSBLOCK> blocks;
+    loadFolders(numberOfFiles, files, folders, folderOf);
+    makeBlocks(numberOfFiles, files, folders, folderOf, true, "update", SEND_CONTENTS, blocks);
+    for (size_t b = 0; b < blocks.size(); b++) {
+        if (revision != NULL && revision[0] != '\0') {
+            blocks[b].Arguments.push_back("-r");
+            blocks[b].Arguments.push_back(revision);
+        }
+    }
+    return runBlocks(blocks, error);
+}
+
+bool cvsEdit(int numberOfFiles, const PATHID *files, bool edit, std::string &error) {
+    std::vector<CVSFOLDER> folders;
+    std::vector<int> folderOf;
+    std::vector<CVSBLOCK> blocks;
+    loadFolders(numberOfFiles, files, folders, folderOf);
+    makeBlocks(numberOfFiles, files, folders, folderOf, false, "noop", SEND_NOTHING, blocks);
+
+    // As cvs does, edit keeps a copy in CVS\Base for unedit to restore.
+    std::string fileName, baseFolder, baseFile;
+    for (size_t b = 0; b < blocks.size(); b++) {
+        blocks[b].Notify = edit ? 'E' : 'U';
+        joinPath(blocks[b].Folder->Folder, "CVS\\Base", baseFolder);
+        if (edit)
+            CreateDirectory(baseFolder.c_str(), NULL);
+        for (size_t i = 0; i < blocks[b].Names.size(); i++) {
+            const char *name = blocks[b].Names[i].c_str();
+            joinPath(blocks[b].Folder->Folder, name, fileName);
+            baseFile = baseFolder + "\\" + name;
+            DWORD attr = GetFileAttributes(fileName.c_str());
+            if (edit) {
+                CopyFile(fileName.c_str(), baseFile.c_str(), FALSE);
+                if (attr != INVALID_FILE_ATTRIBUTES)
+                    SetFileAttributes(fileName.c_str(), attr & ~FILE_ATTRIBUTE_READONLY);
+            } else {
+                if (attr != INVALID_FILE_ATTRIBUTES)
+                    SetFileAttributes(fileName.c_str(), attr & ~FILE_ATTRIBUTE_READONLY);
+                MoveFileEx(baseFile.c_str(), fileName.c_str(), MOVEFILE_REPLACE_EXISTING);
+                attr = GetFileAttributes(fileName.c_str());
+                if (attr != INVALID_FILE_ATTRIBUTES)
+                    SetFileAttributes(fileName.c_str(), attr | FILE_ATTRIBUTE_READONLY);
+            }
+        }
+    }
+    return runBlocks(blocks, error);
+}
+
+void closeCvsSessions() {
+    for (std::map<std::string, CVSSESSION *>::iterator it = gSessions.begin(); it != gSessions.end(); ++it)
+        closeSession(it->second);
+    gSessions.clear();
+}
@@ -0,0 +1,59 @@
+/*
+*
+*
+* The source code contained in this listing contains proprietary and
+* confidential trade secrets of The MathWorks, Inc.  The use, modification,
+* or development of derivative work based on the code or ideas obtained
+* from the code is prohibited without the express written permission of The
+* MathWorks, Inc. The disclosure of this code to any party not authorized
+* by The MathWorks, Inc. is strictly forbidden.
+* CONFIDENTIAL AND CONTAINING PROPRIETARY TRADE SECRETS
+*/
+
+#ifndef VERCTRLCVS_H
+#define VERCTRLCVS_H
+
+#include <windows.h>
+#include <string>
+
+#include "verctrlPath.h"
+
+/*
+* A CVS client speaking the client/server protocol. Each repository gets
+* one server, started the first time it is used and kept until the MEX
+* file is cleared, so commands do not pay for starting cvs and connecting
+* to the repository every time. The requests for every folder of a
+* command are sent before any response is read, and responses are parsed
+* as they arrive. CVS\Entries is kept up to date as cvs itself would.
+*
+* The repository is read from the CVS\Root file of each file's folder:
+*   path or :local:path         cvs server
+*   :ext:[user@]host:path       %CVS_RSH% [user@]host cvs server, with
+*                               ssh if CVS_RSH is not set
+* Other methods, such as :pserver:, are not supported.
+*
+* Functions return false, with the server's messages in error, if a
+* repository cannot be reached or reports an error. None of them use the
+* MEX API, and all are called on the MATLAB thread.
+*/
+
+// Statuses as SccStatus bits. Files in folders without a CVS folder are
+// SCC_STATUS_NOTCONTROLLED.
+bool cvsStatus(int numberOfFiles, const PATHID *files, LONG *status, std::string &error);
+
+// The output of cvs log.
+bool cvsLog(int numberOfFiles, const PATHID *files, std::string &log, std::string &error);
+
+// Commit files, adding those not yet in CVS\Entries first.
+bool cvsCheckin(int numberOfFiles, const PATHID *files, const char *comment, std::string &error);
+
+// Bring files up to date, or to revision if it is not NULL.
+bool cvsUpdate(int numberOfFiles, const PATHID *files, const char *revision, std::string &error);
+
+// cvs edit, or cvs unedit if edit is false, which restores the file as it
+// was when edited.
+bool cvsEdit(int numberOfFiles, const PATHID *files, bool edit, std::string &error);
+
+void closeCvsSessions();
+
+#endif
@@ -0,0 +1,520 @@
+/*
+*
+*
+* The source code contained in this listing contains proprietary and
+* confidential trade secrets of The MathWorks, Inc.  The use, modification,
+* or development of derivative work based on the code or ideas obtained
+* from the code is prohibited without the express written permission of The
+* MathWorks, Inc. The disclosure of this code to any party not authorized
+* by The MathWorks, Inc. is strictly forbidden.
+* CONFIDENTIAL AND CONTAINING PROPRIETARY TRADE SECRETS
+*/
+
+/*
+* The index file, versions 2 to 4, all numbers big endian:
+*
+*   "DIRC", u32 version, u32 number of entries
+*   entries, sorted by path:
+*       u32 ctime, ctime ns, mtime, mtime ns, dev, ino, mode, uid, gid, size
+*       u8[20] SHA-1 of the staged blob
+*       u16 flags: assume valid 0x8000, extended 0x4000, stage 0x3000,
+*           length of the path 0x0fff
+*       u16 extended flags, if extended: skip worktree 0x4000,
+*           intent to add 0x2000
+*       path; versions 2 and 3: NUL terminated and padded with NULs to a
+*           multiple of 8 bytes from the start of the entry; version 4: the
+*           number of bytes to drop from the end of the previous path, as a
+*           varint, then the rest of the path, NUL terminated
+*   extensions: u8[4] signature, u32 length, data
+*   u8[20] SHA-1 of everything before it
+*/
+
+#include <windows.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+
+#include "scc.h"
+#include "verctrlPath.h"
+#include "verctrlHash.h"
+#include "verctrlGit.h"
+
+// Upper bound on the threads looking at working files at once.
+#define GIT_THREADS             16
+
+// How long a folder's working tree, or its not being in one, is trusted
+// before its .git is looked for again.
+#define GIT_FOLDER_RECHECK_MS   5000
+
+#define GIT_FLAG_ASSUME_VALID   0x8000
+#define GIT_FLAG_EXTENDED       0x4000
+#define GIT_FLAG_STAGE          0x3000
+#define GIT_FLAG_NAME_LENGTH    0x0fff
+#define GIT_EXT_SKIP_WORKTREE   0x4000
+#define GIT_EXT_INTENT_TO_ADD   0x2000
+
+#define GIT_MODE_TYPE           0170000
+#define GIT_MODE_GITLINK        0160000
+#define GIT_MODE_SYMLINK        0120000
+
+// Seconds from 1601, the FILETIME epoch, to 1970.
+#define GIT_EPOCH_SECONDS       11644473600ULL
+
+typedef struct GITENTRY {
+    std::string     Key;            // lower case, '\\' separated, for lookup
+    unsigned int    MtimeSec;
+    unsigned int    MtimeNsec;
+    unsigned int    Mode;
+    unsigned int    Size;
+    unsigned char   Hash[SHA1_LEN];
+    unsigned short  Flags;
+    unsigned short  ExtFlags;
+} GITENTRY;
+
+/*
+* One reading of an index. Never changed once read, so status threads
+* look at it without gGitLock while holding a reference.
+*/
+typedef struct GITINDEX {
+    PATHID                  WorkTree;
+    FILETIME                IndexTime;
+    bool                    Valid;
+    std::vector<GITENTRY>   Entries;    // sorted by Key
+    volatile LONG           Refs;       // the repository and status queries
+} GITINDEX;
+
+typedef struct GITREPO {
+    PATHID                  WorkTree;
+    std::string             IndexName;
+    ULONGLONG               IndexSize;
+    FILETIME                IndexTime;
+    GITINDEX               *Index;      // NULL until read
+} GITREPO;
+
+typedef struct GITFOLDER {
+    PATHID                  WorkTree;   // NO_PATH if not in one
+    ULONGLONG               Checked;    // GetTickCount64
+} GITFOLDER;
+
+static SRWLOCK                          gGitLock    = SRWLOCK_INIT;
+static std::map<PATHID, GITREPO *>      gRepos;     // by working tree
+static std::map<PATHID, GITFOLDER>      gFolders;   // folder to its working tree
+
+static std::string lookupKey(const char *name, size_t len) {
+    std::string key(name, len);
+    for (size_t i = 0; i < key.size(); i++)
+        key[i] = key[i] == '/' ? '\\' : (char)tolower((unsigned char)key[i]);
+    return key;
+}
+
+static bool byKey(const GITENTRY &a, const GITENTRY &b) {
+    return a.Key < b.Key;
+}
+
+/*
+* Parse an index file. Returns false if it is not one this can read,
+* such as a split or sparse index.
+*/
+static bool parseIndex(const unsigned char *data, size_t size, std::vector<GITENTRY> &entries) {
+    if (size < 12 + SHA1_LEN || memcmp(data, "DIRC", 4) != 0)
+        return false;
+    unsigned int version = getBigU32(data + 4);
+    unsigned int count   = getBigU32(data + 8);
+    if (version < 2 || version > 4)
+        return false;
+    const unsigned char *p   = data + 12;
+    const unsigned char *end = data + size - SHA1_LEN;
+    std::string name;
+    entries.resize(count);
+    for (unsigned int i = 0; i < count; i++) {
+        if (end - p < 62)
+            return false;
+        GITENTRY &entry = entries[i];
+        entry.MtimeSec  = getBigU32(p + 8);
+        entry.MtimeNsec = getBigU32(p + 12);
+        entry.Mode      = getBigU32(p + 24);
+        entry.Size      = getBigU32(p + 36);
+        memcpy(entry.Hash, p + 40, SHA1_LEN);
+        entry.Flags     = getBigU16(p + 60);
+        entry.ExtFlags  = 0;
+        const unsigned char *q = p + 62;
+        if ((entry.Flags & GIT_FLAG_EXTENDED) != 0) {
+            if (version < 3 || end - q < 2)
+                return false;
+            entry.ExtFlags = getBigU16(q);
+            q += 2;
+        }
+        if (version == 4) {
+            if (q >= end)
+                return false;
+            unsigned char c = *q++;
+            size_t strip = c & 0x7f;
+            while ((c & 0x80) != 0) {
+                if (q >= end)
+                    return false;
+                c     = *q++;
+                strip = ((strip + 1) << 7) + (c & 0x7f);
+            }
+            const unsigned char *nul = (const unsigned char *)memchr(q, '\0', end - q);
+            if (nul == NULL || strip > name.size())
+                return false;
+            name.erase(name.size() - strip);
+            name.append((const char *)q, nul - q);
+            p = nul + 1;
+        } else {
+            const unsigned char *nul = (const unsigned char *)memchr(q, '\0', end - q);
+            if (nul == NULL)
+                return false;
+            name.assign((const char *)q, nul - q);
+            size_t length = ((q - p) + name.size() + 8) & ~(size_t)7;
+            if ((size_t)(end - p) < length)
+                return false;
+            p += length;
+        }
+        entry.Key = lookupKey(name.data(), name.size());
+    }
+
+    // Entries kept in another file, or folders standing for their files.
+    while (end - p >= 8) {
+        if (memcmp(p, "link", 4) == 0 || memcmp(p, "sdir", 4) == 0)
+            return false;
+        unsigned int length = getBigU32(p + 4);
+        if ((size_t)(end - p - 8) < length)
+            break;
+        p += 8 + length;
+    }
+    std::stable_sort(entries.begin(), entries.end(), byKey);
+    return true;
+}
+
+static void releaseIndex(GITINDEX *index) {
+    if (index != NULL && InterlockedDecrement(&index->Refs) == 0)
+        delete index;
+}
+
+static void setIndex(GITREPO *repo, GITINDEX *index, ULONGLONG size, const FILETIME &time) {
+    index->WorkTree = repo->WorkTree;
+    index->IndexTime = time;
+    index->Refs     = 1;
+    releaseIndex(repo->Index);
+    repo->Index     = index;
+    repo->IndexSize = size;
+    repo->IndexTime = time;
+}
+
+/*
+* Read the repository's index again if it changed since it was last read.
+* Queries still looking at the old reading keep it until they finish.
+*/
+static void loadIndex(GITREPO *repo) {
+    WIN32_FILE_ATTRIBUTE_DATA info;
+    if (!GetFileAttributesEx(repo->IndexName.c_str(), GetFileExInfoStandard, &info)) {
+        // No index yet: nothing is tracked.
+        if (repo->Index != NULL && repo->IndexSize == 0 && repo->Index->Valid && repo->Index->Entries.empty())
+            return;
+        FILETIME never;
+        memset(&never, 0, sizeof(never));
+        GITINDEX *index = new GITINDEX;
+        index->Valid    = true;
+        setIndex(repo, index, 0, never);
+        return;
+    }
+    ULONGLONG size = ((ULONGLONG)info.nFileSizeHigh << 32) | info.nFileSizeLow;
+    if (repo->Index != NULL && repo->IndexSize == size && CompareFileTime(&repo->IndexTime, &info.ftLastWriteTime) == 0)
+        return;
+
+    GITINDEX *index = new GITINDEX;
+    index->Valid    = false;
+    HANDLE file = CreateFile(repo->IndexName.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        // Try again on the next query.
+        setIndex(repo, index, (ULONGLONG)-1, info.ftLastWriteTime);
+        return;
+    }
+    HANDLE mapping = size > 0 ? CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL) : NULL;
+    const unsigned char *view = mapping != NULL ?
+        (const unsigned char *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, (SIZE_T)size) : NULL;
+    if (view != NULL) {
+        index->Valid = parseIndex(view, (size_t)size, index->Entries);
+        UnmapViewOfFile(view);
+    }
+    if (mapping != NULL)
+        CloseHandle(mapping);
+    CloseHandle(file);
+    if (!index->Valid)
+        index->Entries.clear();
+    setIndex(repo, index, size, info.ftLastWriteTime);
+}
+
+/*
+* The git directory of a working tree at dir: .git itself, or the folder
+* named by a .git file, as in linked working trees and submodules.
+*/
+static bool gitDirOf(const std::string &dir, std::string &gitDir) {
+    std::string dotGit = dir + "\\.git";
+    DWORD attr = GetFileAttributes(dotGit.c_str());
+    if (attr == INVALID_FILE_ATTRIBUTES)
+        return false;
+    if ((attr & FILE_ATTRIBUTE_DIRECTORY) != 0) {
+        gitDir = dotGit;
+        return true;
+    }
+    HANDLE file = CreateFile(dotGit.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+    char text[_MAX_PATH + 16];
+    DWORD got = 0;
+    BOOL ok = ReadFile(file, text, sizeof(text) - 1, &got, NULL);
+    CloseHandle(file);
+    if (!ok || got < 8 || strncmp(text, "gitdir: ", 8) != 0)
+        return false;
+    text[got] = '\0';
+    std::string target(text + 8);
+    while (!target.empty() && (target[target.size() - 1] == '\n' || target[target.size() - 1] == '\r'))
+        target.erase(target.size() - 1);
+    for (size_t i = 0; i < target.size(); i++) {
+        if (target[i] == '/')
+            target[i] = '\\';
+    }
+    bool absolute = (target.size() > 1 && target[1] == ':') || (target.size() > 1 && target[0] == '\\');
+    gitDir = absolute ? target : dir + "\\" + target;
+    return true;
+}
+
+/*
+* The repository whose working tree holds folder, or NULL. Called with
+* gGitLock held exclusively. What is found is looked for again after
+* GIT_FOLDER_RECHECK_MS, so a folder that becomes a working tree, or
+* stops being one, is noticed.
+*/
+static GITREPO *repoForFolder(PATHID folder, ULONGLONG now) {
+    std::vector<PATHID> visited;
+    PATHID workTree = NO_PATH;
+    std::string gitDir;
+    for (PATHID id = folder; id != NO_PATH; id = parentPathId(id)) {
+        std::map<PATHID, GITFOLDER>::const_iterator known = gFolders.find(id);
+        if (known != gFolders.end() && now - known->second.Checked < GIT_FOLDER_RECHECK_MS) {
+            workTree = known->second.WorkTree;
+            break;
+        }
+        visited.push_back(id);
+        if (gitDirOf(pathName(id), gitDir)) {
+            workTree = id;
+            GITREPO *&repo = gRepos[id];
+            if (repo == NULL || repo->IndexName != gitDir + "\\index") {
+                if (repo != NULL)
+                    releaseIndex(repo->Index);
+                delete repo;
+                repo            = new GITREPO;
+                repo->WorkTree  = id;
+                repo->IndexName = gitDir + "\\index";
+                repo->IndexSize = (ULONGLONG)-1;
+                repo->Index     = NULL;
+                memset(&repo->IndexTime, 0, sizeof(repo->IndexTime));
+            }
+            break;
+        }
+    }
+    GITFOLDER found;
+    found.WorkTree = workTree;
+    found.Checked  = now;
+    for (size_t i = 0; i < visited.size(); i++)
+        gFolders[visited[i]] = found;
+    return workTree != NO_PATH ? gRepos[workTree] : NULL;
+}
+
+static ULONGLONG unixTime(const FILETIME &ft, unsigned int *nsec) {
+    ULONGLONG t = ((ULONGLONG)ft.dwHighDateTime << 32) | ft.dwLowDateTime;
+    *nsec = (unsigned int)(t % 10000000) * 100;
+    return t / 10000000 - GIT_EPOCH_SECONDS;
+}
+
+static void blobHash(const std::string &data, unsigned char hash[SHA1_LEN]) {
+    char header[32];
+    int length = _snprintf(header, sizeof(header), "blob %lu", (unsigned long)data.size());
+    SHA1CTX ctx;
+    sha1Init(&ctx);
+    sha1Update(&ctx, header, length + 1);
+    sha1Update(&ctx, data.data(), data.size());
+    sha1Final(&ctx, hash);
+}
+
+/*
+* Whether the file's contents are what the entry staged, as is or with
+* CRLF line endings made LF as core.autocrlf does.
+*/
+static bool sameContents(const char *fileName, const GITENTRY &entry) {
+    HANDLE file = CreateFile(fileName, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+    std::string data;
+    char buffer[64 * 1024];
+    DWORD got;
+    while (ReadFile(file, buffer, sizeof(buffer), &got, NULL) && got > 0)
+        data.append(buffer, got);
+    CloseHandle(file);
+
+    unsigned char hash[SHA1_LEN];
+    blobHash(data, hash);
+    if (memcmp(hash, entry.Hash, SHA1_LEN) == 0)
+        return true;
+    if (data.find("\r\n") == std::string::npos)
+        return false;
+    std::string lf;
+    lf.reserve(data.size());
+    for (size_t i = 0; i < data.size(); i++) {
+        if (data[i] != '\r' || i + 1 >= data.size() || data[i + 1] != '\n')
+            lf += data[i];
+    }
+    blobHash(lf, hash);
+    return memcmp(hash, entry.Hash, SHA1_LEN) == 0;
+}
+
+static LONG entryStatus(const GITINDEX *index, const std::vector<GITENTRY>::const_iterator &first,
+                        const std::vector<GITENTRY>::const_iterator &last, PATHID file) {
+    const GITENTRY &entry = *first;
+    LONG status = SCC_STATUS_CONTROLLED;
+    if (last - first > 1 || (entry.Flags & GIT_FLAG_STAGE) != 0)
+        return status | SCC_STATUS_MODIFIED;        // unmerged
+    if ((entry.ExtFlags & GIT_EXT_INTENT_TO_ADD) != 0)
+        return status | SCC_STATUS_CHECKEDOUT | SCC_STATUS_OUTBYUSER;
+    if ((entry.Flags & GIT_FLAG_ASSUME_VALID) != 0 || (entry.ExtFlags & GIT_EXT_SKIP_WORKTREE) != 0 ||
+        (entry.Mode & GIT_MODE_TYPE) == GIT_MODE_GITLINK)
+        return status;
+
+    std::string name;
+    longPathName(file, name);
+    WIN32_FILE_ATTRIBUTE_DATA info;
+    if (!GetFileAttributesEx(name.c_str(), GetFileExInfoStandard, &info))
+        return status | SCC_STATUS_DELETED;
+    if ((info.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0)
+        return status | SCC_STATUS_DELETED | SCC_STATUS_MODIFIED;
+    if ((entry.Mode & GIT_MODE_TYPE) == GIT_MODE_SYMLINK)
+        return status;
+
+    unsigned int nsec;
+    ULONGLONG sec = unixTime(info.ftLastWriteTime, &nsec);
+    bool sameSize = entry.Size == info.nFileSizeLow;
+    bool sameTime = entry.MtimeSec == (unsigned int)sec && (entry.MtimeNsec == 0 || entry.MtimeNsec == nsec);
+
+    // A file written in the same tick as the index may have changed after
+    // its stat data was taken, so its time proves nothing. git records
+    // such files with size 0 to force a look at their contents.
+    unsigned int indexNsec;
+    ULONGLONG indexSec = unixTime(index->IndexTime, &indexNsec);
+    bool racy = entry.MtimeSec > indexSec ||
+        (entry.MtimeSec == indexSec && (entry.MtimeNsec == 0 || entry.MtimeNsec >= indexNsec));
+    if (sameSize && sameTime && !racy)
+        return status;
+    if (!sameSize && entry.Size != 0)
+        return status | SCC_STATUS_MODIFIED;
+    return sameContents(name.c_str(), entry) ? status : (status | SCC_STATUS_MODIFIED);
+}
+
+typedef struct GITWORK {
+    int                 NumberOfFiles;
+    const PATHID       *Files;
+    GITINDEX          **Indexes;
+    LONG               *Status;
+    volatile LONG       Next;
+} GITWORK;
+
+static DWORD WINAPI gitThread(LPVOID arg) {
+    GITWORK *work = (GITWORK *) arg;
+    for (;;) {
+        LONG i = InterlockedIncrement(&work->Next) - 1;
+        if (i >= work->NumberOfFiles)
+            break;
+        const GITINDEX *index = work->Indexes[i];
+        if (index == NULL) {
+            work->Status[i] = SCC_STATUS_NOTCONTROLLED;
+            continue;
+        }
+        if (!index->Valid) {
+            work->Status[i] = SCC_STATUS_INVALID;
+            continue;
+        }
+        const char *root = pathName(index->WorkTree);
+        const char *name = pathName(work->Files[i]);
+        size_t rootLength = strlen(root);
+        if (root[rootLength - 1] != '\\')
+            rootLength++;
+        GITENTRY key;
+        key.Key = lookupKey(name + rootLength, strlen(name + rootLength));
+        std::pair<std::vector<GITENTRY>::const_iterator, std::vector<GITENTRY>::const_iterator> range =
+            std::equal_range(index->Entries.begin(), index->Entries.end(), key, byKey);
+        work->Status[i] = range.first == range.second ? SCC_STATUS_NOTCONTROLLED :
+            entryStatus(index, range.first, range.second, work->Files[i]);
+    }
+    return 0;
+}
+
+void gitStatus(int numberOfFiles, const PATHID *files, LONG *status) {
+    if (numberOfFiles <= 0)
+        return;
+    // Only finding the working trees and reading their indexes changes
+    // what gGitLock guards; the files are looked at without it, each
+    // against a reading of its index held for the query.
+    std::vector<GITINDEX *> indexes(numberOfFiles);
+    std::map<GITREPO *, GITINDEX *> loaded;
+    ULONGLONG now = GetTickCount64();
+    AcquireSRWLockExclusive(&gGitLock);
+    for (int i = 0; i < numberOfFiles; i++) {
+        GITREPO *repo = repoForFolder(parentPathId(files[i]), now);
+        // The working tree folder itself, or a file outside it.
+        if (repo != NULL && (files[i] == repo->WorkTree || !isPathUnder(files[i], repo->WorkTree)))
+            repo = NULL;
+        if (repo == NULL) {
+            indexes[i] = NULL;
+            continue;
+        }
+        std::map<GITREPO *, GITINDEX *>::iterator it = loaded.find(repo);
+        if (it == loaded.end()) {
+            loadIndex(repo);
+            InterlockedIncrement(&repo->Index->Refs);
+            it = loaded.insert(std::make_pair(repo, repo->Index)).first;
+        }
+        indexes[i] = it->second;
+    }
+    ReleaseSRWLockExclusive(&gGitLock);
+
+    GITWORK work;
+    work.NumberOfFiles  = numberOfFiles;
+    work.Files          = files;
+    work.Indexes        = &indexes[0];
+    work.Status         = status;
+    work.Next           = 0;
+    HANDLE threads[GIT_THREADS];
+    int started = 0;
+    for (int t = 1; t < GIT_THREADS && t * 256 < numberOfFiles; t++) {
+        threads[started] = CreateThread(NULL, 0, gitThread, &work, 0, NULL);
+        if (threads[started] != NULL)
+            started++;
+    }
+    gitThread(&work);
+    if (started > 0) {
+        WaitForMultipleObjects(started, threads, TRUE, INFINITE);
+        for (int t = 0; t < started; t++)
+            CloseHandle(threads[t]);
+    }
+    for (std::map<GITREPO *, GITINDEX *>::iterator it = loaded.begin(); it != loaded.end(); ++it)
+        releaseIndex(it->second);
+}
+
+void forgetGitIndexes() {
+    AcquireSRWLockExclusive(&gGitLock);
+    for (std::map<PATHID, GITREPO *>::iterator it = gRepos.begin(); it != gRepos.end(); ++it) {
+        releaseIndex(it->second->Index);
+        delete it->second;
+    }
+    gRepos.clear();
+    gFolders.clear();
+    ReleaseSRWLockExclusive(&gGitLock);
+}
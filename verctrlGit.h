@@ -0,0 +1,43 @@
+/*
+*
+*
+* The source code contained in this listing contains proprietary and
+* confidential trade secrets of The MathWorks, Inc.  The use, modification,
+* or development of derivative work based on the code or ideas obtained
+* from the code is prohibited without the express written permission of The
+* MathWorks, Inc. The disclosure of this code to any party not authorized
+* by The MathWorks, Inc. is strictly forbidden.
+* CONFIDENTIAL AND CONTAINING PROPRIETARY TRADE SECRETS
+*/
+
+#ifndef VERCTRLGIT_H
+#define VERCTRLGIT_H
+
+#include <windows.h>
+
+#include "verctrlPath.h"
+
+/*
+* Status of files in git working trees, read from the repository's index
+* file without running git. Each file's size and time are compared with
+* those recorded in the index; contents are hashed only for files
+* changed too close to when the index was written to tell from their
+* time.
+*
+* Statuses are SccStatus bits:
+*   untracked, or not in a working tree   SCC_STATUS_NOTCONTROLLED
+*   tracked                               SCC_STATUS_CONTROLLED
+*   modified or unmerged                  | SCC_STATUS_MODIFIED
+*   deleted from the working tree         | SCC_STATUS_DELETED
+*   added with git add -N                 | SCC_STATUS_CHECKEDOUT | SCC_STATUS_OUTBYUSER
+*   index cannot be read                  SCC_STATUS_INVALID
+*
+* All functions are thread-safe and none of them use the MEX API.
+*/
+
+void gitStatus(int numberOfFiles, const PATHID *files, LONG *status);
+
+// Forget the working trees found and the indexes read.
+void forgetGitIndexes();
+
+#endif
@@ -0,0 +1,287 @@
+/*
+*
+*
+* The source code contained in this listing contains proprietary and
+* confidential trade secrets of The MathWorks, Inc.  The use, modification,
+* or development of derivative work based on the code or ideas obtained
+* from the code is prohibited without the express written permission of The
+* MathWorks, Inc. The disclosure of this code to any party not authorized
+* by The MathWorks, Inc. is strictly forbidden.
+* CONFIDENTIAL AND CONTAINING PROPRIETARY TRADE SECRETS
+*/
+
+#include <windows.h>
+#include <string.h>
+#include <string>
+
+#include "verctrlHash.h"
+
+#define ROL32(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+
+static void sha1Block(unsigned int state[5], const unsigned char *block) {
+    unsigned int w[80];
+    for (int i = 0; i < 16; i++) {
+        w[i] = ((unsigned int)block[4 * i] << 24) | ((unsigned int)block[4 * i + 1] << 16) |
+            ((unsigned int)block[4 * i + 2] << 8) | (unsigned int)block[4 * i + 3];
+    }
+    for (int i = 16; i < 80; i++)
+        w[i] = ROL32(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+    unsigned int a = state[0], b = state[1], c = state[2], d = state[3], e = state[4];
+    for (int i = 0; i < 80; i++) {
+        unsigned int f, k;
+        if (i < 20) {
+            f = (b & c) | (~b & d);
+            k = 0x5A827999;
+        } else if (i < 40) {
+            f = b ^ c ^ d;
+            k = 0x6ED9EBA1;
+        } else if (i < 60) {
+            f = (b & c) | (b & d) | (c & d);
+            k = 0x8F1BBCDC;
+        } else {
+            f = b ^ c ^ d;
+            k = 0xCA62C1D6;
+        }
+        unsigned int t = ROL32(a, 5) + f + e + k + w[i];
+        e = d;
+        d = c;
+        c = ROL32(b, 30);
+        b = a;
+        a = t;
+    }
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+}
+
+void sha1Init(SHA1CTX *ctx) {
+    ctx->State[0]   = 0x67452301;
+    ctx->State[1]   = 0xEFCDAB89;
+    ctx->State[2]   = 0x98BADCFE;
+    ctx->State[3]   = 0x10325476;
+    ctx->State[4]   = 0xC3D2E1F0;
+    ctx->Length     = 0;
+}
+
+void sha1Update(SHA1CTX *ctx, const void *data, size_t len) {
+    const unsigned char *p = (const unsigned char *)data;
+    size_t used = (size_t)(ctx->Length & 63);
+    ctx->Length += len;
+    if (used > 0) {
+        size_t take = 64 - used < len ? 64 - used : len;
+        memcpy(ctx->Block + used, p, take);
+        p   += take;
+        len -= take;
+        if (used + take < 64)
+            return;
+        sha1Block(ctx->State, ctx->Block);
+    }
+    while (len >= 64) {
+        sha1Block(ctx->State, p);
+        p   += 64;
+        len -= 64;
+    }
+    memcpy(ctx->Block, p, len);
+}
+
+void sha1Final(SHA1CTX *ctx, unsigned char digest[SHA1_LEN]) {
+    unsigned long long bits = ctx->Length * 8;
+    unsigned char pad[72];
+    size_t used     = (size_t)(ctx->Length & 63);
+    size_t padLen   = (used < 56 ? 56 : 120) - used;
+    memset(pad, 0, sizeof(pad));
+    pad[0] = 0x80;
+    for (int i = 0; i < 8; i++)
+        pad[padLen + i] = (unsigned char)(bits >> (56 - 8 * i));
+    sha1Update(ctx, pad, padLen + 8);
+    for (int i = 0; i < 5; i++) {
+        digest[4 * i]       = (unsigned char)(ctx->State[i] >> 24);
+        digest[4 * i + 1]   = (unsigned char)(ctx->State[i] >> 16);
+        digest[4 * i + 2]   = (unsigned char)(ctx->State[i] >> 8);
+        digest[4 * i + 3]   = (unsigned char)ctx->State[i];
+    }
+}
+
+void sha1(const void *data, size_t len, unsigned char digest[SHA1_LEN]) {
+    SHA1CTX ctx;
+    sha1Init(&ctx);
+    sha1Update(&ctx, data, len);
+    sha1Final(&ctx, digest);
+}
+
+bool sha1File(const char *fileName, unsigned char digest[SHA1_LEN]) {
+    HANDLE file = CreateFile(fileName, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+        OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+    SHA1CTX ctx;
+    sha1Init(&ctx);
+    char buf[64 * 1024];
+    DWORD got = 0;
+    bool ok = true;
+    for (;;) {
+        if (!ReadFile(file, buf, sizeof(buf), &got, NULL)) {
+            ok = false;
+            break;
+        }
+        if (got == 0)
+            break;
+        sha1Update(&ctx, buf, got);
+    }
+    CloseHandle(file);
+    if (ok)
+        sha1Final(&ctx, digest);
+    return ok;
+}
+
+void sha1ToHex(const unsigned char digest[SHA1_LEN], std::string &hex) {
+    static const char digits[] = "0123456789abcdef";
+    hex.resize(2 * SHA1_LEN);
+    for (int i = 0; i < SHA1_LEN; i++) {
+        hex[2 * i]      = digits[digest[i] >> 4];
+        hex[2 * i + 1]  = digits[digest[i] & 15];
+    }
+}
+
+bool sha1FromHex(const char *hex, unsigned char digest[SHA1_LEN]) {
+    for (int i = 0; i < 2 * SHA1_LEN; i++) {
+        char c = hex[i];
+        int v;
+        if (c >= '0' && c <= '9')
+            v = c - '0';
+        else if (c >= 'a' && c <= 'f')
+            v = c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F')
+            v = c - 'A' + 10;
+        else
+            return false;
+        if (i % 2 == 0)
+            digest[i / 2] = (unsigned char)(v << 4);
+        else
+            digest[i / 2] |= (unsigned char)v;
+    }
+    return true;
+}
+
+static unsigned int gCrcTable[256];
+
+static struct CRCTABLE {
+    CRCTABLE() {
+        for (unsigned int n = 0; n < 256; n++) {
+            unsigned int c = n;
+            for (int k = 0; k < 8; k++)
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            gCrcTable[n] = c;
+        }
+    }
+} gCrcTableInit;
+
+unsigned int crc32(const void *data, size_t len) {
+    const unsigned char *p = (const unsigned char *)data;
+    unsigned int c = 0xFFFFFFFFu;
+    for (size_t i = 0; i < len; i++)
+        c = gCrcTable[(c ^ p[i]) & 0xFF] ^ (c >> 8);
+    return c ^ 0xFFFFFFFFu;
+}
+
+/*
+* Record encoding
+*/
+unsigned int getU32(const unsigned char *p) {
+    return (unsigned int)p[0] | ((unsigned int)p[1] << 8) | ((unsigned int)p[2] << 16) |
+        ((unsigned int)p[3] << 24);
+}
+
+unsigned long long getU64(const unsigned char *p) {
+    return (unsigned long long)getU32(p) | ((unsigned long long)getU32(p + 4) << 32);
+}
+
+void putU32(unsigned char *p, unsigned int value) {
+    for (int i = 0; i < 4; i++)
+        p[i] = (unsigned char)(value >> (8 * i));
+}
+
+void putU64(unsigned char *p, unsigned long long value) {
+    putU32(p, (unsigned int)value);
+    putU32(p + 4, (unsigned int)(value >> 32));
+}
+
+void putU32(std::string &buf, unsigned int value) {
+    unsigned char p[4];
+    putU32(p, value);
+    buf.append((const char *)p, 4);
+}
+
+void putVarint(std::string &buf, unsigned long long value) {
+    while (value >= 0x80) {
+        buf += (char)((value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+    buf += (char)value;
+}
+
+void putSigned(std::string &buf, long long value) {
+    putVarint(buf, ((unsigned long long)value << 1) ^ (unsigned long long)(value >> 63));
+}
+
+void putString(std::string &buf, const std::string &str) {
+    putVarint(buf, str.size());
+    buf += str;
+}
+
+unsigned int getBigU32(const unsigned char *p) {
+    return ((unsigned int)p[0] << 24) | ((unsigned int)p[1] << 16) | ((unsigned int)p[2] << 8) | p[3];
+}
+
+unsigned short getBigU16(const unsigned char *p) {
+    return (unsigned short)((p[0] << 8) | p[1]);
+}
+
+void initRecordReader(RECORDREADER *rd, const void *data, size_t len) {
+    rd->Pos = (const unsigned char *)data;
+    rd->End = rd->Pos + len;
+    rd->Ok  = true;
+}
+
+int getByte(RECORDREADER *rd) {
+    if (rd->Pos >= rd->End) {
+        rd->Ok = false;
+        return 0;
+    }
+    return *rd->Pos++;
+}
+
+unsigned long long getVarint(RECORDREADER *rd) {
+    unsigned long long value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (rd->Pos >= rd->End) {
+            rd->Ok = false;
+            return 0;
+        }
+        unsigned char b = *rd->Pos++;
+        value |= (unsigned long long)(b & 0x7F) << shift;
+        if ((b & 0x80) == 0)
+            return value;
+    }
+    rd->Ok = false;
+    return 0;
+}
+
+long long getSigned(RECORDREADER *rd) {
+    unsigned long long v = getVarint(rd);
+    return (long long)(v >> 1) ^ -(long long)(v & 1);
+}
+
+std::string getString(RECORDREADER *rd) {
+    unsigned long long len = getVarint(rd);
+    if (!rd->Ok || len > (unsigned long long)(rd->End - rd->Pos)) {
+        rd->Ok = false;
+        return std::string();
+    }
+    std::string str((const char *)rd->Pos, (size_t)len);
+    rd->Pos += len;
+    return str;
+}
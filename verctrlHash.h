@@ -0,0 +1,76 @@
+/*
+*
+*
+* The source code contained in this listing contains proprietary and
+* confidential trade secrets of The MathWorks, Inc.  The use, modification,
+* or development of derivative work based on the code or ideas obtained
+* from the code is prohibited without the express written permission of The
+* MathWorks, Inc. The disclosure of this code to any party not authorized
+* by The MathWorks, Inc. is strictly forbidden.
+* CONFIDENTIAL AND CONTAINING PROPRIETARY TRADE SECRETS
+*/
+
+#ifndef VERCTRLHASH_H
+#define VERCTRLHASH_H
+
+#include <stddef.h>
+#include <string>
+
+/*
+* SHA-1, for content addressing, and CRC-32 and the record encoding, for
+* the logs and indexes on disk. None of them use the MEX API.
+*/
+#define SHA1_LEN 20
+
+typedef struct SHA1CTX {
+    unsigned int        State[5];
+    unsigned long long  Length;         // bytes hashed so far
+    unsigned char       Block[64];
+} SHA1CTX;
+
+void sha1Init(SHA1CTX *ctx);
+void sha1Update(SHA1CTX *ctx, const void *data, size_t len);
+void sha1Final(SHA1CTX *ctx, unsigned char digest[SHA1_LEN]);
+void sha1(const void *data, size_t len, unsigned char digest[SHA1_LEN]);
+
+// Hash a file's contents. Returns false if it cannot be read.
+bool sha1File(const char *fileName, unsigned char digest[SHA1_LEN]);
+
+void sha1ToHex(const unsigned char digest[SHA1_LEN], std::string &hex);
+bool sha1FromHex(const char *hex, unsigned char digest[SHA1_LEN]);
+
+unsigned int crc32(const void *data, size_t len);
+
+/*
+* Record encoding: little-endian integers, varints of 7 bits a byte, low
+* bits first, zigzag varints for signed values and strings prefixed with
+* their length as a varint. The putters on a string append to it.
+*/
+unsigned int getU32(const unsigned char *p);
+unsigned long long getU64(const unsigned char *p);
+void putU32(unsigned char *p, unsigned int value);
+void putU64(unsigned char *p, unsigned long long value);
+void putU32(std::string &buf, unsigned int value);
+void putVarint(std::string &buf, unsigned long long value);
+void putSigned(std::string &buf, long long value);
+void putString(std::string &buf, const std::string &str);
+
+// Big-endian, as in git's index.
+unsigned int getBigU32(const unsigned char *p);
+unsigned short getBigU16(const unsigned char *p);
+
+// Ok is cleared, and the getters return 0 or "", once a read runs past
+// End or a varint is too long.
+typedef struct RECORDREADER {
+    const unsigned char    *Pos;
+    const unsigned char    *End;
+    bool                    Ok;
+} RECORDREADER;
+
+void initRecordReader(RECORDREADER *rd, const void *data, size_t len);
+int getByte(RECORDREADER *rd);
+unsigned long long getVarint(RECORDREADER *rd);
+long long getSigned(RECORDREADER *rd);
+std::string getString(RECORDREADER *rd);
+
+#endif
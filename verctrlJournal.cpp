@@ -0,0 +1,858 @@
+/*
+*
+*
+* The source code contained in this listing contains proprietary and
+* confidential trade secrets of The MathWorks, Inc.  The use, modification,
+* or development of derivative work based on the code or ideas obtained
+* from the code is prohibited without the express written permission of The
+* MathWorks, Inc. The disclosure of this code to any party not authorized
+* by The MathWorks, Inc. is strictly forbidden.
+* CONFIDENTIAL AND CONTAINING PROPRIETARY TRADE SECRETS
+*/
+
+/*
+* Journal layout: the 4 byte magic and a version byte, followed by
+* records of
+*
+*   u32     length of the payload
+*   u32     CRC-32 of the payload
+*   payload
+*
+* A payload is either an entry
+*
+*   u8      JOURNAL_RECORD_ENTRY
+*   varint  id
+*   u8      op (JournalOp)
+*   svarint options
+*   string  provider library, folder, project name, aux path, comment
+*   varint  number of files, followed by that many strings
+*   string  for each file, the SHA-1 of its contents when it was
+*           journaled, or empty if it was not taken (version 2 on)
+*
+* or the outcome of one
+*
+*   u8      JOURNAL_RECORD_OUTCOME
+*   varint  id
+*   u8      state (JournalState)
+*   svarint return code of the last attempt
+*
+* Strings are a varint length followed by the bytes. An entry is flushed
+* to disk before journalOperation returns, and the outcomes of a batch
+* together once it has been sent. Both are written without gJournalLock
+* held, so status lookups do not wait on the disk. A record torn
+* by a crash fails its CRC and is cut off, with everything after it,
+* when the journal is next opened. The journal is rewritten with only
+* the pending entries when it is opened and whenever it drains.
+*
+* Providers read the working files when they are sent, so an ADD or
+* CHECKIN whose files changed after it was journaled would record the
+* later contents under its comment. Such an entry fails instead, with
+* SCC_E_CHECKINCONFLICT.
+*/
+
+#include <windows.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <map>
+
+#include "scc.h"
+#include "verctrl.h"
+#include "verctrlRecord.h"
+#include "verctrlPath.h"
+#include "verctrlProvider.h"
+#include "verctrlCache.h"
+#include "verctrlHash.h"
+#include "verctrlPristine.h"
+#include "verctrlJournal.h"
+
+#define JOURNAL_MAGIC           "VCJN"
+#define JOURNAL_VERSION         2
+#define JOURNAL_RECORD_ENTRY    1
+#define JOURNAL_RECORD_OUTCOME  2
+
+#define JOURNAL_MAX_BATCH       1024        // files per provider call
+#define JOURNAL_MAX_ATTEMPTS    20
+#define JOURNAL_FIRST_RETRY_MS  1000
+#define JOURNAL_LAST_RETRY_MS   (5 * 60 * 1000)
+#define JOURNAL_MAX_FINISHED    1000        // finished entries kept for JOURNAL_STATUS
+
+typedef struct JOURNALENTRY {
+    ULONGLONG               Id;
+    int                     Op;
+    LONG                    Options;
+    std::string             LibPath;
+    PATHID                  Folder;
+    std::string             ProjName;
+    std::string             AxPath;
+    std::string             Comment;
+    std::vector<PATHID>     Files;
+    std::vector<std::string> Hashes;        // SHA-1 of each file as journaled, ADD and CHECKIN only
+    int                     State;
+    int                     Attempts;
+    SCCRTN                  Rtn;
+    ULONGLONG               NextAttempt;    // GetTickCount64
+    bool                    Foreground;     // left for the thread its provider was loaded on
+} JOURNALENTRY;
+
+static CRITICAL_SECTION             gJournalLock;
+static CRITICAL_SECTION             gJournalWriteLock;  // held to write or replace gJournalFile,
+                                                        // taken after gJournalLock if both are
+static CONDITION_VARIABLE           gJournalChanged;
+static volatile LONG                gJournalLockReady   = 0;
+static volatile bool                gJournalOn          = false;
+static HANDLE                       gJournalFile        = INVALID_HANDLE_VALUE;
+static std::string                  gJournalName;
+static HANDLE                       gFlusher            = NULL;
+static bool                         gStopFlusher        = false;
+static ULONGLONG                    gNextId             = 1;
+static std::vector<JOURNALENTRY *>  gPending;           // in id order
+static std::vector<JOURNALENTRY *>  gFinished;
+static std::map<PATHID, int>        gPendingFiles;      // number of pending entries per file
+static int                          gWriting            = 0;    // entries being written
+
+static void initJournalLock() {
+    if (InterlockedCompareExchange(&gJournalLockReady, 1, 0) == 0) {
+        InitializeCriticalSection(&gJournalLock);
+        InitializeCriticalSection(&gJournalWriteLock);
+        InitializeConditionVariable(&gJournalChanged);
+        InterlockedExchange(&gJournalLockReady, 2);
+    }
+    while (gJournalLockReady != 2)
+        Sleep(0);
+}
+
+static void encodeEntry(std::string &payload, const JOURNALENTRY *entry) {
+    payload += (char)JOURNAL_RECORD_ENTRY;
+    putVarint(payload, entry->Id);
+    payload += (char)entry->Op;
+    putSigned(payload, entry->Options);
+    putString(payload, entry->LibPath);
+    putString(payload, pathName(entry->Folder));
+    putString(payload, entry->ProjName);
+    putString(payload, entry->AxPath);
+    putString(payload, entry->Comment);
+    putVarint(payload, entry->Files.size());
+    for (size_t i = 0; i < entry->Files.size(); i++)
+        putString(payload, pathName(entry->Files[i]));
+    for (size_t i = 0; i < entry->Files.size(); i++)
+        putString(payload, i < entry->Hashes.size() ? entry->Hashes[i] : std::string());
+}
+
+static void encodeOutcome(std::string &payload, const JOURNALENTRY *entry) {
+    payload += (char)JOURNAL_RECORD_OUTCOME;
+    putVarint(payload, entry->Id);
+    payload += (char)entry->State;
+    putSigned(payload, entry->Rtn);
+}
+
+/*
+* Append records and wait for them to reach the disk. Called with
+* gJournalWriteLock held.
+*/
+static bool writeRecords(const std::vector<std::string> &payloads) {
+    if (gJournalFile == INVALID_HANDLE_VALUE)
+        return false;
+    std::string frame;
+    for (size_t i = 0; i < payloads.size(); i++) {
+        putU32(frame, (unsigned int)payloads[i].size());
+        putU32(frame, crc32(payloads[i].data(), payloads[i].size()));
+        frame += payloads[i];
+    }
+    DWORD written = 0;
+    if (!WriteFile(gJournalFile, frame.data(), (DWORD)frame.size(), &written, NULL) ||
+        written != frame.size())
+        return false;
+    return FlushFileBuffers(gJournalFile) != 0;
+}
+
+static HANDLE openJournalFile(const char *fileName) {
+    return CreateFile(fileName, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL,
+        OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+}
+
+/*
+* Read the journal into gPending and gFinished, and cut off a torn tail.
+*/
+static bool replayJournal(HANDLE file) {
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart > 0x7FFFFFFF)
+        return false;
+    std::vector<char> data((size_t)size.QuadPart + 1);
+    DWORD got = 0;
+    if (size.QuadPart > 0 &&
+        (!ReadFile(file, &data[0], (DWORD)size.QuadPart, &got, NULL) || got != (DWORD)size.QuadPart))
+        return false;
+    if (got == 0)
+        return true;
+    // Version 1 entries have no hashes; the journal is rewritten in the
+    // current version once it is read.
+    if (got < 5 || memcmp(&data[0], JOURNAL_MAGIC, 4) != 0 || data[4] < 1 || data[4] > JOURNAL_VERSION)
+        return false;
+    int version = data[4];
+
+    std::map<ULONGLONG, JOURNALENTRY *> byId;
+    size_t pos = 5;
+    while (pos + 8 <= got) {
+        unsigned int len = getU32((const unsigned char *)&data[pos]);
+        unsigned int crc = getU32((const unsigned char *)&data[pos + 4]);
+        if (len > got - pos - 8 || crc32(&data[pos + 8], len) != crc)
+            break;
+        RECORDREADER rd;
+        initRecordReader(&rd, &data[pos + 8], len);
+        int type = getByte(&rd);
+        if (type == JOURNAL_RECORD_ENTRY) {
+            JOURNALENTRY *entry = new JOURNALENTRY;
+            entry->Id           = getVarint(&rd);
+            entry->Op           = getByte(&rd);
+            entry->Options      = (LONG)getSigned(&rd);
+            entry->LibPath      = getString(&rd);
+            entry->Folder       = internPath(getString(&rd).c_str());
+            entry->ProjName     = getString(&rd);
+            entry->AxPath       = getString(&rd);
+            entry->Comment      = getString(&rd);
+            ULONGLONG n         = getVarint(&rd);
+            for (ULONGLONG i = 0; rd.Ok && i < n; i++)
+                entry->Files.push_back(internPath(getString(&rd).c_str()));
+            for (ULONGLONG i = 0; rd.Ok && version >= 2 && i < n; i++)
+                entry->Hashes.push_back(getString(&rd));
+            entry->State        = JOURNAL_PENDING;
+            entry->Attempts     = 0;
+            entry->Rtn          = SCC_OK;
+            entry->NextAttempt  = 0;
+            entry->Foreground   = false;
+            if (!rd.Ok) {
+                delete entry;
+                break;
+            }
+            byId[entry->Id] = entry;
+            if (entry->Id >= gNextId)
+                gNextId = entry->Id + 1;
+        } else if (type == JOURNAL_RECORD_OUTCOME) {
+            ULONGLONG id    = getVarint(&rd);
+            int state       = getByte(&rd);
+            SCCRTN rtn      = (SCCRTN)getSigned(&rd);
+            if (!rd.Ok)
+                break;
+            std::map<ULONGLONG, JOURNALENTRY *>::iterator it = byId.find(id);
+            if (it != byId.end()) {
+                it->second->State   = state;
+                it->second->Rtn     = rtn;
+            }
+        } else {
+            break;
+        }
+        pos += 8 + len;
+    }
+
+    for (std::map<ULONGLONG, JOURNALENTRY *>::iterator it = byId.begin(); it != byId.end(); ++it) {
+        JOURNALENTRY *entry = it->second;
+        if (entry->State == JOURNAL_PENDING) {
+            gPending.push_back(entry);
+            for (size_t i = 0; i < entry->Files.size(); i++)
+                gPendingFiles[entry->Files[i]]++;
+        } else {
+            gFinished.push_back(entry);
+        }
+    }
+    return true;
+}
+
+/*
+* Replace the journal with one holding only the entries in keep. Called
+* with gJournalWriteLock held.
+*/
+static bool compactJournal(const std::vector<JOURNALENTRY *> &keep) {
+    std::string tmpName = gJournalName + ".tmp";
+    HANDLE tmp = CreateFile(tmpName.c_str(), GENERIC_READ | GENERIC_WRITE, 0, NULL,
+        CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (tmp == INVALID_HANDLE_VALUE)
+        return false;
+    std::string header(JOURNAL_MAGIC);
+    header += (char)JOURNAL_VERSION;
+    DWORD written = 0;
+    bool ok = WriteFile(tmp, header.data(), (DWORD)header.size(), &written, NULL) != 0;
+    for (size_t i = 0; ok && i < keep.size(); i++) {
+        std::string payload;
+        encodeEntry(payload, keep[i]);
+        std::string frame;
+        putU32(frame, (unsigned int)payload.size());
+        putU32(frame, crc32(payload.data(), payload.size()));
+        frame += payload;
+        ok = WriteFile(tmp, frame.data(), (DWORD)frame.size(), &written, NULL) != 0;
+    }
+    ok = ok && FlushFileBuffers(tmp);
+    CloseHandle(tmp);
+    if (!ok) {
+        DeleteFile(tmpName.c_str());
+        return false;
+    }
+
+    if (gJournalFile != INVALID_HANDLE_VALUE)
+        CloseHandle(gJournalFile);
+    gJournalFile = INVALID_HANDLE_VALUE;
+    if (!MoveFileEx(tmpName.c_str(), gJournalName.c_str(),
+            MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+        DeleteFile(tmpName.c_str());
+    }
+    gJournalFile = openJournalFile(gJournalName.c_str());
+    if (gJournalFile == INVALID_HANDLE_VALUE)
+        return false;
+    SetFilePointer(gJournalFile, 0, NULL, FILE_END);
+    return true;
+}
+
+/*
+* Errors that may go away if the call is retried later.
+*/
+static bool isTransient(SCCRTN rtn) {
+    return rtn == SCC_E_ACCESSFAILURE || rtn == SCC_E_CONNECTIONFAILURE ||
+        rtn == SCC_E_NONSPECIFICERROR || rtn == SCC_E_INITIALIZEFAILED ||
+        rtn == SCC_E_PROJNOTOPEN;
+}
+
+/*
+* Whether a file of an ADD or CHECKIN entry no longer has the contents
+* it was journaled with. Does not need gJournalLock.
+*/
+static bool entryChanged(const JOURNALENTRY *entry) {
+    for (size_t i = 0; i < entry->Files.size() && i < entry->Hashes.size(); i++) {
+        if (entry->Hashes[i].empty())
+            continue;
+        unsigned char digest[SHA1_LEN];
+        if (!sha1File(pathName(entry->Files[i]), digest) ||
+            memcmp(digest, entry->Hashes[i].data(), SHA1_LEN) != 0)
+            return true;
+    }
+    return false;
+}
+
+static bool sameBatch(const JOURNALENTRY *a, const JOURNALENTRY *b) {
+    return a->Op == b->Op && a->Options == b->Options && a->Folder == b->Folder &&
+        a->LibPath == b->LibPath && a->Comment == b->Comment;
+}
+
+/*
+* Pick the oldest entry that is due and every later one that can go in
+* the same provider call. An entry is held back if an earlier entry
+* that is not in the batch touches one of its files, so that the
+* operations on each file reach the provider in order. foreground picks
+* the entries the flusher left for the thread their provider was loaded
+* on instead of the others. Called with gJournalLock held.
+*/
+static void nextBatch(std::vector<JOURNALENTRY *> &batch, ULONGLONG now, ULONGLONG *wakeAt, bool foreground) {
+    std::map<PATHID, bool> blocked;
+    size_t numberOfFiles = 0;
+    *wakeAt = 0;
+    for (size_t i = 0; i < gPending.size(); i++) {
+        JOURNALENTRY *entry = gPending[i];
+        bool mine = entry->Foreground == foreground;
+        bool due = mine && entry->NextAttempt <= now;
+        if (mine && !due && (*wakeAt == 0 || entry->NextAttempt < *wakeAt))
+            *wakeAt = entry->NextAttempt;
+
+        bool isBlocked = false;
+        for (size_t f = 0; f < entry->Files.size() && !isBlocked; f++)
+            isBlocked = blocked.count(entry->Files[f]) != 0;
+
+        bool take = due && !isBlocked &&
+            (batch.empty() || (sameBatch(batch[0], entry) &&
+                               numberOfFiles + entry->Files.size() <= JOURNAL_MAX_BATCH));
+        if (take) {
+            batch.push_back(entry);
+            numberOfFiles += entry->Files.size();
+        } else {
+            for (size_t f = 0; f < entry->Files.size(); f++)
+                blocked[entry->Files[f]] = true;
+        }
+    }
+}
+
+/*
+* Send a batch to its provider, loading it if this MATLAB session has not,
+* e.g. for entries left from before a restart. *unavailable is set if it
+* cannot be loaded, and nothing was sent; *elsewhere too if that is
+* because the provider is not reentrant and belongs to another thread.
+* The flusher does not keep such a provider loaded, so that the MATLAB
+* thread can. Runs without gJournalLock held; the entries are only
+* changed under the lock.
+*/
+static SCCRTN sendBatch(const std::vector<JOURNALENTRY *> &batch, bool foreground,
+                        bool *unavailable, bool *elsewhere) {
+    const JOURNALENTRY *head = batch[0];
+    *unavailable    = false;
+    *elsewhere      = false;
+    SCCSESSION *session = acquireSessionForLib(head->LibPath.c_str(), NULL, head->Folder);
+    if (session == NULL) {
+        DWORD owner = providerOwnerThread(head->LibPath.c_str());
+        if (owner != 0 && owner != GetCurrentThreadId()) {
+            *unavailable    = true;
+            *elsewhere      = true;
+            return SCC_E_INITIALIZEFAILED;
+        }
+        bool loaded;
+        SCCRTN rtn;
+        SCCPROVIDER *provider = startProvider(NULL, head->LibPath.c_str(), &loaded, &rtn);
+        if (provider != NULL && !foreground && (provider->Capability & SCC_CAP_REENTRANT) == 0) {
+            // Loaded here just now, or by another thread meanwhile.
+            if (provider->OwnerThread == GetCurrentThreadId())
+                unloadProvider(provider);
+            *unavailable    = true;
+            *elsewhere      = true;
+            return SCC_E_INITIALIZEFAILED;
+        }
+        if (provider != NULL)
+            session = acquireSessionForLib(head->LibPath.c_str(), NULL, head->Folder);
+        if (session == NULL) {
+            *unavailable = true;
+            return SCC_E_INITIALIZEFAILED;
+        }
+    }
+
+    SCCRTN rtn = SCC_OK;
+    if (session->CurrentFolder != head->Folder)
+        rtn = openSessionProject(session, NULL, head->Folder,
+            head->ProjName.c_str(), head->AxPath.c_str());
+
+    if (IS_SCC_SUCCESS(rtn)) {
+        std::vector<LPCSTR> names;
+        for (size_t b = 0; b < batch.size(); b++) {
+            for (size_t f = 0; f < batch[b]->Files.size(); f++)
+                names.push_back(pathName(batch[b]->Files[f]));
+        }
+        LONG nFiles     = (LONG)names.size();
+        LPSTR comment   = const_cast<LPSTR>(head->Comment.c_str());
+        SCCPROVIDER *provider = session->Provider;
+        SCCRECORD rec;
+        switch (head->Op) {
+        case JOURNAL_ADD: {
+            std::vector<LONG> fOptions(names.size(), head->Options);
+            recordBegin(&rec, session->Provider->LibPath, session->Context, SCCPROC_ADD, nFiles, &names[0], comment, head->Options);
+            rtn = (*(SccAdd_PROC) provider->Procs[SCCPROC_ADD])
+                (session->Context, NULL, nFiles, &names[0], comment, &fOptions[0], NULL);
+            recordEnd(&rec, rtn, nFiles, &fOptions[0], 0, NULL);
+            break;
+        }
+        case JOURNAL_CHECKIN:
+            recordBegin(&rec, session->Provider->LibPath, session->Context, SCCPROC_CHECKIN, nFiles, &names[0], comment, head->Options);
+            rtn = (*(SccCheckin_PROC) provider->Procs[SCCPROC_CHECKIN])
+                (session->Context, NULL, nFiles, &names[0], comment, head->Options, NULL);
+            recordEnd(&rec, rtn, 0, NULL, 0, NULL);
+            break;
+        case JOURNAL_REMOVE:
+            recordBegin(&rec, session->Provider->LibPath, session->Context, SCCPROC_REMOVE, nFiles, &names[0], comment, head->Options);
+            rtn = (*(SccRemove_PROC) provider->Procs[SCCPROC_REMOVE])
+                (session->Context, NULL, nFiles, &names[0], comment, head->Options, NULL);
+            recordEnd(&rec, rtn, 0, NULL, 0, NULL);
+            break;
+        case JOURNAL_UNCHECKOUT:
+            recordBegin(&rec, session->Provider->LibPath, session->Context, SCCPROC_UNCHECKOUT, nFiles, &names[0], NULL, head->Options);
+            rtn = (*(SccUncheckout_PROC) provider->Procs[SCCPROC_UNCHECKOUT])
+                (session->Context, NULL, nFiles, &names[0], head->Options, NULL);
+            recordEnd(&rec, rtn, 0, NULL, 0, NULL);
+            break;
+        default:
+            rtn = SCC_E_NONSPECIFICERROR;
+        }
+    }
+    releaseSession(session);
+    return rtn;
+}
+
+/*
+* Move an entry from gPending to gFinished, and add its outcome record
+* to outcomes. Called with gJournalLock held.
+*/
+static void finishEntry(JOURNALENTRY *entry, int state, SCCRTN rtn, std::vector<std::string> &outcomes) {
+    entry->State    = state;
+    entry->Rtn      = rtn;
+    for (size_t i = 0; i < gPending.size(); i++) {
+        if (gPending[i] == entry) {
+            gPending.erase(gPending.begin() + i);
+            break;
+        }
+    }
+    for (size_t f = 0; f < entry->Files.size(); f++) {
+        std::map<PATHID, int>::iterator it = gPendingFiles.find(entry->Files[f]);
+        if (it != gPendingFiles.end() && --it->second == 0)
+            gPendingFiles.erase(it);
+        invalidateStatus(entry->Files[f]);
+    }
+    outcomes.push_back(std::string());
+    encodeOutcome(outcomes.back(), entry);
+    gFinished.push_back(entry);
+    if (gFinished.size() > JOURNAL_MAX_FINISHED) {
+        delete gFinished[0];
+        gFinished.erase(gFinished.begin());
+    }
+}
+
+/*
+* Send a batch taken by nextBatch and record how it went. Called with
+* gJournalLock held, which is let go of while the provider is called.
+*/
+static void runBatch(const std::vector<JOURNALENTRY *> &batch, bool foreground) {
+    LeaveCriticalSection(&gJournalLock);
+    std::vector<JOURNALENTRY *> changed;
+    std::vector<JOURNALENTRY *> send;
+    for (size_t b = 0; b < batch.size(); b++)
+        (entryChanged(batch[b]) ? changed : send).push_back(batch[b]);
+    bool unavailable    = false;
+    bool elsewhere      = false;
+    SCCRTN rtn          = SCC_OK;
+    if (!send.empty())
+        rtn = sendBatch(send, foreground, &unavailable, &elsewhere);
+    // What the provider checked in or added is the files' new base,
+    // as they were read when the batch was sent.
+    if (!unavailable && IS_SCC_SUCCESS(rtn) && (batch[0]->Op == JOURNAL_ADD || batch[0]->Op == JOURNAL_CHECKIN)) {
+        for (size_t b = 0; b < send.size(); b++)
+            capturePristine((int)send[b]->Files.size(), &send[b]->Files[0]);
+    }
+    EnterCriticalSection(&gJournalLock);
+
+    std::vector<std::string> outcomes;
+    for (size_t b = 0; b < changed.size(); b++) {
+        changed[b]->Attempts++;
+        finishEntry(changed[b], JOURNAL_FAILED, SCC_E_CHECKINCONFLICT, outcomes);
+    }
+    for (size_t b = 0; b < send.size(); b++) {
+        JOURNALENTRY *entry = send[b];
+        if (elsewhere && !foreground) {
+            // Left for sendJournalOpsHere on the MATLAB thread.
+            entry->Foreground   = true;
+            entry->NextAttempt  = 0;
+            continue;
+        }
+        if (unavailable) {
+            // Not an attempt: the entry stays pending until the
+            // provider can be loaded.
+            entry->NextAttempt = GetTickCount64() + JOURNAL_LAST_RETRY_MS;
+            continue;
+        }
+        entry->Attempts++;
+        entry->Rtn = rtn;
+        if (IS_SCC_SUCCESS(rtn)) {
+            finishEntry(entry, JOURNAL_DONE, rtn, outcomes);
+        } else if (!isTransient(rtn) || entry->Attempts >= JOURNAL_MAX_ATTEMPTS) {
+            finishEntry(entry, JOURNAL_FAILED, rtn, outcomes);
+        } else {
+            ULONGLONG delay = JOURNAL_FIRST_RETRY_MS;
+            for (int a = 1; a < entry->Attempts && delay < JOURNAL_LAST_RETRY_MS; a++)
+                delay *= 2;
+            if (delay > JOURNAL_LAST_RETRY_MS)
+                delay = JOURNAL_LAST_RETRY_MS;
+            entry->NextAttempt = GetTickCount64() + delay;
+        }
+    }
+    WakeAllConditionVariable(&gJournalChanged);
+
+    // Write the outcomes, or drop them with the rest of the journal
+    // once it has drained. Taking gJournalWriteLock before letting
+    // go of gJournalLock keeps an entry journaled meanwhile out of
+    // the journal being replaced.
+    bool compact = gPending.empty() && gWriting == 0;
+    if (compact || !outcomes.empty()) {
+        EnterCriticalSection(&gJournalWriteLock);
+        LeaveCriticalSection(&gJournalLock);
+        if (!compact || !compactJournal(std::vector<JOURNALENTRY *>()))
+            writeRecords(outcomes);
+        LeaveCriticalSection(&gJournalWriteLock);
+        EnterCriticalSection(&gJournalLock);
+    }
+}
+
+static DWORD WINAPI flusherThread(LPVOID) {
+    EnterCriticalSection(&gJournalLock);
+    while (!gStopFlusher) {
+        std::vector<JOURNALENTRY *> batch;
+        ULONGLONG wakeAt;
+        ULONGLONG now = GetTickCount64();
+        nextBatch(batch, now, &wakeAt, false);
+        if (batch.empty()) {
+            DWORD wait = INFINITE;
+            if (wakeAt != 0)
+                wait = (DWORD)(wakeAt - now);
+            SleepConditionVariableCS(&gJournalChanged, &gJournalLock, wait);
+            continue;
+        }
+        runBatch(batch, false);
+    }
+    LeaveCriticalSection(&gJournalLock);
+    return 0;
+}
+
+/*
+* Open the journal in fileName, creating it if needed, and start sending
+* the entries left in it to their providers.
+*/
+bool startJournal(const char *fileName) {
+    initJournalLock();
+    stopJournal();
+
+    EnterCriticalSection(&gJournalLock);
+    EnterCriticalSection(&gJournalWriteLock);
+    gJournalName = fileName;
+    gJournalFile = openJournalFile(fileName);
+    bool ok = gJournalFile != INVALID_HANDLE_VALUE && replayJournal(gJournalFile) &&
+        compactJournal(gPending);
+    if (ok) {
+        gStopFlusher    = false;
+        gFlusher        = CreateThread(NULL, 0, flusherThread, NULL, 0, NULL);
+        ok              = gFlusher != NULL;
+    }
+    if (!ok && gJournalFile != INVALID_HANDLE_VALUE) {
+        CloseHandle(gJournalFile);
+        gJournalFile = INVALID_HANDLE_VALUE;
+    }
+    gJournalOn = ok;
+    LeaveCriticalSection(&gJournalWriteLock);
+    LeaveCriticalSection(&gJournalLock);
+    return ok;
+}
+
+/*
+* Stop the flusher and close the journal. Pending entries stay in the
+* journal file.
+*/
+void stopJournal() {
+    if (gJournalLockReady != 2)
+        return;
+    EnterCriticalSection(&gJournalLock);
+    gJournalOn      = false;
+    HANDLE flusher  = gFlusher;
+    gFlusher        = NULL;
+    gStopFlusher    = true;
+    WakeAllConditionVariable(&gJournalChanged);
+    LeaveCriticalSection(&gJournalLock);
+    if (flusher != NULL) {
+        WaitForSingleObject(flusher, INFINITE);
+        CloseHandle(flusher);
+    }
+
+    EnterCriticalSection(&gJournalLock);
+    EnterCriticalSection(&gJournalWriteLock);
+    if (gJournalFile != INVALID_HANDLE_VALUE) {
+        CloseHandle(gJournalFile);
+        gJournalFile = INVALID_HANDLE_VALUE;
+    }
+    LeaveCriticalSection(&gJournalWriteLock);
+    for (size_t i = 0; i < gPending.size(); i++)
+        delete gPending[i];
+    for (size_t i = 0; i < gFinished.size(); i++)
+        delete gFinished[i];
+    gPending.clear();
+    gFinished.clear();
+    gPendingFiles.clear();
+    WakeAllConditionVariable(&gJournalChanged);
+    LeaveCriticalSection(&gJournalLock);
+}
+
+bool isJournaling() {
+    return gJournalOn;
+}
+
+/*
+* Append an operation to the journal. Returns once it is on disk, or
+* false if it could not be written, in which case the caller should
+* perform the operation itself.
+*/
+bool journalOperation(int op, const char *libPath, PATHID folder,
+                      const char *projName, const char *axPath,
+                      const char *comment, LONG options,
+                      int numberOfFiles, const PATHID *files) {
+    if (!isJournaling())
+        return false;
+    JOURNALENTRY *entry = new JOURNALENTRY;
+    entry->Op           = op;
+    entry->Options      = options;
+    entry->LibPath      = libPath;
+    entry->Folder       = folder;
+    entry->ProjName     = projName != NULL ? projName : "";
+    entry->AxPath       = axPath != NULL ? axPath : "";
+    entry->Comment      = comment != NULL ? comment : "";
+    entry->Files.assign(files, files + numberOfFiles);
+    if (op == JOURNAL_ADD || op == JOURNAL_CHECKIN) {
+        // A file that cannot be read is left to the provider to report.
+        entry->Hashes.resize(numberOfFiles);
+        for (int i = 0; i < numberOfFiles; i++) {
+            unsigned char digest[SHA1_LEN];
+            if (sha1File(pathName(files[i]), digest))
+                entry->Hashes[i].assign((const char *)digest, SHA1_LEN);
+        }
+    }
+    entry->State        = JOURNAL_PENDING;
+    entry->Attempts     = 0;
+    entry->Rtn          = SCC_OK;
+    entry->NextAttempt  = 0;
+    entry->Foreground   = false;
+
+    EnterCriticalSection(&gJournalLock);
+    entry->Id = gNextId++;
+    gWriting++;
+    LeaveCriticalSection(&gJournalLock);
+
+    std::vector<std::string> payloads(1);
+    encodeEntry(payloads[0], entry);
+    EnterCriticalSection(&gJournalWriteLock);
+    bool ok = writeRecords(payloads);
+    LeaveCriticalSection(&gJournalWriteLock);
+
+    EnterCriticalSection(&gJournalLock);
+    gWriting--;
+    // If the journal was turned off meanwhile, the entry is sent once it
+    // is turned on again.
+    bool keep = ok && gJournalOn;
+    if (keep) {
+        size_t at = gPending.size();
+        while (at > 0 && gPending[at - 1]->Id > entry->Id)
+            at--;
+        gPending.insert(gPending.begin() + at, entry);
+        for (int i = 0; i < numberOfFiles; i++) {
+            gPendingFiles[files[i]]++;
+            invalidateStatus(files[i]);
+        }
+    }
+    WakeAllConditionVariable(&gJournalChanged);
+    LeaveCriticalSection(&gJournalLock);
+    if (!keep)
+        delete entry;
+    return ok;
+}
+
+/*
+* Send the entries the flusher left because their provider is not
+* reentrant, if this is the thread it was loaded on or it is not loaded.
+*/
+void sendJournalOpsHere() {
+    if (!isJournaling())
+        return;
+    EnterCriticalSection(&gJournalLock);
+    for (;;) {
+        std::vector<JOURNALENTRY *> batch;
+        ULONGLONG wakeAt;
+        nextBatch(batch, GetTickCount64(), &wakeAt, true);
+        if (batch.empty())
+            break;
+        runBatch(batch, true);
+    }
+    LeaveCriticalSection(&gJournalLock);
+}
+
+void hasPendingJournalOps(int numberOfFiles, const PATHID *files, std::vector<bool> &pending) {
+    pending.assign(numberOfFiles, false);
+    if (!isJournaling())
+        return;
+    EnterCriticalSection(&gJournalLock);
+    for (int i = 0; i < numberOfFiles && !gPendingFiles.empty(); i++)
+        pending[i] = gPendingFiles.count(files[i]) != 0;
+    LeaveCriticalSection(&gJournalLock);
+}
+
+/*
+* Apply the pending entries for file to its status. Called with
+* gJournalLock held.
+*/
+static LONG applyPendingEntries(PATHID file, LONG status) {
+    for (size_t i = 0; i < gPending.size(); i++) {
+        const JOURNALENTRY *entry = gPending[i];
+        bool touches = false;
+        for (size_t f = 0; f < entry->Files.size() && !touches; f++)
+            touches = entry->Files[f] == file;
+        if (!touches)
+            continue;
+        bool keep = (entry->Options & SCC_KEEP_CHECKEDOUT) != 0;
+        switch (entry->Op) {
+        case JOURNAL_ADD:
+            status |= SCC_STATUS_CONTROLLED;
+            if (keep)
+                status |= SCC_STATUS_CHECKEDOUT | SCC_STATUS_OUTBYUSER;
+            break;
+        case JOURNAL_CHECKIN:
+            status &= ~SCC_STATUS_MODIFIED;
+            if (!keep)
+                status &= ~(SCC_STATUS_CHECKEDOUT | SCC_STATUS_OUTBYUSER | SCC_STATUS_OUTEXCLUSIVE);
+            break;
+        case JOURNAL_REMOVE:
+            status = SCC_STATUS_NOTCONTROLLED;
+            break;
+        case JOURNAL_UNCHECKOUT:
+            status &= ~(SCC_STATUS_CHECKEDOUT | SCC_STATUS_OUTBYUSER |
+                        SCC_STATUS_OUTEXCLUSIVE | SCC_STATUS_MODIFIED);
+            break;
+        }
+    }
+    return status;
+}
+
+void applyPendingJournalOps(int numberOfFiles, const PATHID *files, LONG *status) {
+    if (!isJournaling())
+        return;
+    EnterCriticalSection(&gJournalLock);
+    for (int i = 0; i < numberOfFiles && !gPendingFiles.empty(); i++) {
+        if (gPendingFiles.count(files[i]) != 0)
+            status[i] = applyPendingEntries(files[i], status[i]);
+    }
+    LeaveCriticalSection(&gJournalLock);
+}
+
+bool waitForJournal(int numberOfFiles, const PATHID *files, DWORD timeout, SCCRTN *rtn) {
+    *rtn = SCC_OK;
+    if (!isJournaling())
+        return true;
+    ULONGLONG deadline = GetTickCount64() + timeout;
+    EnterCriticalSection(&gJournalLock);
+    for (;;) {
+        const JOURNALENTRY *waitingFor = NULL;
+        for (size_t i = 0; i < gPending.size() && waitingFor == NULL; i++) {
+            const JOURNALENTRY *entry = gPending[i];
+            for (size_t f = 0; f < entry->Files.size() && waitingFor == NULL; f++) {
+                for (int n = 0; n < numberOfFiles; n++) {
+                    if (entry->Files[f] == files[n]) {
+                        waitingFor = entry;
+                        break;
+                    }
+                }
+            }
+        }
+        if (waitingFor == NULL) {
+            LeaveCriticalSection(&gJournalLock);
+            return true;
+        }
+        ULONGLONG now = GetTickCount64();
+        if (now >= deadline || !gJournalOn) {
+            *rtn = waitingFor->Attempts > 0 ? waitingFor->Rtn : SCC_E_ACCESSFAILURE;
+            LeaveCriticalSection(&gJournalLock);
+            return false;
+        }
+        SleepConditionVariableCS(&gJournalChanged, &gJournalLock, (DWORD)(deadline - now));
+    }
+}
+
+static void addInfo(std::vector<JOURNALINFO> &entries, const JOURNALENTRY *entry) {
+    JOURNALINFO info;
+    info.Id         = entry->Id;
+    info.Op         = entry->Op;
+    info.State      = entry->State;
+    info.Attempts   = entry->Attempts;
+    info.Rtn        = entry->Rtn;
+    info.Comment    = entry->Comment;
+    for (size_t f = 0; f < entry->Files.size(); f++)
+        info.Files.push_back(pathName(entry->Files[f]));
+    entries.push_back(info);
+}
+
+/*
+* The entries still pending and the ones finished most recently, oldest
+* first.
+*/
+void getJournalInfo(std::vector<JOURNALINFO> &entries) {
+    entries.clear();
+    if (gJournalLockReady != 2)
+        return;
+    EnterCriticalSection(&gJournalLock);
+    for (size_t i = 0; i < gFinished.size(); i++)
+        addInfo(entries, gFinished[i]);
+    for (size_t i = 0; i < gPending.size(); i++)
+        addInfo(entries, gPending[i]);
+    LeaveCriticalSection(&gJournalLock);
+}
@@ -0,0 +1,84 @@
+/*
+*
+*
+* The source code contained in this listing contains proprietary and
+* confidential trade secrets of The MathWorks, Inc.  The use, modification,
+* or development of derivative work based on the code or ideas obtained
+* from the code is prohibited without the express written permission of The
+* MathWorks, Inc. The disclosure of this code to any party not authorized
+* by The MathWorks, Inc. is strictly forbidden.
+* CONFIDENTIAL AND CONTAINING PROPRIETARY TRADE SECRETS
+*/
+
+#ifndef VERCTRLJOURNAL_H
+#define VERCTRLJOURNAL_H
+
+#include <windows.h>
+#include <string>
+#include <vector>
+
+#include "scc.h"
+#include "verctrlPath.h"
+
+/*
+* Write-behind journal. While it is on, CHECKIN, ADD and REMOVE are
+* appended to a journal file, flushed to disk, and returned from at once.
+* A background thread sends them on to the provider, batching entries
+* for the same project, command and comment into one call, and retrying
+* with backoff while the provider is unreachable. Entries left in the
+* journal when MATLAB exits are sent once the journal is turned on again.
+* An ADD or CHECKIN whose files change before it is sent fails with
+* SCC_E_CHECKINCONFLICT, rather than sending contents it was not given.
+* Entries for a provider that is not reentrant are only sent by
+* sendJournalOpsHere, on the thread the provider was loaded on.
+*
+* All functions are thread-safe and none of them use the MEX API.
+*/
+
+enum JournalOp {
+    JOURNAL_ADD,
+    JOURNAL_CHECKIN,
+    JOURNAL_REMOVE,
+    JOURNAL_UNCHECKOUT          // files already restored locally
+};
+
+enum JournalState {
+    JOURNAL_PENDING,
+    JOURNAL_DONE,
+    JOURNAL_FAILED
+};
+
+typedef struct JOURNALINFO {
+    ULONGLONG                   Id;
+    int                         Op;         // JournalOp
+    int                         State;      // JournalState
+    int                         Attempts;
+    SCCRTN                      Rtn;        // result of the last attempt
+    std::string                 Comment;
+    std::vector<std::string>    Files;
+} JOURNALINFO;
+
+bool startJournal(const char *fileName);
+void stopJournal();
+bool isJournaling();
+
+bool journalOperation(int op, const char *libPath, PATHID folder,
+                      const char *projName, const char *axPath,
+                      const char *comment, LONG options,
+                      int numberOfFiles, const PATHID *files);
+
+void sendJournalOpsHere();
+
+// Which of the files have entries pending, and their statuses as they
+// will be once those are flushed. Each takes the journal lock once for
+// all the files.
+void hasPendingJournalOps(int numberOfFiles, const PATHID *files, std::vector<bool> &pending);
+void applyPendingJournalOps(int numberOfFiles, const PATHID *files, LONG *status);
+
+// Wait until no entry for the files is pending. Returns false on
+// timeout, with the result of the last attempt in *rtn.
+bool waitForJournal(int numberOfFiles, const PATHID *files, DWORD timeout, SCCRTN *rtn);
+
+void getJournalInfo(std::vector<JOURNALINFO> &entries);
+
+#endif
@@ -0,0 +1,1059 @@
+/*
+*
+*
+* The source code contained in this listing contains proprietary and
+* confidential trade secrets of The MathWorks, Inc.  The use, modification,
+* or development of derivative work based on the code or ideas obtained
+* from the code is prohibited without the express written permission of The
+* MathWorks, Inc. The disclosure of this code to any party not authorized
+* by The MathWorks, Inc. is strictly forbidden.
+* CONFIDENTIAL AND CONTAINING PROPRIETARY TRADE SECRETS
+*/
+
+/*
+* SCC provider that keeps revisions on the local disk. Built as its own
+* DLL (exports in verctrlLocal.def, linked with verctrlStore.cpp and
+* verctrlHash.cpp) and selected with verctrl('SET_DLL', 'verctrlLocal.dll'),
+* or registered under SourceCodeControlProvider like any other provider.
+* verctrlLocalTest.cpp is a console program that checks the entry points
+* against a temporary project.
+*
+* A project is a folder with a store next to it, in the .verctrl folder
+* that SccGetProjPath finds above the given folder or creates in it. The
+* project name is the project folder, and the aux path is the store, so
+* several working folders can share one store by opening it with the same
+* aux path. File contents go in the object store (verctrlStore.cpp); what
+* was done to them goes in revisions.log in the store folder, one record
+* per call however many files it names:
+*
+*   "VCLOG1\0\0", then per record
+*       u32     length of the payload
+*       u32     CRC-32 of the payload
+*       u8      LOG_ADD .. LOG_RENAME
+*       u8      LOG_KEEP_CHECKEDOUT or 0, for LOG_ADD and LOG_CHECKIN
+*       varint  time, as a FILETIME
+*       string  user
+*       string  comment
+*       varint  number of files, then per file its name relative to the
+*               project folder, then the new name for LOG_RENAME or the
+*               SHA-1 of its contents for LOG_ADD and LOG_CHECKIN
+*
+* Every process using the store reads the log up to date under the store
+* lock before each call, so checkouts are seen across processes. Contexts
+* may be used from several threads, one call at a time per context.
+*/
+
+#include <windows.h>
+#include <shellapi.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <map>
+
+#include "scc.h"
+#include "verctrlHash.h"
+#include "verctrlProvider.h"
+#include "verctrlStore.h"
+
+#define LOCAL_SCC_NAME      "Local"
+#define LOCAL_AUX_LABEL     "Store"
+#define LOCAL_STORE_FOLDER  ".verctrl"
+#define LOCAL_LOG_FILE      "revisions.log"
+#define LOCAL_LOG_SIGNATURE "VCLOG1"
+#define LOCAL_LOG_HEADER    8
+#define LOCAL_COMMENT_LEN   1024
+
+enum LocalLogOp {
+    LOG_ADD,
+    LOG_CHECKIN,
+    LOG_CHECKOUT,
+    LOG_UNCHECKOUT,
+    LOG_REMOVE,
+    LOG_RENAME
+};
+
+#define LOG_KEEP_CHECKEDOUT 1
+
+typedef struct LOCALREVISION {
+    unsigned char   Id[SHA1_LEN];
+    ULONGLONG       Time;
+    std::string     User;
+    std::string     Comment;
+} LOCALREVISION;
+
+typedef struct LOCALFILE {
+    std::string                 Name;           // relative to the project folder
+    std::vector<LOCALREVISION>  Revisions;
+    std::string                 CheckedOutBy;
+    bool                        Removed;
+} LOCALFILE;
+
+// Size and time of a working file when it was last compared to its head.
+typedef struct WORKSTAT {
+    ULONGLONG       Size;
+    FILETIME        Time;
+    unsigned char   Head[SHA1_LEN];
+    bool            Modified;
+} WORKSTAT;
+
+/*
+* A store and its log, shared by all the contexts in the process that
+* have it open.
+*/
+typedef struct LOCALPROJECT {
+    std::string                         StoreDir;
+    OBJECTSTORE                        *Store;
+    HANDLE                              Log;
+    ULONGLONG                           LogEnd;
+    std::map<std::string, LOCALFILE>    Files;      // by case folded name
+    SRWLOCK                             Lock;
+    SRWLOCK                             WorkLock;
+    std::map<std::string, WORKSTAT>     Work;       // by case folded full path
+    int                                 Users;
+    struct LOCALPROJECT                *Next;
+} LOCALPROJECT;
+
+typedef struct LOCALCONTEXT {
+    char            User[SCC_USER_LEN + 1];
+    std::string     Root;           // project folder, no trailing separator
+    LOCALPROJECT   *Project;
+    LPTEXTOUTPROC   TextOut;
+} LOCALCONTEXT;
+
+// A file named in a call, resolved against the project.
+typedef struct LOCALNAME {
+    std::string     Path;           // full path
+    std::string     Name;           // relative to the project folder
+    std::string     Key;            // Name, case folded
+    LOCALFILE      *File;           // NULL if never added
+} LOCALNAME;
+
+static SRWLOCK        gProjectsLock = SRWLOCK_INIT;
+static LOCALPROJECT  *gProjects     = NULL;
+
+static std::string foldCase(const std::string &str) {
+    std::string key(str);
+    if (!key.empty())
+        CharLowerBuff(&key[0], (DWORD)key.size());
+    return key;
+}
+
+static std::string fullPath(const char *path) {
+    char full[_MAX_PATH];
+    DWORD len = GetFullPathName(path, sizeof(full), full, NULL);
+    std::string result = (len > 0 && len < sizeof(full)) ? std::string(full, len) : std::string(path);
+    while (result.size() > 3 && (result[result.size() - 1] == '\\' || result[result.size() - 1] == '/'))
+        result.erase(result.size() - 1);
+    return result;
+}
+
+// path with a trailing separator, for joining and prefix tests
+static std::string asFolder(const std::string &path) {
+    if (!path.empty() && path[path.size() - 1] == '\\')
+        return path;
+    return path + "\\";
+}
+
+static bool isAbsolutePath(const char *path) {
+    return path != NULL && ((path[0] != '\0' && path[1] == ':' && (path[2] == '\\' || path[2] == '/')) ||
+        (path[0] == '\\' && path[1] == '\\'));
+}
+
+static bool isFolder(const std::string &path) {
+    DWORD attr = GetFileAttributes(path.c_str());
+    return attr != INVALID_FILE_ATTRIBUTES && (attr & FILE_ATTRIBUTE_DIRECTORY) != 0;
+}
+
+static bool isControlled(const LOCALNAME &name) {
+    return name.File != NULL && !name.File->Removed && !name.File->Revisions.empty();
+}
+
+static const unsigned char *headOf(const LOCALFILE *file) {
+    return file->Revisions.back().Id;
+}
+
+/*
+* Log records
+*/
+static void applyRecord(LOCALPROJECT *project, RECORDREADER *rd) {
+    int op          = getByte(rd);
+    int flags       = getByte(rd);
+    LOCALREVISION rev;
+    rev.Time        = getVarint(rd);
+    rev.User        = getString(rd);
+    rev.Comment     = getString(rd);
+    ULONGLONG n     = getVarint(rd);
+    for (ULONGLONG i = 0; i < n && rd->Ok; i++) {
+        std::string name = getString(rd);
+        std::string newName;
+        if (op == LOG_RENAME) {
+            newName = getString(rd);
+        } else if (op == LOG_ADD || op == LOG_CHECKIN) {
+            if (rd->End - rd->Pos < SHA1_LEN) {
+                rd->Ok = false;
+                break;
+            }
+            memcpy(rev.Id, rd->Pos, SHA1_LEN);
+            rd->Pos += SHA1_LEN;
+        }
+        if (!rd->Ok)
+            break;
+
+        LOCALFILE &file = project->Files[foldCase(name)];
+        switch (op) {
+        case LOG_ADD:
+            file.Name       = name;
+            file.Removed    = false;
+            file.CheckedOutBy = (flags & LOG_KEEP_CHECKEDOUT) != 0 ? rev.User : std::string();
+            file.Revisions.push_back(rev);
+            break;
+        case LOG_CHECKIN:
+            // Checking in an unchanged file does not make a revision.
+            if (file.Revisions.empty() || memcmp(headOf(&file), rev.Id, SHA1_LEN) != 0)
+                file.Revisions.push_back(rev);
+            if ((flags & LOG_KEEP_CHECKEDOUT) == 0)
+                file.CheckedOutBy.clear();
+            break;
+        case LOG_CHECKOUT:
+            file.CheckedOutBy = rev.User;
+            break;
+        case LOG_UNCHECKOUT:
+            file.CheckedOutBy.clear();
+            break;
+        case LOG_REMOVE:
+            file.Removed = true;
+            file.CheckedOutBy.clear();
+            break;
+        case LOG_RENAME: {
+            LOCALFILE moved = file;
+            project->Files.erase(foldCase(name));
+            moved.Name = newName;
+            project->Files[foldCase(newName)] = moved;
+            break;
+        }
+        }
+    }
+}
+
+/*
+* Apply what other processes, or this one, appended to the log since it
+* was last read. The caller holds the project and store locks.
+*/
+static bool syncProject(LOCALPROJECT *project) {
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(project->Log, &size))
+        return false;
+    ULONGLONG end = (ULONGLONG)size.QuadPart;
+    if (end == project->LogEnd)
+        return true;
+    if (end < project->LogEnd || end - project->LogEnd > 0x7FFFFFFF)
+        return false;
+
+    std::vector<char> data((size_t)(end - project->LogEnd));
+    OVERLAPPED ov;
+    memset(&ov, 0, sizeof(ov));
+    ov.Offset       = (DWORD)project->LogEnd;
+    ov.OffsetHigh   = (DWORD)(project->LogEnd >> 32);
+    DWORD got = 0;
+    if (!ReadFile(project->Log, &data[0], (DWORD)data.size(), &got, &ov) || got != data.size())
+        return false;
+
+    size_t pos = 0;
+    while (pos + 8 <= got) {
+        unsigned int len = getU32((const unsigned char *)&data[pos]);
+        if (len > got - pos - 8 || crc32(&data[pos + 8], len) != getU32((const unsigned char *)&data[pos + 4]))
+            break;
+        RECORDREADER rd;
+        initRecordReader(&rd, &data[pos + 8], len);
+        applyRecord(project, &rd);
+        pos += 8 + len;
+    }
+    project->LogEnd += pos;
+    if (pos < got) {
+        // A writer died part way through its record.
+        LARGE_INTEGER cut;
+        cut.QuadPart = (LONGLONG)project->LogEnd;
+        SetFilePointerEx(project->Log, cut, NULL, FILE_BEGIN);
+        SetEndOfFile(project->Log);
+    }
+    return true;
+}
+
+static std::string beginRecord(int op, int flags, const char *user, LPCSTR comment) {
+    FILETIME now;
+    GetSystemTimeAsFileTime(&now);
+    std::string payload;
+    payload += (char)op;
+    payload += (char)flags;
+    putVarint(payload, ((ULONGLONG)now.dwHighDateTime << 32) | now.dwLowDateTime);
+    putString(payload, user);
+    putString(payload, comment != NULL ? comment : "");
+    return payload;
+}
+
+/*
+* Append a record to the log, make it durable, and apply it.
+*/
+static bool appendRecords(LOCALPROJECT *project, const std::string *payloads, int n) {
+    std::string frame;
+    for (int i = 0; i < n; i++) {
+        putU32(frame, (unsigned int)payloads[i].size());
+        putU32(frame, crc32(payloads[i].data(), payloads[i].size()));
+        frame += payloads[i];
+    }
+    OVERLAPPED ov;
+    memset(&ov, 0, sizeof(ov));
+    ov.Offset       = (DWORD)project->LogEnd;
+    ov.OffsetHigh   = (DWORD)(project->LogEnd >> 32);
+    DWORD put = 0;
+    if (!WriteFile(project->Log, frame.data(), (DWORD)frame.size(), &put, &ov) || put != frame.size() ||
+        !FlushFileBuffers(project->Log))
+        return false;
+    return syncProject(project);
+}
+
+static bool appendRecord(LOCALPROJECT *project, const std::string &payload) {
+    return appendRecords(project, &payload, 1);
+}
+
+/*
+* Projects
+*/
+static LOCALPROJECT *attachProject(const std::string &storeDir) {
+    std::string key = foldCase(storeDir);
+    AcquireSRWLockExclusive(&gProjectsLock);
+    LOCALPROJECT *project;
+    for (project = gProjects; project != NULL; project = project->Next) {
+        if (foldCase(project->StoreDir) == key)
+            break;
+    }
+    if (project == NULL) {
+        OBJECTSTORE *store = openObjectStore(storeDir.c_str());
+        std::string logName = asFolder(storeDir) + LOCAL_LOG_FILE;
+        HANDLE log = store == NULL ? INVALID_HANDLE_VALUE :
+            CreateFile(logName.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE,
+            NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+        char signature[LOCAL_LOG_HEADER];
+        DWORD done = 0;
+        bool ok = log != INVALID_HANDLE_VALUE && lockObjectStore(store);
+        if (ok) {
+            LARGE_INTEGER size;
+            ok = GetFileSizeEx(log, &size) != 0;
+            if (ok && size.QuadPart < LOCAL_LOG_HEADER) {
+                memset(signature, 0, sizeof(signature));
+                strcpy(signature, LOCAL_LOG_SIGNATURE);
+                ok = WriteFile(log, signature, LOCAL_LOG_HEADER, &done, NULL) && done == LOCAL_LOG_HEADER &&
+                    FlushFileBuffers(log);
+            } else if (ok) {
+                ok = ReadFile(log, signature, LOCAL_LOG_HEADER, &done, NULL) && done == LOCAL_LOG_HEADER &&
+                    memcmp(signature, LOCAL_LOG_SIGNATURE, sizeof(LOCAL_LOG_SIGNATURE)) == 0;
+            }
+        }
+        if (ok) {
+            project = new LOCALPROJECT;
+            project->StoreDir   = storeDir;
+            project->Store      = store;
+            project->Log        = log;
+            project->LogEnd     = LOCAL_LOG_HEADER;
+            project->Users      = 0;
+            InitializeSRWLock(&project->Lock);
+            InitializeSRWLock(&project->WorkLock);
+            ok = syncProject(project);
+            if (!ok)
+                delete project;
+        }
+        if (store != NULL && log != INVALID_HANDLE_VALUE)
+            unlockObjectStore(store);
+        if (ok) {
+            project->Next   = gProjects;
+            gProjects       = project;
+        } else {
+            project = NULL;
+            if (log != INVALID_HANDLE_VALUE)
+                CloseHandle(log);
+            closeObjectStore(store);
+        }
+    }
+    if (project != NULL)
+        project->Users++;
+    ReleaseSRWLockExclusive(&gProjectsLock);
+    return project;
+}
+
+static void detachProject(LOCALPROJECT *project) {
+    AcquireSRWLockExclusive(&gProjectsLock);
+    if (--project->Users == 0) {
+        for (LOCALPROJECT **p = &gProjects; *p != NULL; p = &(*p)->Next) {
+            if (*p == project) {
+                *p = project->Next;
+                break;
+            }
+        }
+        CloseHandle(project->Log);
+        closeObjectStore(project->Store);
+        delete project;
+    }
+    ReleaseSRWLockExclusive(&gProjectsLock);
+}
+
+/*
+* Lock the project for a call and bring it up to date with the log.
+*/
+static SCCRTN beginCall(LOCALCONTEXT *ctx) {
+    if (ctx->Project == NULL)
+        return SCC_E_PROJNOTOPEN;
+    AcquireSRWLockExclusive(&ctx->Project->Lock);
+    if (!lockObjectStore(ctx->Project->Store)) {
+        ReleaseSRWLockExclusive(&ctx->Project->Lock);
+        return SCC_E_ACCESSFAILURE;
+    }
+    if (!syncProject(ctx->Project)) {
+        unlockObjectStore(ctx->Project->Store);
+        ReleaseSRWLockExclusive(&ctx->Project->Lock);
+        return SCC_E_ACCESSFAILURE;
+    }
+    return SCC_OK;
+}
+
+static void endCall(LOCALCONTEXT *ctx) {
+    unlockObjectStore(ctx->Project->Store);
+    ReleaseSRWLockExclusive(&ctx->Project->Lock);
+}
+
+/*
+* Resolve the files named in a call. Fails if any is outside the project.
+*/
+static SCCRTN resolveNames(LOCALCONTEXT *ctx, LONG nFiles, LPCSTR *lpFileNames, std::vector<LOCALNAME> &names) {
+    names.resize(nFiles);
+    std::string rootKey = foldCase(asFolder(ctx->Root));
+    for (LONG i = 0; i < nFiles; i++) {
+        LOCALNAME &name = names[i];
+        name.Path = fullPath(lpFileNames[i]);
+        std::string pathKey = foldCase(name.Path);
+        if (pathKey.compare(0, rootKey.size(), rootKey) != 0 || pathKey.size() == rootKey.size())
+            return SCC_E_INVALIDFILEPATH;
+        name.Name   = name.Path.substr(rootKey.size());
+        name.Key    = pathKey.substr(rootKey.size());
+        std::map<std::string, LOCALFILE>::iterator it = ctx->Project->Files.find(name.Key);
+        name.File   = it != ctx->Project->Files.end() ? &it->second : NULL;
+    }
+    return SCC_OK;
+}
+
+static std::string fileListRecord(int op, int flags, LOCALCONTEXT *ctx, LPCSTR comment,
+                                  const std::vector<LOCALNAME> &names, const std::vector<bool> &pick) {
+    std::string payload = beginRecord(op, flags, ctx->User, comment);
+    size_t n = 0;
+    for (size_t i = 0; i < names.size(); i++)
+        n += pick[i] ? 1 : 0;
+    putVarint(payload, n);
+    for (size_t i = 0; i < names.size(); i++) {
+        if (pick[i])
+            putString(payload, names[i].Name);
+    }
+    return payload;
+}
+
+/*
+* Working files
+*/
+static bool readWorkFile(const std::string &path, std::string &data) {
+    HANDLE file = CreateFile(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+        OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+    LARGE_INTEGER size;
+    bool ok = GetFileSizeEx(file, &size) && size.QuadPart <= 0x7FFFFFFF;
+    DWORD got = 0;
+    if (ok) {
+        data.resize((size_t)size.QuadPart);
+        ok = data.empty() || (ReadFile(file, &data[0], (DWORD)data.size(), &got, NULL) && got == data.size());
+    }
+    CloseHandle(file);
+    return ok;
+}
+
+static void setReadOnly(const std::string &path, bool readOnly) {
+    DWORD attr = GetFileAttributes(path.c_str());
+    if (attr == INVALID_FILE_ATTRIBUTES)
+        return;
+    DWORD want = readOnly ? (attr | FILE_ATTRIBUTE_READONLY) : (attr & ~FILE_ATTRIBUTE_READONLY);
+    if (want != attr)
+        SetFileAttributes(path.c_str(), want);
+}
+
+/*
+* Replace a working file with a revision, through a temporary file so
+* that it is never left half written.
+*/
+static bool writeWorkFile(LOCALPROJECT *project, const std::string &path, const unsigned char id[SHA1_LEN]) {
+    std::string data;
+    if (!getObject(project->Store, id, data))
+        return false;
+    std::string temp = path + ".verctrl-tmp";
+    HANDLE file = CreateFile(temp.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+    DWORD put = 0;
+    bool ok = (data.empty() || (WriteFile(file, data.data(), (DWORD)data.size(), &put, NULL) && put == data.size())) &&
+        FlushFileBuffers(file);
+    CloseHandle(file);
+    if (ok) {
+        setReadOnly(path, false);
+        ok = MoveFileEx(temp.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+    }
+    if (!ok)
+        DeleteFile(temp.c_str());
+
+    // The new file can have the size and time last compared if the old
+    // one was written within the same tick of the file system clock.
+    AcquireSRWLockExclusive(&project->WorkLock);
+    project->Work.erase(foldCase(path));
+    ReleaseSRWLockExclusive(&project->WorkLock);
+    return ok;
+}
+
+/*
+* Does the working file differ from id? A missing working file does.
+* Files whose size and time have not changed since they were last
+* compared are not read again.
+*/
+static bool isModified(LOCALPROJECT *project, const std::string &path, const unsigned char id[SHA1_LEN]) {
+    WIN32_FILE_ATTRIBUTE_DATA info;
+    if (!GetFileAttributesEx(path.c_str(), GetFileExInfoStandard, &info))
+        return true;
+    ULONGLONG size  = ((ULONGLONG)info.nFileSizeHigh << 32) | info.nFileSizeLow;
+    std::string key = foldCase(path);
+
+    AcquireSRWLockShared(&project->WorkLock);
+    std::map<std::string, WORKSTAT>::const_iterator it = project->Work.find(key);
+    bool known = it != project->Work.end() && it->second.Size == size &&
+        CompareFileTime(&it->second.Time, &info.ftLastWriteTime) == 0 &&
+        memcmp(it->second.Head, id, SHA1_LEN) == 0;
+    bool modified = known && it->second.Modified;
+    ReleaseSRWLockShared(&project->WorkLock);
+    if (known)
+        return modified;
+
+    unsigned char work[SHA1_LEN];
+    if (!sha1File(path.c_str(), work))
+        return false;
+    WORKSTAT stat;
+    stat.Size       = size;
+    stat.Time       = info.ftLastWriteTime;
+    stat.Modified   = memcmp(work, id, SHA1_LEN) != 0;
+    memcpy(stat.Head, id, SHA1_LEN);
+    AcquireSRWLockExclusive(&project->WorkLock);
+    project->Work[key] = stat;
+    ReleaseSRWLockExclusive(&project->WorkLock);
+    return stat.Modified;
+}
+
+/*
+* Show a report through the caller's text output callback, or in a
+* temporary text file.
+*/
+static void showReport(LOCALCONTEXT *ctx, HWND hWnd, const std::string &text) {
+    if (ctx->TextOut != NULL) {
+        ctx->TextOut(text.c_str(), SCC_MSG_INFO);
+        return;
+    }
+    if (hWnd == NULL)
+        return;
+    char tempDir[_MAX_PATH];
+    char tempName[_MAX_PATH];
+    if (GetTempPath(sizeof(tempDir), tempDir) == 0 || GetTempFileName(tempDir, "vcl", 0, tempName) == 0)
+        return;
+    std::string reportName = std::string(tempName) + ".txt";
+    MoveFileEx(tempName, reportName.c_str(), MOVEFILE_REPLACE_EXISTING);
+    FILE *report = fopen(reportName.c_str(), "w");
+    if (report == NULL)
+        return;
+    fputs(text.c_str(), report);
+    fclose(report);
+    ShellExecute(hWnd, "open", reportName.c_str(), NULL, NULL, SW_SHOWNORMAL);
+}
+
+static std::string formatTime(ULONGLONG time) {
+    FILETIME utc, local;
+    SYSTEMTIME st;
+    utc.dwLowDateTime   = (DWORD)time;
+    utc.dwHighDateTime  = (DWORD)(time >> 32);
+    char buf[64];
+    if (!FileTimeToLocalFileTime(&utc, &local) || !FileTimeToSystemTime(&local, &st))
+        return std::string();
+    _snprintf(buf, sizeof(buf), "%04d-%02d-%02d %02d:%02d:%02d",
+        st.wYear, st.wMonth, st.wDay, st.wHour, st.wMinute, st.wSecond);
+    return buf;
+}
+
+/*
+* Exported entry points. The names must match those looked up by verctrl.
+*/
+extern "C" {
+
+SCCRTN SccInitialize(LPVOID *ppContext, HWND hWnd, LPCSTR lpCallerName, LPSTR lpSccName,
+                     LPLONG lpSccCaps, LPSTR lpAuxPathLabel, LPLONG pnCheckoutCommentLen,
+                     LPLONG pnCommentLen) {
+    LOCALCONTEXT *ctx = new LOCALCONTEXT;
+    ctx->User[0]    = '\0';
+    ctx->Project    = NULL;
+    ctx->TextOut    = NULL;
+    *ppContext      = ctx;
+
+    strcpy(lpSccName, LOCAL_SCC_NAME);
+    strcpy(lpAuxPathLabel, LOCAL_AUX_LABEL);
+    *lpSccCaps = SCC_CAP_REMOVE | SCC_CAP_RENAME | SCC_CAP_DIFF | SCC_CAP_HISTORY |
+        SCC_CAP_PROPERTIES | SCC_CAP_QUERYINFO | SCC_CAP_GETPROJPATH | SCC_CAP_COMMENTCHECKOUT |
+        SCC_CAP_COMMENTCHECKIN | SCC_CAP_COMMENTADD | SCC_CAP_COMMENTREMOVE | SCC_CAP_TEXTOUT |
+        SCC_CAP_REENTRANT;
+    *pnCheckoutCommentLen   = LOCAL_COMMENT_LEN;
+    *pnCommentLen           = LOCAL_COMMENT_LEN;
+    return SCC_OK;
+}
+
+SCCRTN SccCloseProject(LPVOID pContext);
+
+SCCRTN SccUninitialize(LPVOID pContext) {
+    SccCloseProject(pContext);
+    delete (LOCALCONTEXT *) pContext;
+    return SCC_OK;
+}
+
+SCCRTN SccOpenProject(LPVOID pvContext, HWND hWnd, LPSTR lpUser, LPSTR lpProjName,
+                      LPCSTR lpLocalProjPath, LPSTR lpAuxProjPath, LPCSTR lpComment,
+                      LPTEXTOUTPROC lpTextOutProc, LONG dwFlags) {
+    LOCALCONTEXT *ctx = (LOCALCONTEXT *) pvContext;
+    if (ctx->Project != NULL)
+        return SCC_E_PROJECTALREADYOPEN;
+
+    if (lpUser != NULL && lpUser[0] != '\0') {
+        strncpy(ctx->User, lpUser, SCC_USER_LEN);
+        ctx->User[SCC_USER_LEN] = '\0';
+    } else {
+        DWORD len = sizeof(ctx->User);
+        if (!GetUserName(ctx->User, &len))
+            strcpy(ctx->User, "unknown");
+        if (lpUser != NULL)
+            strcpy(lpUser, ctx->User);
+    }
+
+    // Names from SccGetProjPath are absolute; anything else means the
+    // defaults for the local folder.
+    ctx->Root = fullPath(isAbsolutePath(lpProjName) && isFolder(lpProjName) ? lpProjName : lpLocalProjPath);
+    std::string storeDir = isAbsolutePath(lpAuxProjPath) ? fullPath(lpAuxProjPath) :
+        asFolder(ctx->Root) + LOCAL_STORE_FOLDER;
+    bool exists = isFolder(storeDir);
+    if (!exists && (dwFlags & SCC_OP_CREATEIFNEW) == 0)
+        return SCC_E_UNKNOWNPROJECT;
+    ctx->Project = attachProject(storeDir);
+    if (ctx->Project == NULL)
+        return exists ? SCC_E_ACCESSFAILURE : SCC_E_COULDNOTCREATEPROJECT;
+    ctx->TextOut = lpTextOutProc;
+    return exists ? SCC_OK : SCC_I_PROJECTCREATED;
+}
+
+SCCRTN SccGetProjPath(LPVOID pvContext, HWND hWnd, LPSTR lpUser, LPSTR lpProjName,
+                      LPSTR lpLocalPath, LPSTR lpAuxProjPath, BOOL bAllowChangePath,
+                      BOOL *pbNew) {
+    // The project is the closest folder at or above the local one that
+    // has a store, or the local folder itself if none does.
+    std::string local   = fullPath(lpLocalPath);
+    std::string root    = local;
+    while (!isFolder(asFolder(root) + LOCAL_STORE_FOLDER)) {
+        size_t cut = root.find_last_of('\\');
+        if (cut == std::string::npos || cut < 2 || root.size() <= 3) {
+            root.clear();
+            break;
+        }
+        root.erase(cut < 3 && root[1] == ':' ? 3 : cut);
+    }
+    *pbNew = root.empty();
+    if (root.empty())
+        root = local;
+    std::string storeDir = asFolder(root) + LOCAL_STORE_FOLDER;
+    if (root.size() > SCC_PRJPATH_LEN || storeDir.size() > SCC_PRJPATH_LEN)
+        return SCC_E_INVALIDFILEPATH;
+    if (*pbNew && !CreateDirectory(storeDir.c_str(), NULL))
+        return SCC_E_COULDNOTCREATEPROJECT;
+    if (*pbNew)
+        SetFileAttributes(storeDir.c_str(), FILE_ATTRIBUTE_HIDDEN);
+    strcpy(lpProjName, root.c_str());
+    strcpy(lpAuxProjPath, storeDir.c_str());
+    return SCC_OK;
+}
+
+SCCRTN SccCloseProject(LPVOID pContext) {
+    LOCALCONTEXT *ctx = (LOCALCONTEXT *) pContext;
+    if (ctx->Project == NULL)
+        return SCC_E_PROJNOTOPEN;
+    detachProject(ctx->Project);
+    ctx->Project    = NULL;
+    ctx->TextOut    = NULL;
+    return SCC_OK;
+}
+
+SCCRTN SccAdd(LPVOID pContext, HWND hWnd, LONG nFiles, LPCSTR *lpFileNames,
+              LPCSTR lpComment, LONG *pdwFlags, LPCMDOPTS pvOptions) {
+    LOCALCONTEXT *ctx = (LOCALCONTEXT *) pContext;
+    SCCRTN rtn = beginCall(ctx);
+    if (!IS_SCC_SUCCESS(rtn))
+        return rtn;
+    std::vector<LOCALNAME> names;
+    rtn = resolveNames(ctx, nFiles, lpFileNames, names);
+    for (LONG i = 0; i < nFiles && IS_SCC_SUCCESS(rtn); i++) {
+        if (isControlled(names[i]))
+            rtn = SCC_E_FILEALREADYEXISTS;
+    }
+
+    // Store every file, then make the objects and the log records durable
+    // once for the whole call. Files added with SCC_KEEP_CHECKEDOUT go in
+    // a second record that leaves them checked out.
+    std::vector<bool> keep(nFiles, false);
+    LONG kept = 0;
+    for (LONG i = 0; i < nFiles; i++) {
+        keep[i] = pdwFlags != NULL && (pdwFlags[i] & SCC_KEEP_CHECKEDOUT) != 0;
+        kept   += keep[i] ? 1 : 0;
+    }
+    std::string payloads[2];
+    payloads[0] = beginRecord(LOG_ADD, 0, ctx->User, lpComment);
+    payloads[1] = beginRecord(LOG_ADD, LOG_KEEP_CHECKEDOUT, ctx->User, lpComment);
+    putVarint(payloads[0], nFiles - kept);
+    putVarint(payloads[1], kept);
+    for (LONG i = 0; i < nFiles && IS_SCC_SUCCESS(rtn); i++) {
+        std::string data;
+        unsigned char id[SHA1_LEN];
+        const unsigned char *base = names[i].File != NULL && !names[i].File->Revisions.empty() ?
+            headOf(names[i].File) : NULL;
+        if (!readWorkFile(names[i].Path, data))
+            rtn = SCC_E_FILENOTEXIST;
+        else if (!putObject(ctx->Project->Store, data, base, id))
+            rtn = SCC_E_ACCESSFAILURE;
+        putString(payloads[keep[i]], names[i].Name);
+        payloads[keep[i]].append((const char *)id, SHA1_LEN);
+    }
+    int first = kept == nFiles ? 1 : 0;
+    int count = kept == 0 || kept == nFiles ? 1 : 2;
+    if (IS_SCC_SUCCESS(rtn) &&
+        (!flushObjectStore(ctx->Project->Store) || !appendRecords(ctx->Project, payloads + first, count)))
+        rtn = SCC_E_ACCESSFAILURE;
+    if (IS_SCC_SUCCESS(rtn)) {
+        for (LONG i = 0; i < nFiles; i++)
+            setReadOnly(names[i].Path, !keep[i]);
+    }
+    endCall(ctx);
+    return rtn;
+}
+
+SCCRTN SccCheckout(LPVOID pvContext, HWND hWnd, LONG nFiles, LPCSTR *lpFileNames,
+                   LPCSTR lpComment, LONG fOptions, LPCMDOPTS pvOptions) {
+    LOCALCONTEXT *ctx = (LOCALCONTEXT *) pvContext;
+    SCCRTN rtn = beginCall(ctx);
+    if (!IS_SCC_SUCCESS(rtn))
+        return rtn;
+    std::vector<LOCALNAME> names;
+    std::vector<bool> pick(nFiles, false);
+    bool picked = false;
+    rtn = resolveNames(ctx, nFiles, lpFileNames, names);
+    for (LONG i = 0; i < nFiles && IS_SCC_SUCCESS(rtn); i++) {
+        if (!isControlled(names[i]))
+            rtn = SCC_E_FILENOTCONTROLLED;
+        else if (names[i].File->CheckedOutBy.empty())
+            pick[i] = picked = true;
+        else if (names[i].File->CheckedOutBy != ctx->User)
+            rtn = SCC_E_FILEOUTEXCLUSIVE;
+    }
+    // Restore missing working files before recording the checkout, so a
+    // failed write leaves nothing checked out.
+    for (LONG i = 0; i < nFiles && IS_SCC_SUCCESS(rtn); i++) {
+        if (GetFileAttributes(names[i].Path.c_str()) == INVALID_FILE_ATTRIBUTES &&
+            !writeWorkFile(ctx->Project, names[i].Path, headOf(names[i].File)))
+            rtn = SCC_E_ACCESSFAILURE;
+    }
+    // Files already checked out by the caller need no new record.
+    if (IS_SCC_SUCCESS(rtn) && picked &&
+        !appendRecord(ctx->Project, fileListRecord(LOG_CHECKOUT, 0, ctx, lpComment, names, pick)))
+        rtn = SCC_E_ACCESSFAILURE;
+    for (LONG i = 0; i < nFiles && IS_SCC_SUCCESS(rtn); i++)
+        setReadOnly(names[i].Path, false);
+    endCall(ctx);
+    return rtn;
+}
+
+SCCRTN SccCheckin(LPVOID pContext, HWND hWnd, LONG nFiles, LPCSTR *lpFileNames,
+                  LPCSTR lpComment, LONG fOptions, LPCMDOPTS pvOptions) {
+    LOCALCONTEXT *ctx = (LOCALCONTEXT *) pContext;
+    SCCRTN rtn = beginCall(ctx);
+    if (!IS_SCC_SUCCESS(rtn))
+        return rtn;
+    std::vector<LOCALNAME> names;
+    rtn = resolveNames(ctx, nFiles, lpFileNames, names);
+    for (LONG i = 0; i < nFiles && IS_SCC_SUCCESS(rtn); i++) {
+        if (!isControlled(names[i]))
+            rtn = SCC_E_FILENOTCONTROLLED;
+        else if (names[i].File->CheckedOutBy != ctx->User)
+            rtn = SCC_E_NOTCHECKEDOUT;
+    }
+
+    bool keep = (fOptions & SCC_KEEP_CHECKEDOUT) != 0;
+    std::string payload = beginRecord(LOG_CHECKIN, keep ? LOG_KEEP_CHECKEDOUT : 0, ctx->User, lpComment);
+    putVarint(payload, nFiles);
+    for (LONG i = 0; i < nFiles && IS_SCC_SUCCESS(rtn); i++) {
+        std::string data;
+        unsigned char id[SHA1_LEN];
+        if (!readWorkFile(names[i].Path, data))
+            rtn = SCC_E_FILENOTEXIST;
+        else if (!putObject(ctx->Project->Store, data, headOf(names[i].File), id))
+            rtn = SCC_E_ACCESSFAILURE;
+        putString(payload, names[i].Name);
+        payload.append((const char *)id, SHA1_LEN);
+    }
+    if (IS_SCC_SUCCESS(rtn) &&
+        (!flushObjectStore(ctx->Project->Store) || !appendRecord(ctx->Project, payload)))
+        rtn = SCC_E_ACCESSFAILURE;
+    if (IS_SCC_SUCCESS(rtn) && !keep) {
+        for (LONG i = 0; i < nFiles; i++)
+            setReadOnly(names[i].Path, true);
+    }
+    endCall(ctx);
+    return rtn;
+}
+
+SCCRTN SccUncheckout(LPVOID pContext, HWND hWnd, LONG nFiles, LPCSTR *lpFileNames,
+                     LONG fOptions, LPCMDOPTS pvOptions) {
+    LOCALCONTEXT *ctx = (LOCALCONTEXT *) pContext;
+    SCCRTN rtn = beginCall(ctx);
+    if (!IS_SCC_SUCCESS(rtn))
+        return rtn;
+    std::vector<LOCALNAME> names;
+    std::vector<bool> pick(nFiles, true);
+    rtn = resolveNames(ctx, nFiles, lpFileNames, names);
+    for (LONG i = 0; i < nFiles && IS_SCC_SUCCESS(rtn); i++) {
+        if (!isControlled(names[i]))
+            rtn = SCC_E_FILENOTCONTROLLED;
+        else if (names[i].File->CheckedOutBy != ctx->User)
+            rtn = SCC_E_NOTCHECKEDOUT;
+    }
+    for (LONG i = 0; i < nFiles && IS_SCC_SUCCESS(rtn); i++) {
+        if (!writeWorkFile(ctx->Project, names[i].Path, headOf(names[i].File)))
+            rtn = SCC_E_ACCESSFAILURE;
+        else
+            setReadOnly(names[i].Path, true);
+    }
+    if (IS_SCC_SUCCESS(rtn) &&
+        !appendRecord(ctx->Project, fileListRecord(LOG_UNCHECKOUT, 0, ctx, NULL, names, pick)))
+        rtn = SCC_E_ACCESSFAILURE;
+    endCall(ctx);
+    return rtn;
+}
+
+SCCRTN SccGet(LPVOID pvContext, HWND hWnd, LONG nFiles, LPCSTR *lpFileNames,
+              LONG fOptions, LPCMDOPTS pvOptions) {
+    LOCALCONTEXT *ctx = (LOCALCONTEXT *) pvContext;
+    SCCRTN rtn = beginCall(ctx);
+    if (!IS_SCC_SUCCESS(rtn))
+        return rtn;
+    std::vector<LOCALNAME> names;
+    rtn = resolveNames(ctx, nFiles, lpFileNames, names);
+    for (LONG i = 0; i < nFiles && IS_SCC_SUCCESS(rtn); i++) {
+        if (!isControlled(names[i]))
+            rtn = SCC_E_FILENOTCONTROLLED;
+    }
+    // Leave the caller's own checkouts alone.
+    for (LONG i = 0; i < nFiles && IS_SCC_SUCCESS(rtn); i++) {
+        if (names[i].File->CheckedOutBy == ctx->User)
+            continue;
+        if (isModified(ctx->Project, names[i].Path, headOf(names[i].File))) {
+            if (!writeWorkFile(ctx->Project, names[i].Path, headOf(names[i].File)))
+                rtn = SCC_E_ACCESSFAILURE;
+        }
+        setReadOnly(names[i].Path, true);
+    }
+    endCall(ctx);
+    return rtn;
+}
+
+SCCRTN SccRemove(LPVOID pContext, HWND hWnd, LONG nFiles, LPCSTR *lpFileNames,
+                 LPCSTR lpComment, LONG dwFlags, LPCMDOPTS pvOptions) {
+    LOCALCONTEXT *ctx = (LOCALCONTEXT *) pContext;
+    SCCRTN rtn = beginCall(ctx);
+    if (!IS_SCC_SUCCESS(rtn))
+        return rtn;
+    std::vector<LOCALNAME> names;
+    std::vector<bool> pick(nFiles, true);
+    rtn = resolveNames(ctx, nFiles, lpFileNames, names);
+    for (LONG i = 0; i < nFiles && IS_SCC_SUCCESS(rtn); i++) {
+        if (!isControlled(names[i]))
+            rtn = SCC_E_FILENOTCONTROLLED;
+        else if (!names[i].File->CheckedOutBy.empty() && names[i].File->CheckedOutBy != ctx->User)
+            rtn = SCC_E_FILEOUTEXCLUSIVE;
+    }
+    if (IS_SCC_SUCCESS(rtn) &&
+        !appendRecord(ctx->Project, fileListRecord(LOG_REMOVE, 0, ctx, lpComment, names, pick)))
+        rtn = SCC_E_ACCESSFAILURE;
+    if (IS_SCC_SUCCESS(rtn)) {
+        for (LONG i = 0; i < nFiles; i++)
+            setReadOnly(names[i].Path, false);
+    }
+    endCall(ctx);
+    return rtn;
+}
+
+SCCRTN SccRename(LPVOID pContext, HWND hWnd, LPCSTR lpFileName, LPCSTR lpNewName) {
+    LOCALCONTEXT *ctx = (LOCALCONTEXT *) pContext;
+    SCCRTN rtn = beginCall(ctx);
+    if (!IS_SCC_SUCCESS(rtn))
+        return rtn;
+    LPCSTR both[2] = {lpFileName, lpNewName};
+    std::vector<LOCALNAME> names;
+    rtn = resolveNames(ctx, 2, both, names);
+    if (IS_SCC_SUCCESS(rtn) && !isControlled(names[0]))
+        rtn = SCC_E_FILENOTCONTROLLED;
+    else if (IS_SCC_SUCCESS(rtn) && names[0].Key != names[1].Key && names[1].File != NULL)
+        rtn = SCC_E_FILEALREADYEXISTS;
+    if (IS_SCC_SUCCESS(rtn)) {
+        std::string payload = beginRecord(LOG_RENAME, 0, ctx->User, NULL);
+        putVarint(payload, 1);
+        putString(payload, names[0].Name);
+        putString(payload, names[1].Name);
+        if (!appendRecord(ctx->Project, payload))
+            rtn = SCC_E_ACCESSFAILURE;
+    }
+    endCall(ctx);
+    return rtn;
+}
+
+/*
+* All diffs are content comparisons; there is no visual diff.
+*/
+SCCRTN SccDiff(LPVOID pContext, HWND hWnd, LPCSTR lpFileName, LONG fOptions,
+               LPCMDOPTS pvOptions) {
+    LOCALCONTEXT *ctx = (LOCALCONTEXT *) pContext;
+    SCCRTN rtn = beginCall(ctx);
+    if (!IS_SCC_SUCCESS(rtn))
+        return rtn;
+    std::vector<LOCALNAME> names;
+    rtn = resolveNames(ctx, 1, &lpFileName, names);
+    if (IS_SCC_SUCCESS(rtn) && !isControlled(names[0]))
+        rtn = SCC_E_FILENOTCONTROLLED;
+    else if (IS_SCC_SUCCESS(rtn) && GetFileAttributes(names[0].Path.c_str()) == INVALID_FILE_ATTRIBUTES)
+        rtn = SCC_E_FILENOTEXIST;
+    else if (IS_SCC_SUCCESS(rtn) && isModified(ctx->Project, names[0].Path, headOf(names[0].File)))
+        rtn = SCC_I_FILEDIFFERS;
+    endCall(ctx);
+    return rtn;
+}
+
+SCCRTN SccHistory(LPVOID pContext, HWND hWnd, LONG nFiles, LPCSTR *lpFileNames,
+                  LONG fOptions, LPCMDOPTS pvOptions) {
+    LOCALCONTEXT *ctx = (LOCALCONTEXT *) pContext;
+    SCCRTN rtn = beginCall(ctx);
+    if (!IS_SCC_SUCCESS(rtn))
+        return rtn;
+    std::vector<LOCALNAME> names;
+    std::string text;
+    rtn = resolveNames(ctx, nFiles, lpFileNames, names);
+    for (LONG i = 0; i < nFiles && IS_SCC_SUCCESS(rtn); i++) {
+        if (names[i].File == NULL || names[i].File->Revisions.empty()) {
+            rtn = SCC_E_FILENOTCONTROLLED;
+            break;
+        }
+        const LOCALFILE *file = names[i].File;
+        text += file->Name + (file->Removed ? " (removed)\r\n" : "\r\n");
+        for (size_t r = file->Revisions.size(); r-- > 0; ) {
+            const LOCALREVISION &rev = file->Revisions[r];
+            char line[64];
+            _snprintf(line, sizeof(line), "  %d  ", (int)(r + 1));
+            text += line + formatTime(rev.Time) + "  " + rev.User + "\r\n";
+            if (!rev.Comment.empty())
+                text += "      " + rev.Comment + "\r\n";
+        }
+        text += "\r\n";
+    }
+    endCall(ctx);
+    if (IS_SCC_SUCCESS(rtn))
+        showReport(ctx, hWnd, text);
+    return rtn;
+}
+
+SCCRTN SccProperties(LPVOID pContext, HWND hWnd, LPCSTR lpFileName) {
+    LOCALCONTEXT *ctx = (LOCALCONTEXT *) pContext;
+    SCCRTN rtn = beginCall(ctx);
+    if (!IS_SCC_SUCCESS(rtn))
+        return rtn;
+    std::vector<LOCALNAME> names;
+    std::string text;
+    rtn = resolveNames(ctx, 1, &lpFileName, names);
+    if (IS_SCC_SUCCESS(rtn) && !isControlled(names[0]))
+        rtn = SCC_E_FILENOTCONTROLLED;
+    if (IS_SCC_SUCCESS(rtn)) {
+        const LOCALFILE *file = names[0].File;
+        std::string head;
+        char revisions[32];
+        sha1ToHex(headOf(file), head);
+        _snprintf(revisions, sizeof(revisions), "%d", (int)file->Revisions.size());
+        text = "File:        " + file->Name + "\r\n" +
+            "Store:       " + ctx->Project->StoreDir + "\r\n" +
+            "Revisions:   " + revisions + "\r\n" +
+            "Latest:      " + head + "\r\n" +
+            "Checked in:  " + formatTime(file->Revisions.back().Time) + " by " + file->Revisions.back().User + "\r\n" +
+            "Checked out: " + (file->CheckedOutBy.empty() ? std::string("no") : "by " + file->CheckedOutBy) + "\r\n";
+    }
+    endCall(ctx);
+    if (IS_SCC_SUCCESS(rtn))
+        showReport(ctx, hWnd, text);
+    return rtn;
+}
+
+SCCRTN SccQueryInfo(LPVOID pContext, LONG nFiles, LPCSTR *lpFileNames, LPLONG lpStatus) {
+    LOCALCONTEXT *ctx = (LOCALCONTEXT *) pContext;
+    SCCRTN rtn = beginCall(ctx);
+    if (!IS_SCC_SUCCESS(rtn))
+        return rtn;
+
+    // Work out everything but local modifications under the lock, and
+    // note which files need their contents compared.
+    std::vector<std::string>    paths;
+    std::vector<LONG>           which;
+    std::vector<unsigned char>  heads;
+    std::string rootKey = foldCase(asFolder(ctx->Root));
+    for (LONG i = 0; i < nFiles; i++) {
+        std::string path    = fullPath(lpFileNames[i]);
+        std::string key     = foldCase(path);
+        lpStatus[i]         = SCC_STATUS_NOTCONTROLLED;
+        if (key.compare(0, rootKey.size(), rootKey) != 0)
+            continue;
+        std::map<std::string, LOCALFILE>::const_iterator it = ctx->Project->Files.find(key.substr(rootKey.size()));
+        if (it == ctx->Project->Files.end() || it->second.Removed || it->second.Revisions.empty())
+            continue;
+        const LOCALFILE &file = it->second;
+        lpStatus[i] = SCC_STATUS_CONTROLLED;
+        if (file.CheckedOutBy == ctx->User)
+            lpStatus[i] |= SCC_STATUS_CHECKEDOUT | SCC_STATUS_OUTBYUSER;
+        else if (!file.CheckedOutBy.empty())
+            lpStatus[i] |= SCC_STATUS_OUTOTHER;
+        paths.push_back(path);
+        which.push_back(i);
+        heads.insert(heads.end(), headOf(&file), headOf(&file) + SHA1_LEN);
+    }
+    endCall(ctx);
+
+    for (size_t f = 0; f < which.size(); f++) {
+        if (isModified(ctx->Project, paths[f], &heads[f * SHA1_LEN]))
+            lpStatus[which[f]] |= SCC_STATUS_MODIFIED;
+    }
+    return SCC_OK;
+}
+
+SCCRTN SccGetCommandOptions(LPVOID pContext, HWND hWnd, enum SCCCOMMAND nCommand,
+                            LPCMDOPTS *ppvOptions) {
+    return SCC_E_OPNOTSUPPORTED;
+}
+
+SCCRTN SccRunScc(LPVOID pContext, HWND hWnd, LONG nFiles, LPCSTR *lpFileNames) {
+    return SCC_E_OPNOTSUPPORTED;
+}
+
+} // extern "C"
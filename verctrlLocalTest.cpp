@@ -0,0 +1,347 @@
+/*
+*
+*
+* The source code contained in this listing contains proprietary and
+* confidential trade secrets of The MathWorks, Inc.  The use, modification,
+* or development of derivative work based on the code or ideas obtained
+* from the code is prohibited without the express written permission of The
+* MathWorks, Inc. The disclosure of this code to any party not authorized
+* by The MathWorks, Inc. is strictly forbidden.
+* CONFIDENTIAL AND CONTAINING PROPRIETARY TRADE SECRETS
+*/
+
+/*
+* Conformance driver for the local SCC provider. A console program that
+* loads verctrlLocal.dll, or the provider named on the command line, the
+* way verctrl does, and runs the Scc* entry points against a project in a
+* new temporary folder:
+*
+*   verctrlLocalTest [provider.dll]
+*
+* Two contexts open the project as different users, so checkouts are
+* checked from both sides. The folder is deleted afterwards. Prints each
+* failed check and exits with 1 if there were any.
+*
+* Like the provider, the driver is Win32 only: it tests the DLL verctrl
+* loads, through LoadLibrary, and the read-only attributes and file times
+* the provider relies on.
+*/
+
+#include <windows.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+
+#include "scc.h"
+#include "verctrl.h"
+#include "verctrlProvider.h"
+
+#define LOCAL_TEST_DLL  "verctrlLocal.dll"
+
+static SccInitialize_PROC       pInitialize;
+static SccUninitialize_PROC     pUninitialize;
+static SccOpenProject_PROC      pOpenProject;
+static SccGetProjPath_PROC      pGetProjPath;
+static SccCloseProject_PROC     pCloseProject;
+static SccGet_PROC              pGet;
+static SccCheckout_PROC         pCheckout;
+static SccCheckin_PROC          pCheckin;
+static SccUncheckout_PROC       pUncheckout;
+static SccAdd_PROC              pAdd;
+static SccRemove_PROC           pRemove;
+static SccRename_PROC           pRename;
+static SccDiff_PROC             pDiff;
+static SccHistory_PROC          pHistory;
+static SccQueryInfo_PROC        pQueryInfo;
+
+static int gChecks      = 0;
+static int gFailures    = 0;
+
+#define CHECK(cond) check((cond), #cond, __LINE__)
+
+static void check(bool ok, const char *what, int line) {
+    gChecks++;
+    if (!ok) {
+        gFailures++;
+        printf("verctrlLocalTest(%d): failed: %s\n", line, what);
+    }
+}
+
+static FARPROC getProc(HMODULE lib, const char *name) {
+    FARPROC proc = GetProcAddress(lib, name);
+    if (proc == NULL)
+        printf("verctrlLocalTest: %s is not exported\n", name);
+    return proc;
+}
+
+static bool loadProvider(const char *libPath) {
+    HMODULE lib = LoadLibrary(libPath);
+    if (lib == NULL) {
+        printf("verctrlLocalTest: cannot load %s (error %lu)\n", libPath, GetLastError());
+        return false;
+    }
+    pInitialize     = (SccInitialize_PROC)      getProc(lib, "SccInitialize");
+    pUninitialize   = (SccUninitialize_PROC)    getProc(lib, "SccUninitialize");
+    pOpenProject    = (SccOpenProject_PROC)     getProc(lib, "SccOpenProject");
+    pGetProjPath    = (SccGetProjPath_PROC)     getProc(lib, "SccGetProjPath");
+    pCloseProject   = (SccCloseProject_PROC)    getProc(lib, "SccCloseProject");
+    pGet            = (SccGet_PROC)             getProc(lib, "SccGet");
+    pCheckout       = (SccCheckout_PROC)        getProc(lib, "SccCheckout");
+    pCheckin        = (SccCheckin_PROC)         getProc(lib, "SccCheckin");
+    pUncheckout     = (SccUncheckout_PROC)      getProc(lib, "SccUncheckout");
+    pAdd            = (SccAdd_PROC)             getProc(lib, "SccAdd");
+    pRemove         = (SccRemove_PROC)          getProc(lib, "SccRemove");
+    pRename         = (SccRename_PROC)          getProc(lib, "SccRename");
+    pDiff           = (SccDiff_PROC)            getProc(lib, "SccDiff");
+    pHistory        = (SccHistory_PROC)         getProc(lib, "SccHistory");
+    pQueryInfo      = (SccQueryInfo_PROC)       getProc(lib, "SccQueryInfo");
+    return pInitialize != NULL && pUninitialize != NULL && pOpenProject != NULL &&
+        pGetProjPath != NULL && pCloseProject != NULL && pGet != NULL && pCheckout != NULL &&
+        pCheckin != NULL && pUncheckout != NULL && pAdd != NULL && pRemove != NULL &&
+        pRename != NULL && pDiff != NULL && pHistory != NULL && pQueryInfo != NULL;
+}
+
+/*
+* Files
+*/
+static bool writeText(const std::string &path, const char *text) {
+    SetFileAttributes(path.c_str(), FILE_ATTRIBUTE_NORMAL);
+    FILE *file = fopen(path.c_str(), "wb");
+    if (file == NULL)
+        return false;
+    bool ok = fwrite(text, 1, strlen(text), file) == strlen(text);
+    return fclose(file) == 0 && ok;
+}
+
+static std::string readText(const std::string &path) {
+    std::string text;
+    FILE *file = fopen(path.c_str(), "rb");
+    if (file == NULL)
+        return text;
+    char buf[4096];
+    size_t got;
+    while ((got = fread(buf, 1, sizeof(buf), file)) > 0)
+        text.append(buf, got);
+    fclose(file);
+    return text;
+}
+
+static bool exists(const std::string &path) {
+    return GetFileAttributes(path.c_str()) != INVALID_FILE_ATTRIBUTES;
+}
+
+static bool isReadOnly(const std::string &path) {
+    DWORD attr = GetFileAttributes(path.c_str());
+    return attr != INVALID_FILE_ATTRIBUTES && (attr & FILE_ATTRIBUTE_READONLY) != 0;
+}
+
+static void deleteTree(const std::string &folder) {
+    WIN32_FIND_DATA found;
+    HANDLE find = FindFirstFile((folder + "\\*").c_str(), &found);
+    if (find != INVALID_HANDLE_VALUE) {
+        do {
+            if (strcmp(found.cFileName, ".") == 0 || strcmp(found.cFileName, "..") == 0)
+                continue;
+            std::string path = folder + "\\" + found.cFileName;
+            SetFileAttributes(path.c_str(), FILE_ATTRIBUTE_NORMAL);
+            if (found.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+                deleteTree(path);
+            else
+                DeleteFile(path.c_str());
+        } while (FindNextFile(find, &found));
+        FindClose(find);
+    }
+    RemoveDirectory(folder.c_str());
+}
+
+/*
+* Provider calls
+*/
+static LPVOID openAs(const char *user, const std::string &root, bool *created) {
+    LPVOID context = NULL;
+    char sccName[SCC_NAME_LEN + 1];
+    char auxLabel[SCC_AUXLABEL_LEN + 1];
+    LONG caps = 0, checkoutCommentLen = 0, commentLen = 0;
+    CHECK(pInitialize(&context, NULL, "verctrlLocalTest", sccName, &caps, auxLabel,
+        &checkoutCommentLen, &commentLen) == SCC_OK);
+    CHECK((caps & SCC_CAP_QUERYINFO) != 0);
+    CHECK((caps & SCC_CAP_REENTRANT) != 0);
+    if (context == NULL)
+        return NULL;
+
+    char userName[SCC_USER_LEN + 1];
+    char projName[SCC_PRJPATH_LEN + 1];
+    char localPath[_MAX_PATH];
+    char auxPath[SCC_PRJPATH_LEN + 1];
+    BOOL isNew = FALSE;
+    strcpy(userName, user);
+    strcpy(localPath, root.c_str());
+    projName[0] = auxPath[0] = '\0';
+    CHECK(pGetProjPath(context, NULL, userName, projName, localPath, auxPath, FALSE, &isNew) == SCC_OK);
+    if (created != NULL)
+        *created = isNew != FALSE;
+    CHECK(_stricmp(projName, root.c_str()) == 0);
+    CHECK(exists(auxPath));
+
+    SCCRTN rtn = pOpenProject(context, NULL, userName, projName, root.c_str(), auxPath, "",
+        NULL, SCC_OP_CREATEIFNEW);
+    CHECK(IS_SCC_SUCCESS(rtn));
+    return context;
+}
+
+static void closeAs(LPVOID context) {
+    CHECK(pCloseProject(context) == SCC_OK);
+    CHECK(pUninitialize(context) == SCC_OK);
+}
+
+static LONG status(LPVOID context, const std::string &path) {
+    LPCSTR name = path.c_str();
+    LONG st     = -1;
+    CHECK(pQueryInfo(context, 1, &name, &st) == SCC_OK);
+    return st;
+}
+
+static bool isOut(LONG st, LONG bits) {
+    return (st & (SCC_STATUS_CHECKEDOUT | SCC_STATUS_OUTBYUSER | SCC_STATUS_OUTOTHER)) == bits;
+}
+
+static SCCRTN checkout(LPVOID context, const std::string &path) {
+    LPCSTR name = path.c_str();
+    return pCheckout(context, NULL, 1, &name, "", 0, NULL);
+}
+
+static SCCRTN checkin(LPVOID context, const std::string &path, LONG options) {
+    LPCSTR name = path.c_str();
+    return pCheckin(context, NULL, 1, &name, "", options, NULL);
+}
+
+/*
+* The checks. alice works in the folder; bob opens the same project to
+* see her checkouts from another context.
+*/
+static void runChecks(const std::string &root) {
+    std::string a = root + "\\a.m";
+    std::string b = root + "\\b.m";
+    std::string c = root + "\\c.m";
+    CHECK(writeText(a, "a = 1;\r\n"));
+    CHECK(writeText(b, "b = 1;\r\n"));
+
+    bool created = false;
+    LPVOID alice = openAs("alice", root, &created);
+    CHECK(created);
+    LPVOID bob   = openAs("bob", root, &created);
+    CHECK(!created);
+    if (alice == NULL || bob == NULL)
+        return;
+    CHECK(status(alice, a) == SCC_STATUS_NOTCONTROLLED);
+
+    // ADD, one file kept checked out.
+    LPCSTR both[2]  = {a.c_str(), b.c_str()};
+    LONG flags[2]   = {0, SCC_KEEP_CHECKEDOUT};
+    CHECK(pAdd(alice, NULL, 2, both, "first", flags, NULL) == SCC_OK);
+    CHECK(isOut(status(alice, a), 0));
+    CHECK(isReadOnly(a));
+    CHECK(isOut(status(alice, b), SCC_STATUS_CHECKEDOUT | SCC_STATUS_OUTBYUSER));
+    CHECK(!isReadOnly(b));
+    CHECK(isOut(status(bob, b), SCC_STATUS_OUTOTHER));
+    CHECK(pAdd(alice, NULL, 1, both, "again", flags, NULL) == SCC_E_FILEALREADYEXISTS);
+
+    // CHECKOUT, exclusive between users.
+    CHECK(checkout(bob, b) == SCC_E_FILEOUTEXCLUSIVE);
+    CHECK(checkout(alice, a) == SCC_OK);
+    CHECK(!isReadOnly(a));
+    CHECK(isOut(status(alice, a), SCC_STATUS_CHECKEDOUT | SCC_STATUS_OUTBYUSER));
+    CHECK(isOut(status(bob, a), SCC_STATUS_OUTOTHER));
+
+    // Local changes, then UNCHECKOUT back to the base revision.
+    CHECK(writeText(a, "a = 2;\r\n"));
+    CHECK((status(alice, a) & SCC_STATUS_MODIFIED) != 0);
+    CHECK(pDiff(alice, NULL, a.c_str(), SCC_DIFF_QUICK_DIFF, NULL) == SCC_I_FILEDIFFERS);
+    LPCSTR name = a.c_str();
+    CHECK(pUncheckout(alice, NULL, 1, &name, 0, NULL) == SCC_OK);
+    CHECK(readText(a) == "a = 1;\r\n");
+    CHECK(isReadOnly(a));
+    CHECK(isOut(status(alice, a), 0));
+    CHECK(pDiff(alice, NULL, a.c_str(), SCC_DIFF_QUICK_DIFF, NULL) == SCC_OK);
+
+    // CHECKIN of a change.
+    CHECK(checkout(alice, a) == SCC_OK);
+    CHECK(writeText(a, "a = 3;\r\n"));
+    CHECK(checkin(alice, a, 0) == SCC_OK);
+    CHECK(isReadOnly(a));
+    LONG st = status(alice, a);
+    CHECK(isOut(st, 0) && (st & SCC_STATUS_MODIFIED) == 0);
+    CHECK(isOut(status(bob, a), 0));
+    CHECK(checkin(alice, a, 0) == SCC_E_NOTCHECKEDOUT);
+
+    // GET and CHECKOUT restore a missing working file.
+    SetFileAttributes(a.c_str(), FILE_ATTRIBUTE_NORMAL);
+    CHECK(DeleteFile(a.c_str()) != 0);
+    CHECK((status(alice, a) & SCC_STATUS_MODIFIED) != 0);
+    CHECK(pGet(alice, NULL, 1, &name, 0, NULL) == SCC_OK);
+    CHECK(readText(a) == "a = 3;\r\n");
+    SetFileAttributes(a.c_str(), FILE_ATTRIBUTE_NORMAL);
+    CHECK(DeleteFile(a.c_str()) != 0);
+    CHECK(checkout(alice, a) == SCC_OK);
+    CHECK(readText(a) == "a = 3;\r\n");
+    CHECK(!isReadOnly(a));
+    CHECK(checkout(alice, a) == SCC_OK);
+    CHECK(isOut(status(alice, a), SCC_STATUS_CHECKEDOUT | SCC_STATUS_OUTBYUSER));
+    CHECK(pUncheckout(alice, NULL, 1, &name, 0, NULL) == SCC_OK);
+
+    // CHECKIN keeping the file checked out.
+    CHECK(writeText(b, "b = 2;\r\n"));
+    CHECK(checkin(alice, b, SCC_KEEP_CHECKEDOUT) == SCC_OK);
+    CHECK(isOut(status(alice, b), SCC_STATUS_CHECKEDOUT | SCC_STATUS_OUTBYUSER));
+    CHECK(!isReadOnly(b));
+    CHECK(checkin(alice, b, 0) == SCC_OK);
+    CHECK(isOut(status(bob, b), 0));
+
+    // RENAME and REMOVE.
+    CHECK(MoveFile(b.c_str(), c.c_str()) != 0);
+    CHECK(pRename(alice, NULL, b.c_str(), c.c_str()) == SCC_OK);
+    CHECK(status(alice, b) == SCC_STATUS_NOTCONTROLLED);
+    CHECK((status(bob, c) & SCC_STATUS_CONTROLLED) != 0);
+    CHECK(pRemove(alice, NULL, 1, &name, "", 0, NULL) == SCC_OK);
+    CHECK(status(bob, a) == SCC_STATUS_NOTCONTROLLED);
+    CHECK(checkout(alice, a) == SCC_E_FILENOTCONTROLLED);
+
+    name = c.c_str();
+    CHECK(pHistory(alice, NULL, 1, &name, 0, NULL) == SCC_OK);
+    closeAs(bob);
+    closeAs(alice);
+
+    // A new context reads the same state back from the log.
+    LPVOID again = openAs("carol", root, &created);
+    if (again == NULL)
+        return;
+    CHECK(!created);
+    CHECK(status(again, a) == SCC_STATUS_NOTCONTROLLED);
+    CHECK(isOut(status(again, c), 0));
+    CHECK(readText(c) == "b = 2;\r\n");
+    closeAs(again);
+}
+
+int main(int argc, char *argv[]) {
+    if (!loadProvider(argc > 1 ? argv[1] : LOCAL_TEST_DLL))
+        return 1;
+
+    char tempDir[_MAX_PATH];
+    char root[_MAX_PATH];
+    if (GetTempPath(sizeof(tempDir), tempDir) == 0) {
+        printf("verctrlLocalTest: no temporary folder\n");
+        return 1;
+    }
+    _snprintf(root, sizeof(root), "%svctest-%lu-%lu", tempDir, GetCurrentProcessId(), GetTickCount());
+    root[sizeof(root) - 1] = '\0';
+    if (!CreateDirectory(root, NULL)) {
+        printf("verctrlLocalTest: cannot create %s\n", root);
+        return 1;
+    }
+
+    runChecks(root);
+    deleteTree(root);
+
+    printf("verctrlLocalTest: %d checks, %d failed\n", gChecks, gFailures);
+    return gFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,648 @@
+/*
+*
+*
+* The source code contained in this listing contains proprietary and
+* confidential trade secrets of The MathWorks, Inc.  The use, modification,
+* or development of derivative work based on the code or ideas obtained
+* from the code is prohibited without the express written permission of The
+* MathWorks, Inc. The disclosure of this code to any party not authorized
+* by The MathWorks, Inc. is strictly forbidden.
+* CONFIDENTIAL AND CONTAINING PROPRIETARY TRADE SECRETS
+*/
+
+/*
+* Snapshots share the folders they have in common: each folder is kept
+* once by its tree hash, with the tree hashes of its subfolders, and a
+* snapshot is the tree hash of the root. Taking one stores only the
+* folders along the paths to what changed since the last, and a folder
+* is forgotten once no snapshot kept leads to it.
+*
+* Index file, %LOCALAPPDATA%\verctrl\merkle-<crc of root>.idx, one record
+* per line:
+*
+*   verctrl-merkle 2
+*   root <path>
+*   next <next snapshot id>
+*   f <size> <time> <sha1> <path>       a file
+*   n <tree hash> <files hash>          a folder, followed by its subfolders:
+*   c <tree hash> <name>
+*   s <id> <tree hash>                  a snapshot, by the tree hash of the root
+*
+* The first snapshot of a session, and stopMerkle, write all of it to a
+* temporary file and rename it over the old one. Other snapshots append
+* their new folders and their root.
+*/
+
+#include <windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <algorithm>
+
+#include "verctrlPath.h"
+#include "verctrlHash.h"
+#include "verctrlWatch.h"
+#include "verctrlMerkle.h"
+
+// Snapshots kept per tree. Older ones are forgotten.
+#define MERKLE_MAX_SNAPSHOTS    32
+
+#define MERKLE_HEADER           "verctrl-merkle 2"
+
+typedef struct MERKLEFILE {
+    ULONGLONG       Size;
+    ULONGLONG       Time;
+    unsigned char   Hash[SHA1_LEN];
+} MERKLEFILE;
+
+typedef struct MERKLEDIR {
+    std::map<std::string, MERKLEFILE>   Files;      // by name
+    std::map<std::string, PATHID>       Dirs;       // by name
+    unsigned char                       FilesHash[SHA1_LEN];
+    unsigned char                       TreeHash[SHA1_LEN];
+    bool                                Stale;      // hashes need computing
+} MERKLEDIR;
+
+// A folder as it was in one or more snapshots. Nodes are keyed by their
+// tree hash, as raw bytes.
+typedef std::pair<std::string, std::string> NODEDIR;   // name, tree hash
+
+typedef struct MERKLENODE {
+    unsigned char                       FilesHash[SHA1_LEN];
+    std::vector<NODEDIR>                Dirs;
+    int                                 Refs;       // parent nodes and snapshots
+} MERKLENODE;
+
+typedef struct MERKLEINDEX {
+    PATHID                              Root;
+    std::map<PATHID, MERKLEDIR>         Dirs;
+    std::map<std::string, MERKLENODE>   Nodes;
+    std::map<ULONGLONG, std::string>    Snapshots;  // root tree hash by id
+    ULONGLONG                           NextId;
+    bool                                Saved;      // written in full this session
+    int                                 Watch;
+
+    // Set by the watch.
+    CRITICAL_SECTION                    ChangeLock;
+    bool                                AllChanged;
+    std::set<PATHID>                    ChangedDirs;
+} MERKLEINDEX;
+
+static SRWLOCK                          gMerkleLock     = SRWLOCK_INIT;
+static std::map<PATHID, MERKLEINDEX *>  gIndexes;
+
+// Folders of version control metadata, which are not part of the tree.
+static const char *gSkippedNames[] = {".verctrl", ".git", ".svn", ".hg", NULL};
+
+static bool isSkippedName(const char *name) {
+    for (int i = 0; gSkippedNames[i] != NULL; i++) {
+        if (_stricmp(name, gSkippedNames[i]) == 0)
+            return true;
+    }
+    return false;
+}
+
+static const char *baseName(PATHID id) {
+    const char *name    = pathName(id);
+    const char *slash   = strrchr(name, '\\');
+    return slash != NULL ? slash + 1 : name;
+}
+
+static bool isSkippedPath(PATHID root, PATHID id) {
+    for (; id != NO_PATH && id != root; id = parentPathId(id)) {
+        if (isSkippedName(baseName(id)))
+            return true;
+    }
+    return false;
+}
+
+static std::string indexFileName(PATHID root) {
+    char dir[_MAX_PATH];
+    DWORD len = GetEnvironmentVariable("LOCALAPPDATA", dir, sizeof(dir));
+    if (len == 0 || len >= sizeof(dir)) {
+        len = GetTempPath(sizeof(dir), dir);
+        if (len == 0 || len >= sizeof(dir))
+            return "";
+    }
+    std::string folder = dir;
+    if (folder[folder.size() - 1] != '\\')
+        folder += '\\';
+    folder += "verctrl";
+    CreateDirectory(folder.c_str(), NULL);
+
+    std::string rootName = pathName(root);
+    for (size_t i = 0; i < rootName.size(); i++)
+        rootName[i] = (char)tolower((unsigned char)rootName[i]);
+    char name[32];
+    _snprintf(name, sizeof(name), "\\merkle-%08x.idx", crc32(rootName.data(), rootName.size()));
+    return folder + name;
+}
+
+static void merkleChanged(void *context, int numberOfChanges, const PATHID *changes) {
+    MERKLEINDEX *index = (MERKLEINDEX *) context;
+    EnterCriticalSection(&index->ChangeLock);
+    for (int i = 0; i < numberOfChanges; i++) {
+        if (changes[i] == NO_PATH)
+            index->AllChanged = true;
+        else if (!isSkippedPath(index->Root, changes[i]))
+            index->ChangedDirs.insert(parentPathId(changes[i]));
+    }
+    LeaveCriticalSection(&index->ChangeLock);
+}
+
+/*
+* Mark a folder and the folders above it as needing their hashes computed.
+*/
+static void markStale(MERKLEINDEX *index, PATHID id) {
+    for (;;) {
+        std::map<PATHID, MERKLEDIR>::iterator it = index->Dirs.find(id);
+        if (it == index->Dirs.end() || it->second.Stale)
+            return;
+        it->second.Stale = true;
+        if (id == index->Root)
+            return;
+        id = parentPathId(id);
+    }
+}
+
+static void removeTree(MERKLEINDEX *index, PATHID id) {
+    std::map<PATHID, MERKLEDIR>::iterator it = index->Dirs.find(id);
+    if (it == index->Dirs.end())
+        return;
+    std::map<std::string, PATHID> dirs;
+    dirs.swap(it->second.Dirs);
+    index->Dirs.erase(it);
+    for (std::map<std::string, PATHID>::const_iterator d = dirs.begin(); d != dirs.end(); ++d)
+        removeTree(index, d->second);
+}
+
+/*
+* Read a folder again, hashing files whose size or time changed. New
+* subfolders are read in full, and existing ones too if recurse is set.
+* Returns false if the folder cannot be read.
+*/
+static bool scanDir(MERKLEINDEX *index, PATHID id, bool recurse) {
+    std::string name;
+    longPathName(id, name);
+    WIN32_FIND_DATA data;
+    HANDLE find = FindFirstFile((name + "\\*").c_str(), &data);
+    if (find == INVALID_HANDLE_VALUE)
+        return false;
+
+    bool isNew = index->Dirs.count(id) == 0;
+    MERKLEDIR &dir = index->Dirs[id];
+    std::map<std::string, MERKLEFILE> files;
+    std::map<std::string, PATHID> dirs;
+    std::vector<PATHID> newDirs;
+    bool changed = false;
+    do {
+        if (strcmp(data.cFileName, ".") == 0 || strcmp(data.cFileName, "..") == 0)
+            continue;
+        if ((data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0) {
+            // Junctions and links may lead outside the tree, or around it.
+            if ((data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) != 0 || isSkippedName(data.cFileName))
+                continue;
+            std::map<std::string, PATHID>::const_iterator old = dir.Dirs.find(data.cFileName);
+            if (old != dir.Dirs.end()) {
+                dirs[data.cFileName] = old->second;
+            } else {
+                PATHID subdir = internPath((std::string(pathName(id)) + "\\" + data.cFileName).c_str());
+                dirs[data.cFileName] = subdir;
+                newDirs.push_back(subdir);
+                changed = true;
+            }
+            continue;
+        }
+        MERKLEFILE file;
+        file.Size = ((ULONGLONG)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+        file.Time = ((ULONGLONG)data.ftLastWriteTime.dwHighDateTime << 32) | data.ftLastWriteTime.dwLowDateTime;
+        std::map<std::string, MERKLEFILE>::const_iterator old = dir.Files.find(data.cFileName);
+        if (old != dir.Files.end() && old->second.Size == file.Size && old->second.Time == file.Time) {
+            files[data.cFileName] = old->second;
+            continue;
+        }
+        if (!sha1File((name + "\\" + data.cFileName).c_str(), file.Hash)) {
+            // Locked, perhaps. Hash it again next time.
+            memset(file.Hash, 0, sizeof(file.Hash));
+            file.Time = 0;
+        }
+        files[data.cFileName] = file;
+        changed = true;
+    } while (FindNextFile(find, &data));
+    FindClose(find);
+
+    for (std::map<std::string, PATHID>::const_iterator d = dir.Dirs.begin(); d != dir.Dirs.end(); ++d) {
+        if (dirs.count(d->first) == 0) {
+            removeTree(index, d->second);
+            changed = true;
+        }
+    }
+    for (std::map<std::string, MERKLEFILE>::const_iterator f = dir.Files.begin(); f != dir.Files.end() && !changed; ++f)
+        changed = files.count(f->first) == 0;
+    dir.Files.swap(files);
+    dir.Dirs.swap(dirs);
+    if (changed || isNew)
+        markStale(index, id);
+
+    for (size_t i = 0; i < newDirs.size(); i++) {
+        if (!scanDir(index, newDirs[i], true))
+            index->Dirs.erase(newDirs[i]);
+    }
+    if (recurse) {
+        for (std::map<std::string, PATHID>::const_iterator d = dirs.begin(); d != dirs.end(); ++d) {
+            if (std::find(newDirs.begin(), newDirs.end(), d->second) == newDirs.end())
+                scanDir(index, d->second, true);
+        }
+    }
+    return true;
+}
+
+static void computeHashes(MERKLEINDEX *index, PATHID id) {
+    MERKLEDIR &dir = index->Dirs[id];
+    if (!dir.Stale)
+        return;
+    SHA1CTX ctx;
+    sha1Init(&ctx);
+    for (std::map<std::string, MERKLEFILE>::const_iterator f = dir.Files.begin(); f != dir.Files.end(); ++f) {
+        sha1Update(&ctx, f->first.c_str(), f->first.size() + 1);
+        sha1Update(&ctx, f->second.Hash, SHA1_LEN);
+    }
+    sha1Final(&ctx, dir.FilesHash);
+
+    sha1Init(&ctx);
+    sha1Update(&ctx, dir.FilesHash, SHA1_LEN);
+    for (std::map<std::string, PATHID>::const_iterator d = dir.Dirs.begin(); d != dir.Dirs.end(); ++d) {
+        computeHashes(index, d->second);
+        sha1Update(&ctx, d->first.c_str(), d->first.size() + 1);
+        sha1Update(&ctx, index->Dirs[d->second].TreeHash, SHA1_LEN);
+    }
+    sha1Final(&ctx, dir.TreeHash);
+    dir.Stale = false;
+}
+
+/*
+* Bring the index up to date with the folders. Returns false if the root
+* cannot be read.
+*/
+static bool refreshIndex(MERKLEINDEX *index) {
+    // A watch that stopped, e.g. because the root was deleted and made
+    // again, is replaced before the tree is read, as in getIndex.
+    bool watching = isWatching(index->Watch);
+    if (!watching) {
+        if (index->Watch >= 0)
+            removeWatch(index->Watch);
+        index->Watch = addWatch(index->Root, merkleChanged, index);
+    }
+    EnterCriticalSection(&index->ChangeLock);
+    bool all = index->AllChanged || !watching;
+    std::set<PATHID> changedDirs;
+    changedDirs.swap(index->ChangedDirs);
+    index->AllChanged = false;
+    LeaveCriticalSection(&index->ChangeLock);
+
+    if (all) {
+        if (!scanDir(index, index->Root, true)) {
+            index->Dirs.clear();
+            return false;
+        }
+        // Drop folders read from disk that are no longer in the tree.
+        std::set<PATHID> reachable;
+        std::vector<PATHID> pending(1, index->Root);
+        while (!pending.empty()) {
+            PATHID id = pending.back();
+            pending.pop_back();
+            reachable.insert(id);
+            const MERKLEDIR &dir = index->Dirs[id];
+            for (std::map<std::string, PATHID>::const_iterator d = dir.Dirs.begin(); d != dir.Dirs.end(); ++d)
+                pending.push_back(d->second);
+        }
+        for (std::map<PATHID, MERKLEDIR>::iterator it = index->Dirs.begin(); it != index->Dirs.end(); ) {
+            if (reachable.count(it->first) == 0)
+                index->Dirs.erase(it++);
+            else
+                ++it;
+        }
+    } else {
+        for (std::set<PATHID>::const_iterator it = changedDirs.begin(); it != changedDirs.end(); ++it) {
+            // A folder not indexed is new or deleted, and reading the
+            // nearest one above it that is indexed finds which.
+            PATHID id = *it;
+            while (id != NO_PATH && index->Dirs.count(id) == 0 && isPathUnder(id, index->Root))
+                id = parentPathId(id);
+            if (id == NO_PATH || index->Dirs.count(id) == 0)
+                continue;
+            while (!scanDir(index, id, false) && id != index->Root) {
+                id = parentPathId(id);
+                if (index->Dirs.count(id) == 0)
+                    break;
+            }
+        }
+        if (index->Dirs.count(index->Root) == 0)
+            return false;
+    }
+    computeHashes(index, index->Root);
+    return true;
+}
+
+static void hexLine(FILE *file, const unsigned char hash[SHA1_LEN]) {
+    std::string hex;
+    sha1ToHex(hash, hex);
+    fputs(hex.c_str(), file);
+}
+
+static std::string nodeKey(const unsigned char hash[SHA1_LEN]) {
+    return std::string((const char *)hash, SHA1_LEN);
+}
+
+static void writeNode(FILE *file, const std::string &key, const MERKLENODE &node) {
+    fputs("n ", file);
+    hexLine(file, (const unsigned char *)key.data());
+    fputc(' ', file);
+    hexLine(file, node.FilesHash);
+    fputc('\n', file);
+    for (size_t c = 0; c < node.Dirs.size(); c++) {
+        fputs("c ", file);
+        hexLine(file, (const unsigned char *)node.Dirs[c].second.data());
+        fprintf(file, " %s\n", node.Dirs[c].first.c_str());
+    }
+}
+
+static void writeSnapshot(FILE *file, ULONGLONG id, const std::string &root) {
+    fprintf(file, "s %I64u ", id);
+    hexLine(file, (const unsigned char *)root.data());
+    fputc('\n', file);
+}
+
+static bool writeIndex(MERKLEINDEX *index) {
+    std::string fileName = indexFileName(index->Root);
+    if (fileName.empty())
+        return false;
+    std::string tempName = fileName + ".tmp";
+    FILE *file = fopen(tempName.c_str(), "w");
+    if (file == NULL)
+        return false;
+    fprintf(file, "%s\nroot %s\nnext %I64u\n", MERKLE_HEADER, pathName(index->Root), index->NextId);
+    for (std::map<PATHID, MERKLEDIR>::const_iterator d = index->Dirs.begin(); d != index->Dirs.end(); ++d) {
+        const char *dirName = pathName(d->first);
+        for (std::map<std::string, MERKLEFILE>::const_iterator f = d->second.Files.begin(); f != d->second.Files.end(); ++f) {
+            fprintf(file, "f %I64u %I64u ", f->second.Size, f->second.Time);
+            hexLine(file, f->second.Hash);
+            fprintf(file, " %s\\%s\n", dirName, f->first.c_str());
+        }
+    }
+    for (std::map<std::string, MERKLENODE>::const_iterator n = index->Nodes.begin(); n != index->Nodes.end(); ++n)
+        writeNode(file, n->first, n->second);
+    for (std::map<ULONGLONG, std::string>::const_iterator s = index->Snapshots.begin(); s != index->Snapshots.end(); ++s)
+        writeSnapshot(file, s->first, s->second);
+    bool ok = fflush(file) == 0 && !ferror(file);
+    fclose(file);
+    ok = ok && MoveFileEx(tempName.c_str(), fileName.c_str(), MOVEFILE_REPLACE_EXISTING);
+    if (!ok)
+        DeleteFile(tempName.c_str());
+    index->Saved = ok;
+    return ok;
+}
+
+/*
+* Save a new snapshot: in full the first time in a session, which also
+* drops what older snapshots no longer need, and by appending its new
+* nodes after that.
+*/
+static bool saveSnapshot(MERKLEINDEX *index, ULONGLONG id, const std::vector<std::string> &added) {
+    if (!index->Saved)
+        return writeIndex(index);
+    std::string fileName = indexFileName(index->Root);
+    FILE *file = fileName.empty() ? NULL : fopen(fileName.c_str(), "a");
+    if (file == NULL)
+        return false;
+    for (size_t i = 0; i < added.size(); i++)
+        writeNode(file, added[i], index->Nodes[added[i]]);
+    writeSnapshot(file, id, index->Snapshots[id]);
+    bool ok = fflush(file) == 0 && !ferror(file);
+    fclose(file);
+    // Write it all next time rather than after a partial record.
+    index->Saved = ok;
+    return ok;
+}
+
+static void addNodeRef(MERKLEINDEX *index, const std::string &key) {
+    std::map<std::string, MERKLENODE>::iterator it = index->Nodes.find(key);
+    if (it == index->Nodes.end() || it->second.Refs++ > 0)
+        return;
+    for (size_t c = 0; c < it->second.Dirs.size(); c++)
+        addNodeRef(index, it->second.Dirs[c].second);
+}
+
+static void releaseNode(MERKLEINDEX *index, const std::string &key) {
+    std::map<std::string, MERKLENODE>::iterator it = index->Nodes.find(key);
+    if (it == index->Nodes.end() || --it->second.Refs > 0)
+        return;
+    std::vector<NODEDIR> dirs;
+    dirs.swap(it->second.Dirs);
+    index->Nodes.erase(it);
+    for (size_t c = 0; c < dirs.size(); c++)
+        releaseNode(index, dirs[c].second);
+}
+
+/*
+* Read what an earlier session saved. File hashes are used again for
+* files whose size and time have not changed; folders are found by
+* reading the tree.
+*/
+static void loadIndex(MERKLEINDEX *index) {
+    std::string fileName = indexFileName(index->Root);
+    FILE *file = fileName.empty() ? NULL : fopen(fileName.c_str(), "r");
+    if (file == NULL)
+        return;
+    std::vector<char> buffer(64 * 1024);
+    char *line = &buffer[0];
+    bool ok = fgets(line, (int)buffer.size(), file) != NULL && strncmp(line, MERKLE_HEADER, strlen(MERKLE_HEADER)) == 0;
+    MERKLENODE *node    = NULL;
+    while (ok && fgets(line, (int)buffer.size(), file) != NULL) {
+        size_t len = strlen(line);
+        if (len == 0 || line[len - 1] != '\n')
+            break;
+        line[len - 1] = '\0';
+        char hash[SHA1_LEN * 2 + 1], filesHash[SHA1_LEN * 2 + 1];
+        ULONGLONG a, b;
+        int pos = 0;
+        if (strncmp(line, "root ", 5) == 0) {
+            ok = internPath(line + 5) == index->Root;
+        } else if (sscanf(line, "next %I64u", &a) == 1) {
+            index->NextId = a;
+        } else if (sscanf(line, "f %I64u %I64u %40s %n", &a, &b, hash, &pos) == 3 && pos > 0) {
+            MERKLEFILE entry;
+            entry.Size = a;
+            entry.Time = b;
+            PATHID id = internPath(line + pos);
+            if (sha1FromHex(hash, entry.Hash))
+                index->Dirs[parentPathId(id)].Files[baseName(id)] = entry;
+        } else if (sscanf(line, "n %40s %40s", hash, filesHash) == 2) {
+            unsigned char tree[SHA1_LEN];
+            ok = sha1FromHex(hash, tree);
+            if (ok) {
+                node        = &index->Nodes[nodeKey(tree)];
+                node->Refs  = 0;
+                node->Dirs.clear();
+                ok = sha1FromHex(filesHash, node->FilesHash);
+            }
+        } else if (node != NULL && sscanf(line, "c %40s %n", hash, &pos) == 1 && pos > 0) {
+            unsigned char tree[SHA1_LEN];
+            ok = sha1FromHex(hash, tree);
+            if (ok)
+                node->Dirs.push_back(NODEDIR(line + pos, nodeKey(tree)));
+        } else if (sscanf(line, "s %I64u %40s", &a, hash) == 2) {
+            unsigned char tree[SHA1_LEN];
+            ok = sha1FromHex(hash, tree);
+            if (ok) {
+                index->Snapshots[a] = nodeKey(tree);
+                if (a >= index->NextId)
+                    index->NextId   = a + 1;
+            }
+            node = NULL;
+        }
+    }
+    fclose(file);
+    if (!ok) {
+        index->Dirs.clear();
+        index->Nodes.clear();
+        index->Snapshots.clear();
+        index->NextId = 1;
+    }
+
+    // Keep the newest snapshots, and the nodes they lead to.
+    while (index->Snapshots.size() > MERKLE_MAX_SNAPSHOTS)
+        index->Snapshots.erase(index->Snapshots.begin());
+    for (std::map<ULONGLONG, std::string>::const_iterator s = index->Snapshots.begin(); s != index->Snapshots.end(); ++s)
+        addNodeRef(index, s->second);
+    for (std::map<std::string, MERKLENODE>::iterator n = index->Nodes.begin(); n != index->Nodes.end(); ) {
+        if (n->second.Refs == 0)
+            index->Nodes.erase(n++);
+        else
+            ++n;
+    }
+    for (std::map<PATHID, MERKLEDIR>::iterator d = index->Dirs.begin(); d != index->Dirs.end(); ++d)
+        d->second.Stale = true;
+}
+
+/*
+* The index of the tree at root, created and read from disk if needed.
+* Called with gMerkleLock held exclusively.
+*/
+static MERKLEINDEX *getIndex(PATHID root) {
+    std::map<PATHID, MERKLEINDEX *>::const_iterator it = gIndexes.find(root);
+    if (it != gIndexes.end())
+        return it->second;
+    MERKLEINDEX *index  = new MERKLEINDEX;
+    index->Root         = root;
+    index->NextId       = 1;
+    index->AllChanged   = true;
+    index->Saved        = false;
+    InitializeCriticalSection(&index->ChangeLock);
+    loadIndex(index);
+    // Watch before reading the tree, so no change is missed.
+    index->Watch        = addWatch(root, merkleChanged, index);
+    gIndexes[root]      = index;
+    return index;
+}
+
+/*
+* Store the nodes of folder id and below that are not stored yet, and
+* add them to added, subfolders first. Returns the key of its node.
+*/
+static std::string storeNodes(MERKLEINDEX *index, PATHID id, std::vector<std::string> &added) {
+    const MERKLEDIR &dir = index->Dirs[id];
+    std::string key = nodeKey(dir.TreeHash);
+    if (index->Nodes.count(key) != 0)
+        return key;
+    MERKLENODE node;
+    memcpy(node.FilesHash, dir.FilesHash, SHA1_LEN);
+    node.Refs = 0;
+    for (std::map<std::string, PATHID>::const_iterator d = dir.Dirs.begin(); d != dir.Dirs.end(); ++d) {
+        std::string child = storeNodes(index, d->second, added);
+        index->Nodes[child].Refs++;
+        node.Dirs.push_back(NODEDIR(d->first, child));
+    }
+    index->Nodes[key] = node;
+    added.push_back(key);
+    return key;
+}
+
+ULONGLONG merkleSnapshot(PATHID root) {
+    ULONGLONG id = 0;
+    AcquireSRWLockExclusive(&gMerkleLock);
+    MERKLEINDEX *index = getIndex(root);
+    if (refreshIndex(index)) {
+        id = index->NextId++;
+        std::vector<std::string> added;
+        std::string root = storeNodes(index, index->Root, added);
+        index->Nodes[root].Refs++;
+        index->Snapshots[id] = root;
+        while (index->Snapshots.size() > MERKLE_MAX_SNAPSHOTS) {
+            releaseNode(index, index->Snapshots.begin()->second);
+            index->Snapshots.erase(index->Snapshots.begin());
+        }
+        saveSnapshot(index, id, added);
+    }
+    ReleaseSRWLockExclusive(&gMerkleLock);
+    return id;
+}
+
+static void compareTree(MERKLEINDEX *index, PATHID id, const std::string &oldKey, std::vector<PATHID> &changed) {
+    std::map<std::string, MERKLENODE>::const_iterator old = index->Nodes.find(oldKey);
+    if (old == index->Nodes.end()) {
+        changed.push_back(id);
+        return;
+    }
+    const MERKLEDIR &dir = index->Dirs[id];
+    if (memcmp(dir.TreeHash, oldKey.data(), SHA1_LEN) == 0)
+        return;
+    if (memcmp(dir.FilesHash, old->second.FilesHash, SHA1_LEN) != 0)
+        changed.push_back(id);
+    std::map<std::string, std::string> oldDirs(old->second.Dirs.begin(), old->second.Dirs.end());
+    for (std::map<std::string, PATHID>::const_iterator d = dir.Dirs.begin(); d != dir.Dirs.end(); ++d) {
+        std::map<std::string, std::string>::iterator o = oldDirs.find(d->first);
+        if (o == oldDirs.end()) {
+            changed.push_back(d->second);
+            continue;
+        }
+        compareTree(index, d->second, o->second, changed);
+        oldDirs.erase(o);
+    }
+    for (std::map<std::string, std::string>::const_iterator o = oldDirs.begin(); o != oldDirs.end(); ++o)
+        changed.push_back(internPath((std::string(pathName(id)) + "\\" + o->first).c_str()));
+}
+
+bool merkleChangedSince(PATHID root, ULONGLONG snapshotId, std::vector<PATHID> &changed) {
+    changed.clear();
+    bool ok = false;
+    AcquireSRWLockExclusive(&gMerkleLock);
+    MERKLEINDEX *index = getIndex(root);
+    std::map<ULONGLONG, std::string>::const_iterator snapshot = index->Snapshots.find(snapshotId);
+    if (snapshot != index->Snapshots.end() && refreshIndex(index)) {
+        compareTree(index, root, snapshot->second, changed);
+        ok = true;
+    }
+    ReleaseSRWLockExclusive(&gMerkleLock);
+    return ok;
+}
+
+void stopMerkle() {
+    AcquireSRWLockExclusive(&gMerkleLock);
+    for (std::map<PATHID, MERKLEINDEX *>::iterator it = gIndexes.begin(); it != gIndexes.end(); ++it) {
+        MERKLEINDEX *index = it->second;
+        if (index->Watch >= 0)
+            removeWatch(index->Watch);
+        if (!index->Dirs.empty())
+            writeIndex(index);
+        DeleteCriticalSection(&index->ChangeLock);
+        delete index;
+    }
+    gIndexes.clear();
+    ReleaseSRWLockExclusive(&gMerkleLock);
+}
@@ -0,0 +1,46 @@
+/*
+*
+*
+* The source code contained in this listing contains proprietary and
+* confidential trade secrets of The MathWorks, Inc.  The use, modification,
+* or development of derivative work based on the code or ideas obtained
+* from the code is prohibited without the express written permission of The
+* MathWorks, Inc. The disclosure of this code to any party not authorized
+* by The MathWorks, Inc. is strictly forbidden.
+* CONFIDENTIAL AND CONTAINING PROPRIETARY TRADE SECRETS
+*/
+
+#ifndef VERCTRLMERKLE_H
+#define VERCTRLMERKLE_H
+
+#include <windows.h>
+#include <vector>
+
+#include "verctrlPath.h"
+
+/*
+* Hash trees over folders. The hash of a folder covers the names and
+* SHA-1 of its files and the names and hashes of its subfolders, so two
+* snapshots of a tree differ only along the paths to what changed.
+*
+* While a tree is indexed its folder is watched, and only folders with
+* changes reported are read again. Files whose size and time are
+* unchanged are not hashed again, also across sessions, as the index is
+* saved below %LOCALAPPDATA%.
+*
+* All functions are thread-safe and none of them use the MEX API.
+*/
+
+// Record the current state of the tree at root. Returns the id of the
+// snapshot, or 0 if root cannot be read.
+ULONGLONG merkleSnapshot(PATHID root);
+
+// Folders that changed since the snapshot: those with files added,
+// changed or deleted directly in them, and those added or deleted.
+// Returns false if the snapshot is not known or root cannot be read.
+bool merkleChangedSince(PATHID root, ULONGLONG snapshotId, std::vector<PATHID> &changed);
+
+// Save and forget every index.
+void stopMerkle();
+
+#endif
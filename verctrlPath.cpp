@@ -0,0 +1,294 @@
+/*
+*
+*
+* The source code contained in this listing contains proprietary and
+* confidential trade secrets of The MathWorks, Inc.  The use, modification,
+* or development of derivative work based on the code or ideas obtained
+* from the code is prohibited without the express written permission of The
+* MathWorks, Inc. The disclosure of this code to any party not authorized
+* by The MathWorks, Inc. is strictly forbidden.
+* CONFIDENTIAL AND CONTAINING PROPRIETARY TRADE SECRETS
+*/
+
+/*
+* Paths are kept in two open addressing hash tables: one from the case
+* folded canonical path to its id, and one from every absolute spelling
+* callers have passed in to the id it resolved to, so that a spelling
+* seen before costs one hash and one string compare. The entries
+* themselves live in fixed chunks that never move, so an id is turned
+* back into its entry without taking the lock.
+*/
+
+#include <windows.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <string>
+#include <vector>
+
+#include "verctrlPath.h"
+
+#define PATH_CHUNK_BITS     12
+#define PATH_CHUNK_SIZE     (1 << PATH_CHUNK_BITS)
+#define PATH_CHUNKS         4096                // up to 16M paths
+#define MAX_PATH_SPELLINGS  (1 << 20)
+
+typedef struct PATHENTRY {
+    std::string     Name;       // canonical spelling
+    std::string     Key;        // Name, case folded
+    unsigned int    Hash;       // of Key
+    PATHID          Parent;
+} PATHENTRY;
+
+typedef struct PATHSLOT {
+    unsigned int    Hash;
+    unsigned int    Index;      // 0: empty slot
+} PATHSLOT;
+
+static SRWLOCK                      gPathLock       = SRWLOCK_INIT;
+static PATHENTRY                  **gChunks[PATH_CHUNKS];
+static PATHID                       gNumberOfPaths  = 1;    // id 0 is NO_PATH
+static std::vector<PATHSLOT>        gByKey;                 // Index: PATHID
+static std::vector<PATHSLOT>        gBySpelling;            // Index: spelling + 1
+static std::vector<std::string>     gSpellings;
+static std::vector<PATHID>          gSpellingIds;
+
+static PATHENTRY *pathEntry(PATHID id) {
+    return gChunks[id >> PATH_CHUNK_BITS][id & (PATH_CHUNK_SIZE - 1)];
+}
+
+static unsigned int hashString(const char *s, size_t len) {
+    unsigned int h = 2166136261u;
+    for (size_t i = 0; i < len; i++)
+        h = (h ^ (unsigned char)s[i]) * 16777619u;
+    return h;
+}
+
+/*
+* Length of the root of an absolute path, "C:\" or "\\server\share",
+* or 0 if the path is relative.
+*/
+static size_t rootLength(const std::string &path) {
+    if (path.size() >= 3 && path[1] == ':' && path[2] == '\\')
+        return 3;
+    if (path.size() >= 2 && path[0] == '\\' && path[1] == '\\') {
+        size_t server = path.find('\\', 2);
+        if (server == std::string::npos)
+            return path.size();
+        size_t share = path.find('\\', server + 1);
+        return share == std::string::npos ? path.size() : share;
+    }
+    return 0;
+}
+
+/*
+* Absolute paths are normalized here without calling into the file
+* system, so there is no limit on their length. Relative ones are
+* resolved against the current directory first.
+*/
+static void canonicalPath(const char *path, std::string &canon) {
+    std::string p(path);
+    for (size_t i = 0; i < p.size(); i++) {
+        if (p[i] == '/')
+            p[i] = '\\';
+    }
+    if (p.compare(0, 8, "\\\\?\\UNC\\") == 0)
+        p.replace(0, 8, "\\\\");
+    else if (p.compare(0, 4, "\\\\?\\") == 0)
+        p.erase(0, 4);
+
+    if (rootLength(p) == 0) {
+        DWORD len = GetFullPathName(p.c_str(), 0, NULL, NULL);
+        if (len > 0) {
+            std::vector<char> full(len + 1);
+            DWORD got = GetFullPathName(p.c_str(), len + 1, &full[0], NULL);
+            if (got > 0 && got <= len)
+                p.assign(&full[0], got);
+        }
+    }
+
+    // Drop empty and "." components, and resolve "..", below the root.
+    size_t root = rootLength(p);
+    canon.assign(p, 0, root);
+    size_t i = root;
+    while (i < p.size()) {
+        size_t end = p.find('\\', i);
+        if (end == std::string::npos)
+            end = p.size();
+        size_t len = end - i;
+        if (len == 0 || (len == 1 && p[i] == '.')) {
+            // nothing to add
+        } else if (len == 2 && p[i] == '.' && p[i + 1] == '.') {
+            size_t cut = canon.find_last_of('\\');
+            canon.resize(cut == std::string::npos || cut < root ? root : cut);
+        } else {
+            if (!canon.empty() && canon[canon.size() - 1] != '\\')
+                canon += '\\';
+            canon.append(p, i, len);
+        }
+        i = end + 1;
+    }
+}
+
+static PATHID findKeyLocked(const std::string &key, unsigned int hash) {
+    if (gByKey.empty())
+        return NO_PATH;
+    size_t mask = gByKey.size() - 1;
+    for (size_t s = hash & mask; gByKey[s].Index != 0; s = (s + 1) & mask) {
+        if (gByKey[s].Hash == hash && pathEntry(gByKey[s].Index)->Key == key)
+            return gByKey[s].Index;
+    }
+    return NO_PATH;
+}
+
+static PATHID findSpellingLocked(const char *path, unsigned int hash) {
+    if (gBySpelling.empty())
+        return NO_PATH;
+    size_t mask = gBySpelling.size() - 1;
+    for (size_t s = hash & mask; gBySpelling[s].Index != 0; s = (s + 1) & mask) {
+        if (gBySpelling[s].Hash == hash && gSpellings[gBySpelling[s].Index - 1] == path)
+            return gSpellingIds[gBySpelling[s].Index - 1];
+    }
+    return NO_PATH;
+}
+
+/*
+* Add a slot to a table, doubling it first if it is half full.
+*/
+static void insertSlot(std::vector<PATHSLOT> &table, size_t count, unsigned int hash, unsigned int index) {
+    if (2 * (count + 1) > table.size()) {
+        std::vector<PATHSLOT> old;
+        old.swap(table);
+        PATHSLOT empty = {0, 0};
+        table.assign(old.empty() ? 1024 : 2 * old.size(), empty);
+        for (size_t i = 0; i < old.size(); i++) {
+            if (old[i].Index != 0)
+                insertSlot(table, 0, old[i].Hash, old[i].Index);
+        }
+    }
+    size_t mask = table.size() - 1;
+    size_t s    = hash & mask;
+    while (table[s].Index != 0)
+        s = (s + 1) & mask;
+    table[s].Hash   = hash;
+    table[s].Index  = index;
+}
+
+static PATHID internCanonicalLocked(const std::string &canon) {
+    if (canon.empty())
+        return NO_PATH;
+    std::string key(canon);
+    CharLowerBuff(&key[0], (DWORD)key.size());
+    unsigned int hash = hashString(key.c_str(), key.size());
+    PATHID id = findKeyLocked(key, hash);
+    if (id != NO_PATH)
+        return id;
+
+    PATHID parent   = NO_PATH;
+    size_t root     = rootLength(canon);
+    if (canon.size() > root) {
+        size_t cut = canon.find_last_of('\\');
+        if (cut != std::string::npos)
+            parent = internCanonicalLocked(canon.substr(0, cut < root ? root : cut));
+    }
+
+    if (gNumberOfPaths >= (PATHID)PATH_CHUNKS * PATH_CHUNK_SIZE)
+        return NO_PATH;
+    id = gNumberOfPaths;
+    PATHENTRY **chunk = gChunks[id >> PATH_CHUNK_BITS];
+    if (chunk == NULL) {
+        chunk = (PATHENTRY **) calloc(PATH_CHUNK_SIZE, sizeof(PATHENTRY *));
+        if (chunk == NULL)
+            return NO_PATH;
+        gChunks[id >> PATH_CHUNK_BITS] = chunk;
+    }
+    PATHENTRY *entry = new PATHENTRY;
+    entry->Name     = canon;
+    entry->Key      = key;
+    entry->Hash     = hash;
+    entry->Parent   = parent;
+    chunk[id & (PATH_CHUNK_SIZE - 1)] = entry;
+    insertSlot(gByKey, gNumberOfPaths - 1, hash, id);
+    gNumberOfPaths++;
+    return id;
+}
+
+/*
+* True for a spelling that names the same file whatever the current
+* folder and drive: X:\... or a UNC path. Others, e.g. foo.m, \foo.m or
+* X:foo.m, are resolved against the current folder, which MATLAB's cd
+* changes, so they are never cached.
+*/
+static bool isFixedSpelling(const char *path) {
+    if (isalpha((unsigned char)path[0]) && path[1] == ':')
+        return path[2] == '\\' || path[2] == '/';
+    return (path[0] == '\\' || path[0] == '/') && (path[1] == '\\' || path[1] == '/');
+}
+
+PATHID internPath(const char *path) {
+    if (path == NULL || path[0] == '\0')
+        return NO_PATH;
+    unsigned int hash = hashString(path, strlen(path));
+    bool fixed = isFixedSpelling(path);
+
+    PATHID id = NO_PATH;
+    if (fixed) {
+        AcquireSRWLockShared(&gPathLock);
+        id = findSpellingLocked(path, hash);
+        ReleaseSRWLockShared(&gPathLock);
+        if (id != NO_PATH)
+            return id;
+    }
+
+    std::string canon;
+    canonicalPath(path, canon);
+
+    AcquireSRWLockExclusive(&gPathLock);
+    id = internCanonicalLocked(canon);
+    if (fixed && id != NO_PATH && gSpellings.size() < MAX_PATH_SPELLINGS &&
+        findSpellingLocked(path, hash) == NO_PATH) {
+        gSpellings.push_back(path);
+        gSpellingIds.push_back(id);
+        insertSlot(gBySpelling, gSpellings.size() - 1, hash, (unsigned int)gSpellings.size());
+    }
+    ReleaseSRWLockExclusive(&gPathLock);
+    return id;
+}
+
+/*
+* The id of the folder containing fileName.
+*/
+PATHID internParentPath(const char *fileName) {
+    return parentPathId(internPath(fileName));
+}
+
+PATHID parentPathId(PATHID id) {
+    return id == NO_PATH ? NO_PATH : pathEntry(id)->Parent;
+}
+
+/*
+* True if id is folder or below it.
+*/
+bool isPathUnder(PATHID id, PATHID folder) {
+    if (folder == NO_PATH)
+        return false;
+    for (; id != NO_PATH; id = pathEntry(id)->Parent) {
+        if (id == folder)
+            return true;
+    }
+    return false;
+}
+
+const char *pathName(PATHID id) {
+    return id == NO_PATH ? "" : pathEntry(id)->Name.c_str();
+}
+
+void longPathName(PATHID id, std::string &name) {
+    name = pathName(id);
+    if (name.size() < MAX_PATH || rootLength(name) == 0)
+        return;
+    if (name[0] == '\\')
+        name.replace(0, 2, "\\\\?\\UNC\\");
+    else
+        name.insert(0, "\\\\?\\");
+}
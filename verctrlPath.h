@@ -0,0 +1,45 @@
+/*
+*
+*
+* The source code contained in this listing contains proprietary and
+* confidential trade secrets of The MathWorks, Inc.  The use, modification,
+* or development of derivative work based on the code or ideas obtained
+* from the code is prohibited without the express written permission of The
+* MathWorks, Inc. The disclosure of this code to any party not authorized
+* by The MathWorks, Inc. is strictly forbidden.
+* CONFIDENTIAL AND CONTAINING PROPRIETARY TRADE SECRETS
+*/
+
+#ifndef VERCTRLPATH_H
+#define VERCTRLPATH_H
+
+#include <string>
+
+/*
+* Interned paths. Every spelling of a path - relative or absolute, with
+* '/' or '\\', in any case, with or without a trailing separator or a
+* \\?\ prefix - maps to the same id, so callers compare and hash paths
+* as integers. Ids are never reused, and the id of a path's parent is
+* computed once when the path is interned.
+*
+* All functions are thread-safe and none of them use the MEX API.
+*/
+typedef unsigned int PATHID;
+
+#define NO_PATH 0
+
+PATHID internPath(const char *path);
+PATHID internParentPath(const char *fileName);
+PATHID parentPathId(PATHID id);
+bool isPathUnder(PATHID id, PATHID folder);
+
+// Canonical spelling: absolute, '\\' separated, no trailing separator
+// except for a drive root, and in the case first seen. "" for NO_PATH.
+// The string lives as long as the process.
+const char *pathName(PATHID id);
+
+// Spelling for Win32 file APIs, with a \\?\ prefix if it is too long
+// for MAX_PATH.
+void longPathName(PATHID id, std::string &name);
+
+#endif
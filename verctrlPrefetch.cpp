@@ -0,0 +1,430 @@
+/*
+*
+*
+* The source code contained in this listing contains proprietary and
+* confidential trade secrets of The MathWorks, Inc.  The use, modification,
+* or development of derivative work based on the code or ideas obtained
+* from the code is prohibited without the express written permission of The
+* MathWorks, Inc. The disclosure of this code to any party not authorized
+* by The MathWorks, Inc. is strictly forbidden.
+* CONFIDENTIAL AND CONTAINING PROPRIETARY TRADE SECRETS
+*/
+
+#include <windows.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <set>
+
+#include "scc.h"
+#include "verctrl.h"
+#include "verctrlRecord.h"
+#include "verctrlPath.h"
+#include "verctrlProvider.h"
+#include "verctrlCache.h"
+#include "verctrlJournal.h"
+#include "verctrlPrefetch.h"
+
+#define PREFETCH_MAX_QUEUE      64          // folders; the oldest are dropped
+#define PREFETCH_MAX_NEIGHBOURS 32          // folders queued per folder asked about
+#define PREFETCH_MAX_FILES      1024        // files queried per folder
+#define PREFETCH_MAX_BATCH      64          // files per SccQueryInfo
+#define PREFETCH_MAX_UNRESOLVED 16
+#define PREFETCH_MAX_TRACKED    65536       // prefetched files remembered for the hit rate
+
+// A folder queried this recently is not queued again.
+#define PREFETCH_RECENT_MS      30000
+
+// A folder to query, and the folder STATUS was asked about that led to it.
+typedef struct PREFETCHFOLDER {
+    PATHID          Folder;
+    PATHID          Origin;
+    std::string     LibPath;
+    bool            Mapped;
+    std::string     ProjName;       // of Origin
+    std::string     AxPath;
+} PREFETCHFOLDER;
+
+static CRITICAL_SECTION                     gPrefetchLock;
+static CONDITION_VARIABLE                   gPrefetchChanged;
+static volatile LONG                        gPrefetchLockReady  = 0;
+static HANDLE                               gPrefetchThread     = NULL;
+static bool                                 gStopPrefetch       = false;
+static bool                                 gForeground         = false;
+static std::deque<PREFETCHFOLDER>           gOrigins;       // neighbours not yet listed
+static std::deque<PREFETCHFOLDER>           gQueue;         // newest first
+static std::map<PATHID, PREFETCHFOLDER>     gUnresolved;    // waiting for getsccprj
+static std::map<PATHID, ULONGLONG>          gRecent;        // GetTickCount64 when queried
+static std::set<PATHID>                     gPrefetched;    // not yet asked for by the foreground
+static PREFETCHINFO                         gInfo;
+
+static void initPrefetchLock() {
+    if (InterlockedCompareExchange(&gPrefetchLockReady, 1, 0) == 0) {
+        InitializeCriticalSection(&gPrefetchLock);
+        InitializeConditionVariable(&gPrefetchChanged);
+        InterlockedExchange(&gPrefetchLockReady, 2);
+    }
+    while (gPrefetchLockReady != 2)
+        Sleep(0);
+}
+
+static bool isQueued(PATHID folder) {
+    for (size_t i = 0; i < gQueue.size(); i++) {
+        if (gQueue[i].Folder == folder)
+            return true;
+    }
+    return gUnresolved.find(folder) != gUnresolved.end();
+}
+
+static bool isRecent(PATHID folder, ULONGLONG now) {
+    std::map<PATHID, ULONGLONG>::const_iterator it = gRecent.find(folder);
+    return it != gRecent.end() && now - it->second < PREFETCH_RECENT_MS;
+}
+
+/*
+* Put folder at the front of the queue. Called with gPrefetchLock held.
+*/
+static void pushFolder(const PREFETCHFOLDER &folder) {
+    gQueue.push_front(folder);
+    while (gQueue.size() > PREFETCH_MAX_QUEUE) {
+        gQueue.pop_back();
+        gInfo.Dropped++;
+    }
+}
+
+/*
+* Wait until no foreground query is running. Returns false if prefetching
+* is stopping. Called with gPrefetchLock held.
+*/
+static bool waitForIdle() {
+    while (!gStopPrefetch && gForeground)
+        SleepConditionVariableCS(&gPrefetchChanged, &gPrefetchLock, INFINITE);
+    return !gStopPrefetch;
+}
+
+static void listSubfolders(PATHID folder, PATHID except, std::vector<PATHID> &folders) {
+    WIN32_FIND_DATA data;
+    HANDLE find = FindFirstFile((std::string(pathName(folder)) + "\\*").c_str(), &data);
+    if (find == INVALID_HANDLE_VALUE)
+        return;
+    do {
+        if ((data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0 ||
+            (data.dwFileAttributes & (FILE_ATTRIBUTE_REPARSE_POINT | FILE_ATTRIBUTE_HIDDEN)) != 0)
+            continue;
+        // ., .. and the metadata folders of version control systems.
+        if (data.cFileName[0] == '.' || _stricmp(data.cFileName, "CVS") == 0)
+            continue;
+        PATHID sub = internPath((std::string(pathName(folder)) + "\\" + data.cFileName).c_str());
+        if (sub != except)
+            folders.push_back(sub);
+    } while (folders.size() < PREFETCH_MAX_NEIGHBOURS && FindNextFile(find, &data));
+    FindClose(find);
+}
+
+/*
+* Queue the subfolders of origin, then its siblings. Runs on the prefetch
+* thread without gPrefetchLock held.
+*/
+static void queueNeighbours(const PREFETCHFOLDER &origin) {
+    std::vector<PATHID> folders;
+    listSubfolders(origin.Origin, NO_PATH, folders);
+    PATHID parent = parentPathId(origin.Origin);
+    if (parent != NO_PATH && folders.size() < PREFETCH_MAX_NEIGHBOURS)
+        listSubfolders(parent, origin.Origin, folders);
+
+    EnterCriticalSection(&gPrefetchLock);
+    ULONGLONG now = GetTickCount64();
+    // Pushed last to first, so the queue is in listing order.
+    for (size_t i = folders.size(); i-- > 0;) {
+        if (isQueued(folders[i]) || isRecent(folders[i], now))
+            continue;
+        PREFETCHFOLDER folder   = origin;
+        folder.Folder           = folders[i];
+        pushFolder(folder);
+    }
+    LeaveCriticalSection(&gPrefetchLock);
+}
+
+static void listFiles(PATHID folder, std::vector<PATHID> &files) {
+    WIN32_FIND_DATA data;
+    HANDLE find = FindFirstFile((std::string(pathName(folder)) + "\\*").c_str(), &data);
+    if (find == INVALID_HANDLE_VALUE)
+        return;
+    LONG status;
+    do {
+        if ((data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0)
+            continue;
+        PATHID file = internPath((std::string(pathName(folder)) + "\\" + data.cFileName).c_str());
+        if (!lookupStatus(file, &status))
+            files.push_back(file);
+    } while (files.size() < PREFETCH_MAX_FILES && FindNextFile(find, &data));
+    FindClose(find);
+}
+
+/*
+* Query the files of a folder into the status cache, a batch at a time,
+* waiting for foreground queries in between. Runs on the prefetch thread
+* without gPrefetchLock held.
+*/
+static void queryFolder(const PREFETCHFOLDER &work) {
+    // Only folders routed to the same provider as the one asked about.
+    char libPath[_MAX_PATH];
+    bool mapped = providerLibForPath(work.Folder, libPath);
+    if (mapped ? _stricmp(libPath, work.LibPath.c_str()) != 0 : work.Mapped)
+        return;
+    // Nor can it call a provider that is not reentrant; that is only
+    // called on the thread that loaded it.
+    if (providerOwnerThread(work.LibPath.c_str()) != 0)
+        return;
+
+    // Open the project saved for the folder, or else for a subfolder the
+    // project of the folder it is in.
+    PATHID projectFolder = work.Folder;
+    char projName[SCC_PRJPATH_LEN + 1];
+    char axPath[SCC_PRJPATH_LEN + 1];
+    if (!lookupProjectInfo(work.Folder, projName, axPath)) {
+        if (parentPathId(work.Folder) != work.Origin) {
+            EnterCriticalSection(&gPrefetchLock);
+            if (gUnresolved.size() < PREFETCH_MAX_UNRESOLVED)
+                gUnresolved[work.Folder] = work;
+            else
+                gInfo.Dropped++;
+            LeaveCriticalSection(&gPrefetchLock);
+            return;
+        }
+        projectFolder = work.Origin;
+        strncpy(projName, work.ProjName.c_str(), SCC_PRJPATH_LEN);
+        projName[SCC_PRJPATH_LEN] = '\0';
+        strncpy(axPath, work.AxPath.c_str(), SCC_PRJPATH_LEN);
+        axPath[SCC_PRJPATH_LEN] = '\0';
+    }
+
+    std::vector<PATHID> files;
+    listFiles(work.Folder, files);
+
+    for (size_t start = 0; start < files.size(); start += PREFETCH_MAX_BATCH) {
+        EnterCriticalSection(&gPrefetchLock);
+        bool go = waitForIdle();
+        LeaveCriticalSection(&gPrefetchLock);
+        if (!go)
+            return;
+
+        size_t count = files.size() - start;
+        if (count > PREFETCH_MAX_BATCH)
+            count = PREFETCH_MAX_BATCH;
+        SCCSESSION *session = acquireSessionForLib(work.LibPath.c_str(), NULL, projectFolder);
+        if (session == NULL)
+            return;     // provider unloaded
+        SCCRTN rtn = SCC_OK;
+        if (session->CurrentFolder != projectFolder)
+            rtn = openSessionProject(session, NULL, projectFolder, projName, axPath);
+        std::vector<LPCSTR> names(count);
+        std::vector<LONG> status(count, 0);
+        ULONGLONG epoch = getStatusEpoch();
+        if (!IS_SCC_ERROR(rtn)) {
+            for (size_t n = 0; n < count; n++)
+                names[n] = pathName(files[start + n]);
+            SCCRECORD rec;
+            recordBegin(&rec, session->Provider->LibPath, session->Context, SCCPROC_QUERYINFO, (LONG)count, &names[0], NULL, 0);
+            rtn = (*(SccQueryInfo_PROC) session->Provider->Procs[SCCPROC_QUERYINFO])
+                (session->Context, (LONG)count, &names[0], &status[0]);
+            recordEnd(&rec, rtn, (LONG)count, &status[0], 0, NULL);
+        }
+        releaseSession(session);
+        if (IS_SCC_ERROR(rtn))
+            return;
+
+        std::vector<bool> journaled;
+        hasPendingJournalOps((int)count, &files[start], journaled);
+        EnterCriticalSection(&gPrefetchLock);
+        gInfo.Queries++;
+        if (gPrefetched.size() + count > PREFETCH_MAX_TRACKED)
+            gPrefetched.clear();
+        for (size_t n = 0; n < count; n++) {
+            // Statuses the cache did not keep, e.g. as the file changed
+            // meanwhile, are not counted.
+            if (journaled[n] || !storeStatus(files[start + n], status[n], epoch))
+                continue;
+            gPrefetched.insert(files[start + n]);
+            gInfo.Files++;
+        }
+        LeaveCriticalSection(&gPrefetchLock);
+    }
+}
+
+static DWORD WINAPI prefetchThread(LPVOID) {
+    // Below normal CPU and I/O priority, so the foreground always goes first.
+    if (!SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_BEGIN))
+        SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_LOWEST);
+
+    EnterCriticalSection(&gPrefetchLock);
+    for (;;) {
+        while (!gStopPrefetch && (gForeground || (gOrigins.empty() && gQueue.empty())))
+            SleepConditionVariableCS(&gPrefetchChanged, &gPrefetchLock, INFINITE);
+        if (gStopPrefetch)
+            break;
+
+        // List the neighbours of every folder asked about first, so the
+        // most recent ones are queried first.
+        if (!gOrigins.empty()) {
+            PREFETCHFOLDER origin = gOrigins.back();
+            gOrigins.pop_back();
+            LeaveCriticalSection(&gPrefetchLock);
+            queueNeighbours(origin);
+            EnterCriticalSection(&gPrefetchLock);
+            continue;
+        }
+
+        PREFETCHFOLDER work = gQueue.front();
+        gQueue.pop_front();
+        ULONGLONG now = GetTickCount64();
+        if (isRecent(work.Folder, now))
+            continue;
+        gRecent[work.Folder] = now;
+        if (gRecent.size() > 4 * PREFETCH_MAX_QUEUE) {
+            for (std::map<PATHID, ULONGLONG>::iterator it = gRecent.begin(); it != gRecent.end();) {
+                if (now - it->second >= PREFETCH_RECENT_MS)
+                    gRecent.erase(it++);
+                else
+                    ++it;
+            }
+        }
+        gInfo.Folders++;
+        LeaveCriticalSection(&gPrefetchLock);
+
+        queryFolder(work);
+
+        EnterCriticalSection(&gPrefetchLock);
+    }
+    LeaveCriticalSection(&gPrefetchLock);
+    return 0;
+}
+
+bool startPrefetch() {
+    initPrefetchLock();
+    EnterCriticalSection(&gPrefetchLock);
+    if (gPrefetchThread == NULL) {
+        gStopPrefetch   = false;
+        memset(&gInfo, 0, sizeof(gInfo));
+        gPrefetchThread = CreateThread(NULL, 0, prefetchThread, NULL, 0, NULL);
+    }
+    bool ok = gPrefetchThread != NULL;
+    LeaveCriticalSection(&gPrefetchLock);
+    return ok;
+}
+
+void stopPrefetch() {
+    if (gPrefetchLockReady != 2)
+        return;
+    EnterCriticalSection(&gPrefetchLock);
+    HANDLE thread   = gPrefetchThread;
+    gPrefetchThread = NULL;
+    gStopPrefetch   = true;
+    gOrigins.clear();
+    gQueue.clear();
+    gUnresolved.clear();
+    gRecent.clear();
+    gPrefetched.clear();
+    WakeAllConditionVariable(&gPrefetchChanged);
+    LeaveCriticalSection(&gPrefetchLock);
+    if (thread != NULL) {
+        WaitForSingleObject(thread, INFINITE);
+        CloseHandle(thread);
+    }
+}
+
+bool isPrefetchOn() {
+    return gPrefetchLockReady == 2 && gPrefetchThread != NULL;
+}
+
+void prefetchNeighbours(PATHID folder, const char *libPath, bool mapped,
+                        const char *projName, const char *axPath) {
+    if (!isPrefetchOn() || folder == NO_PATH)
+        return;
+    EnterCriticalSection(&gPrefetchLock);
+    bool queued = false;
+    for (size_t i = 0; i < gOrigins.size() && !queued; i++)
+        queued = gOrigins[i].Origin == folder;
+    if (!queued) {
+        PREFETCHFOLDER origin;
+        origin.Folder   = folder;
+        origin.Origin   = folder;
+        origin.LibPath  = libPath;
+        origin.Mapped   = mapped;
+        origin.ProjName = projName;
+        origin.AxPath   = axPath;
+        gOrigins.push_back(origin);
+        if (gOrigins.size() > PREFETCH_MAX_QUEUE) {
+            gOrigins.pop_front();
+            gInfo.Dropped++;
+        }
+        WakeAllConditionVariable(&gPrefetchChanged);
+    }
+    LeaveCriticalSection(&gPrefetchLock);
+}
+
+void takeUnresolvedFolders(int max, std::vector<PATHID> &folders) {
+    if (!isPrefetchOn())
+        return;
+    EnterCriticalSection(&gPrefetchLock);
+    for (std::map<PATHID, PREFETCHFOLDER>::const_iterator it = gUnresolved.begin();
+         it != gUnresolved.end() && (int)folders.size() < max; ++it)
+        folders.push_back(it->first);
+    LeaveCriticalSection(&gPrefetchLock);
+}
+
+void prefetchResolved(PATHID folder, bool saved) {
+    if (gPrefetchLockReady != 2)
+        return;
+    EnterCriticalSection(&gPrefetchLock);
+    std::map<PATHID, PREFETCHFOLDER>::iterator it = gUnresolved.find(folder);
+    if (it != gUnresolved.end()) {
+        if (saved) {
+            gRecent.erase(folder);
+            pushFolder(it->second);
+            WakeAllConditionVariable(&gPrefetchChanged);
+        }
+        gUnresolved.erase(it);
+    }
+    LeaveCriticalSection(&gPrefetchLock);
+}
+
+void beginForeground() {
+    if (gPrefetchLockReady != 2)
+        return;
+    EnterCriticalSection(&gPrefetchLock);
+    gForeground = true;
+    LeaveCriticalSection(&gPrefetchLock);
+}
+
+void endForeground() {
+    if (gPrefetchLockReady != 2)
+        return;
+    EnterCriticalSection(&gPrefetchLock);
+    gForeground = false;
+    WakeAllConditionVariable(&gPrefetchChanged);
+    LeaveCriticalSection(&gPrefetchLock);
+}
+
+void notePrefetchLookup(PATHID file, bool cached) {
+    if (!isPrefetchOn())
+        return;
+    EnterCriticalSection(&gPrefetchLock);
+    if (!cached)
+        gInfo.Misses++;
+    else if (gPrefetched.erase(file) > 0)
+        gInfo.Hits++;
+    LeaveCriticalSection(&gPrefetchLock);
+}
+
+void getPrefetchInfo(PREFETCHINFO *info) {
+    memset(info, 0, sizeof(PREFETCHINFO));
+    if (gPrefetchLockReady != 2)
+        return;
+    EnterCriticalSection(&gPrefetchLock);
+    *info           = gInfo;
+    info->Queued    = (int)(gQueue.size() + gOrigins.size() + gUnresolved.size());
+    LeaveCriticalSection(&gPrefetchLock);
+}
@@ -0,0 +1,73 @@
+/*
+*
+*
+* The source code contained in this listing contains proprietary and
+* confidential trade secrets of The MathWorks, Inc.  The use, modification,
+* or development of derivative work based on the code or ideas obtained
+* from the code is prohibited without the express written permission of The
+* MathWorks, Inc. The disclosure of this code to any party not authorized
+* by The MathWorks, Inc. is strictly forbidden.
+* CONFIDENTIAL AND CONTAINING PROPRIETARY TRADE SECRETS
+*/
+
+#ifndef VERCTRLPREFETCH_H
+#define VERCTRLPREFETCH_H
+
+#include <windows.h>
+#include <vector>
+
+#include "verctrlPath.h"
+
+/*
+* Status prefetch. While it is on, each folder STATUS was asked about is
+* queued, and a low priority thread queries the files of its subfolders
+* and of its sibling folders into the status cache, a batch per project.
+* The thread waits while a STATUS is running in the foreground.
+*
+* Subfolders without a saved project use the project of the folder they
+* are in. Siblings without one are left for the foreground to look up
+* with getsccprj, which can only be called on the MATLAB thread, and are
+* queried once it has. Folders of providers that are not reentrant are
+* not prefetched, as those are only called on the thread that loaded them.
+*
+* All functions are thread-safe and none of them use the MEX API.
+*/
+
+typedef struct PREFETCHINFO {
+    int             Queued;         // folders waiting to be queried
+    ULONGLONG       Folders;        // folders queried
+    ULONGLONG       Queries;        // SccQueryInfo calls
+    ULONGLONG       Files;          // statuses put in the status cache
+    ULONGLONG       Hits;           // foreground lookups answered by a prefetched status
+    ULONGLONG       Misses;         // foreground lookups not in the status cache
+    ULONGLONG       Dropped;        // folders dropped from a full queue
+} PREFETCHINFO;
+
+bool startPrefetch();
+void stopPrefetch();
+bool isPrefetchOn();
+
+// Queue the neighbours of folder after a foreground STATUS of it, with
+// the provider library and project it was queried with. mapped says if
+// libPath came from a folder mapping rather than being the default.
+void prefetchNeighbours(PATHID folder, const char *libPath, bool mapped,
+                        const char *projName, const char *axPath);
+
+// Sibling folders that need their saved project looked up, at most max
+// of them. Once it is stored in the project cache, or known not to be
+// saved, prefetchResolved queues the folder again.
+void takeUnresolvedFolders(int max, std::vector<PATHID> &folders);
+void prefetchResolved(PATHID folder, bool saved);
+
+// Bracket foreground status queries; the prefetch thread waits while one
+// is running. Each command calls endForeground first, for a query that
+// ended in an error.
+void beginForeground();
+void endForeground();
+
+// A foreground status cache lookup, for the hit rate.
+void notePrefetchLookup(PATHID file, bool cached);
+
+void getPrefetchInfo(PREFETCHINFO *info);
+
+#endif
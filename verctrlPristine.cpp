@@ -0,0 +1,723 @@
+/*
+*
+*
+* The source code contained in this listing contains proprietary and
+* confidential trade secrets of The MathWorks, Inc.  The use, modification,
+* or development of derivative work based on the code or ideas obtained
+* from the code is prohibited without the express written permission of The
+* MathWorks, Inc. The disclosure of this code to any party not authorized
+* by The MathWorks, Inc. is strictly forbidden.
+* CONFIDENTIAL AND CONTAINING PROPRIETARY TRADE SECRETS
+*/
+
+/*
+* Store folder layout:
+*
+*   objects\ab\cdef...  read-only copy of contents with SHA-1 abcdef...
+*   bases.log           which file has which base, one line per change:
+*                           + <sha1> <size> <time> <path>
+*                           - <path>
+*                       where size and time are those of the working file
+*                       when its base was recorded, and when each copy
+*                       was last used:
+*                           = <sha1> <time>
+*                       The log is rewritten with only the current lines
+*                       when it is stopped, and when it has grown well past
+*                       the number of files and copies it describes.
+*
+* Last uses are kept in memory and only written when the log is
+* rewritten; a copy with none is taken as last used when it was made.
+* They choose which copies to delete when the folder is over its size
+* limit. The copies' own times are left alone.
+*/
+
+#include <windows.h>
+#include <winioctl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+
+#include "verctrlPath.h"
+#include "verctrlHash.h"
+#include "verctrlPristine.h"
+
+// Upper bound on the threads copying files at once.
+#define PRISTINE_THREADS    8
+
+// A copy left in objects\ by a process that is still running is only
+// deleted once it is this old, in case the process id was reused.
+#define PRISTINE_TEMP_STALE (24 * 60 * 60 * 10000000ULL)
+
+typedef struct PRISTINEOBJECT {
+    ULONGLONG       Size;
+    ULONGLONG       LastUse;        // FILETIME
+} PRISTINEOBJECT;
+
+typedef struct PRISTINEBASE {
+    std::string     Key;            // hex SHA-1 of the base
+    ULONGLONG       WorkSize;
+    ULONGLONG       WorkTime;
+} PRISTINEBASE;
+
+// Result of capturing one file.
+typedef struct PRISTINECAPTURE {
+    bool            Ok;
+    bool            New;            // a copy was added
+    bool            Cloned;
+    std::string     Key;
+    ULONGLONG       Size;
+    ULONGLONG       WorkSize;
+    ULONGLONG       WorkTime;
+} PRISTINECAPTURE;
+
+static SRWLOCK                                  gPristineLock   = SRWLOCK_INIT;
+static bool                                     gPristineOn     = false;
+static std::string                              gFolder;
+static FILE                                    *gBasesLog       = NULL;
+static ULONGLONG                                gLogLines       = 0;
+static std::map<std::string, PRISTINEOBJECT>    gObjects;       // by key
+static std::map<PATHID, PRISTINEBASE>           gBases;
+static PRISTINEINFO                             gInfo;
+static volatile LONG                            gTempCounter    = 0;
+
+static ULONGLONG fileTime(const FILETIME &ft) {
+    return ((ULONGLONG)ft.dwHighDateTime << 32) | ft.dwLowDateTime;
+}
+
+static ULONGLONG now() {
+    FILETIME ft;
+    GetSystemTimeAsFileTime(&ft);
+    return fileTime(ft);
+}
+
+static std::string objectName(const std::string &folder, const std::string &key) {
+    return folder + "\\objects\\" + key.substr(0, 2) + "\\" + key.substr(2);
+}
+
+static std::string tempName(const std::string &folder) {
+    char name[64];
+    _snprintf(name, sizeof(name), "\\objects\\tmp-%lu-%ld",
+        GetCurrentProcessId(), InterlockedIncrement(&gTempCounter));
+    return folder + name;
+}
+
+static bool workFileInfo(const char *path, ULONGLONG *size, ULONGLONG *time) {
+    WIN32_FILE_ATTRIBUTE_DATA info;
+    if (!GetFileAttributesEx(path, GetFileExInfoStandard, &info) ||
+        (info.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0)
+        return false;
+    *size = ((ULONGLONG)info.nFileSizeHigh << 32) | info.nFileSizeLow;
+    *time = fileTime(info.ftLastWriteTime);
+    return true;
+}
+
+/*
+* Make dst share src's blocks. Only ReFS supports this, and only within
+* a volume; the destination must not exist.
+*/
+static bool cloneFile(const char *src, const char *dst) {
+    HANDLE in = CreateFile(src, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (in == INVALID_HANDLE_VALUE)
+        return false;
+    FSCTL_GET_INTEGRITY_INFORMATION_BUFFER integrity;
+    LARGE_INTEGER size;
+    DWORD bytes = 0;
+    if (!DeviceIoControl(in, FSCTL_GET_INTEGRITY_INFORMATION, NULL, 0,
+            &integrity, sizeof(integrity), &bytes, NULL) ||
+        !GetFileSizeEx(in, &size)) {
+        CloseHandle(in);
+        return false;
+    }
+    HANDLE out = CreateFile(dst, GENERIC_READ | GENERIC_WRITE | DELETE, 0, NULL,
+        CREATE_NEW, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (out == INVALID_HANDLE_VALUE) {
+        CloseHandle(in);
+        return false;
+    }
+
+    // Both files must have the same integrity setting, and the cloned
+    // range must be whole clusters.
+    FSCTL_SET_INTEGRITY_INFORMATION_BUFFER setIntegrity;
+    setIntegrity.ChecksumAlgorithm  = integrity.ChecksumAlgorithm;
+    setIntegrity.Reserved           = 0;
+    setIntegrity.Flags              = integrity.Flags;
+    ULONGLONG cluster   = integrity.ClusterSizeInBytes > 0 ? integrity.ClusterSizeInBytes : 4096;
+    ULONGLONG length    = (ULONGLONG)size.QuadPart;
+    bool ok = DeviceIoControl(out, FSCTL_SET_INTEGRITY_INFORMATION, &setIntegrity,
+        sizeof(setIntegrity), NULL, 0, &bytes, NULL) != 0;
+    if (ok && length > 0) {
+        ok = SetFilePointerEx(out, size, NULL, FILE_BEGIN) && SetEndOfFile(out);
+        DUPLICATE_EXTENTS_DATA dup;
+        dup.FileHandle                  = in;
+        dup.SourceFileOffset.QuadPart   = 0;
+        dup.TargetFileOffset.QuadPart   = 0;
+        dup.ByteCount.QuadPart          = (LONGLONG)((length + cluster - 1) / cluster * cluster);
+        ok = ok && DeviceIoControl(out, FSCTL_DUPLICATE_EXTENTS_TO_FILE, &dup, sizeof(dup),
+            NULL, 0, &bytes, NULL);
+    }
+    if (!ok) {
+        FILE_DISPOSITION_INFO dispose;
+        dispose.DeleteFile = TRUE;
+        SetFileInformationByHandle(out, FileDispositionInfo, &dispose, sizeof(dispose));
+    }
+    CloseHandle(out);
+    CloseHandle(in);
+    return ok;
+}
+
+/*
+* Copy src to dst, which must not exist, as a clone if possible.
+*/
+static bool copyFile(const char *src, const char *dst, bool *cloned) {
+    *cloned = cloneFile(src, dst);
+    return *cloned || CopyFile(src, dst, TRUE);
+}
+
+static void setReadOnly(const char *path, bool readOnly) {
+    DWORD attr = GetFileAttributes(path);
+    if (attr == INVALID_FILE_ATTRIBUTES)
+        return;
+    DWORD want = readOnly ? (attr | FILE_ATTRIBUTE_READONLY) : (attr & ~FILE_ATTRIBUTE_READONLY);
+    if (want != attr)
+        SetFileAttributes(path, want);
+}
+
+static void setWriteTime(const char *path, ULONGLONG time) {
+    HANDLE file = CreateFile(path, FILE_WRITE_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_DELETE,
+        NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return;
+    FILETIME ft;
+    ft.dwLowDateTime    = (DWORD)time;
+    ft.dwHighDateTime   = (DWORD)(time >> 32);
+    SetFileTime(file, NULL, NULL, &ft);
+    CloseHandle(file);
+}
+
+/*
+* Work shared out between threads, one file at a time.
+*/
+typedef struct PRISTINEJOB {
+    int                 NumberOfFiles;
+    const PATHID       *Files;
+    volatile LONG       Next;
+    std::string         Folder;
+    void              (*Run)(struct PRISTINEJOB *job, int i);
+    PRISTINECAPTURE    *Captures;
+    bool               *Restored;
+    std::string        *Keys;
+} PRISTINEJOB;
+
+static DWORD WINAPI pristineThread(LPVOID arg) {
+    PRISTINEJOB *job = (PRISTINEJOB *) arg;
+    for (;;) {
+        LONG i = InterlockedIncrement(&job->Next) - 1;
+        if (i >= job->NumberOfFiles)
+            break;
+        job->Run(job, i);
+    }
+    return 0;
+}
+
+static void runJob(PRISTINEJOB *job) {
+    HANDLE threads[PRISTINE_THREADS];
+    int started = 0;
+    for (int t = 1; t < PRISTINE_THREADS && t < job->NumberOfFiles; t++) {
+        threads[started] = CreateThread(NULL, 0, pristineThread, job, 0, NULL);
+        if (threads[started] != NULL)
+            started++;
+    }
+    pristineThread(job);
+    if (started > 0) {
+        WaitForMultipleObjects(started, threads, TRUE, INFINITE);
+        for (int t = 0; t < started; t++)
+            CloseHandle(threads[t]);
+    }
+}
+
+static void captureFile(PRISTINEJOB *job, int i) {
+    PRISTINECAPTURE *capture = &job->Captures[i];
+    capture->Ok     = false;
+    capture->New    = false;
+    capture->Cloned = false;
+    std::string path;
+    longPathName(job->Files[i], path);
+    unsigned char digest[SHA1_LEN];
+    if (!workFileInfo(path.c_str(), &capture->WorkSize, &capture->WorkTime) ||
+        !sha1File(path.c_str(), digest))
+        return;
+    sha1ToHex(digest, capture->Key);
+    capture->Size = capture->WorkSize;
+
+    AcquireSRWLockShared(&gPristineLock);
+    bool known = gObjects.count(capture->Key) != 0;
+    ReleaseSRWLockShared(&gPristineLock);
+    if (known) {
+        capture->Ok = true;
+        return;
+    }
+
+    // Copy first and name the copy by what was copied, in case the file
+    // changed after it was hashed.
+    std::string temp = tempName(job->Folder);
+    if (!copyFile(path.c_str(), temp.c_str(), &capture->Cloned))
+        return;
+    ULONGLONG timeUnused;
+    if (!sha1File(temp.c_str(), digest) || !workFileInfo(temp.c_str(), &capture->Size, &timeUnused)) {
+        DeleteFile(temp.c_str());
+        return;
+    }
+    sha1ToHex(digest, capture->Key);
+    std::string name = objectName(job->Folder, capture->Key);
+    CreateDirectory(name.substr(0, name.size() - (SHA1_LEN * 2 - 2) - 1).c_str(), NULL);
+    setReadOnly(temp.c_str(), true);
+    if (MoveFileEx(temp.c_str(), name.c_str(), 0)) {
+        capture->New = true;
+    } else {
+        // Another thread or process stored the same contents.
+        setReadOnly(temp.c_str(), false);
+        DeleteFile(temp.c_str());
+        if (GetFileAttributes(name.c_str()) == INVALID_FILE_ATTRIBUTES)
+            return;
+    }
+    capture->Ok = true;
+}
+
+static void restoreFile(PRISTINEJOB *job, int i) {
+    job->Restored[i] = false;
+    if (job->Keys[i].empty())
+        return;
+    std::string path;
+    longPathName(job->Files[i], path);
+    std::string temp = path + ".verctrl-tmp";
+    bool cloned;
+    DeleteFile(temp.c_str());
+    if (!copyFile(objectName(job->Folder, job->Keys[i]).c_str(), temp.c_str(), &cloned))
+        return;
+    // A copy has the time of the file it was made from. The restored file
+    // is a change to the working file, so it gets the time now.
+    setWriteTime(temp.c_str(), now());
+    setReadOnly(path.c_str(), false);
+    if (!MoveFileEx(temp.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING)) {
+        setReadOnly(temp.c_str(), false);
+        DeleteFile(temp.c_str());
+        return;
+    }
+    setReadOnly(path.c_str(), true);
+    job->Restored[i] = true;
+}
+
+static void logBase(PATHID file, const PRISTINEBASE *base) {
+    if (gBasesLog == NULL)
+        return;
+    if (base != NULL)
+        fprintf(gBasesLog, "+ %s %I64u %I64u %s\n", base->Key.c_str(), base->WorkSize, base->WorkTime, pathName(file));
+    else
+        fprintf(gBasesLog, "- %s\n", pathName(file));
+    gLogLines++;
+}
+
+/*
+* Delete the least recently used copies until the folder is well under
+* its limit. Called with gPristineLock held exclusively.
+*/
+static void collectLocked() {
+    if (gInfo.Bytes <= gInfo.MaxBytes)
+        return;
+    std::vector<std::pair<ULONGLONG, std::string> > byUse;
+    for (std::map<std::string, PRISTINEOBJECT>::const_iterator it = gObjects.begin(); it != gObjects.end(); ++it)
+        byUse.push_back(std::make_pair(it->second.LastUse, it->first));
+    std::sort(byUse.begin(), byUse.end());
+
+    // Collect down to 90% of the limit, so that collecting is rare.
+    ULONGLONG target = gInfo.MaxBytes / 10 * 9;
+    for (size_t i = 0; i < byUse.size() && gInfo.Bytes > target; i++) {
+        std::string name = objectName(gFolder, byUse[i].second);
+        setReadOnly(name.c_str(), false);
+        DeleteFile(name.c_str());
+        gInfo.Bytes -= gObjects[byUse[i].second].Size;
+        gObjects.erase(byUse[i].second);
+        gInfo.Collected++;
+    }
+    for (std::map<PATHID, PRISTINEBASE>::iterator it = gBases.begin(); it != gBases.end(); ) {
+        if (gObjects.count(it->second.Key) == 0) {
+            logBase(it->first, NULL);
+            gBases.erase(it++);
+        } else {
+            ++it;
+        }
+    }
+}
+
+/*
+* Rewrite bases.log with only the current bases and last uses. Closes
+* the log.
+*/
+static bool compactLogLocked() {
+    std::string logName     = gFolder + "\\bases.log";
+    std::string tempLogName = logName + ".tmp";
+    FILE *log = fopen(tempLogName.c_str(), "w");
+    if (log == NULL)
+        return false;
+    for (std::map<PATHID, PRISTINEBASE>::const_iterator it = gBases.begin(); it != gBases.end(); ++it)
+        fprintf(log, "+ %s %I64u %I64u %s\n", it->second.Key.c_str(), it->second.WorkSize,
+            it->second.WorkTime, pathName(it->first));
+    for (std::map<std::string, PRISTINEOBJECT>::const_iterator it = gObjects.begin(); it != gObjects.end(); ++it)
+        fprintf(log, "= %s %I64u\n", it->first.c_str(), it->second.LastUse);
+    bool ok = fflush(log) == 0;
+    fclose(log);
+    if (gBasesLog != NULL) {
+        fclose(gBasesLog);
+        gBasesLog = NULL;
+    }
+    ok = ok && MoveFileEx(tempLogName.c_str(), logName.c_str(), MOVEFILE_REPLACE_EXISTING);
+    if (ok)
+        gLogLines = gBases.size() + gObjects.size();
+    else
+        DeleteFile(tempLogName.c_str());
+    return ok;
+}
+
+static bool isLogLong() {
+    return gLogLines > 2 * (gBases.size() + gObjects.size()) + 1000;
+}
+
+/*
+* Write out what was logged, first rewriting the log if it is long.
+* Called with gPristineLock held exclusively.
+*/
+static void flushLogLocked() {
+    if (gBasesLog == NULL)
+        return;
+    if (!isLogLong()) {
+        fflush(gBasesLog);
+        return;
+    }
+    compactLogLocked();
+    gBasesLog = fopen((gFolder + "\\bases.log").c_str(), "a");
+}
+
+/*
+* A copy that did not finish, named by tempName. Copies being made by
+* another process sharing the folder are kept.
+*/
+static bool isAbandonedCopy(const WIN32_FIND_DATA &data) {
+    if (now() > fileTime(data.ftCreationTime) + PRISTINE_TEMP_STALE)
+        return true;
+    unsigned long pid = 0;
+    if (sscanf(data.cFileName, "tmp-%lu-", &pid) != 1 || pid == GetCurrentProcessId())
+        return false;
+    HANDLE process = OpenProcess(SYNCHRONIZE, FALSE, pid);
+    if (process == NULL)
+        return GetLastError() == ERROR_INVALID_PARAMETER;
+    bool exited = WaitForSingleObject(process, 0) == WAIT_OBJECT_0;
+    CloseHandle(process);
+    return exited;
+}
+
+static void scanObjects(const std::string &folder) {
+    WIN32_FIND_DATA dirData;
+    HANDLE dirs = FindFirstFile((folder + "\\objects\\*").c_str(), &dirData);
+    if (dirs == INVALID_HANDLE_VALUE)
+        return;
+    do {
+        std::string dirName = dirData.cFileName;
+        if ((dirData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0) {
+            if (isAbandonedCopy(dirData)) {
+                std::string temp = folder + "\\objects\\" + dirName;
+                setReadOnly(temp.c_str(), false);
+                DeleteFile(temp.c_str());
+            }
+            continue;
+        }
+        if (dirName.size() != 2)
+            continue;
+        WIN32_FIND_DATA data;
+        HANDLE files = FindFirstFile((folder + "\\objects\\" + dirName + "\\*").c_str(), &data);
+        if (files == INVALID_HANDLE_VALUE)
+            continue;
+        do {
+            if ((data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0)
+                continue;
+            PRISTINEOBJECT object;
+            object.Size     = ((ULONGLONG)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+            object.LastUse  = fileTime(data.ftCreationTime);
+            gObjects[dirName + data.cFileName] = object;
+            gInfo.Bytes += object.Size;
+        } while (FindNextFile(files, &data));
+        FindClose(files);
+    } while (FindNextFile(dirs, &dirData));
+    FindClose(dirs);
+}
+
+static void readBasesLog(const std::string &logName) {
+    FILE *log = fopen(logName.c_str(), "r");
+    if (log == NULL)
+        return;
+    std::vector<char> line(64 * 1024);
+    while (fgets(&line[0], (int)line.size(), log) != NULL) {
+        size_t len = strlen(&line[0]);
+        if (len == 0 || line[len - 1] != '\n')
+            continue;       // torn last line
+        line[len - 1] = '\0';
+        gLogLines++;
+        if (line[0] == '-' && line[1] == ' ') {
+            gBases.erase(internPath(&line[2]));
+            continue;
+        }
+        char key[SHA1_LEN * 2 + 1];
+        ULONGLONG lastUse;
+        if (line[0] == '=') {
+            std::map<std::string, PRISTINEOBJECT>::iterator it;
+            if (sscanf(&line[0], "= %40s %I64u", key, &lastUse) == 2 &&
+                (it = gObjects.find(key)) != gObjects.end() && it->second.LastUse < lastUse)
+                it->second.LastUse = lastUse;
+            continue;
+        }
+        PRISTINEBASE base;
+        int pathStart = 0;
+        if (sscanf(&line[0], "+ %40s %I64u %I64u %n", key, &base.WorkSize, &base.WorkTime, &pathStart) < 3 ||
+            pathStart == 0)
+            continue;
+        base.Key = key;
+        if (gObjects.count(base.Key) != 0)
+            gBases[internPath(&line[pathStart])] = base;
+    }
+    fclose(log);
+}
+
+bool startPristine(const char *folder, ULONGLONG maxBytes) {
+    stopPristine();
+    AcquireSRWLockExclusive(&gPristineLock);
+    gFolder = folder;
+    while (gFolder.size() > 3 && gFolder[gFolder.size() - 1] == '\\')
+        gFolder.erase(gFolder.size() - 1);
+    CreateDirectory(gFolder.c_str(), NULL);
+    CreateDirectory((gFolder + "\\objects").c_str(), NULL);
+
+    gInfo.Folder    = gFolder;
+    gInfo.MaxBytes  = maxBytes;
+    gInfo.Bytes     = 0;
+    gInfo.Objects   = gInfo.Files = gInfo.Cloned = gInfo.Copied = gInfo.Collected = 0;
+    gLogLines       = 0;
+    scanObjects(gFolder);
+    std::string logName = gFolder + "\\bases.log";
+    readBasesLog(logName);
+    collectLocked();
+    if (isLogLong())
+        compactLogLocked();
+    gBasesLog   = fopen(logName.c_str(), "a");
+    gPristineOn = gBasesLog != NULL;
+    if (!gPristineOn) {
+        gObjects.clear();
+        gBases.clear();
+    }
+    ReleaseSRWLockExclusive(&gPristineLock);
+    return gPristineOn;
+}
+
+void stopPristine() {
+    AcquireSRWLockExclusive(&gPristineLock);
+    if (gPristineOn)
+        compactLogLocked();
+    if (gBasesLog != NULL) {
+        fclose(gBasesLog);
+        gBasesLog = NULL;
+    }
+    gObjects.clear();
+    gBases.clear();
+    gPristineOn = false;
+    ReleaseSRWLockExclusive(&gPristineLock);
+}
+
+bool isPristineOn() {
+    return gPristineOn;
+}
+
+void capturePristine(int numberOfFiles, const PATHID *files) {
+    if (!gPristineOn || numberOfFiles <= 0)
+        return;
+    std::vector<PRISTINECAPTURE> captures(numberOfFiles);
+    PRISTINEJOB job;
+    job.NumberOfFiles   = numberOfFiles;
+    job.Files           = files;
+    job.Next            = 0;
+    job.Run             = captureFile;
+    job.Captures        = &captures[0];
+    job.Restored        = NULL;
+    job.Keys            = NULL;
+    AcquireSRWLockShared(&gPristineLock);
+    job.Folder          = gFolder;
+    ReleaseSRWLockShared(&gPristineLock);
+    runJob(&job);
+
+    AcquireSRWLockExclusive(&gPristineLock);
+    if (gPristineOn && job.Folder == gFolder) {
+        ULONGLONG time = now();
+        for (int i = 0; i < numberOfFiles; i++) {
+            const PRISTINECAPTURE &capture = captures[i];
+            if (!capture.Ok) {
+                if (gBases.erase(files[i]) != 0)
+                    logBase(files[i], NULL);
+                continue;
+            }
+            std::map<std::string, PRISTINEOBJECT>::iterator it = gObjects.find(capture.Key);
+            if (it == gObjects.end()) {
+                PRISTINEOBJECT object;
+                object.Size     = capture.Size;
+                object.LastUse  = time;
+                gObjects[capture.Key] = object;
+                gInfo.Bytes    += capture.Size;
+            } else {
+                it->second.LastUse = time;
+            }
+            if (capture.New)
+                (capture.Cloned ? gInfo.Cloned : gInfo.Copied)++;
+            PRISTINEBASE base;
+            base.Key        = capture.Key;
+            base.WorkSize   = capture.WorkSize;
+            base.WorkTime   = capture.WorkTime;
+            gBases[files[i]] = base;
+            logBase(files[i], &base);
+        }
+        collectLocked();
+        flushLogLocked();
+    }
+    ReleaseSRWLockExclusive(&gPristineLock);
+}
+
+void forgetPristine(int numberOfFiles, const PATHID *files) {
+    if (!gPristineOn)
+        return;
+    AcquireSRWLockExclusive(&gPristineLock);
+    for (int i = 0; i < numberOfFiles; i++) {
+        if (gBases.erase(files[i]) != 0)
+            logBase(files[i], NULL);
+    }
+    flushLogLocked();
+    ReleaseSRWLockExclusive(&gPristineLock);
+}
+
+/*
+* The key of file's base, and the size and time the working file had
+* when it was recorded. Marks the copy as used.
+*/
+static bool findBase(PATHID file, PRISTINEBASE *base, std::string *folder) {
+    bool found = false;
+    AcquireSRWLockExclusive(&gPristineLock);
+    std::map<PATHID, PRISTINEBASE>::const_iterator it = gBases.find(file);
+    if (gPristineOn && it != gBases.end() && gObjects.count(it->second.Key) != 0) {
+        *base   = it->second;
+        *folder = gFolder;
+        gObjects[base->Key].LastUse = now();
+        found   = true;
+    }
+    ReleaseSRWLockExclusive(&gPristineLock);
+    return found;
+}
+
+bool hasPristineBase(PATHID file) {
+    AcquireSRWLockShared(&gPristineLock);
+    std::map<PATHID, PRISTINEBASE>::const_iterator it = gBases.find(file);
+    bool found = gPristineOn && it != gBases.end() && gObjects.count(it->second.Key) != 0;
+    ReleaseSRWLockShared(&gPristineLock);
+    return found;
+}
+
+int comparePristine(PATHID file) {
+    PRISTINEBASE base;
+    std::string folder;
+    if (!gPristineOn || !findBase(file, &base, &folder))
+        return PRISTINE_UNKNOWN;
+    std::string path;
+    longPathName(file, path);
+    ULONGLONG size, time;
+    if (!workFileInfo(path.c_str(), &size, &time))
+        return PRISTINE_UNKNOWN;
+    if (size == base.WorkSize && time == base.WorkTime)
+        return PRISTINE_SAME;
+
+    unsigned char digest[SHA1_LEN];
+    std::string key;
+    if (!sha1File(path.c_str(), digest))
+        return PRISTINE_UNKNOWN;
+    sha1ToHex(digest, key);
+    return key == base.Key ? PRISTINE_SAME : PRISTINE_DIFFERENT;
+}
+
+int restorePristine(int numberOfFiles, const PATHID *files, bool *restored) {
+    if (!gPristineOn || numberOfFiles <= 0)
+        return 0;
+    std::vector<std::string> keys(numberOfFiles);
+    PRISTINEJOB job;
+    for (int i = 0; i < numberOfFiles; i++) {
+        PRISTINEBASE base;
+        if (findBase(files[i], &base, &job.Folder))
+            keys[i] = base.Key;
+    }
+    job.NumberOfFiles   = numberOfFiles;
+    job.Files           = files;
+    job.Next            = 0;
+    job.Run             = restoreFile;
+    job.Captures        = NULL;
+    job.Restored        = restored;
+    job.Keys            = &keys[0];
+    runJob(&job);
+
+    // The restored files are their bases again; remember their new times
+    // so comparing them does not read them.
+    int count = 0;
+    AcquireSRWLockExclusive(&gPristineLock);
+    for (int i = 0; i < numberOfFiles; i++) {
+        if (!restored[i])
+            continue;
+        count++;
+        std::string path;
+        longPathName(files[i], path);
+        std::map<PATHID, PRISTINEBASE>::iterator it = gBases.find(files[i]);
+        if (it != gBases.end() && workFileInfo(path.c_str(), &it->second.WorkSize, &it->second.WorkTime))
+            logBase(files[i], &it->second);
+    }
+    flushLogLocked();
+    ReleaseSRWLockExclusive(&gPristineLock);
+    return count;
+}
+
+bool pristineCopy(PATHID file, std::string &copyName) {
+    PRISTINEBASE base;
+    std::string folder;
+    if (!gPristineOn || !findBase(file, &base, &folder))
+        return false;
+    char tempDir[_MAX_PATH];
+    DWORD len = GetTempPath(sizeof(tempDir), tempDir);
+    if (len == 0 || len >= sizeof(tempDir))
+        return false;
+    std::string dir = std::string(tempDir) + "verctrl-base";
+    CreateDirectory(dir.c_str(), NULL);
+    dir += "\\" + base.Key;
+    CreateDirectory(dir.c_str(), NULL);
+
+    const char *name    = pathName(file);
+    const char *slash   = strrchr(name, '\\');
+    copyName = dir + "\\" + (slash != NULL ? slash + 1 : name);
+    if (GetFileAttributes(copyName.c_str()) != INVALID_FILE_ATTRIBUTES)
+        return true;
+    bool cloned;
+    if (!copyFile(objectName(folder, base.Key).c_str(), copyName.c_str(), &cloned))
+        return false;
+    setWriteTime(copyName.c_str(), now());
+    return true;
+}
+
+void getPristineInfo(PRISTINEINFO *info) {
+    AcquireSRWLockShared(&gPristineLock);
+    *info           = gInfo;
+    info->Objects   = gObjects.size();
+    info->Files     = gBases.size();
+    ReleaseSRWLockShared(&gPristineLock);
+}
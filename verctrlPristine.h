@@ -0,0 +1,70 @@
+/*
+*
+*
+* The source code contained in this listing contains proprietary and
+* confidential trade secrets of The MathWorks, Inc.  The use, modification,
+* or development of derivative work based on the code or ideas obtained
+* from the code is prohibited without the express written permission of The
+* MathWorks, Inc. The disclosure of this code to any party not authorized
+* by The MathWorks, Inc. is strictly forbidden.
+* CONFIDENTIAL AND CONTAINING PROPRIETARY TRADE SECRETS
+*/
+
+#ifndef VERCTRLPRISTINE_H
+#define VERCTRLPRISTINE_H
+
+#include <windows.h>
+#include <string>
+
+#include "verctrlPath.h"
+
+/*
+* Pristine store. While it is on, the contents of files right after GET,
+* CHECKOUT, ADD and CHECKIN are kept as their base revision in a folder
+* of copies named by their SHA-1, so identical contents are kept once.
+* Copies are block clones where the file system supports them. When the
+* folder grows past its size limit the least recently used copies are
+* deleted.
+*
+* All functions are thread-safe and none of them use the MEX API.
+*/
+
+enum PristineCompare {
+    PRISTINE_UNKNOWN = -1,      // no base kept for the file
+    PRISTINE_SAME,
+    PRISTINE_DIFFERENT
+};
+
+typedef struct PRISTINEINFO {
+    std::string     Folder;
+    ULONGLONG       MaxBytes;
+    ULONGLONG       Bytes;
+    ULONGLONG       Objects;
+    ULONGLONG       Files;          // files with a base
+    ULONGLONG       Cloned;         // copies made as block clones
+    ULONGLONG       Copied;         // copies made by copying the data
+    ULONGLONG       Collected;      // copies deleted to stay under MaxBytes
+} PRISTINEINFO;
+
+bool startPristine(const char *folder, ULONGLONG maxBytes);
+void stopPristine();
+bool isPristineOn();
+
+// Keep the current contents of the files as their base revision.
+void capturePristine(int numberOfFiles, const PATHID *files);
+void forgetPristine(int numberOfFiles, const PATHID *files);
+
+bool hasPristineBase(PATHID file);
+int comparePristine(PATHID file);
+
+// Put the base revision back in place of each file, read-only. Returns
+// the number of files restored; restored[i] says which.
+int restorePristine(int numberOfFiles, const PATHID *files, bool *restored);
+
+// A copy of the base revision under the same file name, in a folder of
+// its own below the temporary folder, for diff tools.
+bool pristineCopy(PATHID file, std::string &copyName);
+
+void getPristineInfo(PRISTINEINFO *info);
+
+#endif
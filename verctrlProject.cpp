@@ -0,0 +1,407 @@
+/*
+*
+*
+* The source code contained in this listing contains proprietary and
+* confidential trade secrets of The MathWorks, Inc.  The use, modification,
+* or development of derivative work based on the code or ideas obtained
+* from the code is prohibited without the express written permission of The
+* MathWorks, Inc. The disclosure of this code to any party not authorized
+* by The MathWorks, Inc. is strictly forbidden.
+* CONFIDENTIAL AND CONTAINING PROPRIETARY TRADE SECRETS
+*/
+
+#include <windows.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <utility>
+
+#include "verctrlPath.h"
+#include "verctrlWatch.h"
+#include "verctrlProject.h"
+
+#define XML_BUFFER_SIZE     (64 * 1024)
+
+// Longest chain of parent folders followed in hashed metadata.
+#define MAX_PROJECT_DEPTH   256
+
+typedef std::pair<std::string, std::string> XMLATTRIBUTE;
+typedef void (*XMLCALLBACK)(void *context, const std::string &element, const std::vector<XMLATTRIBUTE> &attributes);
+
+typedef struct PROJECTINDEX {
+    PATHID                  Manifest;
+    PATHID                  Root;
+    PATHID                  Metadata;       // resources\project
+    std::vector<PATHID>     Files;          // sorted
+    volatile LONG           Stale;
+    int                     Watch;          // -1 if the folder is not watched
+} PROJECTINDEX;
+
+// An item of hashed metadata: the id of its parent folder, from the name
+// of the folder its metadata is in, and its name.
+typedef struct PROJECTITEM {
+    std::string             Parent;
+    std::string             Location;
+} PROJECTITEM;
+
+typedef struct PROJECTSCAN {
+    PROJECTINDEX                       *Project;
+    std::vector<PATHID>                 Files;
+    std::map<std::string, PROJECTITEM>  Items;      // by id
+    std::string                         Folder;     // of the metadata file being parsed
+    std::string                         Item;       // its item id
+} PROJECTSCAN;
+
+static SRWLOCK                              gProjectLock = SRWLOCK_INIT;
+static std::map<PATHID, PROJECTINDEX *>     gProjects;      // by manifest
+
+static void decodeEntities(std::string &text) {
+    size_t amp = text.find('&');
+    if (amp == std::string::npos)
+        return;
+    std::string decoded = text.substr(0, amp);
+    for (size_t i = amp; i < text.size(); i++) {
+        size_t semi;
+        if (text[i] != '&' || (semi = text.find(';', i)) == std::string::npos) {
+            decoded += text[i];
+            continue;
+        }
+        std::string entity = text.substr(i + 1, semi - i - 1);
+        if (entity == "amp")
+            decoded += '&';
+        else if (entity == "lt")
+            decoded += '<';
+        else if (entity == "gt")
+            decoded += '>';
+        else if (entity == "quot")
+            decoded += '"';
+        else if (entity == "apos")
+            decoded += '\'';
+        else if (!entity.empty() && entity[0] == '#') {
+            unsigned long code = entity.size() > 1 && (entity[1] == 'x' || entity[1] == 'X') ?
+                strtoul(entity.c_str() + 2, NULL, 16) : strtoul(entity.c_str() + 1, NULL, 10);
+            // Names are kept as UTF-8, as the file has them.
+            if (code < 0x80) {
+                decoded += (char)code;
+            } else if (code < 0x800) {
+                decoded += (char)(0xc0 | (code >> 6));
+                decoded += (char)(0x80 | (code & 0x3f));
+            } else {
+                decoded += (char)(0xe0 | ((code >> 12) & 0x0f));
+                decoded += (char)(0x80 | ((code >> 6) & 0x3f));
+                decoded += (char)(0x80 | (code & 0x3f));
+            }
+        } else {
+            decoded += text.substr(i, semi - i + 1);
+        }
+        i = semi;
+    }
+    text.swap(decoded);
+}
+
+static void parseTag(const std::string &tag, XMLCALLBACK callback, void *context) {
+    size_t i = 0;
+    while (i < tag.size() && !isspace((unsigned char)tag[i]) && tag[i] != '/')
+        i++;
+    std::string element = tag.substr(0, i);
+    std::vector<XMLATTRIBUTE> attributes;
+    while (i < tag.size()) {
+        while (i < tag.size() && (isspace((unsigned char)tag[i]) || tag[i] == '/'))
+            i++;
+        size_t nameStart = i;
+        while (i < tag.size() && tag[i] != '=' && !isspace((unsigned char)tag[i]))
+            i++;
+        std::string name = tag.substr(nameStart, i - nameStart);
+        while (i < tag.size() && (isspace((unsigned char)tag[i]) || tag[i] == '='))
+            i++;
+        if (i >= tag.size() || (tag[i] != '"' && tag[i] != '\''))
+            break;
+        char quote = tag[i++];
+        size_t end = tag.find(quote, i);
+        if (end == std::string::npos)
+            break;
+        std::string value = tag.substr(i, end - i);
+        decodeEntities(value);
+        attributes.push_back(XMLATTRIBUTE(name, value));
+        i = end + 1;
+    }
+    callback(context, element, attributes);
+}
+
+/*
+* Call callback with the name and attributes of each start tag in an XML
+* file, reading it a buffer at a time. Text, comments, processing
+* instructions, declarations and end tags are skipped.
+*/
+static bool parseXmlFile(const char *fileName, XMLCALLBACK callback, void *context) {
+    HANDLE file = CreateFile(fileName, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+        OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+    std::vector<char> buffer(XML_BUFFER_SIZE);
+    std::string pending;
+    DWORD got;
+    while (ReadFile(file, &buffer[0], XML_BUFFER_SIZE, &got, NULL) && got > 0) {
+        pending.append(&buffer[0], got);
+        size_t pos = 0;
+        for (;;) {
+            size_t lt = pending.find('<', pos);
+            if (lt == std::string::npos) {
+                pos = pending.size();
+                break;
+            }
+            pos = lt;
+            const char *close = NULL;
+            if (pending.compare(lt, 4, "<!--") == 0)
+                close = "-->";
+            else if (pending.compare(lt, 9, "<![CDATA[") == 0)
+                close = "]]>";
+            else if (pending.compare(lt, 2, "<?") == 0)
+                close = "?>";
+            else if (pending.size() - lt < 9 && (lt + 1 == pending.size() || pending[lt + 1] == '!'))
+                break;      // may be one of the above, once the rest is read
+            if (close != NULL) {
+                size_t end = pending.find(close, lt + 2);
+                if (end == std::string::npos)
+                    break;
+                pos = end + strlen(close);
+                continue;
+            }
+            size_t end = lt + 1;
+            char quote = 0;
+            for (; end < pending.size(); end++) {
+                char c = pending[end];
+                if (quote != 0) {
+                    if (c == quote)
+                        quote = 0;
+                } else if (c == '"' || c == '\'') {
+                    quote = c;
+                } else if (c == '>') {
+                    break;
+                }
+            }
+            if (end >= pending.size())
+                break;
+            if (pending[lt + 1] != '/' && pending[lt + 1] != '!')
+                parseTag(pending.substr(lt + 1, end - lt - 1), callback, context);
+            pos = end + 1;
+        }
+        pending.erase(0, pos);
+    }
+    CloseHandle(file);
+    return true;
+}
+
+static const std::string *attribute(const std::vector<XMLATTRIBUTE> &attributes, const char *name) {
+    for (size_t i = 0; i < attributes.size(); i++) {
+        if (_stricmp(attributes[i].first.c_str(), name) == 0)
+            return &attributes[i].second;
+    }
+    return NULL;
+}
+
+static PATHID memberPath(PATHID root, std::string location) {
+    for (size_t i = 0; i < location.size(); i++) {
+        if (location[i] == '/')
+            location[i] = '\\';
+    }
+    while (!location.empty() && location[0] == '\\')
+        location.erase(0, 1);
+    if (location.empty())
+        return NO_PATH;
+    return internPath((std::string(pathName(root)) + "\\" + location).c_str());
+}
+
+static void onManifestElement(void *context, const std::string &element, const std::vector<XMLATTRIBUTE> &attributes) {
+    PROJECTSCAN *scan = (PROJECTSCAN *) context;
+    if (_stricmp(element.c_str(), "File") != 0)
+        return;
+    const std::string *location = attribute(attributes, "Location");
+    PATHID file = location != NULL ? memberPath(scan->Project->Root, *location) : NO_PATH;
+    if (file != NO_PATH)
+        scan->Files.push_back(file);
+}
+
+static void onMetadataElement(void *context, const std::string &element, const std::vector<XMLATTRIBUTE> &attributes) {
+    PROJECTSCAN *scan = (PROJECTSCAN *) context;
+    if (element != "Info")
+        return;
+    const std::string *location = attribute(attributes, "location");
+    const std::string *type = attribute(attributes, "type");
+    if (location == NULL || type == NULL || *type != "File")
+        return;
+    PROJECTITEM &item = scan->Items[scan->Item];
+    item.Parent   = scan->Folder;
+    item.Location = *location;
+}
+
+static bool endsWith(const std::string &text, const char *suffix) {
+    size_t length = strlen(suffix);
+    return text.size() >= length && _stricmp(text.c_str() + text.size() - length, suffix) == 0;
+}
+
+/*
+* Read the metadata below folder. relative is the member path the folder
+* stands for in the Root.type.Files layout, or NULL outside it.
+*/
+static void scanMetadata(PROJECTSCAN *scan, const std::string &folder, const std::string *relative) {
+    WIN32_FIND_DATA data;
+    HANDLE find = FindFirstFile((folder + "\\*").c_str(), &data);
+    if (find == INVALID_HANDLE_VALUE)
+        return;
+    std::string folderName = folder.substr(folder.rfind('\\') + 1);
+    do {
+        std::string name = data.cFileName;
+        if (name == "." || name == "..")
+            continue;
+        std::string path = folder + "\\" + name;
+        if ((data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0) {
+            if ((data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) != 0)
+                continue;
+            if (relative == NULL && _stricmp(name.c_str(), "Root.type.Files") == 0) {
+                std::string top;
+                scanMetadata(scan, path, &top);
+            } else if (relative != NULL && endsWith(name, ".type.File")) {
+                std::string sub = *relative + name.substr(0, name.size() - 10) + "\\";
+                scanMetadata(scan, path, &sub);
+            } else if (relative == NULL) {
+                scanMetadata(scan, path, NULL);
+            }
+        } else if (relative != NULL) {
+            if (endsWith(name, ".type.File.xml")) {
+                PATHID file = memberPath(scan->Project->Root, *relative + name.substr(0, name.size() - 14));
+                if (file != NO_PATH)
+                    scan->Files.push_back(file);
+            }
+        } else if (endsWith(name, ".xml")) {
+            // <id>p.xml or <id>d.xml, or <id>.xml.
+            std::string item = name.substr(0, name.size() - 4);
+            if (endsWith(item, "p") || endsWith(item, "d"))
+                item.erase(item.size() - 1);
+            scan->Folder = folderName;
+            scan->Item   = item;
+            parseXmlFile(path.c_str(), onMetadataElement, scan);
+        }
+    } while (FindNextFile(find, &data));
+    FindClose(find);
+}
+
+/*
+* The member path of an item of hashed metadata: its parent's path and
+* its name. Items whose parent is not an item are in the project folder.
+*/
+static bool itemPath(const PROJECTSCAN *scan, const std::string &id, std::string &path) {
+    std::vector<const PROJECTITEM *> chain;
+    std::string current = id;
+    std::map<std::string, PROJECTITEM>::const_iterator it;
+    while ((it = scan->Items.find(current)) != scan->Items.end()) {
+        if (chain.size() >= MAX_PROJECT_DEPTH)
+            return false;
+        chain.push_back(&it->second);
+        current = it->second.Parent;
+    }
+    path.clear();
+    for (size_t i = chain.size(); i-- > 0;)
+        path += (path.empty() ? "" : "\\") + chain[i]->Location;
+    return !path.empty();
+}
+
+static bool buildIndex(PROJECTINDEX *project) {
+    PROJECTSCAN scan;
+    scan.Project = project;
+    std::string manifest;
+    longPathName(project->Manifest, manifest);
+    if (!parseXmlFile(manifest.c_str(), onManifestElement, &scan))
+        return false;
+    scanMetadata(&scan, pathName(project->Metadata), NULL);
+    std::string path;
+    for (std::map<std::string, PROJECTITEM>::const_iterator it = scan.Items.begin(); it != scan.Items.end(); ++it) {
+        PATHID file = itemPath(&scan, it->first, path) ? memberPath(project->Root, path) : NO_PATH;
+        if (file != NO_PATH)
+            scan.Files.push_back(file);
+    }
+
+    std::sort(scan.Files.begin(), scan.Files.end());
+    scan.Files.erase(std::unique(scan.Files.begin(), scan.Files.end()), scan.Files.end());
+    project->Files.clear();
+    for (size_t i = 0; i < scan.Files.size(); i++) {
+        DWORD attr = GetFileAttributes(pathName(scan.Files[i]));
+        if (attr == INVALID_FILE_ATTRIBUTES || (attr & FILE_ATTRIBUTE_DIRECTORY) == 0)
+            project->Files.push_back(scan.Files[i]);
+    }
+    return true;
+}
+
+static void onProjectChange(void *context, int numberOfChanges, const PATHID *changes) {
+    PROJECTINDEX *project = (PROJECTINDEX *) context;
+    for (int i = 0; i < numberOfChanges; i++) {
+        if (changes[i] == NO_PATH || changes[i] == project->Manifest || changes[i] == project->Metadata ||
+            isPathUnder(changes[i], project->Metadata)) {
+            InterlockedExchange(&project->Stale, 1);
+            return;
+        }
+    }
+}
+
+/*
+* The index of manifest, read again if it is stale. Called with
+* gProjectLock held exclusively.
+*/
+static PROJECTINDEX *currentIndex(PATHID manifest) {
+    PROJECTINDEX *project;
+    std::map<PATHID, PROJECTINDEX *>::iterator it = gProjects.find(manifest);
+    if (it != gProjects.end()) {
+        project = it->second;
+        // Without a watch nothing says when it changes, so a watch that
+        // stopped is replaced before the index is read again.
+        bool watching = isWatching(project->Watch);
+        if (watching && InterlockedExchange(&project->Stale, 0) == 0)
+            return project;
+        if (!watching) {
+            if (project->Watch >= 0)
+                removeWatch(project->Watch);
+            project->Watch = addWatch(project->Root, onProjectChange, project);
+            InterlockedExchange(&project->Stale, 0);
+        }
+    } else {
+        project = new PROJECTINDEX;
+        project->Manifest = manifest;
+        project->Root     = parentPathId(manifest);
+        project->Metadata = internPath((std::string(pathName(project->Root)) + "\\resources\\project").c_str());
+        project->Stale    = 0;
+        project->Watch    = addWatch(project->Root, onProjectChange, project);
+        gProjects[manifest] = project;
+    }
+    if (!buildIndex(project)) {
+        if (project->Watch >= 0)
+            removeWatch(project->Watch);
+        gProjects.erase(manifest);
+        delete project;
+        return NULL;
+    }
+    return project;
+}
+
+bool projectFiles(PATHID manifest, std::vector<PATHID> &files) {
+    AcquireSRWLockExclusive(&gProjectLock);
+    PROJECTINDEX *project = currentIndex(manifest);
+    if (project != NULL)
+        files = project->Files;
+    ReleaseSRWLockExclusive(&gProjectLock);
+    return project != NULL;
+}
+
+void closeProjects() {
+    AcquireSRWLockExclusive(&gProjectLock);
+    for (std::map<PATHID, PROJECTINDEX *>::iterator it = gProjects.begin(); it != gProjects.end(); ++it) {
+        if (it->second->Watch >= 0)
+            removeWatch(it->second->Watch);
+        delete it->second;
+    }
+    gProjects.clear();
+    ReleaseSRWLockExclusive(&gProjectLock);
+}
@@ -0,0 +1,44 @@
+/*
+*
+*
+* The source code contained in this listing contains proprietary and
+* confidential trade secrets of The MathWorks, Inc.  The use, modification,
+* or development of derivative work based on the code or ideas obtained
+* from the code is prohibited without the express written permission of The
+* MathWorks, Inc. The disclosure of this code to any party not authorized
+* by The MathWorks, Inc. is strictly forbidden.
+* CONFIDENTIAL AND CONTAINING PROPRIETARY TRADE SECRETS
+*/
+
+#ifndef VERCTRLPROJECT_H
+#define VERCTRLPROJECT_H
+
+#include <vector>
+
+#include "verctrlPath.h"
+
+/*
+* Simulink project membership. The files of a project are read from its
+* .prj file and the metadata under resources\project next to it, with a
+* streaming XML parse, and kept as a sorted list of path ids. A watch on
+* the project folder marks the list stale when the .prj or the metadata
+* change, and it is read again the next time it is asked for.
+*
+* Files are listed in any of these forms:
+*   <File Location="folder/file.m"/> in the .prj
+*   resources\project\Root.type.Files\folder.type.File\file.m.type.File.xml
+*   <Info location="file.m" type="File"/> in the metadata of each item,
+*   in a folder named by the id of the item's parent folder
+* Folders listed as members are left out.
+*
+* All functions are thread-safe and none of them use the MEX API.
+*/
+
+// The files of the project defined by manifest, a .prj file, sorted by
+// id. Returns false if manifest cannot be read.
+bool projectFiles(PATHID manifest, std::vector<PATHID> &files);
+
+// Forget every project and stop watching their folders.
+void closeProjects();
+
+#endif
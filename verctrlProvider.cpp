@@ -0,0 +1,492 @@
+/*
+*
+*
+* The source code contained in this listing contains proprietary and
+* confidential trade secrets of The MathWorks, Inc.  The use, modification,
+* or development of derivative work based on the code or ideas obtained
+* from the code is prohibited without the express written permission of The
+* MathWorks, Inc. The disclosure of this code to any party not authorized
+* by The MathWorks, Inc. is strictly forbidden.
+* CONFIDENTIAL AND CONTAINING PROPRIETARY TRADE SECRETS
+*/
+
+/*
+* Registry of loaded SCC providers, their session pools and the folders
+* routed to them.
+*
+* Locking: gRegistryLock guards the provider list and the folder
+* mappings, and is only held briefly. Each provider's PoolLock guards
+* its sessions. The provider is never called with either lock held,
+* except for the first SccInitialize of a provider being loaded.
+*/
+
+#include <windows.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "scc.h"
+#include "verctrl.h"
+#include "verctrlRecord.h"
+#include "verctrlProvider.h"
+
+// Entry point names, indexed by SccProcId.
+static const char *sccProcNames[SCCPROC_COUNT] = {
+    "SccInitialize",
+    "SccUninitialize",
+    "SccOpenProject",
+    "SccGetProjPath",
+    "SccCloseProject",
+    "SccGet",
+    "SccCheckout",
+    "SccCheckin",
+    "SccUncheckout",
+    "SccAdd",
+    "SccRemove",
+    "SccRename",
+    "SccDiff",
+    "SccHistory",
+    "SccProperties",
+    "SccQueryInfo",
+    "SccGetCommandOptions",
+    "SccRunScc"
+};
+
+typedef struct FOLDERMAPPING {
+    PATHID      Folder;
+    std::string LibPath;
+} FOLDERMAPPING;
+
+static SRWLOCK                      gRegistryLock   = SRWLOCK_INIT;
+static SCCPROVIDER                 *gProviders      = NULL;
+static std::vector<FOLDERMAPPING>   gMappings;
+static int                          gPoolSize       = 0;    // 0: one per processor
+
+static SCCPROVIDER *findProviderLocked(const char *libPath) {
+    for (SCCPROVIDER *p = gProviders; p != NULL; p = p->Next) {
+        if (_stricmp(p->LibPath, libPath) == 0)
+            return p;
+    }
+    return NULL;
+}
+
+SCCPROVIDER *findProvider(const char *libPath) {
+    AcquireSRWLockShared(&gRegistryLock);
+    SCCPROVIDER *provider = findProviderLocked(libPath);
+    ReleaseSRWLockShared(&gRegistryLock);
+    return provider;
+}
+
+bool hasProviders() {
+    return gProviders != NULL;
+}
+
+/*
+* The thread a provider must be called on: 0 if it is reentrant or
+* libPath is not loaded, otherwise the thread that loaded it.
+*/
+DWORD providerOwnerThread(const char *libPath) {
+    AcquireSRWLockShared(&gRegistryLock);
+    SCCPROVIDER *provider = findProviderLocked(libPath);
+    DWORD owner = 0;
+    if (provider != NULL && (provider->Capability & SCC_CAP_REENTRANT) == 0)
+        owner = provider->OwnerThread;
+    ReleaseSRWLockShared(&gRegistryLock);
+    return owner;
+}
+
+/*
+* Initialize a new context on the provider.
+*/
+static SCCSESSION *newSession(SCCPROVIDER *provider, HWND hWnd, SCCRTN *rtn) {
+    SCCSESSION *session = (SCCSESSION *) calloc(1, sizeof(SCCSESSION));
+    char sccName[SCC_NAME_LEN + 1];
+    char axPath[SCC_PRJPATH_LEN + 1];
+    LONG capability         = 0;
+    LONG checkoutCommentLen = 0;
+    LONG commentLen         = 0;
+    sccName[0]  = '\0';
+    axPath[0]   = '\0';
+
+    SCCRECORD rec;
+    recordBegin(&rec, provider->LibPath, NULL, SCCPROC_INITIALIZE, 0, NULL, "MATLAB", 0);
+    *rtn = (*(SccInitialize_PROC) provider->Procs[SCCPROC_INITIALIZE])
+        (&session->Context, hWnd, "MATLAB", sccName, &capability,
+        axPath, &checkoutCommentLen, &commentLen);
+    LONG initResults[3]         = {capability, checkoutCommentLen, commentLen};
+    const char *initStrings[2]  = {sccName, axPath};
+    rec.Context                 = session->Context;
+    recordEnd(&rec, *rtn, 3, initResults, 2, initStrings);
+
+    if (IS_SCC_ERROR(*rtn)) {
+        free(session);
+        return NULL;
+    }
+    if (provider->Sessions == NULL) {
+        strcpy(provider->SccName, sccName);
+        provider->Capability            = capability;
+        provider->CheckoutCommentLen    = checkoutCommentLen;
+        provider->CommentLen            = commentLen;
+    }
+    session->Provider = provider;
+
+    // get the user name from the environment, it's used when opening projects
+    const char *usrNm = getenv("USER");
+    if (usrNm != NULL && strlen(usrNm) <= SCC_USER_LEN) {
+        strcpy(session->UserName, usrNm);
+    }
+    return session;
+}
+
+static void deleteSession(SCCSESSION *session) {
+    closeSessionProject(session);
+    SCCRECORD rec;
+    recordBegin(&rec, session->Provider->LibPath, session->Context, SCCPROC_UNINITIALIZE, 0, NULL, NULL, 0);
+    long rtn = (*(SccUninitialize_PROC) session->Provider->Procs[SCCPROC_UNINITIALIZE])
+        (session->Context);
+    recordEnd(&rec, rtn, 0, NULL, 0, NULL);
+    free(session);
+}
+
+/*
+* Number of sessions the provider may have open at once.
+*/
+static int poolSizeFor(const SCCPROVIDER *provider) {
+    if ((provider->Capability & SCC_CAP_REENTRANT) == 0)
+        return 1;
+    int size = gPoolSize;
+    if (size <= 0) {
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+        size = (int)info.dwNumberOfProcessors;
+    }
+    if (size < 1)
+        size = 1;
+    return size < SCC_MAX_SESSIONS ? size : SCC_MAX_SESSIONS;
+}
+
+/*
+* Return the provider for libPath, loading the library and initializing
+* its first session if this is the first time it is used. On failure
+* NULL is returned and *loaded tells whether the library itself could be
+* loaded.
+*/
+SCCPROVIDER *startProvider(HWND hWnd, const char *libPath, bool *loaded, SCCRTN *rtn) {
+    *loaded = true;
+    *rtn    = SCC_OK;
+
+    AcquireSRWLockExclusive(&gRegistryLock);
+    SCCPROVIDER *provider = findProviderLocked(libPath);
+    if (provider != NULL) {
+        ReleaseSRWLockExclusive(&gRegistryLock);
+        return provider;
+    }
+
+    HMODULE lib = LoadLibrary(libPath);
+    if (lib == NULL) {
+        ReleaseSRWLockExclusive(&gRegistryLock);
+        *loaded = false;
+        *rtn    = SCC_E_INITIALIZEFAILED;
+        return NULL;
+    }
+
+    provider = (SCCPROVIDER *) calloc(1, sizeof(SCCPROVIDER));
+    strncpy(provider->LibPath, libPath, _MAX_PATH - 1);
+    provider->Lib           = lib;
+    provider->OwnerThread   = GetCurrentThreadId();
+    for (int i = 0; i < SCCPROC_COUNT; i++)
+        provider->Procs[i] = GetProcAddress(lib, sccProcNames[i]);
+
+    SCCSESSION *session = newSession(provider, hWnd, rtn);
+    if (session == NULL) {
+        ReleaseSRWLockExclusive(&gRegistryLock);
+        FreeLibrary(lib);
+        free(provider);
+        return NULL;
+    }
+    InitializeCriticalSection(&provider->PoolLock);
+    InitializeConditionVariable(&provider->PoolChanged);
+    provider->Sessions          = session;
+    provider->NumberOfSessions  = 1;
+    provider->MaxSessions       = poolSizeFor(provider);
+
+    provider->Next  = gProviders;
+    gProviders      = provider;
+    ReleaseSRWLockExclusive(&gRegistryLock);
+    return provider;
+}
+
+/*
+* Remove the provider from the registry, wait for every thread using it
+* to release its session, then close all its sessions and free it.
+*/
+void unloadProvider(SCCPROVIDER *provider) {
+    bool found = false;
+    AcquireSRWLockExclusive(&gRegistryLock);
+    for (SCCPROVIDER **link = &gProviders; *link != NULL; link = &(*link)->Next) {
+        if (*link == provider) {
+            *link = provider->Next;
+            found = true;
+            break;
+        }
+    }
+    ReleaseSRWLockExclusive(&gRegistryLock);
+    if (!found)
+        return;
+
+    EnterCriticalSection(&provider->PoolLock);
+    provider->Closing = true;
+    WakeAllConditionVariable(&provider->PoolChanged);
+    while (provider->Users > 0)
+        SleepConditionVariableCS(&provider->PoolChanged, &provider->PoolLock, INFINITE);
+    LeaveCriticalSection(&provider->PoolLock);
+
+    while (provider->Sessions != NULL) {
+        SCCSESSION *session = provider->Sessions;
+        provider->Sessions  = session->Next;
+        deleteSession(session);
+    }
+    DeleteCriticalSection(&provider->PoolLock);
+    FreeLibrary(provider->Lib);
+    free(provider);
+}
+
+void unloadAllProviders() {
+    for (;;) {
+        AcquireSRWLockShared(&gRegistryLock);
+        SCCPROVIDER *provider = gProviders;
+        ReleaseSRWLockShared(&gRegistryLock);
+        if (provider == NULL)
+            break;
+        unloadProvider(provider);
+    }
+}
+
+/*
+* Borrow a session of the provider, waiting if they are all in use and
+* the pool is full. A session that already has the project for folder
+* open is preferred, so that projects are not reopened needlessly.
+* Returns NULL if the provider is being unloaded, no context could be
+* initialized, or the provider is not reentrant and this is not the
+* thread that loaded it.
+*/
+SCCSESSION *acquireSession(SCCPROVIDER *provider, HWND hWnd, PATHID folder) {
+    SCCSESSION *session = NULL;
+    if ((provider->Capability & SCC_CAP_REENTRANT) == 0 &&
+        provider->OwnerThread != GetCurrentThreadId())
+        return NULL;
+
+    EnterCriticalSection(&provider->PoolLock);
+    provider->Users++;
+    while (!provider->Closing) {
+        SCCSESSION *idle = NULL;
+        for (SCCSESSION *s = provider->Sessions; s != NULL; s = s->Next) {
+            if (s->Busy)
+                continue;
+            if (idle == NULL)
+                idle = s;
+            if (folder != NO_PATH && s->CurrentFolder == folder) {
+                idle = s;
+                break;
+            }
+        }
+        if (idle != NULL) {
+            session         = idle;
+            session->Busy   = true;
+            break;
+        }
+        if (provider->NumberOfSessions < provider->MaxSessions) {
+            // Reserve the slot, then initialize outside the lock.
+            provider->NumberOfSessions++;
+            LeaveCriticalSection(&provider->PoolLock);
+            SCCRTN rtn;
+            session = newSession(provider, hWnd, &rtn);
+            EnterCriticalSection(&provider->PoolLock);
+            if (session != NULL) {
+                session->Busy       = true;
+                session->Next       = provider->Sessions;
+                provider->Sessions  = session;
+                break;
+            }
+            // The provider will not give us another context; make do
+            // with the ones we have.
+            provider->NumberOfSessions--;
+            provider->MaxSessions = provider->NumberOfSessions;
+            if (provider->MaxSessions == 0)
+                break;
+            continue;
+        }
+        SleepConditionVariableCS(&provider->PoolChanged, &provider->PoolLock, INFINITE);
+    }
+    if (session == NULL) {
+        provider->Users--;
+        WakeAllConditionVariable(&provider->PoolChanged);
+    }
+    LeaveCriticalSection(&provider->PoolLock);
+    return session;
+}
+
+/*
+* As acquireSession, for callers that only know the library of the
+* provider. Returns NULL if that library is not loaded.
+*/
+SCCSESSION *acquireSessionForLib(const char *libPath, HWND hWnd, PATHID folder) {
+    AcquireSRWLockShared(&gRegistryLock);
+    SCCPROVIDER *provider = findProviderLocked(libPath);
+    if (provider != NULL) {
+        // Count ourselves as a user before the registry lock is dropped,
+        // so that the provider cannot be freed in between.
+        EnterCriticalSection(&provider->PoolLock);
+        provider->Users++;
+        LeaveCriticalSection(&provider->PoolLock);
+    }
+    ReleaseSRWLockShared(&gRegistryLock);
+    if (provider == NULL)
+        return NULL;
+
+    SCCSESSION *session = acquireSession(provider, hWnd, folder);
+    EnterCriticalSection(&provider->PoolLock);
+    provider->Users--;
+    WakeAllConditionVariable(&provider->PoolChanged);
+    LeaveCriticalSection(&provider->PoolLock);
+    return session;
+}
+
+void releaseSession(SCCSESSION *session) {
+    SCCPROVIDER *provider = session->Provider;
+    EnterCriticalSection(&provider->PoolLock);
+    session->Busy = false;
+    provider->Users--;
+    WakeAllConditionVariable(&provider->PoolChanged);
+    LeaveCriticalSection(&provider->PoolLock);
+}
+
+/*
+* Open the project for folder in the session, closing the project it
+* has open.
+*/
+SCCRTN openSessionProject(SCCSESSION *session, HWND hWnd, PATHID folder,
+                          const char *projName, const char *axPath) {
+    const char *localDir = pathName(folder);
+    char proj[SCC_PRJPATH_LEN + 1];
+    char aux[SCC_PRJPATH_LEN + 1];
+    strncpy(proj, projName, SCC_PRJPATH_LEN);
+    proj[SCC_PRJPATH_LEN] = '\0';
+    strncpy(aux, axPath, SCC_PRJPATH_LEN);
+    aux[SCC_PRJPATH_LEN] = '\0';
+
+    closeSessionProject(session);
+
+    LPCSTR openDir[1] = {localDir};
+    SCCRECORD rec;
+    recordBegin(&rec, session->Provider->LibPath, session->Context, SCCPROC_OPENPROJECT, 1, openDir, "", SCC_OP_SILENTOPEN & ~SCC_OP_CREATEIFNEW);
+    SCCRTN rtn = (*(SccOpenProject_PROC) session->Provider->Procs[SCCPROC_OPENPROJECT])
+        (session->Context, hWnd, session->UserName, proj, localDir,
+        aux, "", NULL, SCC_OP_SILENTOPEN & ~SCC_OP_CREATEIFNEW);
+    const char *openStrings[3] = {session->UserName, proj, aux};
+    recordEnd(&rec, rtn, 0, NULL, 3, openStrings);
+
+    if (IS_SCC_SUCCESS(rtn))
+        session->CurrentFolder = folder;
+    return rtn;
+}
+
+/*
+* Close the project currently opened in the session, if any.
+*/
+void closeSessionProject(SCCSESSION *session) {
+    SCCRECORD rec;
+    recordBegin(&rec, session->Provider->LibPath, session->Context, SCCPROC_CLOSEPROJECT, 0, NULL, NULL, 0);
+    long rtn = (*(SccCloseProject_PROC) session->Provider->Procs[SCCPROC_CLOSEPROJECT])
+        (session->Context);
+    recordEnd(&rec, rtn, 0, NULL, 0, NULL);
+    session->CurrentFolder = NO_PATH;
+}
+
+/*
+* Set the number of sessions opened per provider; 0 selects one per
+* processor. Providers that do not report SCC_CAP_REENTRANT always get
+* a single session. Applies to providers loaded afterwards.
+*/
+void setSessionPoolSize(int size) {
+    gPoolSize = size;
+}
+
+int getSessionPoolSize() {
+    return gPoolSize;
+}
+
+/*
+* Route files under folder to the provider in libPath. An empty or NULL
+* libPath removes the mapping for the folder.
+*/
+void mapProviderFolder(const char *folder, const char *libPath) {
+    PATHID key = internPath(folder);
+    if (key == NO_PATH)
+        return;
+
+    AcquireSRWLockExclusive(&gRegistryLock);
+    size_t i = 0;
+    while (i < gMappings.size() && gMappings[i].Folder != key)
+        i++;
+    if (i < gMappings.size()) {
+        if (libPath == NULL || libPath[0] == '\0')
+            gMappings.erase(gMappings.begin() + i);
+        else
+            gMappings[i].LibPath = libPath;
+    } else if (libPath != NULL && libPath[0] != '\0') {
+        FOLDERMAPPING mapping;
+        mapping.Folder  = key;
+        mapping.LibPath = libPath;
+        gMappings.push_back(mapping);
+    }
+    ReleaseSRWLockExclusive(&gRegistryLock);
+}
+
+/*
+* Copy into libPath (_MAX_PATH) the library mapped to the deepest folder
+* containing path. Returns false if it is not under any mapped folder.
+*/
+bool providerLibForPath(PATHID path, char *libPath) {
+    bool found = false;
+
+    AcquireSRWLockShared(&gRegistryLock);
+    if (!gMappings.empty()) {
+        for (PATHID folder = path; folder != NO_PATH && !found; folder = parentPathId(folder)) {
+            for (size_t i = 0; i < gMappings.size(); i++) {
+                if (gMappings[i].Folder == folder) {
+                    strncpy(libPath, gMappings[i].LibPath.c_str(), _MAX_PATH - 1);
+                    libPath[_MAX_PATH - 1] = '\0';
+                    found = true;
+                    break;
+                }
+            }
+        }
+    }
+    ReleaseSRWLockShared(&gRegistryLock);
+    return found;
+}
+
+int getNumberOfMappings() {
+    AcquireSRWLockShared(&gRegistryLock);
+    int n = (int)gMappings.size();
+    ReleaseSRWLockShared(&gRegistryLock);
+    return n;
+}
+
+/*
+* Copy mapping number index into folder and libPath (_MAX_PATH each).
+*/
+bool getMapping(int index, char *folder, char *libPath) {
+    AcquireSRWLockShared(&gRegistryLock);
+    bool found = index >= 0 && index < (int)gMappings.size();
+    if (found) {
+        strncpy(folder, pathName(gMappings[index].Folder), _MAX_PATH - 1);
+        folder[_MAX_PATH - 1] = '\0';
+        strncpy(libPath, gMappings[index].LibPath.c_str(), _MAX_PATH - 1);
+        libPath[_MAX_PATH - 1] = '\0';
+    }
+    ReleaseSRWLockShared(&gRegistryLock);
+    return found;
+}
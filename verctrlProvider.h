@@ -0,0 +1,93 @@
+/*
+*
+*
+* The source code contained in this listing contains proprietary and
+* confidential trade secrets of The MathWorks, Inc.  The use, modification,
+* or development of derivative work based on the code or ideas obtained
+* from the code is prohibited without the express written permission of The
+* MathWorks, Inc. The disclosure of this code to any party not authorized
+* by The MathWorks, Inc. is strictly forbidden.
+* CONFIDENTIAL AND CONTAINING PROPRIETARY TRADE SECRETS
+*/
+
+#ifndef VERCTRLPROVIDER_H
+#define VERCTRLPROVIDER_H
+
+#include <windows.h>
+#include "scc.h"
+#include "verctrlRecord.h"
+#include "verctrlPath.h"
+
+// MSSCCI 1.3: the provider supports several contexts in use at once.
+// Not defined by older versions of scc.h.
+#ifndef SCC_CAP_REENTRANT
+#define SCC_CAP_REENTRANT 0x40000000L
+#endif
+
+// Upper bound on the number of contexts opened per provider.
+#define SCC_MAX_SESSIONS 16
+
+struct SCCPROVIDER;
+
+/*
+* One SCC context of a provider, from its own SccInitialize, with its
+* own open project. A session is used by one thread at a time.
+*/
+typedef struct SCCSESSION {
+    struct SCCPROVIDER *Provider;
+    void               *Context;
+    // Folder of the project currently open in Context, or NO_PATH.
+    PATHID              CurrentFolder;
+    char                UserName[SCC_USER_LEN + 1];
+    bool                Busy;
+    struct SCCSESSION  *Next;
+} SCCSESSION;
+
+/*
+* A loaded SCC provider library and the pool of sessions opened on it.
+* Each library is loaded once, however many folders are mapped to it.
+* A provider without SCC_CAP_REENTRANT may keep per-thread state, so it
+* is only ever called on the thread that loaded it.
+*/
+typedef struct SCCPROVIDER {
+    char                LibPath[_MAX_PATH];
+    HMODULE             Lib;
+    FARPROC             Procs[SCCPROC_COUNT];   // entry points, indexed by SccProcId
+    LONG                Capability;
+    LONG                CheckoutCommentLen;
+    LONG                CommentLen;
+    char                SccName[SCC_NAME_LEN + 1];
+    DWORD               OwnerThread;    // thread that loaded the library
+
+    CRITICAL_SECTION    PoolLock;
+    CONDITION_VARIABLE  PoolChanged;
+    SCCSESSION         *Sessions;
+    int                 NumberOfSessions;
+    int                 MaxSessions;
+    LONG                Users;      // threads holding or waiting for a session
+    bool                Closing;
+    struct SCCPROVIDER *Next;
+} SCCPROVIDER;
+
+SCCPROVIDER *findProvider(const char *libPath);
+SCCPROVIDER *startProvider(HWND hWnd, const char *libPath, bool *loaded, SCCRTN *rtn);
+void unloadProvider(SCCPROVIDER *provider);
+void unloadAllProviders();
+bool hasProviders();
+DWORD providerOwnerThread(const char *libPath);
+
+SCCSESSION *acquireSession(SCCPROVIDER *provider, HWND hWnd, PATHID folder);
+SCCSESSION *acquireSessionForLib(const char *libPath, HWND hWnd, PATHID folder);
+void releaseSession(SCCSESSION *session);
+SCCRTN openSessionProject(SCCSESSION *session, HWND hWnd, PATHID folder,
+                          const char *projName, const char *axPath);
+void closeSessionProject(SCCSESSION *session);
+void setSessionPoolSize(int size);
+int getSessionPoolSize();
+
+void mapProviderFolder(const char *folder, const char *libPath);
+bool providerLibForPath(PATHID path, char *libPath);
+int getNumberOfMappings();
+bool getMapping(int index, char *folder, char *libPath);
+
+#endif
@@ -0,0 +1,637 @@
+/*
+*
+*
+* The source code contained in this listing contains proprietary and
+* confidential trade secrets of The MathWorks, Inc.  The use, modification,
+* or development of derivative work based on the code or ideas obtained
+* from the code is prohibited without the express written permission of The
+* MathWorks, Inc. The disclosure of this code to any party not authorized
+* by The MathWorks, Inc. is strictly forbidden.
+* CONFIDENTIAL AND CONTAINING PROPRIETARY TRADE SECRETS
+*/
+
+/*
+* A ,v archive is an admin section, the delta nodes, the description and
+* the delta texts, newest first:
+*
+*   head 1.2; access; symbols; locks user:1.2; strict; comment @# @;
+*   1.2 date 2024.01.02.03.04.05; author user; state Exp; branches; next 1.1;
+*   1.1 date ...; author user; state Exp; branches; next ;
+*   desc @description@
+*   1.2 log @message@ text @the whole of revision 1.2@
+*   1.1 log @message@ text @edit script from 1.2 to 1.1@
+*
+* Strings are in @s, with @ doubled. An edit script is a list of "dL N",
+* which deletes N lines from line L, and "aL N" followed by N lines, which
+* adds them after line L, in increasing order of L, where L counts lines
+* of the newer revision.
+*
+* A checkin edits the archive in place: a new head number and locks, a
+* delta node and delta text for the new revision, and the old head's text
+* replaced by the script back to it. Everything else is copied as is.
+*/
+
+#include <windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <string>
+#include <vector>
+#include <utility>
+
+#include "verctrlPath.h"
+#include "verctrlRcs.h"
+
+// Upper bound on the threads checking in files at once.
+#define RCS_THREADS     16
+
+// Edit distance past which the diff stops looking for the shortest
+// script and replaces the rest of the file. Its trace takes about
+// RCS_MAX_EDITS squared ints.
+#define RCS_MAX_EDITS   1000
+
+typedef std::pair<std::string, std::string> RCSLOCK;       // user, revision
+
+typedef struct RCSARCHIVE {
+    std::string             Data;
+    std::string             Head;
+    size_t                  HeadStart;          // of the head number in Data
+    size_t                  HeadEnd;
+    std::string             Branch;
+    std::vector<RCSLOCK>    Locks;
+    size_t                  LocksStart;         // after "locks"
+    size_t                  LocksEnd;           // at its ';'
+    bool                    Strict;
+    bool                    Binary;             // expand @b@
+    size_t                  DeltasStart;        // of the first delta node
+    size_t                  HeadTextStart;      // of the head's delta text
+    size_t                  HeadTextValueStart; // of the @ string of its text
+    size_t                  HeadTextValueEnd;
+    std::string             HeadText;
+} RCSARCHIVE;
+
+typedef struct RCSTOKEN {
+    int             Type;       // ';', ':', '@' or 'w' for a word
+    size_t          Start;
+    size_t          End;
+} RCSTOKEN;
+
+typedef struct RCSPARSER {
+    const std::string  *Data;
+    size_t              Pos;
+    RCSTOKEN            Token;
+} RCSPARSER;
+
+static bool nextToken(RCSPARSER *p) {
+    const std::string &data = *p->Data;
+    while (p->Pos < data.size() && isspace((unsigned char)data[p->Pos]))
+        p->Pos++;
+    if (p->Pos >= data.size())
+        return false;
+    p->Token.Start = p->Pos;
+    char c = data[p->Pos];
+    if (c == ';' || c == ':') {
+        p->Token.Type = c;
+        p->Pos++;
+    } else if (c == '@') {
+        p->Token.Type = '@';
+        p->Pos++;
+        for (;;) {
+            size_t at = data.find('@', p->Pos);
+            if (at == std::string::npos)
+                return false;
+            p->Pos = at + 1;
+            if (p->Pos < data.size() && data[p->Pos] == '@')
+                p->Pos++;
+            else
+                break;
+        }
+    } else {
+        p->Token.Type = 'w';
+        while (p->Pos < data.size() && !isspace((unsigned char)data[p->Pos]) &&
+               data[p->Pos] != ';' && data[p->Pos] != ':' && data[p->Pos] != '@')
+            p->Pos++;
+    }
+    p->Token.End = p->Pos;
+    return true;
+}
+
+static std::string tokenText(const RCSPARSER *p) {
+    return p->Data->substr(p->Token.Start, p->Token.End - p->Token.Start);
+}
+
+static bool isWord(const RCSPARSER *p, const char *word) {
+    return p->Token.Type == 'w' && tokenText(p) == word;
+}
+
+static bool isRevision(const RCSPARSER *p) {
+    return p->Token.Type == 'w' && isdigit((unsigned char)(*p->Data)[p->Token.Start]);
+}
+
+static std::string unquote(const std::string &data, size_t start, size_t end) {
+    std::string text;
+    text.reserve(end - start);
+    for (size_t i = start + 1; i + 1 < end; i++) {
+        text += data[i];
+        if (data[i] == '@')
+            i++;
+    }
+    return text;
+}
+
+static std::string quote(const std::string &text) {
+    std::string quoted = "@";
+    quoted.reserve(text.size() + 2);
+    for (size_t i = 0; i < text.size(); i++) {
+        quoted += text[i];
+        if (text[i] == '@')
+            quoted += '@';
+    }
+    return quoted + "@";
+}
+
+// Skip to the ';' ending the phrase the parser is in.
+static bool skipPhrase(RCSPARSER *p) {
+    while (p->Token.Type != ';') {
+        if (!nextToken(p))
+            return false;
+    }
+    return true;
+}
+
+/*
+* Parse the parts of an archive a checkin changes.
+*/
+static bool parseArchive(RCSARCHIVE *archive, std::string &error) {
+    RCSPARSER parser;
+    RCSPARSER *p = &parser;
+    p->Data = &archive->Data;
+    p->Pos  = 0;
+    archive->Strict     = false;
+    archive->Binary     = false;
+    archive->LocksStart = archive->LocksEnd = 0;
+    archive->HeadStart  = archive->HeadEnd  = 0;
+    archive->HeadTextStart = 0;
+
+    // Admin phrases, up to the first delta node or desc.
+    if (!nextToken(p) || !isWord(p, "head")) {
+        error = "not an RCS archive";
+        return false;
+    }
+    for (;;) {
+        if (isRevision(p) || isWord(p, "desc"))
+            break;
+        if (p->Token.Type != 'w') {
+            error = "bad admin section";
+            return false;
+        }
+        std::string keyword = tokenText(p);
+        size_t keywordEnd = p->Token.End;
+        if (!nextToken(p))
+            break;
+        if (keyword == "head") {
+            archive->HeadStart = archive->HeadEnd = p->Token.Start;
+            if (isRevision(p)) {
+                archive->Head    = tokenText(p);
+                archive->HeadEnd = p->Token.End;
+                nextToken(p);
+            }
+        } else if (keyword == "branch" && isRevision(p)) {
+            archive->Branch = tokenText(p);
+        } else if (keyword == "locks") {
+            archive->LocksStart = keywordEnd;
+            while (p->Token.Type == 'w') {
+                std::string user = tokenText(p);
+                if (!nextToken(p) || p->Token.Type != ':' || !nextToken(p) || !isRevision(p)) {
+                    error = "bad locks";
+                    return false;
+                }
+                archive->Locks.push_back(RCSLOCK(user, tokenText(p)));
+                nextToken(p);
+            }
+            archive->LocksEnd = p->Token.Start;
+        } else if (keyword == "strict") {
+            archive->Strict = true;
+        } else if (keyword == "expand" && p->Token.Type == '@') {
+            archive->Binary = unquote(archive->Data, p->Token.Start, p->Token.End) == "b";
+        }
+        if (!skipPhrase(p) || !nextToken(p)) {
+            error = "truncated admin section";
+            return false;
+        }
+    }
+    if (archive->LocksEnd == 0) {
+        error = "no locks phrase";
+        return false;
+    }
+    archive->DeltasStart = p->Token.Start;
+
+    // Delta nodes, up to desc.
+    while (!isWord(p, "desc")) {
+        if (!nextToken(p)) {
+            error = "no description";
+            return false;
+        }
+    }
+    if (!nextToken(p) || p->Token.Type != '@' || !nextToken(p)) {
+        error = "bad description";
+        return false;
+    }
+
+    // Delta texts: the head's text is the whole revision.
+    while (isRevision(p)) {
+        bool isHead = tokenText(p) == archive->Head;
+        size_t start = p->Token.Start;
+        while (!isWord(p, "text")) {
+            if (!nextToken(p)) {
+                error = "truncated delta text";
+                return false;
+            }
+        }
+        if (!nextToken(p) || p->Token.Type != '@') {
+            error = "bad delta text";
+            return false;
+        }
+        if (isHead) {
+            archive->HeadTextStart      = start;
+            archive->HeadTextValueStart = p->Token.Start;
+            archive->HeadTextValueEnd   = p->Token.End;
+            archive->HeadText = unquote(archive->Data, p->Token.Start, p->Token.End);
+            return true;
+        }
+        if (!nextToken(p))
+            break;
+    }
+    error = "no text for the head revision";
+    return false;
+}
+
+static void splitLines(const std::string &text, std::vector<std::string> &lines) {
+    size_t start = 0;
+    while (start < text.size()) {
+        size_t end = text.find('\n', start);
+        end = end == std::string::npos ? text.size() : end + 1;
+        lines.push_back(text.substr(start, end - start));
+        start = end;
+    }
+}
+
+static void appendCommand(std::string &script, char command, size_t line, size_t count) {
+    char buffer[64];
+    _snprintf(buffer, sizeof(buffer), "%c%lu %lu\n", command, (unsigned long)line, (unsigned long)count);
+    buffer[sizeof(buffer) - 1] = '\0';
+    script += buffer;
+}
+
+/*
+* The edit script turning from into to. Common lines at either end are
+* skipped, and the rest is diffed with Myers' algorithm on line hashes.
+*/
+static void makeScript(const std::string &fromText, const std::string &toText, std::string &script) {
+    std::vector<std::string> a, b;
+    splitLines(fromText, a);
+    splitLines(toText, b);
+    size_t prefix = 0;
+    while (prefix < a.size() && prefix < b.size() && a[prefix] == b[prefix])
+        prefix++;
+    size_t suffix = 0;
+    while (suffix < a.size() - prefix && suffix < b.size() - prefix &&
+           a[a.size() - 1 - suffix] == b[b.size() - 1 - suffix])
+        suffix++;
+    int n = (int)(a.size() - prefix - suffix);
+    int m = (int)(b.size() - prefix - suffix);
+
+    std::vector<unsigned int> ha(n), hb(m);
+    for (int i = 0; i < n; i++) {
+        unsigned int h = 2166136261u;
+        for (size_t k = 0; k < a[prefix + i].size(); k++)
+            h = (h ^ (unsigned char)a[prefix + i][k]) * 16777619u;
+        ha[i] = h;
+    }
+    for (int j = 0; j < m; j++) {
+        unsigned int h = 2166136261u;
+        for (size_t k = 0; k < b[prefix + j].size(); k++)
+            h = (h ^ (unsigned char)b[prefix + j][k]) * 16777619u;
+        hb[j] = h;
+    }
+
+    // keep[i] is the line of b that line i of a is kept as, or -1.
+    std::vector<int> keep(n, -1);
+    int maxD = n + m < RCS_MAX_EDITS ? n + m : RCS_MAX_EDITS;
+    std::vector<std::vector<int> > trace;
+    std::vector<int> v(2 * maxD + 3, 0);
+    int offset = maxD + 1;
+    bool found = n + m == 0;
+    for (int d = 0; d <= maxD && !found; d++) {
+        for (int k = -d; k <= d; k += 2) {
+            int x = (k == -d || (k != d && v[offset + k - 1] < v[offset + k + 1])) ?
+                v[offset + k + 1] : v[offset + k - 1] + 1;
+            int y = x - k;
+            while (x < n && y < m && ha[x] == hb[y] && a[prefix + x] == b[prefix + y]) {
+                x++;
+                y++;
+            }
+            v[offset + k] = x;
+            if (x >= n && y >= m) {
+                found = true;
+                break;
+            }
+        }
+        trace.push_back(std::vector<int>(v.begin() + offset - d, v.begin() + offset + d + 1));
+    }
+    if (found) {
+        int x = n, y = m;
+        for (int d = (int)trace.size() - 1; d > 0; d--) {
+            const std::vector<int> &prev = trace[d - 1];   // holds k from -(d-1) to d-1
+            int k = x - y;
+            bool down = k == -d || (k != d && prev[k - 1 + d - 1] < prev[k + 1 + d - 1]);
+            int prevK = down ? k + 1 : k - 1;
+            int prevX = prev[prevK + d - 1];
+            int prevY = prevX - prevK;
+            int startX = down ? prevX : prevX + 1;
+            int startY = startX - k;
+            while (x > startX && y > startY)
+                keep[--x] = --y;
+            x = prevX;
+            y = prevY;
+        }
+        while (x > 0 && y > 0)
+            keep[--x] = --y;
+    }
+
+    // Runs of unkept lines of a are deleted; lines of b between kept
+    // lines are added after the last kept line before them.
+    int j = 0;
+    int i = 0;
+    while (i < n || j < m) {
+        int deleteStart = i;
+        while (i < n && keep[i] < 0)
+            i++;
+        if (i > deleteStart)
+            appendCommand(script, 'd', prefix + deleteStart + 1, i - deleteStart);
+        int addEnd = i < n ? keep[i] : m;
+        if (addEnd > j) {
+            appendCommand(script, 'a', prefix + i, addEnd - j);
+            for (; j < addEnd; j++)
+                script += b[prefix + j];
+        }
+        if (i < n) {
+            i++;
+            j++;
+        }
+    }
+}
+
+static void rcsDate(std::string &date) {
+    SYSTEMTIME now;
+    GetSystemTime(&now);
+    char buffer[32];
+    _snprintf(buffer, sizeof(buffer), "%04d.%02d.%02d.%02d.%02d.%02d",
+        now.wYear, now.wMonth, now.wDay, now.wHour, now.wMinute, now.wSecond);
+    buffer[sizeof(buffer) - 1] = '\0';
+    date = buffer;
+}
+
+// The login RCS records as author and locker.
+static void rcsUser(std::string &user) {
+    const char *login = getenv("LOGNAME");
+    if (login == NULL || login[0] == '\0')
+        login = getenv("USER");
+    if (login != NULL && login[0] != '\0') {
+        user = login;
+        return;
+    }
+    char name[256];
+    DWORD length = sizeof(name);
+    user = GetUserName(name, &length) ? name : "unknown";
+}
+
+static std::string nextRevision(const std::string &head) {
+    size_t dot = head.rfind('.');
+    unsigned long last = strtoul(head.c_str() + (dot == std::string::npos ? 0 : dot + 1), NULL, 10);
+    char buffer[32];
+    _snprintf(buffer, sizeof(buffer), "%lu", last + 1);
+    buffer[sizeof(buffer) - 1] = '\0';
+    return head.substr(0, dot == std::string::npos ? 0 : dot + 1) + buffer;
+}
+
+static std::string locksText(const std::vector<RCSLOCK> &locks) {
+    std::string text;
+    for (size_t i = 0; i < locks.size(); i++)
+        text += "\n\t" + locks[i].first + ":" + locks[i].second;
+    return text;
+}
+
+static void toLF(std::string &text) {
+    std::string lf;
+    lf.reserve(text.size());
+    for (size_t i = 0; i < text.size(); i++) {
+        if (text[i] != '\r' || i + 1 >= text.size() || text[i + 1] != '\n')
+            lf += text[i];
+    }
+    text.swap(lf);
+}
+
+static bool readFileText(const char *fileName, std::string &data) {
+    data.clear();
+    HANDLE file = CreateFile(fileName, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+    char buffer[64 * 1024];
+    DWORD got;
+    while (ReadFile(file, buffer, sizeof(buffer), &got, NULL) && got > 0)
+        data.append(buffer, got);
+    CloseHandle(file);
+    return true;
+}
+
+/*
+* Check in one file. Returns false with a message in error.
+*/
+static bool checkinFile(PATHID file, const char *comment, bool lock, std::string &revision, std::string &error) {
+    std::string workName = pathName(file);
+    size_t slash = workName.rfind('\\');
+    std::string folder = workName.substr(0, slash + 1);
+    std::string name = workName.substr(slash + 1);
+
+    std::string archiveName = folder + "RCS\\" + name + ",v";
+    std::string lockName = folder + "RCS\\," + name + ",";
+    DWORD rcsAttr = GetFileAttributes((folder + "RCS").c_str());
+    bool inRcsFolder = rcsAttr != INVALID_FILE_ATTRIBUTES && (rcsAttr & FILE_ATTRIBUTE_DIRECTORY) != 0;
+    if (GetFileAttributes(archiveName.c_str()) == INVALID_FILE_ATTRIBUTES &&
+        (!inRcsFolder || GetFileAttributes((folder + name + ",v").c_str()) != INVALID_FILE_ATTRIBUTES)) {
+        archiveName = folder + name + ",v";
+        lockName = folder + "," + name + ",";
+    }
+
+    std::string text;
+    if (!readFileText(workName.c_str(), text)) {
+        error = "cannot read " + workName;
+        return false;
+    }
+
+    // The lock file keeps other RCS commands off the archive until it is
+    // renamed over it.
+    HANDLE out = CreateFile(lockName.c_str(), GENERIC_WRITE, 0, NULL, CREATE_NEW, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (out == INVALID_HANDLE_VALUE) {
+        error = GetLastError() == ERROR_FILE_EXISTS ? archiveName + " is in use" : "cannot create " + lockName;
+        return false;
+    }
+
+    std::string user, date, result;
+    rcsUser(user);
+    rcsDate(date);
+    RCSARCHIVE archive;
+    bool exists = readFileText(archiveName.c_str(), archive.Data);
+    bool ok = true;
+    if (!exists) {
+        revision = "1.1";
+        toLF(text);
+        std::vector<RCSLOCK> locks;
+        if (lock)
+            locks.push_back(RCSLOCK(user, revision));
+        result = "head\t" + revision + ";\naccess;\nsymbols;\nlocks" + locksText(locks) +
+            "; strict;\ncomment\t@# @;\n\n\n" + revision + "\ndate\t" + date + ";\tauthor " + user +
+            ";\tstate Exp;\nbranches;\nnext\t;\n\n\ndesc\n" + quote(comment) + "\n\n\n" + revision +
+            "\nlog\n" + quote(std::string(comment) + "\n") + "\ntext\n" + quote(text) + "\n";
+    } else if (!parseArchive(&archive, error)) {
+        error = archiveName + ": " + error;
+        ok = false;
+    } else if (!archive.Branch.empty()) {
+        error = archiveName + ": checkin to the default branch " + archive.Branch + " is not supported";
+        ok = false;
+    } else {
+        // As ci: the user must hold the lock on the head if locking is
+        // strict, and nobody else may.
+        int mine = -1;
+        for (size_t i = 0; i < archive.Locks.size(); i++) {
+            if (archive.Locks[i].first == user)
+                mine = (int)i;
+            else if (archive.Locks[i].second == archive.Head)
+                error = archiveName + ": revision " + archive.Head + " is locked by " + archive.Locks[i].first;
+        }
+        if (!error.empty()) {
+            ok = false;
+        } else if (mine >= 0 && archive.Locks[mine].second != archive.Head) {
+            error = archiveName + ": revision " + archive.Locks[mine].second +
+                " locked by " + user + " is not the head; branches are not supported";
+            ok = false;
+        } else if (mine < 0 && archive.Strict) {
+            error = archiveName + ": no lock set by " + user;
+            ok = false;
+        } else {
+            if (mine >= 0)
+                archive.Locks.erase(archive.Locks.begin() + mine);
+            if (!archive.Binary)
+                toLF(text);
+
+            // An unchanged file reverts to the head, as with ci.
+            bool unchanged = text == archive.HeadText;
+            revision = unchanged ? archive.Head : nextRevision(archive.Head);
+            if (lock)
+                archive.Locks.push_back(RCSLOCK(user, revision));
+            const std::string &data = archive.Data;
+            result = data.substr(0, archive.HeadStart) + revision +
+                data.substr(archive.HeadEnd, archive.LocksStart - archive.HeadEnd) + locksText(archive.Locks);
+            if (unchanged) {
+                result += data.substr(archive.LocksEnd);
+            } else {
+                std::string script;
+                makeScript(text, archive.HeadText, script);
+                result += data.substr(archive.LocksEnd, archive.DeltasStart - archive.LocksEnd) +
+                    revision + "\ndate\t" + date + ";\tauthor " + user + ";\tstate Exp;\nbranches;\nnext\t" +
+                    archive.Head + ";\n\n" +
+                    data.substr(archive.DeltasStart, archive.HeadTextStart - archive.DeltasStart) +
+                    revision + "\nlog\n" + quote(std::string(comment) + "\n") + "\ntext\n" + quote(text) + "\n\n\n" +
+                    data.substr(archive.HeadTextStart, archive.HeadTextValueStart - archive.HeadTextStart) +
+                    quote(script) + data.substr(archive.HeadTextValueEnd);
+            }
+        }
+    }
+
+    DWORD written = 0;
+    if (ok && (!WriteFile(out, result.data(), (DWORD)result.size(), &written, NULL) || written != result.size() ||
+        !FlushFileBuffers(out))) {
+        error = "cannot write " + lockName;
+        ok = false;
+    }
+    CloseHandle(out);
+    if (ok) {
+        // Archives are read-only; MoveFileEx will not replace one that is.
+        // The new archive is on disk before it replaces the old one, so
+        // a crash leaves one or the other.
+        SetFileAttributes(archiveName.c_str(), FILE_ATTRIBUTE_NORMAL);
+        ok = MoveFileEx(lockName.c_str(), archiveName.c_str(),
+            MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+        if (ok)
+            SetFileAttributes(archiveName.c_str(), FILE_ATTRIBUTE_READONLY);
+        else
+            error = "cannot replace " + archiveName;
+    }
+    if (!ok) {
+        SetFileAttributes(lockName.c_str(), FILE_ATTRIBUTE_NORMAL);
+        DeleteFile(lockName.c_str());
+        return false;
+    }
+
+    // Like ci -l or ci -u: writable while locked, read-only otherwise.
+    DWORD attr = GetFileAttributes(workName.c_str());
+    if (attr != INVALID_FILE_ATTRIBUTES)
+        SetFileAttributes(workName.c_str(), lock ? (attr & ~FILE_ATTRIBUTE_READONLY) : (attr | FILE_ATTRIBUTE_READONLY));
+    return true;
+}
+
+typedef struct RCSWORK {
+    int                 NumberOfFiles;
+    const PATHID       *Files;
+    const char         *Comment;
+    bool                Lock;
+    std::string        *Revisions;
+    std::string        *Errors;
+    volatile LONG       Next;
+} RCSWORK;
+
+static DWORD WINAPI rcsThread(LPVOID arg) {
+    RCSWORK *work = (RCSWORK *) arg;
+    for (;;) {
+        LONG i = InterlockedIncrement(&work->Next) - 1;
+        if (i >= work->NumberOfFiles)
+            break;
+        work->Errors[i].clear();
+        if (!checkinFile(work->Files[i], work->Comment, work->Lock, work->Revisions[i], work->Errors[i]) &&
+            work->Errors[i].empty())
+            work->Errors[i] = std::string("cannot check in ") + pathName(work->Files[i]);
+    }
+    return 0;
+}
+
+bool rcsCheckin(int numberOfFiles, const PATHID *files, const char *comment, bool lock,
+                std::string *revisions, std::string *errors) {
+    RCSWORK work;
+    work.NumberOfFiles  = numberOfFiles;
+    work.Files          = files;
+    work.Comment        = comment != NULL ? comment : "";
+    work.Lock           = lock;
+    work.Revisions      = revisions;
+    work.Errors         = errors;
+    work.Next           = 0;
+    HANDLE threads[RCS_THREADS];
+    int started = 0;
+    for (int t = 1; t < RCS_THREADS && t < numberOfFiles; t++) {
+        threads[started] = CreateThread(NULL, 0, rcsThread, &work, 0, NULL);
+        if (threads[started] != NULL)
+            started++;
+    }
+    rcsThread(&work);
+    if (started > 0) {
+        WaitForMultipleObjects(started, threads, TRUE, INFINITE);
+        for (int t = 0; t < started; t++)
+            CloseHandle(threads[t]);
+    }
+    for (int i = 0; i < numberOfFiles; i++) {
+        if (!errors[i].empty())
+            return false;
+    }
+    return true;
+}
@@ -0,0 +1,42 @@
+/*
+*
+*
+* The source code contained in this listing contains proprietary and
+* confidential trade secrets of The MathWorks, Inc.  The use, modification,
+* or development of derivative work based on the code or ideas obtained
+* from the code is prohibited without the express written permission of The
+* MathWorks, Inc. The disclosure of this code to any party not authorized
+* by The MathWorks, Inc. is strictly forbidden.
+* CONFIDENTIAL AND CONTAINING PROPRIETARY TRADE SECRETS
+*/
+
+#ifndef VERCTRLRCS_H
+#define VERCTRLRCS_H
+
+#include <windows.h>
+#include <string>
+
+#include "verctrlPath.h"
+
+/*
+* RCS checkin without running ci. The new revision's text becomes the head
+* of the ,v archive and the previous head is stored as a reverse delta
+* from it, as ci does. The archive is written to the ,file, lock file
+* that RCS itself uses and renamed over the old one, so a concurrent ci
+* or co either sees the old archive or fails to lock it.
+*
+* Archives are found as ci finds them: RCS\file,v, then file,v, and new
+* ones are made in the RCS folder if there is one. Only the trunk is
+* supported; revisions locked on a branch are an error.
+*
+* Thread-safe, and none of the functions use the MEX API.
+*/
+
+// Check in files as "ci -q -t<comment> -m<comment>", with -l if lock is
+// set and -u otherwise. Files are checked in in parallel. revisions[i] is
+// the head revision of file i afterwards, and errors[i] is empty if it
+// was checked in. Returns false if any file failed.
+bool rcsCheckin(int numberOfFiles, const PATHID *files, const char *comment, bool lock,
+                std::string *revisions, std::string *errors);
+
+#endif
@@ -0,0 +1,272 @@
+/*
+*
+*
+* The source code contained in this listing contains proprietary and
+* confidential trade secrets of The MathWorks, Inc.  The use, modification,
+* or development of derivative work based on the code or ideas obtained
+* from the code is prohibited without the express written permission of The
+* MathWorks, Inc. The disclosure of this code to any party not authorized
+* by The MathWorks, Inc. is strictly forbidden.
+* CONFIDENTIAL AND CONTAINING PROPRIETARY TRADE SECRETS
+*/
+
+/*
+* Recording of the calls verctrl makes into the SCC provider.
+*
+* Log layout: the 4 byte magic and a version byte, followed by one
+* record per call:
+*
+*   string  provider library (version 2 on)
+*   varint  context the call was made in, numbered in the order they
+*           first appear in the log (version 2 on)
+*   u8      entry point (SccProcId)
+*   varint  wall time in microseconds
+*   svarint return code
+*   svarint options
+*   varint  number of files, followed by that many strings
+*   string  comment
+*   varint  number of results, followed by that many svarints
+*   varint  number of output strings, followed by that many strings
+*
+* Strings go through a table so that the same path is only written
+* once per log: 0 is a NULL string, an odd value (id << 1 | 1) refers
+* back to a string already in the table and an even value
+* ((length + 1) << 1) is followed by the bytes of a new string.
+* A context's number is dropped once it is uninitialized, since the
+* provider may reuse its address.
+*
+* Records are written under gRecordLock and flushed after it is let
+* go of, so that a crash of MATLAB loses at most the records being
+* written, without making other threads wait on the disk.
+*
+* This file does not use the MEX API; it is also built into the
+* replay provider, along with verctrlHash.cpp.
+*/
+
+#include <windows.h>
+#include <stdio.h>
+#include <string.h>
+#include <map>
+
+#include "verctrlHash.h"
+#include "verctrlRecord.h"
+
+static SRWLOCK  gRecordLock  = SRWLOCK_INIT;
+static FILE    *gRecordFile  = NULL;
+static LONGLONG gTicksPerSec = 0;
+static std::map<std::string, ULONGLONG> gStringIds;
+static std::map<const void *, ULONGLONG> gContextIds;
+static ULONGLONG gNextContext = 1;
+
+static void putTableString(std::string &buf, const char *str) {
+    if (str == NULL) {
+        putVarint(buf, 0);
+        return;
+    }
+    std::string key(str);
+    std::map<std::string, ULONGLONG>::const_iterator it = gStringIds.find(key);
+    if (it != gStringIds.end()) {
+        putVarint(buf, (it->second << 1) | 1);
+        return;
+    }
+    ULONGLONG id = gStringIds.size();
+    gStringIds[key] = id;
+    putVarint(buf, ((ULONGLONG)key.size() + 1) << 1);
+    buf += key;
+}
+
+bool startRecording(const char *logFile) {
+    FILE *fp = fopen(logFile, "wb");
+    if (fp == NULL)
+        return false;
+    setvbuf(fp, NULL, _IOFBF, 64 * 1024);
+    fwrite(SCCLOG_MAGIC, 1, 4, fp);
+    fputc(SCCLOG_VERSION, fp);
+
+    LARGE_INTEGER freq;
+    QueryPerformanceFrequency(&freq);
+
+    AcquireSRWLockExclusive(&gRecordLock);
+    if (gRecordFile != NULL)
+        fclose(gRecordFile);
+    gRecordFile  = fp;
+    gTicksPerSec = freq.QuadPart;
+    gStringIds.clear();
+    gContextIds.clear();
+    gNextContext = 1;
+    ReleaseSRWLockExclusive(&gRecordLock);
+    return true;
+}
+
+void stopRecording() {
+    AcquireSRWLockExclusive(&gRecordLock);
+    if (gRecordFile != NULL) {
+        fclose(gRecordFile);
+        gRecordFile = NULL;
+    }
+    gStringIds.clear();
+    gContextIds.clear();
+    ReleaseSRWLockExclusive(&gRecordLock);
+}
+
+bool isRecording() {
+    return gRecordFile != NULL;
+}
+
+void recordBegin(SCCRECORD *rec, LPCSTR provider, const void *context, int procId,
+                 LONG numberOfFiles, LPCSTR *fileNames, LPCSTR comment, LONG options) {
+    rec->Provider       = provider;
+    rec->Context        = context;
+    rec->ProcId         = procId;
+    rec->Options        = options;
+    rec->NumberOfFiles  = fileNames != NULL ? numberOfFiles : 0;
+    rec->FileNames      = fileNames;
+    rec->Comment        = comment;
+    rec->StartTicks     = 0;
+    if (isRecording()) {
+        LARGE_INTEGER now;
+        QueryPerformanceCounter(&now);
+        rec->StartTicks = now.QuadPart;
+    }
+}
+
+void recordEnd(SCCRECORD *rec, long rtn, LONG numberOfResults, const LONG *results,
+               int numberOfStrings, const char **strings) {
+    if (rec->StartTicks == 0)
+        return;
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+
+    AcquireSRWLockExclusive(&gRecordLock);
+    FILE *fp = gRecordFile;
+    if (fp != NULL) {
+        ULONGLONG micros = (ULONGLONG)(now.QuadPart - rec->StartTicks) * 1000000 / gTicksPerSec;
+        ULONGLONG context = 0;
+        if (rec->Context != NULL) {
+            std::map<const void *, ULONGLONG>::iterator it = gContextIds.find(rec->Context);
+            if (it == gContextIds.end())
+                it = gContextIds.insert(std::make_pair(rec->Context, gNextContext++)).first;
+            context = it->second;
+            if (rec->ProcId == SCCPROC_UNINITIALIZE)
+                gContextIds.erase(it);
+        }
+        std::string record;
+        putTableString(record, rec->Provider);
+        putVarint(record, context);
+        record += (char)rec->ProcId;
+        putVarint(record, micros);
+        putSigned(record, rtn);
+        putSigned(record, rec->Options);
+        putVarint(record, rec->NumberOfFiles);
+        for (LONG i = 0; i < rec->NumberOfFiles; i++)
+            putTableString(record, rec->FileNames[i]);
+        putTableString(record, rec->Comment);
+        if (results == NULL)
+            numberOfResults = 0;
+        putVarint(record, numberOfResults);
+        for (LONG i = 0; i < numberOfResults; i++)
+            putSigned(record, results[i]);
+        if (strings == NULL)
+            numberOfStrings = 0;
+        putVarint(record, numberOfStrings);
+        for (int i = 0; i < numberOfStrings; i++)
+            putTableString(record, strings[i]);
+        fwrite(record.data(), 1, record.size(), fp);
+    }
+    ReleaseSRWLockExclusive(&gRecordLock);
+
+    // The stream has its own lock; holding ours shared only keeps
+    // stopRecording from closing it meanwhile.
+    AcquireSRWLockShared(&gRecordLock);
+    if (fp != NULL && gRecordFile == fp)
+        fflush(fp);
+    ReleaseSRWLockShared(&gRecordLock);
+}
+
+/*
+* Reading the log back.
+*/
+typedef struct SCCLOGREADER {
+    RECORDREADER                Rd;
+    std::vector<std::string>    Strings;
+} SCCLOGREADER;
+
+// Returns false for a NULL string.
+static bool getTableString(SCCLOGREADER *log, std::string &str) {
+    RECORDREADER *rd = &log->Rd;
+    ULONGLONG tag = getVarint(rd);
+    str.clear();
+    if (tag == 0 || !rd->Ok)
+        return false;
+    if (tag & 1) {
+        ULONGLONG id = tag >> 1;
+        if (id >= log->Strings.size()) {
+            rd->Ok = false;
+            return false;
+        }
+        str = log->Strings[(size_t)id];
+        return true;
+    }
+    ULONGLONG len = (tag >> 1) - 1;
+    if (len > (ULONGLONG)(rd->End - rd->Pos)) {
+        rd->Ok = false;
+        return false;
+    }
+    str.assign((const char *)rd->Pos, (size_t)len);
+    rd->Pos += len;
+    log->Strings.push_back(str);
+    return true;
+}
+
+bool readSccLog(const char *logFile, std::vector<SCCLOGENTRY> &entries) {
+    FILE *fp = fopen(logFile, "rb");
+    if (fp == NULL)
+        return false;
+    std::vector<unsigned char> data;
+    unsigned char buf[64 * 1024];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), fp)) > 0)
+        data.insert(data.end(), buf, buf + n);
+    fclose(fp);
+
+    if (data.size() < 5 || memcmp(&data[0], SCCLOG_MAGIC, 4) != 0 || data[4] < 1 || data[4] > SCCLOG_VERSION)
+        return false;
+    int version = data[4];
+
+    SCCLOGREADER log;
+    RECORDREADER *rd = &log.Rd;
+    initRecordReader(rd, &data[0] + 5, data.size() - 5);
+
+    // A log cut short by a crash is still usable up to the last whole record.
+    while (rd->Pos < rd->End) {
+        SCCLOGENTRY entry;
+        entry.Context   = 0;
+        if (version >= 2) {
+            getTableString(&log, entry.Provider);
+            entry.Context = getVarint(rd);
+        }
+        entry.ProcId    = getByte(rd);
+        entry.Micros    = getVarint(rd);
+        entry.Rtn       = (long)getSigned(rd);
+        entry.Options   = (LONG)getSigned(rd);
+        ULONGLONG count = getVarint(rd);
+        std::string str;
+        for (ULONGLONG i = 0; i < count && rd->Ok; i++) {
+            getTableString(&log, str);
+            entry.FileNames.push_back(str);
+        }
+        entry.HasComment = getTableString(&log, entry.Comment);
+        count = getVarint(rd);
+        for (ULONGLONG i = 0; i < count && rd->Ok; i++)
+            entry.Results.push_back((LONG)getSigned(rd));
+        count = getVarint(rd);
+        for (ULONGLONG i = 0; i < count && rd->Ok; i++) {
+            getTableString(&log, str);
+            entry.Strings.push_back(str);
+        }
+        if (!rd->Ok || entry.ProcId >= SCCPROC_COUNT)
+            break;
+        entries.push_back(entry);
+    }
+    return true;
+}
@@ -0,0 +1,94 @@
+/*
+*
+*
+* The source code contained in this listing contains proprietary and
+* confidential trade secrets of The MathWorks, Inc.  The use, modification,
+* or development of derivative work based on the code or ideas obtained
+* from the code is prohibited without the express written permission of The
+* MathWorks, Inc. The disclosure of this code to any party not authorized
+* by The MathWorks, Inc. is strictly forbidden.
+* CONFIDENTIAL AND CONTAINING PROPRIETARY TRADE SECRETS
+*/
+
+#ifndef VERCTRLRECORD_H
+#define VERCTRLRECORD_H
+
+#include <windows.h>
+#include <string>
+#include <vector>
+
+/*
+* Identifies the SCC entry point a recorded call was made to.
+* These values are written to the log file, so new entry points
+* must only ever be added at the end.
+*/
+enum SccProcId {
+    SCCPROC_INITIALIZE = 0,
+    SCCPROC_UNINITIALIZE,
+    SCCPROC_OPENPROJECT,
+    SCCPROC_GETPROJPATH,
+    SCCPROC_CLOSEPROJECT,
+    SCCPROC_GET,
+    SCCPROC_CHECKOUT,
+    SCCPROC_CHECKIN,
+    SCCPROC_UNCHECKOUT,
+    SCCPROC_ADD,
+    SCCPROC_REMOVE,
+    SCCPROC_RENAME,
+    SCCPROC_DIFF,
+    SCCPROC_HISTORY,
+    SCCPROC_PROPERTIES,
+    SCCPROC_QUERYINFO,
+    SCCPROC_GETCOMMANDOPTIONS,
+    SCCPROC_RUNSCC,
+    SCCPROC_COUNT
+};
+
+#define SCCLOG_MAGIC    "VCRL"
+#define SCCLOG_VERSION  2
+
+/*
+* An SCC call in progress. Filled in by recordBegin and written
+* to the log by recordEnd, once the provider has returned. SccInitialize
+* makes its context, so its caller sets Context before recordEnd.
+*/
+typedef struct SCCRECORD {
+    LPCSTR      Provider;
+    const void *Context;
+    int         ProcId;
+    LONGLONG    StartTicks;
+    LONG        Options;
+    LONG        NumberOfFiles;
+    LPCSTR     *FileNames;
+    LPCSTR      Comment;
+} SCCRECORD;
+
+/*
+* One call read back from a log file.
+*/
+typedef struct SCCLOGENTRY {
+    std::string                 Provider;   // library path, "" before version 2
+    ULONGLONG                   Context;    // 1 for the first context in the log, and so on; 0 if unknown
+    int                         ProcId;
+    ULONGLONG                   Micros;     // wall time spent in the provider
+    long                        Rtn;
+    LONG                        Options;
+    std::vector<std::string>    FileNames;
+    bool                        HasComment;
+    std::string                 Comment;
+    std::vector<LONG>           Results;    // status words, capabilities, flags
+    std::vector<std::string>    Strings;    // project names, paths, labels
+} SCCLOGENTRY;
+
+bool startRecording(const char *logFile);
+void stopRecording();
+bool isRecording();
+
+void recordBegin(SCCRECORD *rec, LPCSTR provider, const void *context, int procId,
+                 LONG numberOfFiles, LPCSTR *fileNames, LPCSTR comment, LONG options);
+void recordEnd(SCCRECORD *rec, long rtn, LONG numberOfResults, const LONG *results,
+               int numberOfStrings, const char **strings);
+
+bool readSccLog(const char *logFile, std::vector<SCCLOGENTRY> &entries);
+
+#endif
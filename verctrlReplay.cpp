@@ -0,0 +1,337 @@
+/*
+*
+*
+* The source code contained in this listing contains proprietary and
+* confidential trade secrets of The MathWorks, Inc.  The use, modification,
+* or development of derivative work based on the code or ideas obtained
+* from the code is prohibited without the express written permission of The
+* MathWorks, Inc. The disclosure of this code to any party not authorized
+* by The MathWorks, Inc. is strictly forbidden.
+* CONFIDENTIAL AND CONTAINING PROPRIETARY TRADE SECRETS
+*/
+
+/*
+* SCC provider that replays a log written by verctrl('RECORD_START', ...).
+* Built as its own DLL (exports in verctrlReplay.def) and selected with
+* verctrl('SET_DLL', 'verctrlReplay.dll').
+*
+* Environment variables:
+*   VERCTRL_REPLAY_LOG      log file to replay (required)
+*   VERCTRL_REPLAY_PROVIDER library whose calls are replayed; by default
+*                           the one first initialized in the log
+*   VERCTRL_REPLAY_SCALE    multiplier applied to the recorded wall times;
+*                           1 replays the original timings, 0 returns at once.
+*
+* Each SccInitialize takes the next recorded initialization, and the
+* context it returns replays the calls recorded for that context, in
+* order. A call must match the next of them in entry point and file
+* list, or it fails with SCC_E_NONSPECIFICERROR and nothing is used up.
+* The one exception is an SccQueryInfo on files whose statuses have all
+* been replayed already, which is answered with those statuses.
+* Logs from before contexts were recorded replay as one context.
+*/
+
+#include <windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <deque>
+#include <map>
+
+#include "scc.h"
+#include "verctrlRecord.h"
+
+// File names are matched without regard to case, as by the providers.
+typedef struct NOCASELESS {
+    bool operator()(const std::string &a, const std::string &b) const {
+        return _stricmp(a.c_str(), b.c_str()) < 0;
+    }
+} NOCASELESS;
+
+typedef struct REPLAYLOG {
+    std::vector<SCCLOGENTRY>    Entries;
+    std::deque<size_t>          Inits;      // initializations not yet replayed
+    std::map<ULONGLONG, std::deque<size_t> > ByContext;
+    std::map<std::string, LONG, NOCASELESS> LastStatus;     // as of the calls replayed so far
+    double                      Scale;
+} REPLAYLOG;
+
+// What a context returned by SccInitialize points to.
+typedef struct REPLAYCONTEXT {
+    ULONGLONG   Recorded;   // context of the initialization it replays
+} REPLAYCONTEXT;
+
+static SRWLOCK    gReplayLock = SRWLOCK_INIT;
+static REPLAYLOG *gReplay     = NULL;
+
+static REPLAYLOG *loadReplayLog() {
+    char logFile[_MAX_PATH];
+    char provider[_MAX_PATH];
+    char scale[64];
+    DWORD len = GetEnvironmentVariable("VERCTRL_REPLAY_LOG", logFile, sizeof(logFile));
+    if (len == 0 || len >= sizeof(logFile))
+        return NULL;
+
+    REPLAYLOG *log = new REPLAYLOG;
+    if (!readSccLog(logFile, log->Entries)) {
+        delete log;
+        return NULL;
+    }
+    log->Scale = 1.0;
+    len = GetEnvironmentVariable("VERCTRL_REPLAY_SCALE", scale, sizeof(scale));
+    if (len > 0 && len < sizeof(scale))
+        log->Scale = atof(scale);
+
+    std::string replayed;
+    bool chosen = false;
+    len = GetEnvironmentVariable("VERCTRL_REPLAY_PROVIDER", provider, sizeof(provider));
+    if (len > 0 && len < sizeof(provider)) {
+        replayed    = provider;
+        chosen      = true;
+    }
+    for (size_t i = 0; i < log->Entries.size(); i++) {
+        const SCCLOGENTRY &entry = log->Entries[i];
+        if (!chosen && entry.ProcId == SCCPROC_INITIALIZE) {
+            replayed    = entry.Provider;
+            chosen      = true;
+        }
+        if (chosen && _stricmp(entry.Provider.c_str(), replayed.c_str()) != 0)
+            continue;
+        if (entry.ProcId == SCCPROC_INITIALIZE)
+            log->Inits.push_back(i);
+        else
+            log->ByContext[entry.Context].push_back(i);
+    }
+    return log;
+}
+
+static bool sameFiles(const SCCLOGENTRY &entry, LONG nFiles, LPCSTR *fileNames) {
+    if (fileNames == NULL)
+        nFiles = 0;
+    if ((LONG)entry.FileNames.size() != nFiles)
+        return false;
+    for (LONG i = 0; i < nFiles; i++) {
+        if (_stricmp(entry.FileNames[i].c_str(), fileNames[i]) != 0)
+            return false;
+    }
+    return true;
+}
+
+/*
+* Take the next call recorded for the context if it is this one. Returns
+* NULL, using up nothing, if it is not or there are no calls left.
+*/
+static const SCCLOGENTRY *takeEntry(LPVOID pContext, int procId, LONG nFiles, LPCSTR *fileNames) {
+    const SCCLOGENTRY *found = NULL;
+    const REPLAYCONTEXT *context = (const REPLAYCONTEXT *) pContext;
+
+    AcquireSRWLockExclusive(&gReplayLock);
+    if (gReplay != NULL && context != NULL) {
+        std::deque<size_t> &calls = gReplay->ByContext[context->Recorded];
+        if (!calls.empty()) {
+            const SCCLOGENTRY &next = gReplay->Entries[calls.front()];
+            if (next.ProcId == procId && sameFiles(next, nFiles, fileNames)) {
+                found = &next;
+                calls.pop_front();
+                if (procId == SCCPROC_QUERYINFO && IS_SCC_SUCCESS(next.Rtn)) {
+                    for (size_t f = 0; f < next.FileNames.size() && f < next.Results.size(); f++)
+                        gReplay->LastStatus[next.FileNames[f]] = next.Results[f];
+                }
+            }
+        }
+    }
+    ReleaseSRWLockExclusive(&gReplayLock);
+    return found;
+}
+
+static void replayDelay(ULONGLONG micros) {
+    double scale = gReplay != NULL ? gReplay->Scale : 0.0;
+    if (scale > 0.0) {
+        DWORD ms = (DWORD)(micros * scale / 1000.0);
+        if (ms > 0)
+            Sleep(ms);
+    }
+}
+
+static void copyOut(LPSTR dst, size_t size, const SCCLOGENTRY *entry, size_t index) {
+    if (dst == NULL || entry == NULL || index >= entry->Strings.size())
+        return;
+    strncpy(dst, entry->Strings[index].c_str(), size - 1);
+    dst[size - 1] = '\0';
+}
+
+static LONG resultAt(const SCCLOGENTRY *entry, size_t index, LONG fallback) {
+    if (entry == NULL || index >= entry->Results.size())
+        return fallback;
+    return entry->Results[index];
+}
+
+/*
+* Serve a call that has no output other than its return code.
+*/
+static SCCRTN replayCall(LPVOID pContext, int procId, LONG nFiles, LPCSTR *fileNames) {
+    const SCCLOGENTRY *entry = takeEntry(pContext, procId, nFiles, fileNames);
+    if (entry == NULL)
+        return SCC_E_NONSPECIFICERROR;
+    replayDelay(entry->Micros);
+    return entry->Rtn;
+}
+
+/*
+* Exported entry points. The names must match those looked up by verctrl.
+*/
+extern "C" {
+
+SCCRTN SccInitialize(LPVOID *ppContext, HWND hWnd, LPCSTR lpCallerName, LPSTR lpSccName,
+                     LPLONG lpSccCaps, LPSTR lpAuxPathLabel, LPLONG pnCheckoutCommentLen,
+                     LPLONG pnCommentLen) {
+    const SCCLOGENTRY *entry = NULL;
+    AcquireSRWLockExclusive(&gReplayLock);
+    if (gReplay == NULL)
+        gReplay = loadReplayLog();
+    if (gReplay != NULL && !gReplay->Inits.empty()) {
+        entry = &gReplay->Entries[gReplay->Inits.front()];
+        gReplay->Inits.pop_front();
+    }
+    ReleaseSRWLockExclusive(&gReplayLock);
+    if (entry == NULL)
+        return SCC_E_INITIALIZEFAILED;
+
+    replayDelay(entry->Micros);
+    strcpy(lpSccName, "Replay");
+    copyOut(lpSccName, SCC_NAME_LEN + 1, entry, 0);
+    lpAuxPathLabel[0] = '\0';
+    copyOut(lpAuxPathLabel, SCC_AUXLABEL_LEN + 1, entry, 1);
+    *lpSccCaps              = resultAt(entry, 0, SCC_CAP_QUERYINFO);
+    *pnCheckoutCommentLen   = resultAt(entry, 1, 0);
+    *pnCommentLen           = resultAt(entry, 2, 0);
+
+    REPLAYCONTEXT *context  = new REPLAYCONTEXT;
+    context->Recorded       = entry->Context;
+    *ppContext              = context;
+    return entry->Rtn;
+}
+
+SCCRTN SccUninitialize(LPVOID pContext) {
+    const SCCLOGENTRY *entry = takeEntry(pContext, SCCPROC_UNINITIALIZE, 0, NULL);
+    if (entry != NULL)
+        replayDelay(entry->Micros);
+    delete (REPLAYCONTEXT *) pContext;
+    return SCC_OK;
+}
+
+SCCRTN SccOpenProject(LPVOID pvContext, HWND hWnd, LPSTR lpUser, LPSTR lpProjName,
+                      LPCSTR lpLocalProjPath, LPSTR lpAuxProjPath, LPCSTR lpComment,
+                      LPTEXTOUTPROC lpTextOutProc, LONG dwFlags) {
+    return replayCall(pvContext, SCCPROC_OPENPROJECT, 1, &lpLocalProjPath);
+}
+
+SCCRTN SccGetProjPath(LPVOID pvContext, HWND hWnd, LPSTR lpUser, LPSTR lpProjName,
+                      LPSTR lpLocalPath, LPSTR lpAuxProjPath, BOOL bAllowChangePath,
+                      BOOL *pbNew) {
+    LPCSTR localPath = lpLocalPath;
+    const SCCLOGENTRY *entry = takeEntry(pvContext, SCCPROC_GETPROJPATH, 1, &localPath);
+    if (entry == NULL)
+        return SCC_E_NONSPECIFICERROR;
+    replayDelay(entry->Micros);
+    copyOut(lpProjName, SCC_PRJPATH_LEN + 1, entry, 1);
+    copyOut(lpLocalPath, _MAX_PATH, entry, 2);
+    copyOut(lpAuxProjPath, SCC_PRJPATH_LEN + 1, entry, 3);
+    *pbNew = resultAt(entry, 0, FALSE);
+    return entry->Rtn;
+}
+
+SCCRTN SccCloseProject(LPVOID pvContext) {
+    return replayCall(pvContext, SCCPROC_CLOSEPROJECT, 0, NULL);
+}
+
+SCCRTN SccGet(LPVOID pvContext, HWND hWnd, LONG nFiles, LPCSTR *lpFileNames,
+              LONG fOptions, LPCMDOPTS pvOptions) {
+    return replayCall(pvContext, SCCPROC_GET, nFiles, lpFileNames);
+}
+
+SCCRTN SccCheckout(LPVOID pvContext, HWND hWnd, LONG nFiles, LPCSTR *lpFileNames,
+                   LPCSTR lpComment, LONG fOptions, LPCMDOPTS pvOptions) {
+    return replayCall(pvContext, SCCPROC_CHECKOUT, nFiles, lpFileNames);
+}
+
+SCCRTN SccCheckin(LPVOID pContext, HWND hWnd, LONG nFiles, LPCSTR *lpFileNames,
+                  LPCSTR lpComment, LONG fOptions, LPCMDOPTS pvOptions) {
+    return replayCall(pContext, SCCPROC_CHECKIN, nFiles, lpFileNames);
+}
+
+SCCRTN SccUncheckout(LPVOID pContext, HWND hWnd, LONG nFiles, LPCSTR *lpFileNames,
+                     LONG fOptions, LPCMDOPTS pvOptions) {
+    return replayCall(pContext, SCCPROC_UNCHECKOUT, nFiles, lpFileNames);
+}
+
+SCCRTN SccAdd(LPVOID pContext, HWND hWnd, LONG nFiles, LPCSTR *lpFileNames,
+              LPCSTR lpComment, LONG *pdwFlags, LPCMDOPTS pvOptions) {
+    const SCCLOGENTRY *entry = takeEntry(pContext, SCCPROC_ADD, nFiles, lpFileNames);
+    if (entry == NULL)
+        return SCC_E_NONSPECIFICERROR;
+    replayDelay(entry->Micros);
+    // The flags are recorded as the provider left them.
+    for (LONG i = 0; i < nFiles; i++)
+        pdwFlags[i] = resultAt(entry, i, pdwFlags[i]);
+    return entry->Rtn;
+}
+
+SCCRTN SccRemove(LPVOID pContext, HWND hWnd, LONG nFiles, LPCSTR *lpFileNames,
+                 LPCSTR lpComment, LONG dwFlags, LPCMDOPTS pvOptions) {
+    return replayCall(pContext, SCCPROC_REMOVE, nFiles, lpFileNames);
+}
+
+SCCRTN SccRename(LPVOID pContext, HWND hWnd, LPCSTR lpFileName, LPCSTR lpNewName) {
+    return replayCall(pContext, SCCPROC_RENAME, 1, &lpFileName);
+}
+
+SCCRTN SccDiff(LPVOID pContext, HWND hWnd, LPCSTR lpFileName, LONG fOptions,
+               LPCMDOPTS pvOptions) {
+    return replayCall(pContext, SCCPROC_DIFF, 1, &lpFileName);
+}
+
+SCCRTN SccHistory(LPVOID pContext, HWND hWnd, LONG nFiles, LPCSTR *lpFileNames,
+                  LONG fOptions, LPCMDOPTS pvOptions) {
+    return replayCall(pContext, SCCPROC_HISTORY, nFiles, lpFileNames);
+}
+
+SCCRTN SccProperties(LPVOID pContext, HWND hWnd, LPCSTR lpFileName) {
+    return replayCall(pContext, SCCPROC_PROPERTIES, 1, &lpFileName);
+}
+
+SCCRTN SccQueryInfo(LPVOID pContext, LONG nFiles, LPCSTR *lpFileNames, LPLONG lpStatus) {
+    const SCCLOGENTRY *entry = takeEntry(pContext, SCCPROC_QUERYINFO, nFiles, lpFileNames);
+    if (entry != NULL) {
+        replayDelay(entry->Micros);
+        for (LONG i = 0; i < nFiles; i++)
+            lpStatus[i] = resultAt(entry, i, SCC_STATUS_NOTCONTROLLED);
+        return entry->Rtn;
+    }
+
+    // Not the next call recorded, e.g. after the status cache timed out
+    // at another point than when recording: answer from the statuses
+    // replayed so far, if every file has one.
+    SCCRTN rtn = SCC_OK;
+    AcquireSRWLockShared(&gReplayLock);
+    for (LONG i = 0; i < nFiles && rtn == SCC_OK; i++) {
+        std::map<std::string, LONG, NOCASELESS>::const_iterator it = gReplay->LastStatus.find(lpFileNames[i]);
+        if (it != gReplay->LastStatus.end())
+            lpStatus[i] = it->second;
+        else
+            rtn = SCC_E_NONSPECIFICERROR;
+    }
+    ReleaseSRWLockShared(&gReplayLock);
+    return rtn;
+}
+
+SCCRTN SccGetCommandOptions(LPVOID pContext, HWND hWnd, enum SCCCOMMAND nCommand,
+                            LPCMDOPTS *ppvOptions) {
+    return SCC_I_ADV_SUPPORT;
+}
+
+SCCRTN SccRunScc(LPVOID pContext, HWND hWnd, LONG nFiles, LPCSTR *lpFileNames) {
+    return replayCall(pContext, SCCPROC_RUNSCC, nFiles, lpFileNames);
+}
+
+} // extern "C"
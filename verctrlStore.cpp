@@ -0,0 +1,606 @@
+/*
+*
+*
+* The source code contained in this listing contains proprietary and
+* confidential trade secrets of The MathWorks, Inc.  The use, modification,
+* or development of derivative work based on the code or ideas obtained
+* from the code is prohibited without the express written permission of The
+* MathWorks, Inc. The disclosure of this code to any party not authorized
+* by The MathWorks, Inc. is strictly forbidden.
+* CONFIDENTIAL AND CONTAINING PROPRIETARY TRADE SECRETS
+*/
+
+/*
+* Files in a store directory:
+*
+*   objects.pack    "VCPACK1\0", then one record per object:
+*                       u32     magic "VCOB"
+*                       u32     CRC-32 of the rest of the record
+*                       u8      OBJECT_FULL or OBJECT_DELTA
+*                       u8      length of the delta chain below this object
+*                       u16     unused
+*                       u8[20]  SHA-1 of the object's contents
+*                       u64     pack offset of the delta base
+*                       u32     length of the contents
+*                       u32     length of the payload that follows
+*   objects.idx     32 byte header, then a power of two number of 32 byte
+*                   slots: u8[20] SHA-1, u32 unused, u64 pack offset (0 if
+*                   the slot is empty)
+*   lock            locked with LockFileEx while a process uses the store
+*
+* All integers are little endian. The pack is the only source of truth;
+* the index covers the first PackEnd bytes of it and is brought up to
+* date from the pack when a process finds it behind, or rebuilt from
+* scratch when it was left dirty. A delta is a sequence of operations,
+* each either 0, a varint length and that many literal bytes, or 1 and
+* the varint offset and length of a run to copy from the base.
+*/
+
+#include <windows.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "verctrlHash.h"
+#include "verctrlStore.h"
+
+#define PACK_SIGNATURE      "VCPACK1"
+#define PACK_HEADER         8
+#define OBJECT_MAGIC        0x424F4356u     // "VCOB"
+#define OBJECT_HEADER       48
+#define OBJECT_FULL         0
+#define OBJECT_DELTA        1
+#define MAX_DELTA_DEPTH     50
+#define DELTA_BLOCK         16
+
+#define INDEX_MAGIC         0x58494356u     // "VCIX"
+#define INDEX_HEADER        32
+#define INDEX_SLOT          32
+#define MIN_INDEX_SLOTS     1024
+
+struct OBJECTSTORE {
+    std::string     Dir;
+    HANDLE          Pack;
+    ULONGLONG       PackEnd;        // end of the last complete record
+    HANDLE          Index;
+    HANDLE          IndexMap;
+    unsigned char  *IndexView;
+    unsigned int    Capacity;       // number of slots in the view
+    HANDLE          Lock;
+    int             LockCount;
+    ULONGLONG       LastOffset;     // the object last read or written,
+    std::string     LastData;       // usually the base of the next one
+};
+
+typedef struct OBJECTHEADER {
+    int             Type;
+    int             Depth;
+    unsigned char   Id[SHA1_LEN];
+    ULONGLONG       Base;
+    unsigned int    Length;
+    unsigned int    Stored;
+} OBJECTHEADER;
+
+// Index header fields
+#define IX_MAGIC    0
+#define IX_SLOTS    4
+#define IX_COUNT    8
+#define IX_DIRTY    12
+#define IX_PACKEND  16
+
+static bool readAt(HANDLE file, ULONGLONG offset, void *buf, DWORD len) {
+    OVERLAPPED ov;
+    memset(&ov, 0, sizeof(ov));
+    ov.Offset       = (DWORD)offset;
+    ov.OffsetHigh   = (DWORD)(offset >> 32);
+    DWORD got = 0;
+    return ReadFile(file, buf, len, &got, &ov) && got == len;
+}
+
+static bool writeAt(HANDLE file, ULONGLONG offset, const void *buf, DWORD len) {
+    OVERLAPPED ov;
+    memset(&ov, 0, sizeof(ov));
+    ov.Offset       = (DWORD)offset;
+    ov.OffsetHigh   = (DWORD)(offset >> 32);
+    DWORD put = 0;
+    return WriteFile(file, buf, len, &put, &ov) && put == len;
+}
+
+static ULONGLONG fileSize(HANDLE file) {
+    LARGE_INTEGER size;
+    return GetFileSizeEx(file, &size) ? (ULONGLONG)size.QuadPart : 0;
+}
+
+/*
+* Deltas
+*/
+static unsigned int hashBlock(const char *p) {
+    unsigned int h = 2166136261u;
+    for (int i = 0; i < DELTA_BLOCK; i++)
+        h = (h ^ (unsigned char)p[i]) * 16777619u;
+    return h;
+}
+
+static void putLiteral(std::string &delta, const std::string &target, size_t from, size_t to) {
+    if (to > from) {
+        delta += (char)0;
+        putVarint(delta, to - from);
+        delta.append(target, from, to - from);
+    }
+}
+
+/*
+* Encode target as copies of aligned blocks of base, extended in both
+* directions as far as they match, and literal runs for the rest.
+*/
+static void makeDelta(const std::string &base, const std::string &target, std::string &delta) {
+    delta.clear();
+    size_t blocks = base.size() / DELTA_BLOCK;
+    size_t slots  = 64;
+    while (slots < 2 * blocks)
+        slots *= 2;
+    std::vector<unsigned int> table(slots, 0);     // block offset + 1
+    for (size_t b = 0; b < blocks; b++) {
+        size_t s = hashBlock(&base[b * DELTA_BLOCK]) & (slots - 1);
+        if (table[s] == 0)
+            table[s] = (unsigned int)(b * DELTA_BLOCK + 1);
+    }
+
+    size_t literal = 0;
+    size_t pos     = 0;
+    while (blocks > 0 && pos + DELTA_BLOCK <= target.size()) {
+        unsigned int slot = table[hashBlock(&target[pos]) & (slots - 1)];
+        if (slot == 0 || memcmp(&base[slot - 1], &target[pos], DELTA_BLOCK) != 0) {
+            pos++;
+            continue;
+        }
+        size_t from = slot - 1;
+        size_t len  = DELTA_BLOCK;
+        while (pos + len < target.size() && from + len < base.size() &&
+               target[pos + len] == base[from + len])
+            len++;
+        while (pos > literal && from > 0 && target[pos - 1] == base[from - 1]) {
+            pos--;
+            from--;
+            len++;
+        }
+        putLiteral(delta, target, literal, pos);
+        delta += (char)1;
+        putVarint(delta, from);
+        putVarint(delta, len);
+        pos    += len;
+        literal = pos;
+    }
+    putLiteral(delta, target, literal, target.size());
+}
+
+static bool applyDelta(const std::string &base, const std::string &delta, size_t length, std::string &out) {
+    out.clear();
+    out.reserve(length);
+    RECORDREADER rd;
+    initRecordReader(&rd, delta.data(), delta.size());
+    while (rd.Ok && rd.Pos < rd.End) {
+        int op = getByte(&rd);
+        if (op == 0) {
+            ULONGLONG a = getVarint(&rd);
+            if (!rd.Ok || a > (ULONGLONG)(rd.End - rd.Pos))
+                return false;
+            out.append((const char *)rd.Pos, (size_t)a);
+            rd.Pos += a;
+        } else if (op == 1) {
+            ULONGLONG a = getVarint(&rd);
+            ULONGLONG b = getVarint(&rd);
+            if (!rd.Ok || a > base.size() || b > base.size() - a)
+                return false;
+            out.append(base, (size_t)a, (size_t)b);
+        } else {
+            return false;
+        }
+    }
+    return rd.Ok && out.size() == length;
+}
+
+/*
+* Pack records
+*/
+static void encodeHeader(unsigned char *p, const OBJECTHEADER *h) {
+    memset(p, 0, OBJECT_HEADER);
+    putU32(p, OBJECT_MAGIC);
+    p[8] = (unsigned char)h->Type;
+    p[9] = (unsigned char)h->Depth;
+    memcpy(p + 12, h->Id, SHA1_LEN);
+    putU64(p + 32, h->Base);
+    putU32(p + 40, h->Length);
+    putU32(p + 44, h->Stored);
+}
+
+static bool decodeHeader(const unsigned char *p, OBJECTHEADER *h) {
+    if (getU32(p) != OBJECT_MAGIC)
+        return false;
+    h->Type     = p[8];
+    h->Depth    = p[9];
+    memcpy(h->Id, p + 12, SHA1_LEN);
+    h->Base     = getU64(p + 32);
+    h->Length   = getU32(p + 40);
+    h->Stored   = getU32(p + 44);
+    return h->Type == OBJECT_FULL || h->Type == OBJECT_DELTA;
+}
+
+static bool readObjectHeader(OBJECTSTORE *store, ULONGLONG offset, OBJECTHEADER *h) {
+    unsigned char buf[OBJECT_HEADER];
+    return offset >= PACK_HEADER && offset + OBJECT_HEADER <= store->PackEnd &&
+        readAt(store->Pack, offset, buf, OBJECT_HEADER) && decodeHeader(buf, h);
+}
+
+static bool readPayload(OBJECTSTORE *store, ULONGLONG offset, const OBJECTHEADER *h, std::string &payload) {
+    payload.resize(h->Stored);
+    return h->Stored == 0 || readAt(store->Pack, offset + OBJECT_HEADER, &payload[0], h->Stored);
+}
+
+/*
+* Read the record at offset, checking its CRC. Returns its length, or 0
+* if it is not a complete, valid record.
+*/
+static ULONGLONG checkRecord(OBJECTSTORE *store, ULONGLONG offset, ULONGLONG end, OBJECTHEADER *h) {
+    unsigned char buf[OBJECT_HEADER];
+    if (offset + OBJECT_HEADER > end || !readAt(store->Pack, offset, buf, OBJECT_HEADER) ||
+        !decodeHeader(buf, h) || offset + OBJECT_HEADER + h->Stored > end)
+        return 0;
+    std::string payload;
+    payload.resize(h->Stored);
+    if (h->Stored > 0 && !readAt(store->Pack, offset + OBJECT_HEADER, &payload[0], h->Stored))
+        return 0;
+    std::string body((const char *)buf + 8, OBJECT_HEADER - 8);
+    body += payload;
+    if (crc32(body.data(), body.size()) != getU32(buf + 4))
+        return 0;
+    return OBJECT_HEADER + h->Stored;
+}
+
+/*
+* Index
+*/
+static unsigned char *indexSlot(OBJECTSTORE *store, unsigned int s) {
+    return store->IndexView + INDEX_HEADER + (size_t)s * INDEX_SLOT;
+}
+
+static unsigned int slotOf(const unsigned char id[SHA1_LEN], unsigned int capacity) {
+    return getU32(id) & (capacity - 1);
+}
+
+static void unmapIndex(OBJECTSTORE *store) {
+    if (store->IndexView != NULL)
+        UnmapViewOfFile(store->IndexView);
+    if (store->IndexMap != NULL)
+        CloseHandle(store->IndexMap);
+    store->IndexView    = NULL;
+    store->IndexMap     = NULL;
+    store->Capacity     = 0;
+}
+
+/*
+* Map capacity slots of the index file, growing the file if it is smaller.
+*/
+static bool mapIndex(OBJECTSTORE *store, unsigned int capacity) {
+    unmapIndex(store);
+    ULONGLONG size = INDEX_HEADER + (ULONGLONG)capacity * INDEX_SLOT;
+    store->IndexMap = CreateFileMapping(store->Index, NULL, PAGE_READWRITE,
+        (DWORD)(size >> 32), (DWORD)size, NULL);
+    if (store->IndexMap == NULL)
+        return false;
+    store->IndexView = (unsigned char *) MapViewOfFile(store->IndexMap, FILE_MAP_WRITE, 0, 0, (SIZE_T)size);
+    if (store->IndexView == NULL) {
+        unmapIndex(store);
+        return false;
+    }
+    store->Capacity = capacity;
+    return true;
+}
+
+static void insertIndexSlot(OBJECTSTORE *store, const unsigned char id[SHA1_LEN], ULONGLONG offset) {
+    unsigned int mask = store->Capacity - 1;
+    unsigned int s    = slotOf(id, store->Capacity);
+    while (getU64(indexSlot(store, s) + 24) != 0) {
+        if (memcmp(indexSlot(store, s), id, SHA1_LEN) == 0)
+            return;
+        s = (s + 1) & mask;
+    }
+    memcpy(indexSlot(store, s), id, SHA1_LEN);
+    putU64(indexSlot(store, s) + 24, offset);
+    putU32(store->IndexView + IX_COUNT, getU32(store->IndexView + IX_COUNT) + 1);
+}
+
+/*
+* Rehash the index into capacity slots. Other processes notice the new
+* size in the header and map it again.
+*/
+static bool resizeIndex(OBJECTSTORE *store, unsigned int capacity) {
+    std::vector<unsigned char> entries;
+    for (unsigned int s = 0; s < store->Capacity; s++) {
+        if (getU64(indexSlot(store, s) + 24) != 0)
+            entries.insert(entries.end(), indexSlot(store, s), indexSlot(store, s) + INDEX_SLOT);
+    }
+    ULONGLONG packEnd = store->IndexView != NULL ? getU64(store->IndexView + IX_PACKEND) : PACK_HEADER;
+    if (!mapIndex(store, capacity))
+        return false;
+    memset(store->IndexView, 0, INDEX_HEADER + (size_t)capacity * INDEX_SLOT);
+    putU32(store->IndexView + IX_MAGIC, INDEX_MAGIC);
+    putU32(store->IndexView + IX_SLOTS, capacity);
+    putU32(store->IndexView + IX_DIRTY, 1);
+    putU64(store->IndexView + IX_PACKEND, packEnd);
+    for (size_t i = 0; i < entries.size(); i += INDEX_SLOT)
+        insertIndexSlot(store, &entries[i], getU64(&entries[i + 24]));
+    return true;
+}
+
+static bool addToIndex(OBJECTSTORE *store, const unsigned char id[SHA1_LEN], ULONGLONG offset) {
+    if (2 * (getU32(store->IndexView + IX_COUNT) + 1) > store->Capacity &&
+        !resizeIndex(store, 2 * store->Capacity))
+        return false;
+    putU32(store->IndexView + IX_DIRTY, 1);
+    insertIndexSlot(store, id, offset);
+    return true;
+}
+
+static ULONGLONG findObject(OBJECTSTORE *store, const unsigned char id[SHA1_LEN]) {
+    unsigned int mask = store->Capacity - 1;
+    for (unsigned int s = slotOf(id, store->Capacity); ; s = (s + 1) & mask) {
+        ULONGLONG offset = getU64(indexSlot(store, s) + 24);
+        if (offset == 0)
+            return 0;
+        if (memcmp(indexSlot(store, s), id, SHA1_LEN) == 0)
+            return offset;
+    }
+}
+
+/*
+* Index the pack records from the end of what the index covers to the
+* end of the pack, and cut off a torn record at the end.
+*/
+static bool catchUpIndex(OBJECTSTORE *store) {
+    ULONGLONG end    = fileSize(store->Pack);
+    ULONGLONG offset = getU64(store->IndexView + IX_PACKEND);
+    if (getU32(store->IndexView + IX_DIRTY) != 0 || offset > end || offset < PACK_HEADER) {
+        // Rebuild from scratch.
+        memset(store->IndexView + INDEX_HEADER, 0, (size_t)store->Capacity * INDEX_SLOT);
+        putU32(store->IndexView + IX_COUNT, 0);
+        putU32(store->IndexView + IX_DIRTY, 1);
+        offset = PACK_HEADER;
+    }
+    while (offset < end) {
+        OBJECTHEADER h;
+        ULONGLONG len = checkRecord(store, offset, end, &h);
+        if (len == 0)
+            break;
+        if (!addToIndex(store, h.Id, offset))
+            return false;
+        offset += len;
+    }
+    if (offset < end) {
+        LARGE_INTEGER cut;
+        cut.QuadPart = (LONGLONG)offset;
+        SetFilePointerEx(store->Pack, cut, NULL, FILE_BEGIN);
+        SetEndOfFile(store->Pack);
+        store->LastOffset = 0;
+    }
+    store->PackEnd = offset;
+    return flushObjectStore(store);
+}
+
+bool flushObjectStore(OBJECTSTORE *store) {
+    if (!FlushFileBuffers(store->Pack))
+        return false;
+    putU64(store->IndexView + IX_PACKEND, store->PackEnd);
+    putU32(store->IndexView + IX_DIRTY, 0);
+    return FlushViewOfFile(store->IndexView, 0) && FlushFileBuffers(store->Index);
+}
+
+bool lockObjectStore(OBJECTSTORE *store) {
+    if (store->LockCount++ > 0)
+        return true;
+    OVERLAPPED ov;
+    memset(&ov, 0, sizeof(ov));
+    if (!LockFileEx(store->Lock, LOCKFILE_EXCLUSIVE_LOCK, 0, 1, 0, &ov)) {
+        store->LockCount--;
+        return false;
+    }
+    // Another process may have added objects, and grown the index.
+    unsigned int capacity = getU32(store->IndexView + IX_SLOTS);
+    if (capacity != store->Capacity && !mapIndex(store, capacity)) {
+        unlockObjectStore(store);
+        return false;
+    }
+    store->PackEnd = getU64(store->IndexView + IX_PACKEND);
+    if (fileSize(store->Pack) != store->PackEnd && !catchUpIndex(store)) {
+        unlockObjectStore(store);
+        return false;
+    }
+    return true;
+}
+
+void unlockObjectStore(OBJECTSTORE *store) {
+    if (--store->LockCount > 0)
+        return;
+    if (getU64(store->IndexView + IX_PACKEND) != store->PackEnd)
+        flushObjectStore(store);
+    OVERLAPPED ov;
+    memset(&ov, 0, sizeof(ov));
+    UnlockFileEx(store->Lock, 0, 1, 0, &ov);
+}
+
+static HANDLE openStoreFile(const std::string &dir, const char *name) {
+    std::string fileName = dir + "\\" + name;
+    return CreateFile(fileName.c_str(), GENERIC_READ | GENERIC_WRITE,
+        FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+}
+
+OBJECTSTORE *openObjectStore(const char *dir) {
+    CreateDirectory(dir, NULL);
+    OBJECTSTORE *store = new OBJECTSTORE;
+    store->Dir          = dir;
+    store->PackEnd      = PACK_HEADER;
+    store->IndexMap     = NULL;
+    store->IndexView    = NULL;
+    store->Capacity     = 0;
+    store->LockCount    = 0;
+    store->LastOffset   = 0;
+    store->Lock         = openStoreFile(store->Dir, "lock");
+    store->Pack         = openStoreFile(store->Dir, "objects.pack");
+    store->Index        = openStoreFile(store->Dir, "objects.idx");
+    if (store->Lock == INVALID_HANDLE_VALUE || store->Pack == INVALID_HANDLE_VALUE ||
+        store->Index == INVALID_HANDLE_VALUE) {
+        closeObjectStore(store);
+        return NULL;
+    }
+
+    OVERLAPPED ov;
+    memset(&ov, 0, sizeof(ov));
+    if (!LockFileEx(store->Lock, LOCKFILE_EXCLUSIVE_LOCK, 0, 1, 0, &ov)) {
+        closeObjectStore(store);
+        return NULL;
+    }
+    bool ok = true;
+    char signature[PACK_HEADER];
+    if (fileSize(store->Pack) < PACK_HEADER) {
+        memset(signature, 0, sizeof(signature));
+        strcpy(signature, PACK_SIGNATURE);
+        ok = writeAt(store->Pack, 0, signature, PACK_HEADER) && SetEndOfFile(store->Pack);
+    } else {
+        ok = readAt(store->Pack, 0, signature, PACK_HEADER) &&
+            memcmp(signature, PACK_SIGNATURE, sizeof(PACK_SIGNATURE)) == 0;
+    }
+
+    if (ok) {
+        unsigned int capacity = MIN_INDEX_SLOTS;
+        if (fileSize(store->Index) >= INDEX_HEADER) {
+            unsigned char header[INDEX_HEADER];
+            if (readAt(store->Index, 0, header, INDEX_HEADER) && getU32(header + IX_MAGIC) == INDEX_MAGIC &&
+                getU32(header + IX_SLOTS) >= MIN_INDEX_SLOTS &&
+                (getU32(header + IX_SLOTS) & (getU32(header + IX_SLOTS) - 1)) == 0)
+                capacity = getU32(header + IX_SLOTS);
+        }
+        ok = mapIndex(store, capacity);
+        if (ok && getU32(store->IndexView + IX_MAGIC) != INDEX_MAGIC) {
+            memset(store->IndexView, 0, INDEX_HEADER);
+            putU32(store->IndexView + IX_MAGIC, INDEX_MAGIC);
+            putU32(store->IndexView + IX_SLOTS, capacity);
+            putU32(store->IndexView + IX_DIRTY, 1);
+        }
+        ok = ok && catchUpIndex(store);
+    }
+    UnlockFileEx(store->Lock, 0, 1, 0, &ov);
+    if (!ok) {
+        closeObjectStore(store);
+        return NULL;
+    }
+    return store;
+}
+
+void closeObjectStore(OBJECTSTORE *store) {
+    if (store == NULL)
+        return;
+    unmapIndex(store);
+    if (store->Index != INVALID_HANDLE_VALUE)
+        CloseHandle(store->Index);
+    if (store->Pack != INVALID_HANDLE_VALUE)
+        CloseHandle(store->Pack);
+    if (store->Lock != INVALID_HANDLE_VALUE)
+        CloseHandle(store->Lock);
+    delete store;
+}
+
+bool hasObject(OBJECTSTORE *store, const unsigned char id[SHA1_LEN]) {
+    return findObject(store, id) != 0;
+}
+
+/*
+* Rebuild the contents of the object at offset by walking its delta
+* chain down to a full object and applying the deltas back up.
+*/
+static bool loadObjectAt(OBJECTSTORE *store, ULONGLONG offset, std::string &data) {
+    if (offset == store->LastOffset) {
+        data = store->LastData;
+        return true;
+    }
+    std::vector<ULONGLONG>      chain;
+    std::vector<OBJECTHEADER>   headers;
+    for (;;) {
+        OBJECTHEADER h;
+        if (!readObjectHeader(store, offset, &h) || chain.size() > MAX_DELTA_DEPTH)
+            return false;
+        chain.push_back(offset);
+        headers.push_back(h);
+        if (h.Type == OBJECT_FULL)
+            break;
+        offset = h.Base;
+    }
+    if (!readPayload(store, chain.back(), &headers.back(), data) || data.size() != headers.back().Length)
+        return false;
+    for (size_t i = chain.size() - 1; i-- > 0; ) {
+        std::string delta, out;
+        if (!readPayload(store, chain[i], &headers[i], delta) ||
+            !applyDelta(data, delta, headers[i].Length, out))
+            return false;
+        data.swap(out);
+    }
+    store->LastOffset   = chain.front();
+    store->LastData     = data;
+    return true;
+}
+
+bool getObject(OBJECTSTORE *store, const unsigned char id[SHA1_LEN], std::string &data) {
+    ULONGLONG offset = findObject(store, id);
+    if (offset == 0 || !loadObjectAt(store, offset, data))
+        return false;
+    unsigned char check[SHA1_LEN];
+    sha1(data.data(), data.size(), check);
+    return memcmp(check, id, SHA1_LEN) == 0;
+}
+
+bool putObject(OBJECTSTORE *store, const std::string &data,
+               const unsigned char *base, unsigned char id[SHA1_LEN]) {
+    sha1(data.data(), data.size(), id);
+    if (findObject(store, id) != 0)
+        return true;
+    if ((ULONGLONG)data.size() > 0xFFFFFFFFu)
+        return false;
+
+    OBJECTHEADER h;
+    h.Type      = OBJECT_FULL;
+    h.Depth     = 0;
+    h.Base      = 0;
+    h.Length    = (unsigned int)data.size();
+    memcpy(h.Id, id, SHA1_LEN);
+    const std::string *payload = &data;
+
+    // Keep a delta only if it saves at least a quarter of the size, and
+    // start a new chain once the one below base is as long as allowed.
+    std::string delta;
+    OBJECTHEADER bh;
+    ULONGLONG baseOffset = base != NULL ? findObject(store, base) : 0;
+    if (baseOffset != 0 && readObjectHeader(store, baseOffset, &bh) && bh.Depth < MAX_DELTA_DEPTH) {
+        std::string baseData;
+        if (loadObjectAt(store, baseOffset, baseData)) {
+            makeDelta(baseData, data, delta);
+            if (delta.size() < data.size() - data.size() / 4) {
+                h.Type      = OBJECT_DELTA;
+                h.Depth     = bh.Depth + 1;
+                h.Base      = baseOffset;
+                payload     = &delta;
+            }
+        }
+    }
+    h.Stored = (unsigned int)payload->size();
+
+    std::string record(OBJECT_HEADER, '\0');
+    encodeHeader((unsigned char *)&record[0], &h);
+    record += *payload;
+    putU32((unsigned char *)&record[4], crc32(record.data() + 8, record.size() - 8));
+    if (!writeAt(store->Pack, store->PackEnd, record.data(), (DWORD)record.size()) ||
+        !addToIndex(store, id, store->PackEnd))
+        return false;
+    store->LastOffset   = store->PackEnd;
+    store->LastData     = data;
+    store->PackEnd     += record.size();
+    return true;
+}
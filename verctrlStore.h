@@ -0,0 +1,50 @@
+/*
+*
+*
+* The source code contained in this listing contains proprietary and
+* confidential trade secrets of The MathWorks, Inc.  The use, modification,
+* or development of derivative work based on the code or ideas obtained
+* from the code is prohibited without the express written permission of The
+* MathWorks, Inc. The disclosure of this code to any party not authorized
+* by The MathWorks, Inc. is strictly forbidden.
+* CONFIDENTIAL AND CONTAINING PROPRIETARY TRADE SECRETS
+*/
+
+#ifndef VERCTRLSTORE_H
+#define VERCTRLSTORE_H
+
+#include <windows.h>
+#include <string>
+
+#include "verctrlHash.h"
+
+/*
+* Content addressed object store. Objects are appended to a pack file,
+* either whole or as a delta against an earlier object, and found through
+* an index file mapped into memory: an open addressing table from the
+* SHA-1 of an object's contents to its offset in the pack.
+*
+* A store is not thread-safe. Callers serialize access to it, and hold
+* lockObjectStore around every use when other processes may share the
+* directory. None of these functions use the MEX API.
+*/
+
+typedef struct OBJECTSTORE OBJECTSTORE;
+
+OBJECTSTORE *openObjectStore(const char *dir);
+void closeObjectStore(OBJECTSTORE *store);
+
+// Lock the store against other processes and pick up what they added.
+bool lockObjectStore(OBJECTSTORE *store);
+void unlockObjectStore(OBJECTSTORE *store);
+
+bool hasObject(OBJECTSTORE *store, const unsigned char id[SHA1_LEN]);
+
+// Add data, stored as a delta against base when that is much smaller.
+// base may be NULL. The object is durable once flushObjectStore returns.
+bool putObject(OBJECTSTORE *store, const std::string &data,
+               const unsigned char *base, unsigned char id[SHA1_LEN]);
+bool getObject(OBJECTSTORE *store, const unsigned char id[SHA1_LEN], std::string &data);
+bool flushObjectStore(OBJECTSTORE *store);
+
+#endif
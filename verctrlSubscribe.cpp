@@ -0,0 +1,418 @@
+/*
+*
+*
+* The source code contained in this listing contains proprietary and
+* confidential trade secrets of The MathWorks, Inc.  The use, modification,
+* or development of derivative work based on the code or ideas obtained
+* from the code is prohibited without the express written permission of The
+* MathWorks, Inc. The disclosure of this code to any party not authorized
+* by The MathWorks, Inc. is strictly forbidden.
+* CONFIDENTIAL AND CONTAINING PROPRIETARY TRADE SECRETS
+*/
+
+#include <windows.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+
+#include "scc.h"
+#include "verctrl.h"
+#include "verctrlRecord.h"
+#include "verctrlPath.h"
+#include "verctrlProvider.h"
+#include "verctrlCache.h"
+#include "verctrlJournal.h"
+#include "verctrlWatch.h"
+#include "verctrlSubscribe.h"
+
+// Changes are queried once none have been reported for this long, or
+// once the oldest has waited the longest delay.
+#define SUBSCRIBE_QUIET_MS      200
+#define SUBSCRIBE_MAX_DELAY_MS  2000
+
+#define SUBSCRIBE_MAX_BATCH     256         // files per SccQueryInfo
+
+// Events kept per subscription until drained. Past this they are
+// dropped and reported as lost.
+#define SUBSCRIBE_MAX_EVENTS    16384
+
+typedef struct SUBSCRIPTION {
+    int                     Id;
+    PATHID                  Folder;
+    std::string             LibPath;
+    std::string             ProjName;
+    std::string             AxPath;
+    int                     Watch;
+    std::set<PATHID>        Changed;    // reported by the watch, not yet queried
+    bool                    Lost;
+    std::map<PATHID, LONG>  Known;      // status last queried, of files that exist
+    std::map<PATHID, LONG>  Events;     // latest status per file, not yet drained
+    bool                    LostEvent;
+} SUBSCRIPTION;
+
+// Files of one subscription to query, taken out under the lock.
+typedef struct SUBSCRIBEWORK {
+    int                     Id;
+    PATHID                  Folder;
+    std::string             LibPath;
+    std::string             ProjName;
+    std::string             AxPath;
+    std::vector<PATHID>     Files;
+    std::vector<LONG>       Status;
+    std::vector<bool>       Queried;
+    std::vector<bool>       Exists;
+    bool                    Lost;
+} SUBSCRIBEWORK;
+
+static CRITICAL_SECTION                 gSubscribeLock;
+static CONDITION_VARIABLE               gSubscribeChanged;
+static volatile LONG                    gSubscribeLockReady = 0;
+static std::map<int, SUBSCRIPTION *>    gSubscriptions;
+static int                              gNextSubscription   = 1;
+static HANDLE                           gQueryThread        = NULL;
+static bool                             gStopQuery          = false;
+static ULONGLONG                        gFirstChange        = 0;    // GetTickCount64, 0 if none pending
+static ULONGLONG                        gLastChange         = 0;
+
+static void initSubscribeLock() {
+    if (InterlockedCompareExchange(&gSubscribeLockReady, 1, 0) == 0) {
+        InitializeCriticalSection(&gSubscribeLock);
+        InitializeConditionVariable(&gSubscribeChanged);
+        InterlockedExchange(&gSubscribeLockReady, 2);
+    }
+    while (gSubscribeLockReady != 2)
+        Sleep(0);
+}
+
+static void subscriptionChanged(void *context, int numberOfChanges, const PATHID *changes) {
+    SUBSCRIPTION *subscription = (SUBSCRIPTION *) context;
+    EnterCriticalSection(&gSubscribeLock);
+    for (int i = 0; i < numberOfChanges; i++) {
+        if (changes[i] == NO_PATH) {
+            subscription->Lost = true;
+            invalidateAllStatus();
+        } else {
+            subscription->Changed.insert(changes[i]);
+            invalidateStatus(changes[i]);
+        }
+    }
+    gLastChange = GetTickCount64();
+    if (gFirstChange == 0)
+        gFirstChange = gLastChange;
+    WakeAllConditionVariable(&gSubscribeChanged);
+    LeaveCriticalSection(&gSubscribeLock);
+}
+
+/*
+* Query the status of the files in work, a batch per folder. Runs on the
+* query thread without gSubscribeLock held.
+*/
+static void queryWork(SUBSCRIBEWORK *work) {
+    work->Status.assign(work->Files.size(), 0);
+    work->Queried.assign(work->Files.size(), false);
+    work->Exists.assign(work->Files.size(), false);
+    std::map<PATHID, std::vector<size_t> > byFolder;
+    for (size_t i = 0; i < work->Files.size(); i++) {
+        DWORD attr = GetFileAttributes(pathName(work->Files[i]));
+        work->Exists[i] = attr != INVALID_FILE_ATTRIBUTES;
+        if (attr == INVALID_FILE_ATTRIBUTES || (attr & FILE_ATTRIBUTE_DIRECTORY) == 0)
+            byFolder[parentPathId(work->Files[i])].push_back(i);
+    }
+
+    for (std::map<PATHID, std::vector<size_t> >::const_iterator it = byFolder.begin(); it != byFolder.end(); ++it) {
+        // Open the project saved for the folder, or else the subscribed one.
+        PATHID folder = it->first;
+        char projName[SCC_PRJPATH_LEN + 1];
+        char axPath[SCC_PRJPATH_LEN + 1];
+        if (!lookupProjectInfo(folder, projName, axPath)) {
+            folder = work->Folder;
+            strncpy(projName, work->ProjName.c_str(), SCC_PRJPATH_LEN);
+            projName[SCC_PRJPATH_LEN] = '\0';
+            strncpy(axPath, work->AxPath.c_str(), SCC_PRJPATH_LEN);
+            axPath[SCC_PRJPATH_LEN] = '\0';
+        }
+        SCCSESSION *session = acquireSessionForLib(work->LibPath.c_str(), NULL, folder);
+        if (session == NULL)
+            return;     // provider unloaded
+        SCCRTN rtn = SCC_OK;
+        if (session->CurrentFolder != folder)
+            rtn = openSessionProject(session, NULL, folder, projName, axPath);
+
+        const std::vector<size_t> &files = it->second;
+        for (size_t start = 0; start < files.size() && !IS_SCC_ERROR(rtn); start += SUBSCRIBE_MAX_BATCH) {
+            size_t count = files.size() - start;
+            if (count > SUBSCRIBE_MAX_BATCH)
+                count = SUBSCRIBE_MAX_BATCH;
+            std::vector<LPCSTR> names(count);
+            std::vector<LONG> status(count, 0);
+            for (size_t n = 0; n < count; n++)
+                names[n] = pathName(work->Files[files[start + n]]);
+            ULONGLONG epoch = getStatusEpoch();
+            SCCRECORD rec;
+            recordBegin(&rec, session->Provider->LibPath, session->Context, SCCPROC_QUERYINFO, (LONG)count, &names[0], NULL, 0);
+            rtn = (*(SccQueryInfo_PROC) session->Provider->Procs[SCCPROC_QUERYINFO])
+                (session->Context, (LONG)count, &names[0], &status[0]);
+            recordEnd(&rec, rtn, (LONG)count, &status[0], 0, NULL);
+            if (IS_SCC_ERROR(rtn))
+                break;
+            std::vector<PATHID> ids(count);
+            for (size_t n = 0; n < count; n++) {
+                ids[n] = work->Files[files[start + n]];
+                storeStatus(ids[n], status[n], epoch);
+            }
+            applyPendingJournalOps((int)count, &ids[0], &status[0]);
+            for (size_t n = 0; n < count; n++) {
+                size_t i = files[start + n];
+                work->Status[i]     = status[n];
+                work->Queried[i]    = true;
+            }
+        }
+        releaseSession(session);
+    }
+}
+
+/*
+* Take the changed files of the subscriptions into work. On the query
+* thread those of providers that are not reentrant are left for
+* querySubscriptionsHere; foreground takes only those, and only on the
+* thread the provider was loaded on. Called with gSubscribeLock held.
+*/
+static void takeWork(std::vector<SUBSCRIBEWORK> &work, bool foreground) {
+    for (std::map<int, SUBSCRIPTION *>::iterator it = gSubscriptions.begin(); it != gSubscriptions.end(); ++it) {
+        SUBSCRIPTION *subscription = it->second;
+        if (subscription->Changed.empty() && !subscription->Lost)
+            continue;
+        DWORD owner = providerOwnerThread(subscription->LibPath.c_str());
+        if (foreground ? owner != GetCurrentThreadId() : owner != 0)
+            continue;
+        work.push_back(SUBSCRIBEWORK());
+        SUBSCRIBEWORK &w    = work.back();
+        w.Id                = subscription->Id;
+        w.Folder            = subscription->Folder;
+        w.LibPath           = subscription->LibPath;
+        w.ProjName          = subscription->ProjName;
+        w.AxPath            = subscription->AxPath;
+        w.Files.assign(subscription->Changed.begin(), subscription->Changed.end());
+        w.Lost              = subscription->Lost;
+        subscription->Changed.clear();
+        subscription->Lost  = false;
+    }
+}
+
+/*
+* Forget the statuses of files below folders that were removed, which
+* the watch does not report one by one.
+*/
+static void forgetRemovedFolders(SUBSCRIPTION *subscription, const std::vector<PATHID> &removed) {
+    for (std::map<PATHID, LONG>::iterator it = subscription->Known.begin(); it != subscription->Known.end(); ) {
+        bool under = false;
+        for (size_t i = 0; i < removed.size() && !under; i++)
+            under = isPathUnder(it->first, removed[i]);
+        if (under)
+            subscription->Known.erase(it++);
+        else
+            ++it;
+    }
+}
+
+/*
+* Queue events for the statuses in work that changed. Files found
+* removed get their last event and are forgotten, so that Known only
+* holds files that exist. Called with gSubscribeLock held.
+*/
+static void finishWork(const std::vector<SUBSCRIBEWORK> &work) {
+    for (size_t w = 0; w < work.size(); w++) {
+        std::map<int, SUBSCRIPTION *>::iterator it = gSubscriptions.find(work[w].Id);
+        if (it == gSubscriptions.end())
+            continue;
+        SUBSCRIPTION *subscription = it->second;
+        if (work[w].Lost) {
+            subscription->LostEvent = true;
+            subscription->Known.clear();
+        }
+        std::vector<PATHID> removed;
+        for (size_t i = 0; i < work[w].Files.size(); i++) {
+            PATHID file = work[w].Files[i];
+            LONG status = work[w].Status[i];
+            std::map<PATHID, LONG>::iterator known = subscription->Known.find(file);
+            if (!work[w].Exists[i]) {
+                if (known == subscription->Known.end()) {
+                    // A folder, or a file created and deleted again, e.g.
+                    // by editors saving.
+                    removed.push_back(file);
+                    if (work[w].Queried[i] && status != SCC_STATUS_NOTCONTROLLED)
+                        subscription->Events[file] = status;
+                } else {
+                    if (work[w].Queried[i] && known->second != status)
+                        subscription->Events[file] = status;
+                    subscription->Known.erase(known);
+                }
+                continue;
+            }
+            if (!work[w].Queried[i] || (known != subscription->Known.end() && known->second == status))
+                continue;
+            subscription->Known[file]   = status;
+            subscription->Events[file]  = status;
+        }
+        if (!removed.empty() && !subscription->Known.empty())
+            forgetRemovedFolders(subscription, removed);
+        if (subscription->Events.size() > SUBSCRIBE_MAX_EVENTS) {
+            subscription->Events.clear();
+            subscription->LostEvent = true;
+        }
+    }
+}
+
+static DWORD WINAPI queryThread(LPVOID) {
+    EnterCriticalSection(&gSubscribeLock);
+    for (;;) {
+        while (!gStopQuery && gFirstChange == 0)
+            SleepConditionVariableCS(&gSubscribeChanged, &gSubscribeLock, INFINITE);
+
+        // Let the changes settle, so that saving a file that is written
+        // several times costs one query.
+        while (!gStopQuery) {
+            ULONGLONG now       = GetTickCount64();
+            ULONGLONG quietEnd  = gLastChange + SUBSCRIBE_QUIET_MS;
+            ULONGLONG deadline  = gFirstChange + SUBSCRIBE_MAX_DELAY_MS;
+            ULONGLONG until     = quietEnd < deadline ? quietEnd : deadline;
+            if (now >= until)
+                break;
+            SleepConditionVariableCS(&gSubscribeChanged, &gSubscribeLock, (DWORD)(until - now));
+        }
+        if (gStopQuery)
+            break;
+
+        std::vector<SUBSCRIBEWORK> work;
+        takeWork(work, false);
+        gFirstChange = 0;
+        LeaveCriticalSection(&gSubscribeLock);
+
+        for (size_t w = 0; w < work.size(); w++)
+            queryWork(&work[w]);
+
+        EnterCriticalSection(&gSubscribeLock);
+        finishWork(work);
+    }
+    LeaveCriticalSection(&gSubscribeLock);
+    return 0;
+}
+
+int subscribeFolder(PATHID folder, const char *libPath, const char *projName, const char *axPath) {
+    initSubscribeLock();
+    SUBSCRIPTION *subscription  = new SUBSCRIPTION;
+    subscription->Folder        = folder;
+    subscription->LibPath       = libPath;
+    subscription->ProjName      = projName;
+    subscription->AxPath        = axPath;
+    subscription->Lost          = false;
+    subscription->LostEvent     = false;
+
+    EnterCriticalSection(&gSubscribeLock);
+    subscription->Id = gNextSubscription++;
+    if (gQueryThread == NULL) {
+        gStopQuery      = false;
+        gQueryThread    = CreateThread(NULL, 0, queryThread, NULL, 0, NULL);
+    }
+    bool ok = gQueryThread != NULL;
+    if (ok)
+        gSubscriptions[subscription->Id] = subscription;
+    LeaveCriticalSection(&gSubscribeLock);
+
+    // Not under the lock, which the watch callback takes.
+    subscription->Watch = ok ? addWatch(folder, subscriptionChanged, subscription) : -1;
+    if (subscription->Watch < 0) {
+        int id = subscription->Id;
+        EnterCriticalSection(&gSubscribeLock);
+        gSubscriptions.erase(id);
+        LeaveCriticalSection(&gSubscribeLock);
+        delete subscription;
+        return -1;
+    }
+    return subscription->Id;
+}
+
+void unsubscribeFolder(int id) {
+    if (gSubscribeLockReady != 2)
+        return;
+    EnterCriticalSection(&gSubscribeLock);
+    SUBSCRIPTION *subscription = NULL;
+    std::map<int, SUBSCRIPTION *>::iterator it = gSubscriptions.find(id);
+    if (it != gSubscriptions.end()) {
+        subscription = it->second;
+        gSubscriptions.erase(it);
+    }
+    LeaveCriticalSection(&gSubscribeLock);
+    if (subscription != NULL) {
+        removeWatch(subscription->Watch);
+        delete subscription;
+    }
+}
+
+void stopSubscriptions() {
+    if (gSubscribeLockReady != 2)
+        return;
+    EnterCriticalSection(&gSubscribeLock);
+    std::map<int, SUBSCRIPTION *> subscriptions;
+    subscriptions.swap(gSubscriptions);
+    HANDLE thread   = gQueryThread;
+    gQueryThread    = NULL;
+    gStopQuery      = true;
+    gFirstChange    = 0;
+    WakeAllConditionVariable(&gSubscribeChanged);
+    LeaveCriticalSection(&gSubscribeLock);
+    if (thread != NULL) {
+        WaitForSingleObject(thread, INFINITE);
+        CloseHandle(thread);
+    }
+    for (std::map<int, SUBSCRIPTION *>::iterator it = subscriptions.begin(); it != subscriptions.end(); ++it) {
+        removeWatch(it->second->Watch);
+        delete it->second;
+    }
+}
+
+void querySubscriptionsHere() {
+    if (gSubscribeLockReady != 2)
+        return;
+    EnterCriticalSection(&gSubscribeLock);
+    std::vector<SUBSCRIBEWORK> work;
+    takeWork(work, true);
+    LeaveCriticalSection(&gSubscribeLock);
+    if (work.empty())
+        return;
+
+    for (size_t w = 0; w < work.size(); w++)
+        queryWork(&work[w]);
+
+    EnterCriticalSection(&gSubscribeLock);
+    finishWork(work);
+    LeaveCriticalSection(&gSubscribeLock);
+}
+
+void drainStatusEvents(int subscription, std::vector<STATUSEVENT> &events) {
+    if (gSubscribeLockReady != 2)
+        return;
+    EnterCriticalSection(&gSubscribeLock);
+    for (std::map<int, SUBSCRIPTION *>::iterator it = gSubscriptions.begin(); it != gSubscriptions.end(); ++it) {
+        if (subscription != 0 && it->first != subscription)
+            continue;
+        SUBSCRIPTION *s = it->second;
+        STATUSEVENT event;
+        event.Subscription = s->Id;
+        if (s->LostEvent) {
+            event.File      = NO_PATH;
+            event.Status    = 0;
+            events.push_back(event);
+            s->LostEvent    = false;
+        }
+        for (std::map<PATHID, LONG>::const_iterator e = s->Events.begin(); e != s->Events.end(); ++e) {
+            event.File      = e->first;
+            event.Status    = e->second;
+            events.push_back(event);
+        }
+        s->Events.clear();
+    }
+    LeaveCriticalSection(&gSubscribeLock);
+}
@@ -0,0 +1,54 @@
+/*
+*
+*
+* The source code contained in this listing contains proprietary and
+* confidential trade secrets of The MathWorks, Inc.  The use, modification,
+* or development of derivative work based on the code or ideas obtained
+* from the code is prohibited without the express written permission of The
+* MathWorks, Inc. The disclosure of this code to any party not authorized
+* by The MathWorks, Inc. is strictly forbidden.
+* CONFIDENTIAL AND CONTAINING PROPRIETARY TRADE SECRETS
+*/
+
+#ifndef VERCTRLSUBSCRIBE_H
+#define VERCTRLSUBSCRIBE_H
+
+#include <windows.h>
+#include <vector>
+
+#include "verctrlPath.h"
+
+/*
+* Status subscriptions. Files changed below a subscribed folder are
+* queried again on a background thread, in one batch once changes have
+* settled, and an event is queued for each file whose status is not what
+* was last queried. Events not drained are kept up to a bound, past
+* which they are reported as lost. The status cache is kept up to date
+* as a side effect.
+* Providers that are not reentrant are only queried by
+* querySubscriptionsHere, on the thread that loaded them.
+*
+* All functions are thread-safe and none of them use the MEX API.
+*/
+
+typedef struct STATUSEVENT {
+    int             Subscription;
+    PATHID          File;       // NO_PATH: changes were lost, so any file may have changed
+    LONG            Status;
+} STATUSEVENT;
+
+// The provider must already be loaded. Returns the subscription id, or
+// -1 if the folder cannot be watched.
+int subscribeFolder(PATHID folder, const char *libPath, const char *projName, const char *axPath);
+void unsubscribeFolder(int id);
+void stopSubscriptions();
+
+// Query the changed files of subscriptions whose provider can only be
+// called on this thread.
+void querySubscriptionsHere();
+
+// Take the events queued for a subscription, or for all of them if
+// subscription is 0.
+void drainStatusEvents(int subscription, std::vector<STATUSEVENT> &events);
+
+#endif
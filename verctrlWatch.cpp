@@ -0,0 +1,240 @@
+/*
+*
+*
+* The source code contained in this listing contains proprietary and
+* confidential trade secrets of The MathWorks, Inc.  The use, modification,
+* or development of derivative work based on the code or ideas obtained
+* from the code is prohibited without the express written permission of The
+* MathWorks, Inc. The disclosure of this code to any party not authorized
+* by The MathWorks, Inc. is strictly forbidden.
+* CONFIDENTIAL AND CONTAINING PROPRIETARY TRADE SECRETS
+*/
+
+#include <windows.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <map>
+
+#include "verctrlPath.h"
+#include "verctrlWatch.h"
+
+// Changes the system buffers between reads. Past this it reports that
+// changes were lost. Must be below 64 KB for network folders.
+#define WATCH_BUFFER_BYTES  (60 * 1024)
+
+#define WATCH_FILTER        (FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME | \
+                             FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE | \
+                             FILE_NOTIFY_CHANGE_ATTRIBUTES)
+
+typedef struct WATCHLISTENER {
+    int             Id;
+    WATCHCALLBACK   Callback;
+    void           *Context;
+} WATCHLISTENER;
+
+typedef struct WATCHER {
+    PATHID                      Folder;
+    HANDLE                      Dir;
+    HANDLE                      Stop;
+    HANDLE                      Thread;
+    volatile bool               Running;
+    std::vector<WATCHLISTENER>  Listeners;
+} WATCHER;
+
+static SRWLOCK                      gWatchLock  = SRWLOCK_INIT;
+static std::map<PATHID, WATCHER *>  gWatchers;
+static int                          gNextWatchId = 1;
+
+/*
+* Pass changes to the watcher's listeners.
+*/
+static void notify(WATCHER *watcher, const std::vector<PATHID> &changes) {
+    if (changes.empty())
+        return;
+    AcquireSRWLockShared(&gWatchLock);
+    for (size_t i = 0; i < watcher->Listeners.size(); i++) {
+        const WATCHLISTENER &listener = watcher->Listeners[i];
+        listener.Callback(listener.Context, (int)changes.size(), &changes[0]);
+    }
+    ReleaseSRWLockShared(&gWatchLock);
+}
+
+static void readChanges(WATCHER *watcher, const BYTE *buffer, DWORD length, std::vector<PATHID> &changes) {
+    std::string folder = pathName(watcher->Folder);
+    DWORD offset = 0;
+    while (offset + sizeof(FILE_NOTIFY_INFORMATION) <= length) {
+        const FILE_NOTIFY_INFORMATION *info = (const FILE_NOTIFY_INFORMATION *)(buffer + offset);
+        int wideLength = (int)(info->FileNameLength / sizeof(WCHAR));
+        int nameLength = WideCharToMultiByte(CP_ACP, 0, info->FileName, wideLength, NULL, 0, NULL, NULL);
+        if (nameLength > 0) {
+            std::string name(nameLength, '\0');
+            WideCharToMultiByte(CP_ACP, 0, info->FileName, wideLength, &name[0], nameLength, NULL, NULL);
+            PATHID id = internPath((folder + "\\" + name).c_str());
+            if (changes.empty() || changes.back() != id)
+                changes.push_back(id);
+        }
+        if (info->NextEntryOffset == 0)
+            break;
+        offset += info->NextEntryOffset;
+    }
+}
+
+static DWORD WINAPI watchThread(LPVOID arg) {
+    WATCHER *watcher = (WATCHER *) arg;
+    std::vector<DWORD> buffer(WATCH_BUFFER_BYTES / sizeof(DWORD));
+    OVERLAPPED overlapped;
+    memset(&overlapped, 0, sizeof(overlapped));
+    overlapped.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+    HANDLE events[2] = {watcher->Stop, overlapped.hEvent};
+    std::vector<PATHID> changes;
+    std::vector<PATHID> lost(1, NO_PATH);
+
+    while (overlapped.hEvent != NULL) {
+        ResetEvent(overlapped.hEvent);
+        if (!ReadDirectoryChangesW(watcher->Dir, &buffer[0], (DWORD)(buffer.size() * sizeof(DWORD)),
+                TRUE, WATCH_FILTER, NULL, &overlapped, NULL))
+            break;
+        if (WaitForMultipleObjects(2, events, FALSE, INFINITE) != WAIT_OBJECT_0 + 1) {
+            DWORD unused;
+            CancelIoEx(watcher->Dir, &overlapped);
+            GetOverlappedResult(watcher->Dir, &overlapped, &unused, TRUE);
+            CloseHandle(overlapped.hEvent);
+            return 0;
+        }
+        DWORD length = 0;
+        if (!GetOverlappedResult(watcher->Dir, &overlapped, &length, FALSE)) {
+            if (GetLastError() != ERROR_NOTIFY_ENUM_DIR)
+                break;
+            length = 0;
+        }
+        if (length == 0) {
+            // Too many changes to fit in the buffer.
+            notify(watcher, lost);
+            continue;
+        }
+        changes.clear();
+        readChanges(watcher, (const BYTE *)&buffer[0], length, changes);
+        notify(watcher, changes);
+    }
+
+    // The folder was deleted, or cannot be watched.
+    watcher->Running = false;
+    notify(watcher, lost);
+    if (overlapped.hEvent != NULL)
+        CloseHandle(overlapped.hEvent);
+    return 0;
+}
+
+static void deleteWatcher(WATCHER *watcher) {
+    if (watcher->Thread != NULL) {
+        SetEvent(watcher->Stop);
+        WaitForSingleObject(watcher->Thread, INFINITE);
+        CloseHandle(watcher->Thread);
+    }
+    if (watcher->Stop != NULL)
+        CloseHandle(watcher->Stop);
+    if (watcher->Dir != INVALID_HANDLE_VALUE)
+        CloseHandle(watcher->Dir);
+    delete watcher;
+}
+
+static WATCHER *newWatcher(PATHID folder) {
+    std::string name;
+    longPathName(folder, name);
+    WATCHER *watcher    = new WATCHER;
+    watcher->Folder     = folder;
+    watcher->Dir        = CreateFile(name.c_str(), FILE_LIST_DIRECTORY,
+        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING,
+        FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, NULL);
+    watcher->Stop       = CreateEvent(NULL, TRUE, FALSE, NULL);
+    watcher->Thread     = NULL;
+    watcher->Running    = true;
+    if (watcher->Dir != INVALID_HANDLE_VALUE && watcher->Stop != NULL)
+        watcher->Thread = CreateThread(NULL, 0, watchThread, watcher, 0, NULL);
+    return watcher;
+}
+
+int addWatch(PATHID folder, WATCHCALLBACK callback, void *context) {
+    WATCHER *unused = NULL;
+    AcquireSRWLockExclusive(&gWatchLock);
+    std::map<PATHID, WATCHER *>::iterator it = gWatchers.find(folder);
+    WATCHER *watcher = (it != gWatchers.end()) ? it->second : NULL;
+    if (watcher == NULL || !watcher->Running) {
+        // A watcher whose folder was deleted is replaced once the folder
+        // can be watched again, and its watches move to the new one.
+        WATCHER *started = newWatcher(folder);
+        if (started->Thread == NULL) {
+            ReleaseSRWLockExclusive(&gWatchLock);
+            deleteWatcher(started);
+            return -1;
+        }
+        if (watcher != NULL) {
+            started->Listeners.swap(watcher->Listeners);
+            unused = watcher;
+        }
+        watcher = started;
+        gWatchers[folder] = watcher;
+    }
+    WATCHLISTENER listener;
+    listener.Id         = gNextWatchId++;
+    listener.Callback   = callback;
+    listener.Context    = context;
+    watcher->Listeners.push_back(listener);
+    ReleaseSRWLockExclusive(&gWatchLock);
+
+    // Its thread may be waiting for the lock to notify no one.
+    if (unused != NULL)
+        deleteWatcher(unused);
+    return listener.Id;
+}
+
+void removeWatch(int id) {
+    WATCHER *unused = NULL;
+    AcquireSRWLockExclusive(&gWatchLock);
+    bool found = false;
+    for (std::map<PATHID, WATCHER *>::iterator it = gWatchers.begin(); it != gWatchers.end() && !found; ++it) {
+        std::vector<WATCHLISTENER> &listeners = it->second->Listeners;
+        for (size_t i = 0; i < listeners.size() && !found; i++) {
+            if (listeners[i].Id == id) {
+                listeners.erase(listeners.begin() + i);
+                found = true;
+            }
+        }
+        if (found && listeners.empty()) {
+            unused = it->second;
+            gWatchers.erase(it);
+            break;
+        }
+    }
+    ReleaseSRWLockExclusive(&gWatchLock);
+
+    // Its thread may be waiting for the lock to notify no one.
+    if (unused != NULL)
+        deleteWatcher(unused);
+}
+
+void removeAllWatches() {
+    AcquireSRWLockExclusive(&gWatchLock);
+    std::map<PATHID, WATCHER *> watchers;
+    watchers.swap(gWatchers);
+    for (std::map<PATHID, WATCHER *>::iterator it = watchers.begin(); it != watchers.end(); ++it)
+        it->second->Listeners.clear();
+    ReleaseSRWLockExclusive(&gWatchLock);
+    for (std::map<PATHID, WATCHER *>::iterator it = watchers.begin(); it != watchers.end(); ++it)
+        deleteWatcher(it->second);
+}
+
+bool isWatching(int id) {
+    bool watching = false;
+    AcquireSRWLockShared(&gWatchLock);
+    for (std::map<PATHID, WATCHER *>::const_iterator it = gWatchers.begin(); it != gWatchers.end(); ++it) {
+        const std::vector<WATCHLISTENER> &listeners = it->second->Listeners;
+        for (size_t i = 0; i < listeners.size(); i++) {
+            if (listeners[i].Id == id)
+                watching = it->second->Running;
+        }
+    }
+    ReleaseSRWLockShared(&gWatchLock);
+    return watching;
+}
@@ -0,0 +1,45 @@
+/*
+*
+*
+* The source code contained in this listing contains proprietary and
+* confidential trade secrets of The MathWorks, Inc.  The use, modification,
+* or development of derivative work based on the code or ideas obtained
+* from the code is prohibited without the express written permission of The
+* MathWorks, Inc. The disclosure of this code to any party not authorized
+* by The MathWorks, Inc. is strictly forbidden.
+* CONFIDENTIAL AND CONTAINING PROPRIETARY TRADE SECRETS
+*/
+
+#ifndef VERCTRLWATCH_H
+#define VERCTRLWATCH_H
+
+#include "verctrlPath.h"
+
+/*
+* Folder watches. Each watched folder has one thread waiting on
+* ReadDirectoryChangesW for changes anywhere below it, shared by every
+* watch on that folder.
+*
+* Callbacks run on the watching thread with the paths that changed. A
+* NO_PATH entry means changes were lost, so anything below the folder may
+* have changed. Callbacks must be quick and must not add or remove
+* watches.
+*
+* All functions are thread-safe and none of them use the MEX API.
+*/
+
+typedef void (*WATCHCALLBACK)(void *context, int numberOfChanges, const PATHID *changes);
+
+// Returns a watch id, or -1 if the folder cannot be watched.
+int addWatch(PATHID folder, WATCHCALLBACK callback, void *context);
+
+// Once this returns the callback is not running and will not be called.
+void removeWatch(int id);
+void removeAllWatches();
+
+// False once the watch has stopped seeing changes, e.g. because its
+// folder was deleted, until addWatch is called for the folder again and
+// it can be watched.
+bool isWatching(int id);
+
+#endif